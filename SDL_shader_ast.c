@@ -25,6 +25,7 @@
         retval->ast.filename = ctx->filename; \
         retval->ast.line = ctx->position; \
         retval->ast.dt = NULL; \
+        retval->ast.constant = NULL; \
     } while (0)
 
 #define DELETE_AST_NODE(cls) do { \
@@ -98,6 +99,7 @@ static SDL_SHADER_AstExpression *new_identifier_expression(Context *ctx, const c
 {
     NEW_AST_NODE(retval, SDL_SHADER_AstIdentifierExpression, SDL_SHADER_AST_OP_IDENTIFIER);
     retval->name = name;  /* strcache'd */
+    retval->vardecl = NULL;
     return (SDL_SHADER_AstExpression *) retval;
 }
 
@@ -182,6 +184,7 @@ static SDL_SHADER_AstExpression *new_fncall_expression(Context *ctx, const char
     retval->fnname = fnname;  /* strcache'd */
     retval->arguments = arguments;
     retval->fn = NULL;
+    retval->intrinsic = NULL;
     return (SDL_SHADER_AstExpression *) retval;
 }
 
@@ -388,6 +391,8 @@ static SDL_SHADER_AstVarDeclaration *new_var_declaration(Context *ctx, int c_sty
     retval->name = name; /* strcache'd */
     retval->arraybounds = arraybounds;
     retval->attribute = attribute;
+    retval->assigned = SDL_FALSE;
+    retval->varindex = 0;
     return retval;
 }
 
@@ -787,7 +792,10 @@ static SDL_SHADER_AstFunction *new_function(Context *ctx, int c_style, const cha
     retval->vardecl = new_var_declaration(ctx, c_style, rettype, name, NULL, atattr);
     retval->params = params;  /* NULL==void */
     retval->code = code;
+    retval->reachable = SDL_FALSE;  /* until semantic analysis */
+    retval->precise = SDL_FALSE;  /* until semantic analysis */
     retval->nextfn = NULL;
+    retval->fnindex = 0;
     return retval;
 }
 
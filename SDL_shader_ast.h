@@ -138,6 +138,8 @@ typedef enum SDL_SHADER_AstNodeType
 
 
 typedef struct SDL_SHADER_AstDataType SDL_SHADER_AstDataType;  /* this is opaque to external apps, for now at least. */
+typedef struct SDL_SHADER_AstConstant SDL_SHADER_AstConstant;  /* this is opaque to external apps, for now at least. */
+typedef struct SDL_SHADER_AstIntrinsic SDL_SHADER_AstIntrinsic;  /* this is opaque to external apps, for now at least. */
 
 typedef struct SDL_SHADER_AstNodeInfo
 {
@@ -146,6 +148,7 @@ typedef struct SDL_SHADER_AstNodeInfo
     size_t line;
     /* !!! FIXME: position */
     const SDL_SHADER_AstDataType *dt;  /* this is NULL for everything before semantic analysis. Not every node has a datatype. */
+    const SDL_SHADER_AstConstant *constant;  /* NULL unless semantic analysis worked out this node's value at compile time. */
 } SDL_SHADER_AstNodeInfo;
 
 /* You can cast any AST node pointer to this. */
@@ -188,10 +191,13 @@ typedef struct SDL_SHADER_AstTernaryExpression
     SDL_SHADER_AstExpression *right;
 } SDL_SHADER_AstTernaryExpression;
 
+struct SDL_SHADER_AstVarDeclaration;
+
 typedef struct SDL_SHADER_AstIdentifierExpression
 {
     SDL_SHADER_AstNodeInfo ast;
     const char *name;
+    struct SDL_SHADER_AstVarDeclaration *vardecl;  /* always NULL until semantic analysis; the variable or function parameter this names. */
 } SDL_SHADER_AstIdentifierExpression;
 
 typedef struct SDL_SHADER_AstIntLiteralExpression
@@ -238,7 +244,8 @@ typedef struct SDL_SHADER_AstFunctionCallExpression
     SDL_SHADER_AstNodeInfo ast;
     const char *fnname;
     SDL_SHADER_AstArguments *arguments;  /* NULL if there are no arguments ("()") */
-    struct SDL_SHADER_AstFunction *fn;  /* always NULL until semantic analysis (and will remain NULL for constructors) */
+    struct SDL_SHADER_AstFunction *fn;  /* always NULL until semantic analysis (and will remain NULL for constructors and intrinsics) */
+    const SDL_SHADER_AstIntrinsic *intrinsic;  /* always NULL until semantic analysis (and will remain NULL for constructors and user-defined functions) */
 } SDL_SHADER_AstFunctionCallExpression;
 
 typedef struct SDL_SHADER_AstArrayBounds
@@ -262,6 +269,8 @@ typedef struct SDL_SHADER_AstVarDeclaration
     const char *name;
     SDL_SHADER_AstArrayBoundsList *arraybounds;
     SDL_SHADER_AstAtAttribute *attribute;
+    SDL_bool assigned;  /* SDL_FALSE until semantic analysis; SDL_TRUE if anything writes to this variable after it is declared. */
+    Uint32 varindex;  /* code generation uses this, you should ignore it. */
 } SDL_SHADER_AstVarDeclaration;
 
 typedef struct SDL_SHADER_AstStructMember
@@ -467,7 +476,10 @@ typedef struct SDL_SHADER_AstFunction
     SDL_SHADER_AstVarDeclaration *vardecl;
     SDL_SHADER_AstFunctionParams *params;  /* NULL==void */
     SDL_SHADER_AstStatementBlock *code;
+    SDL_bool reachable;  /* SDL_FALSE until semantic analysis; SDL_TRUE if an entry point might call this function. */
+    SDL_bool precise;  /* SDL_FALSE until semantic analysis; SDL_TRUE if it has a `@precise` attribute, so fast-math shortcuts aren't allowed in it. */
     struct SDL_SHADER_AstFunction *nextfn;  /* semantic analysis uses this, you should ignore it. */
+    Uint32 fnindex;  /* code generation uses this, you should ignore it. */
 } SDL_SHADER_AstFunction;
 
 typedef struct SDL_SHADER_AstTranslationUnit
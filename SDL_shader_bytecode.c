@@ -0,0 +1,1260 @@
+/**
+ * SDL_shader_tools; tools for SDL GPU shader support.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+#define __SDL_SHADER_INTERNAL__ 1
+#include "SDL_shader_internal.h"
+
+/* Things for reading and writing bytecode that don't need a compiler around, so
+   the bytecode dumper (and anything else that loads bytecode) can use them, too. */
+
+/* CRC-32 is the zlib one (reflected polynomial 0xEDB88320). The portable version
+   does eight bytes at a time with "slice-by-8" tables. x86 and x86-64 CPUs with
+   PCLMULQDQ fold 64 bytes at a time with carry-less multiplies instead, which we
+   check for when we first need it. ARM CPUs with the CRC32 extension have
+   instructions for exactly this CRC, but we only use them if the compiler was
+   told the target has them, since there isn't a portable way to ask at runtime. */
+
+#define CRC32_POLY 0xEDB88320
+
+#if defined(__ARM_FEATURE_CRC32)
+#define CRC32_ARM 1
+#include <arm_acle.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32_PCLMUL 1
+#include <cpuid.h>
+#include <immintrin.h>
+#define CRC32_PCLMUL_TARGET __attribute__((target("pclmul,sse4.1")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define CRC32_PCLMUL 1
+#include <intrin.h>
+#include <immintrin.h>
+#define CRC32_PCLMUL_TARGET
+#endif
+
+static Uint32 crc32_tables[8][256];
+static SDL_bool crc32_use_pclmul = SDL_FALSE;
+static SDL_atomic_t crc32_initialized;
+
+/* if two threads get here at once, they both write the same values, so that's okay. */
+static void crc32_init(void)
+{
+    Uint32 i, j;
+
+    for (i = 0; i < 256; i++) {
+        Uint32 crc = i;
+        for (j = 0; j < 8; j++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ CRC32_POLY) : (crc >> 1);
+        }
+        crc32_tables[0][i] = crc;
+    }
+
+    /* crc32_tables[n][i] is the CRC of byte i followed by n zero bytes. */
+    for (i = 0; i < 256; i++) {
+        for (j = 1; j < 8; j++) {
+            const Uint32 prev = crc32_tables[j - 1][i];
+            crc32_tables[j][i] = (prev >> 8) ^ crc32_tables[0][prev & 0xFF];
+        }
+    }
+
+    #if defined(CRC32_PCLMUL) && defined(_MSC_VER)
+    {
+        int regs[4];
+        __cpuid(regs, 1);
+        crc32_use_pclmul = ((regs[2] & (1 << 1)) && (regs[2] & (1 << 19))) ? SDL_TRUE : SDL_FALSE;  /* PCLMULQDQ and SSE4.1 */
+    }
+    #elif defined(CRC32_PCLMUL)
+    {
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            crc32_use_pclmul = ((ecx & bit_PCLMUL) && (ecx & bit_SSE4_1)) ? SDL_TRUE : SDL_FALSE;
+        }
+    }
+    #endif
+
+    SDL_AtomicSet(&crc32_initialized, 1);
+}
+
+static Uint32 crc32_bytes(Uint32 crc, const Uint8 *data, size_t len)
+{
+    while (len--) {
+        crc = (crc >> 8) ^ crc32_tables[0][(crc ^ *(data++)) & 0xFF];
+    }
+    return crc;
+}
+
+static Uint32 crc32_slice8(Uint32 crc, const Uint8 *data, size_t len)
+{
+    while (len >= 8) {
+        /* reading a byte at a time keeps this right on big-endian CPUs; compilers make this one load on little-endian ones. */
+        const Uint32 lo = crc ^ (((Uint32) data[0]) | (((Uint32) data[1]) << 8) | (((Uint32) data[2]) << 16) | (((Uint32) data[3]) << 24));
+        const Uint32 hi = ((Uint32) data[4]) | (((Uint32) data[5]) << 8) | (((Uint32) data[6]) << 16) | (((Uint32) data[7]) << 24);
+        crc = crc32_tables[7][lo & 0xFF] ^ crc32_tables[6][(lo >> 8) & 0xFF] ^
+              crc32_tables[5][(lo >> 16) & 0xFF] ^ crc32_tables[4][lo >> 24] ^
+              crc32_tables[3][hi & 0xFF] ^ crc32_tables[2][(hi >> 8) & 0xFF] ^
+              crc32_tables[1][(hi >> 16) & 0xFF] ^ crc32_tables[0][hi >> 24];
+        data += 8;
+        len -= 8;
+    }
+    return crc32_bytes(crc, data, len);
+}
+
+#ifdef CRC32_ARM
+static Uint32 crc32_arm(Uint32 crc, const Uint8 *data, size_t len)
+{
+    while ((len > 0) && (((size_t) data) & 7)) {
+        crc = __crc32b(crc, *(data++));
+        len--;
+    }
+    while (len >= 8) {
+        Uint64 val;
+        SDL_memcpy(&val, data, 8);
+        crc = __crc32d(crc, val);
+        data += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = __crc32b(crc, *(data++));
+    }
+    return crc;
+}
+#endif
+
+#ifdef CRC32_PCLMUL
+/* Folds four 128-bit lanes at a time, then folds those down to one and does a
+   Barrett reduction to 32 bits ("Fast CRC Computation for Generic Polynomials
+   Using PCLMULQDQ Instruction", Intel, 2009; these are the constants for the
+   reflected zlib polynomial). `len` must be at least 64 and a multiple of 16. */
+CRC32_PCLMUL_TARGET static Uint32 crc32_pclmul(Uint32 crc, const Uint8 *data, size_t len)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596LL, 0x0154442BD4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009ELL, 0x01751997D0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163CD6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01F7011641LL, 0x01DB710641LL);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (data + 0x00)), _mm_cvtsi32_si128((int) crc));
+    x2 = _mm_loadu_si128((const __m128i *) (data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *) (data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *) (data + 0x30));
+    data += 64;
+    len -= 64;
+
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *) (data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *) (data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *) (data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *) (data + 0x30)));
+        data += 64;
+        len -= 64;
+    }
+
+    /* fold the four lanes into one. */
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+
+    while (len >= 16) {
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_loadu_si128((const __m128i *) data)), x5);
+        data += 16;
+        len -= 16;
+    }
+
+    /* 128 bits down to 64. */
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5k0, 0x00), x2);
+
+    /* Barrett reduction down to 32. */
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (Uint32) _mm_extract_epi32(x1, 1);
+}
+#endif
+
+Uint32 SDL_SHADER_BytecodeCrc32(Uint32 crc, const void *_data, size_t len)
+{
+    const Uint8 *data = (const Uint8 *) _data;
+
+    if (!SDL_AtomicGet(&crc32_initialized)) {
+        crc32_init();
+    }
+
+    crc ^= 0xFFFFFFFF;
+
+    #if defined(CRC32_ARM)
+    crc = crc32_arm(crc, data, len);
+    #else
+    #if defined(CRC32_PCLMUL)
+    if (crc32_use_pclmul && (len >= 64)) {
+        const size_t simdlen = len & ~((size_t) 15);
+        crc = crc32_pclmul(crc, data, simdlen);
+        data += simdlen;
+        len -= simdlen;
+    }
+    #endif
+    crc = crc32_slice8(crc, data, len);
+    #endif
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+/* multiplies two polynomials modulo the CRC polynomial (bit 31 is x^0, since the CRC is reflected). */
+static Uint32 crc32_multiply(Uint32 a, Uint32 b)
+{
+    Uint32 m = ((Uint32) 1) << 31;
+    Uint32 p = 0;
+
+    while (a != 0) {
+        if (a & m) {
+            p ^= b;
+            a &= ~m;
+        }
+        m >>= 1;
+        b = (b & 1) ? ((b >> 1) ^ CRC32_POLY) : (b >> 1);
+    }
+    return p;
+}
+
+Uint32 SDL_SHADER_BytecodeCrc32Combine(Uint32 crc1, Uint32 crc2, size_t len2)
+{
+    Uint32 xpow = ((Uint32) 1) << 30;  /* x^1 */
+    Uint32 shift = ((Uint32) 1) << 31;  /* x^0; ends up as x^(len2 * 8). */
+    int i;
+
+    /* appending len2 bytes multiplies crc1 by x^(len2 * 8): square our way up from x^8. */
+    for (i = 0; i < 3; i++) {
+        xpow = crc32_multiply(xpow, xpow);
+    }
+
+    while (len2 != 0) {
+        if (len2 & 1) {
+            shift = crc32_multiply(xpow, shift);
+        }
+        xpow = crc32_multiply(xpow, xpow);
+        len2 >>= 1;
+    }
+
+    return crc32_multiply(shift, crc1) ^ crc2;
+}
+
+
+/* The verifier makes one pass over the bytecode, start to end. It can do this
+   because SSA ids are numbered in the order they're defined: a new id has to be
+   the next one in line, so anything lower is already defined, and anything else
+   isn't. The only things allowed to look ahead are the PHIs at the start of a
+   LOOP, which we check once we get to the end of it.
+
+   Being defined isn't enough, though: an id made inside an IF or LOOP can't be
+   used once that code is done (except by the PHIs right after it, and see
+   verify_end_block() for what can get out anyhow). So as each id is defined, we
+   note how deep in the block stack it was made, in a table with a byte per id.
+   A block's code only ever defines ids from the one it started with on up, so
+   the id is still usable if its level is still open and it isn't older than the
+   code that's open there now; when an IF or LOOP lets some ids out, they move up
+   a level. That makes checking a use a table lookup. The table is the only thing
+   we allocate, and it's a byte for every five words of the biggest function. */
+
+typedef enum VerifyBlockType
+{
+    VERIFY_BLOCK_FUNCTION,
+    VERIFY_BLOCK_IF_TRUE,
+    VERIFY_BLOCK_IF_FALSE,
+    VERIFY_BLOCK_LOOP
+} VerifyBlockType;
+
+typedef enum VerifyPhiState
+{
+    VERIFY_PHI_NOT_ALLOWED,
+    VERIFY_PHI_AFTER_IF,
+    VERIFY_PHI_AFTER_LOOP,
+    VERIFY_PHI_LOOP_START
+} VerifyPhiState;
+
+typedef struct VerifyBlock
+{
+    VerifyBlockType type;
+    size_t pos;  /* word where this block's IF or LOOP starts. */
+    size_t end;  /* word just past the end of this block. */
+    size_t true_end;  /* IFs: where the "true" code ends and the "false" code starts. */
+    Uint32 first_id;  /* the first SSA id defined inside it. */
+    Uint32 scope_id;  /* the first SSA id defined in the code we're in now (for IFs, the "true" or "false" code). */
+    Uint32 prefix_end_id;  /* LOOPs: next_id when we got to its first IF, LOOP or BREAK, zero if we haven't yet. */
+    SDL_bool reaches_end;  /* SDL_FALSE once the code we're in now RETURNs, BREAKs, etc, so its end can't be reached. */
+    SDL_bool true_reaches_end;  /* IFs: reaches_end for the "true" code, once we're in the "false" code. */
+    Uint32 max_forward_id;  /* LOOPs: biggest id its PHIs used before it was defined, zero if none. */
+    Uint32 num_phi_inputs;  /* LOOPs: how many inputs its PHIs have, zero if there aren't any. */
+    Uint32 num_breaks;  /* LOOPs: BREAKs out of it. */
+    Uint32 num_continues;  /* LOOPs: CONTINUEs in it. */
+    int loop;  /* index of the innermost LOOP in the stack, -1 if we aren't in one. */
+} VerifyBlock;
+
+typedef struct Verifier
+{
+    const Uint8 *data;
+    size_t num_words;
+    char *errbuf;
+    size_t errbuflen;
+    Uint32 version;
+    Uint32 num_types;
+    size_t directory;  /* word where the directory starts, zero if there isn't one. */
+    Uint32 directory_functions;
+    Uint32 directory_buckets;
+    Uint32 directory_entry_points;  /* buckets that aren't empty. */
+    Uint32 num_functions;  /* so far. */
+    Uint32 num_exported;  /* so far. */
+    Uint32 max_call;  /* biggest function index a CALL used, plus one. */
+    Uint32 next_id;  /* in the current function. */
+    Uint32 first_code_id;  /* the first SSA id the current function's code defines; everything before it is an argument or constant. */
+    Uint8 *id_levels;  /* for each id the code defines: which level of `blocks` it's usable in. */
+    size_t id_levels_len;  /* how many ids `id_levels` has room for. */
+    VerifyPhiState phi_state;
+    Uint32 phi_inputs;  /* how many inputs a PHI here has to have (zero if it depends). */
+    Uint32 phi_first_id;  /* the first id the IF or LOOP before a PHI defined. */
+    VerifyBlock blocks[SDL_SHADER_BYTECODE_MAX_NESTING + 1];  /* +1 for the function itself. */
+    int depth;
+} Verifier;
+
+static Uint32 verify_word(const Verifier *v, const size_t pos)
+{
+    const Uint8 *ptr = v->data + (pos * 4);
+    return ((Uint32) ptr[0]) | (((Uint32) ptr[1]) << 8) | (((Uint32) ptr[2]) << 16) | (((Uint32) ptr[3]) << 24);
+}
+
+static SDL_bool SDL_PRINTF_VARARG_FUNC(3) verify_fail(Verifier *v, const size_t pos, SDL_PRINTF_FORMAT_STRING const char *fmt, ...)
+{
+    if (v->errbuf && (v->errbuflen > 0)) {
+        const int len = SDL_snprintf(v->errbuf, v->errbuflen, "byte %u: ", (unsigned int) (pos * 4));
+        if ((len >= 0) && (((size_t) len) < v->errbuflen)) {
+            va_list ap;
+            va_start(ap, fmt);
+            SDL_vsnprintf(v->errbuf + len, v->errbuflen - len, fmt, ap);
+            va_end(ap);
+        }
+    }
+    return SDL_FALSE;
+}
+
+static SDL_bool verify_type_id(Verifier *v, const size_t pos, const Uint32 typeid)
+{
+    if ((typeid == 0) || (typeid > v->num_types)) {
+        return verify_fail(v, pos, "type id %u doesn't exist", (unsigned int) typeid);
+    }
+    return SDL_TRUE;
+}
+
+static SDL_bool verify_output(Verifier *v, const size_t pos, const SDL_bool required)
+{
+    const Uint32 id = verify_word(v, pos);
+    const Uint32 typeid = verify_word(v, pos + 1);
+
+    if (id == 0) {
+        if (required) {
+            return verify_fail(v, pos, "instruction has to have an output");
+        } else if (typeid != 0) {
+            return verify_fail(v, pos + 1, "instruction has no output, but its type id is %u", (unsigned int) typeid);
+        }
+        return SDL_TRUE;
+    } else if (id != v->next_id) {
+        return verify_fail(v, pos, "new SSA id %%%u should be %%%u", (unsigned int) id, (unsigned int) v->next_id);
+    } else if ((v->next_id == 0xFFFFFFFF) || ((v->next_id - v->first_code_id) >= v->id_levels_len)) {
+        return verify_fail(v, pos, "too many SSA ids");
+    }
+    v->id_levels[v->next_id - v->first_code_id] = (Uint8) (v->depth - 1);
+    v->next_id++;
+    return verify_type_id(v, pos + 1, typeid);
+}
+
+/* is an id that's already defined still usable here, or was it defined in an IF or LOOP that's done? */
+static SDL_bool verify_id_visible(const Verifier *v, const Uint32 id)
+{
+    Uint8 level;
+
+    if (id < v->first_code_id) {
+        return SDL_TRUE;  /* an argument or constant. */
+    }
+
+    /* if a block at this level closed since, anything open there now started after this id. */
+    level = v->id_levels[id - v->first_code_id];
+    return (((int) level < v->depth) && (id >= v->blocks[level].scope_id)) ? SDL_TRUE : SDL_FALSE;
+}
+
+static SDL_bool verify_input(Verifier *v, const size_t pos)
+{
+    const Uint32 id = verify_word(v, pos);
+    if (id == 0) {
+        return verify_fail(v, pos, "input can't be SSA id zero");
+    } else if (id >= v->next_id) {
+        return verify_fail(v, pos, "SSA id %%%u is used before it's defined", (unsigned int) id);
+    } else if (!verify_id_visible(v, id)) {
+        return verify_fail(v, pos, "SSA id %%%u is used outside of the IF or LOOP that defined it", (unsigned int) id);
+    }
+    return SDL_TRUE;
+}
+
+static SDL_bool verify_inputs(Verifier *v, size_t pos, const size_t end)
+{
+    for (; pos < end; pos++) {
+        if (!verify_input(v, pos)) {
+            return SDL_FALSE;
+        }
+    }
+    return SDL_TRUE;
+}
+
+static SDL_bool verify_phi(Verifier *v, const size_t pos, const Uint32 num_words)
+{
+    const Uint32 num_inputs = num_words - 4;
+    VerifyBlock *block = &v->blocks[v->depth - 1];
+    Uint32 i;
+
+    if (v->phi_state == VERIFY_PHI_NOT_ALLOWED) {
+        return verify_fail(v, pos, "PHI can only be right after an IF or LOOP, or at the start of a LOOP");
+    } else if ((v->phi_state != VERIFY_PHI_LOOP_START) && (num_inputs != v->phi_inputs)) {
+        return verify_fail(v, pos, "PHI should have %u inputs, has %u", (unsigned int) v->phi_inputs, (unsigned int) num_inputs);
+    } else if (v->phi_state != VERIFY_PHI_LOOP_START) {
+        /* right after an IF or LOOP, the inputs can come from inside it. */
+        for (i = 0; i < num_inputs; i++) {
+            const Uint32 id = verify_word(v, pos + 4 + i);
+            if ((id < v->phi_first_id) || (id >= v->next_id)) {
+                if (!verify_input(v, pos + 4 + i)) {
+                    return SDL_FALSE;
+                }
+            }
+        }
+        return verify_output(v, pos + 2, SDL_TRUE);
+    }
+
+    /* at the start of a LOOP, the first input comes from before it, and the rest can come from anywhere in it. */
+    if ((block->num_phi_inputs != 0) && (block->num_phi_inputs != num_inputs)) {
+        return verify_fail(v, pos, "PHIs at the start of a LOOP should all have the same number of inputs");
+    } else if (!verify_input(v, pos + 4)) {
+        return SDL_FALSE;
+    } else if (verify_word(v, pos + 4) >= block->first_id) {
+        return verify_fail(v, pos + 4, "first input of a PHI at the start of a LOOP has to come from before it");
+    }
+    block->num_phi_inputs = num_inputs;
+
+    for (i = 1; i < num_inputs; i++) {
+        const Uint32 id = verify_word(v, pos + 4 + i);
+        if (id == 0) {
+            return verify_fail(v, pos + 4 + i, "input can't be SSA id zero");
+        } else if (id > block->max_forward_id) {
+            block->max_forward_id = id;
+        }
+    }
+    return verify_output(v, pos + 2, SDL_TRUE);
+}
+
+static SDL_bool verify_push_block(Verifier *v, const size_t pos, const VerifyBlockType type, const size_t end, const size_t true_end)
+{
+    VerifyBlock *block;
+    if (v->depth > SDL_SHADER_BYTECODE_MAX_NESTING) {
+        return verify_fail(v, pos, "IFs and LOOPs are nested more than %d deep", SDL_SHADER_BYTECODE_MAX_NESTING);
+    }
+    block = &v->blocks[v->depth];
+    SDL_zerop(block);
+    block->type = type;
+    block->pos = pos;
+    block->end = end;
+    block->true_end = true_end;
+    block->first_id = block->scope_id = v->next_id;
+    block->reaches_end = SDL_TRUE;
+    if (type == VERIFY_BLOCK_LOOP) {
+        block->loop = v->depth;
+    } else {
+        block->loop = (v->depth > 0) ? v->blocks[v->depth - 1].loop : -1;
+    }
+    v->depth++;
+    return SDL_TRUE;
+}
+
+/* the ids in [first_id, end_id) that are usable at the end of the innermost block can be used after it, too. */
+static void verify_let_out_ids(Verifier *v, const Uint32 first_id, const Uint32 end_id)
+{
+    const Uint8 level = (Uint8) (v->depth - 1);
+    Uint32 i;
+    for (i = first_id - v->first_code_id; i < (end_id - v->first_code_id); i++) {
+        if (v->id_levels[i] == level) {
+            v->id_levels[i] = level - 1;
+        }
+    }
+}
+
+/* we got to the end of the innermost block. Nothing after it can use the ids it defined, except
+   through a PHI, with two exceptions. If only one side of an IF can reach the end of it (the other
+   RETURNs, BREAKs, etc), there's no PHI, so what that side defined keeps going after the IF. And
+   the code at the start of a LOOP's code, before its first IF, LOOP or BREAK, runs before every
+   way out of the LOOP, so what it defines can still be used after the LOOP. */
+static SDL_bool verify_end_block(Verifier *v, const size_t pos)
+{
+    VerifyBlock *block = &v->blocks[v->depth - 1];
+    VerifyBlock *parent = (v->depth > 1) ? &v->blocks[v->depth - 2] : NULL;
+    const Uint32 loop_inputs = 1 + block->num_continues;
+
+    switch (block->type) {
+        case VERIFY_BLOCK_IF_TRUE:
+            block->type = VERIFY_BLOCK_IF_FALSE;  /* carry on with the "false" code. */
+            block->true_reaches_end = block->reaches_end;
+            block->reaches_end = SDL_TRUE;
+            block->scope_id = v->next_id;  /* none of the "true" code is usable here. */
+            v->phi_state = VERIFY_PHI_NOT_ALLOWED;
+            return SDL_TRUE;
+
+        case VERIFY_BLOCK_IF_FALSE:
+            if (block->true_reaches_end && !block->reaches_end) {
+                verify_let_out_ids(v, block->first_id, block->scope_id);
+            } else if (!block->true_reaches_end && block->reaches_end) {
+                verify_let_out_ids(v, block->scope_id, v->next_id);
+            } else if (!block->true_reaches_end) {
+                parent->reaches_end = SDL_FALSE;  /* neither side gets to the end, so nothing after this IF runs. */
+            }
+            v->depth--;
+            v->phi_state = VERIFY_PHI_AFTER_IF;
+            v->phi_inputs = 2;
+            v->phi_first_id = block->first_id;
+            return SDL_TRUE;
+
+        case VERIFY_BLOCK_LOOP:
+            if (block->max_forward_id >= v->next_id) {
+                return verify_fail(v, pos, "PHI at the start of a LOOP uses SSA id %%%u, which is never defined", (unsigned int) block->max_forward_id);
+            } else if (block->num_phi_inputs && (block->num_phi_inputs != loop_inputs) && (block->num_phi_inputs != (loop_inputs + 1))) {
+                return verify_fail(v, pos, "PHIs at the start of this LOOP should have %u or %u inputs, have %u", (unsigned int) loop_inputs, (unsigned int) (loop_inputs + 1), (unsigned int) block->num_phi_inputs);
+            }
+            verify_let_out_ids(v, block->first_id, block->prefix_end_id ? block->prefix_end_id : v->next_id);
+            if (block->num_breaks == 0) {
+                parent->reaches_end = SDL_FALSE;  /* nothing gets out of this LOOP. */
+            }
+            v->depth--;
+            v->phi_state = VERIFY_PHI_AFTER_LOOP;
+            v->phi_inputs = block->num_breaks;
+            v->phi_first_id = block->first_id;
+            return SDL_TRUE;
+
+        case VERIFY_BLOCK_FUNCTION:
+            break;
+    }
+
+    v->depth--;
+    return SDL_TRUE;
+}
+
+static SDL_bool verify_instruction(Verifier *v, const size_t pos, const Uint32 opcode, const Uint32 num_words, const Uint32 fntype)
+{
+    VerifyBlock *block = &v->blocks[v->depth - 1];
+    const VerifyPhiState phi_state = v->phi_state;
+    Uint32 min_words = 0, max_words = 0;
+    Uint32 num_inputs = 0;  /* for instructions that have an output then a fixed number of inputs. */
+
+    v->phi_state = VERIFY_PHI_NOT_ALLOWED;  /* unless this is another PHI, or something that allows them. */
+
+    switch ((SDL_SHADER_BytecodeTag) opcode) {
+        case SDL_SHADER_BCTAG_OP_NOP:
+        case SDL_SHADER_BCTAG_OP_DISCARD:
+        case SDL_SHADER_BCTAG_OP_BREAK:
+        case SDL_SHADER_BCTAG_OP_CONTINUE:
+            min_words = max_words = 2;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_NEGATE: case SDL_SHADER_BCTAG_OP_COMPLEMENT: case SDL_SHADER_BCTAG_OP_NOT:
+        case SDL_SHADER_BCTAG_OP_ALL: case SDL_SHADER_BCTAG_OP_ANY: case SDL_SHADER_BCTAG_OP_ROUND:
+        case SDL_SHADER_BCTAG_OP_ROUNDEVEN: case SDL_SHADER_BCTAG_OP_TRUNC: case SDL_SHADER_BCTAG_OP_ABS:
+        case SDL_SHADER_BCTAG_OP_SIGN: case SDL_SHADER_BCTAG_OP_FLOOR: case SDL_SHADER_BCTAG_OP_CEIL:
+        case SDL_SHADER_BCTAG_OP_FRACT: case SDL_SHADER_BCTAG_OP_RADIANS: case SDL_SHADER_BCTAG_OP_DEGREES:
+        case SDL_SHADER_BCTAG_OP_SIN: case SDL_SHADER_BCTAG_OP_COS: case SDL_SHADER_BCTAG_OP_TAN:
+        case SDL_SHADER_BCTAG_OP_ASIN: case SDL_SHADER_BCTAG_OP_ACOS: case SDL_SHADER_BCTAG_OP_ATAN:
+        case SDL_SHADER_BCTAG_OP_SINH: case SDL_SHADER_BCTAG_OP_COSH: case SDL_SHADER_BCTAG_OP_TANH:
+        case SDL_SHADER_BCTAG_OP_ASINH: case SDL_SHADER_BCTAG_OP_ACOSH: case SDL_SHADER_BCTAG_OP_ATANH:
+        case SDL_SHADER_BCTAG_OP_EXP: case SDL_SHADER_BCTAG_OP_LOG: case SDL_SHADER_BCTAG_OP_EXP2:
+        case SDL_SHADER_BCTAG_OP_LOG2: case SDL_SHADER_BCTAG_OP_SQRT: case SDL_SHADER_BCTAG_OP_RSQRT:
+        case SDL_SHADER_BCTAG_OP_LEN: case SDL_SHADER_BCTAG_OP_NORMALIZE: case SDL_SHADER_BCTAG_OP_TRANSPOSE:
+        case SDL_SHADER_BCTAG_OP_CONVERT:
+            num_inputs = 1;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_MULTIPLY: case SDL_SHADER_BCTAG_OP_DIVIDE: case SDL_SHADER_BCTAG_OP_MODULO:
+        case SDL_SHADER_BCTAG_OP_ADD: case SDL_SHADER_BCTAG_OP_SUBTRACT: case SDL_SHADER_BCTAG_OP_SHIFTLEFT:
+        case SDL_SHADER_BCTAG_OP_SHIFTRIGHT: case SDL_SHADER_BCTAG_OP_LESSTHAN: case SDL_SHADER_BCTAG_OP_GREATERTHAN:
+        case SDL_SHADER_BCTAG_OP_LESSTHANOREQUAL: case SDL_SHADER_BCTAG_OP_GREATERTHANOREQUAL:
+        case SDL_SHADER_BCTAG_OP_EQUAL: case SDL_SHADER_BCTAG_OP_NOTEQUAL: case SDL_SHADER_BCTAG_OP_BINARYAND:
+        case SDL_SHADER_BCTAG_OP_BINARYOR: case SDL_SHADER_BCTAG_OP_BINARYXOR: case SDL_SHADER_BCTAG_OP_LOGICALAND:
+        case SDL_SHADER_BCTAG_OP_LOGICALOR: case SDL_SHADER_BCTAG_OP_MOD: case SDL_SHADER_BCTAG_OP_ATAN2:
+        case SDL_SHADER_BCTAG_OP_POW: case SDL_SHADER_BCTAG_OP_MIN: case SDL_SHADER_BCTAG_OP_MAX:
+        case SDL_SHADER_BCTAG_OP_STEP: case SDL_SHADER_BCTAG_OP_FREXP: case SDL_SHADER_BCTAG_OP_LDEXP:
+        case SDL_SHADER_BCTAG_OP_DISTANCE: case SDL_SHADER_BCTAG_OP_DOT: case SDL_SHADER_BCTAG_OP_CROSS:
+        case SDL_SHADER_BCTAG_OP_REFLECT: case SDL_SHADER_BCTAG_OP_EXTRACT: case SDL_SHADER_BCTAG_OP_MATMUL:
+            num_inputs = 2;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_CLAMP: case SDL_SHADER_BCTAG_OP_MIX: case SDL_SHADER_BCTAG_OP_SMOOTHSTEP:
+        case SDL_SHADER_BCTAG_OP_MAD: case SDL_SHADER_BCTAG_OP_FACEFORWARD: case SDL_SHADER_BCTAG_OP_REFRACT:
+        case SDL_SHADER_BCTAG_OP_INSERT: case SDL_SHADER_BCTAG_OP_SELECT:
+            num_inputs = 3;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_LITERALINT: case SDL_SHADER_BCTAG_OP_LITERALFLOAT:
+            min_words = max_words = 5;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_LITERALINT4: case SDL_SHADER_BCTAG_OP_LITERALFLOAT4:
+            min_words = max_words = 8;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_SWIZZLE:
+            min_words = max_words = 6;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_CONSTRUCT: case SDL_SHADER_BCTAG_OP_PHI: case SDL_SHADER_BCTAG_OP_CALL:
+            min_words = 5;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_IF:
+            min_words = 4;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_LOOP:
+            min_words = 2;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_RETURN:
+            min_words = max_words = 3;
+            break;
+
+        default:
+            return verify_fail(v, pos, "unknown or unsupported opcode %u", (unsigned int) opcode);
+    }
+
+    if (num_inputs > 0) {
+        min_words = max_words = 4 + num_inputs;  /* opcode, num_words, output, type, inputs. */
+    }
+
+    if ((num_words < min_words) || (max_words && (num_words > max_words))) {
+        return verify_fail(v, pos, "opcode %u shouldn't be %u words long", (unsigned int) opcode, (unsigned int) num_words);
+    }
+
+    if ((opcode == SDL_SHADER_BCTAG_OP_RETURN) || (opcode == SDL_SHADER_BCTAG_OP_DISCARD) || (opcode == SDL_SHADER_BCTAG_OP_BREAK) || (opcode == SDL_SHADER_BCTAG_OP_CONTINUE)) {
+        block->reaches_end = SDL_FALSE;
+    }
+
+    if ((block->type == VERIFY_BLOCK_LOOP) && (block->prefix_end_id == 0) && ((opcode == SDL_SHADER_BCTAG_OP_IF) || (opcode == SDL_SHADER_BCTAG_OP_LOOP) || (opcode == SDL_SHADER_BCTAG_OP_BREAK))) {
+        block->prefix_end_id = v->next_id;  /* the start of this LOOP's code is over. */
+    }
+
+    if (num_inputs > 0) {
+        return verify_inputs(v, pos + 4, pos + 4 + num_inputs) && verify_output(v, pos + 2, SDL_FALSE);
+    }
+
+    switch ((SDL_SHADER_BytecodeTag) opcode) {
+        case SDL_SHADER_BCTAG_OP_BREAK:
+        case SDL_SHADER_BCTAG_OP_CONTINUE:
+            if (block->loop < 0) {
+                return verify_fail(v, pos, "%s isn't in a LOOP", (opcode == SDL_SHADER_BCTAG_OP_BREAK) ? "BREAK" : "CONTINUE");
+            } else if (opcode == SDL_SHADER_BCTAG_OP_BREAK) {
+                v->blocks[block->loop].num_breaks++;
+            } else {
+                v->blocks[block->loop].num_continues++;
+            }
+            return SDL_TRUE;
+
+        case SDL_SHADER_BCTAG_OP_DISCARD:
+            if (fntype == SDL_SHADER_BCFNTYPE_VERTEX) {
+                return verify_fail(v, pos, "DISCARD in a vertex shader");
+            }
+            return SDL_TRUE;
+
+        case SDL_SHADER_BCTAG_OP_LITERALINT: case SDL_SHADER_BCTAG_OP_LITERALFLOAT:
+        case SDL_SHADER_BCTAG_OP_LITERALINT4: case SDL_SHADER_BCTAG_OP_LITERALFLOAT4:
+            return verify_output(v, pos + 2, SDL_FALSE);
+
+        case SDL_SHADER_BCTAG_OP_SWIZZLE:
+            return verify_input(v, pos + 4) && verify_output(v, pos + 2, SDL_FALSE);
+
+        case SDL_SHADER_BCTAG_OP_CONSTRUCT:
+            return verify_inputs(v, pos + 4, pos + num_words) && verify_output(v, pos + 2, SDL_FALSE);
+
+        case SDL_SHADER_BCTAG_OP_PHI:
+            v->phi_state = phi_state;  /* more PHIs can follow this one. */
+            return verify_phi(v, pos, num_words);
+
+        case SDL_SHADER_BCTAG_OP_CALL: {
+            const Uint32 fn = verify_word(v, pos + 2);
+            if ((fn == 0xFFFFFFFF) || (v->directory && (fn >= v->directory_functions))) {
+                return verify_fail(v, pos + 2, "CALL to function #%u, which doesn't exist", (unsigned int) fn);
+            } else if (fn >= v->max_call) {
+                v->max_call = fn + 1;  /* we'll check this once we know how many functions there are. */
+            }
+            return verify_inputs(v, pos + 5, pos + num_words) && verify_output(v, pos + 3, SDL_FALSE);
+        }
+
+        case SDL_SHADER_BCTAG_OP_IF: {
+            const Uint32 true_words = verify_word(v, pos + 3);
+            if (true_words > (num_words - 4)) {
+                return verify_fail(v, pos + 3, "IF's \"true\" code is longer than the IF");
+            }
+            return verify_input(v, pos + 2) && verify_push_block(v, pos, VERIFY_BLOCK_IF_TRUE, pos + num_words, pos + 4 + true_words);
+        }
+
+        case SDL_SHADER_BCTAG_OP_LOOP:
+            if (!verify_push_block(v, pos, VERIFY_BLOCK_LOOP, pos + num_words, 0)) {
+                return SDL_FALSE;
+            }
+            v->phi_state = VERIFY_PHI_LOOP_START;
+            return SDL_TRUE;
+
+        case SDL_SHADER_BCTAG_OP_RETURN:
+            return (verify_word(v, pos + 2) == 0) || verify_input(v, pos + 2);
+
+        default: break;
+    }
+
+    return SDL_TRUE;
+}
+
+/* the function's code, after its constant pool. */
+static SDL_bool verify_code(Verifier *v, size_t pos, const size_t end, const Uint32 fntype)
+{
+    v->depth = 0;
+    v->phi_state = VERIFY_PHI_NOT_ALLOWED;
+    if (!verify_push_block(v, pos, VERIFY_BLOCK_FUNCTION, end, 0)) {
+        return SDL_FALSE;
+    }
+
+    while (v->depth > 0) {
+        const VerifyBlock *block = &v->blocks[v->depth - 1];
+        const size_t block_end = (block->type == VERIFY_BLOCK_IF_TRUE) ? block->true_end : block->end;
+        Uint32 opcode, num_words;
+        size_t inner_end;
+
+        if (pos == block_end) {
+            if (!verify_end_block(v, pos)) {
+                return SDL_FALSE;
+            }
+            continue;
+        } else if ((block_end - pos) < 2) {
+            return verify_fail(v, pos, "instruction goes past the end of its block");
+        }
+
+        opcode = verify_word(v, pos);
+        num_words = verify_word(v, pos + 1);
+        if ((num_words < 2) || (num_words > (block_end - pos))) {
+            return verify_fail(v, pos, "instruction's size (%u words) doesn't fit in its block", (unsigned int) num_words);
+        } else if (!verify_instruction(v, pos, opcode, num_words, fntype)) {
+            return SDL_FALSE;
+        }
+
+        /* IF and LOOP keep going into the code they contain; everything else skips to the next instruction. */
+        inner_end = v->blocks[v->depth - 1].end;
+        if ((opcode == SDL_SHADER_BCTAG_OP_IF) && (inner_end == (pos + num_words))) {
+            pos += 4;
+        } else if ((opcode == SDL_SHADER_BCTAG_OP_LOOP) && (inner_end == (pos + num_words))) {
+            pos += 2;
+        } else {
+            pos += num_words;
+        }
+    }
+
+    return SDL_TRUE;
+}
+
+/* Inputs or Outputs: num_words, count, then each one's type id. */
+static SDL_bool verify_function_details(Verifier *v, size_t *_pos, const size_t end, const Uint32 max_count, Uint32 *_count)
+{
+    const size_t pos = *_pos;
+    Uint32 num_words, count, i;
+
+    if ((end - pos) < 2) {
+        return verify_fail(v, pos, "function's details go past its end");
+    }
+
+    num_words = verify_word(v, pos);
+    count = verify_word(v, pos + 1);
+    /* (careful not to do `2 + count` in 32 bits, which can wrap around.) */
+    if ((num_words < 2) || (num_words > (end - pos)) || (((size_t) count) != (((size_t) num_words) - 2)) || (count > max_count)) {
+        return verify_fail(v, pos, "function's inputs or outputs are corrupt");
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!verify_type_id(v, pos + 2 + i, verify_word(v, pos + 2 + i))) {
+            return SDL_FALSE;
+        }
+    }
+
+    *_pos = pos + num_words;
+    *_count = count;
+    return SDL_TRUE;
+}
+
+/* SDL_TRUE if the DIRECTORY's entry point table finds function `fn` by `name`. */
+static SDL_bool verify_directory_finds(const Verifier *v, const char *name, const Uint32 fn)
+{
+    const size_t buckets = v->directory + 4 + v->directory_functions;
+    const Uint32 mask = v->directory_buckets - 1;
+    const Uint32 hash = SDL_SHADER_BytecodeHashName(name);
+    Uint32 bucket = hash & mask;
+    Uint32 i;
+
+    for (i = 0; i < v->directory_buckets; i++) {
+        const Uint32 found = verify_word(v, buckets + (bucket * 2) + 1);
+        if (found == SDL_SHADER_BYTECODE_NO_FUNCTION) {
+            return SDL_FALSE;
+        } else if ((found == fn) && (verify_word(v, buckets + (bucket * 2)) == hash)) {
+            return SDL_TRUE;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+    return SDL_FALSE;
+}
+
+static SDL_bool verify_function(Verifier *v, const size_t start, const size_t end)
+{
+    const Uint32 fnid = v->num_functions;
+    const Uint32 fntype = verify_word(v, start + 2);
+    const Uint32 namelen = verify_word(v, start + 3);
+    size_t pos = start + 4 + namelen;
+    Uint32 num_inputs, num_outputs, num_constants, i;
+
+    if (v->directory && ((fnid >= v->directory_functions) || (verify_word(v, v->directory + 3 + fnid) != (start * 4)))) {
+        return verify_fail(v, start, "DIRECTORY doesn't have function #%u's offset right", (unsigned int) fnid);
+    } else if (fntype > SDL_SHADER_BCFNTYPE_FRAGMENT) {
+        return verify_fail(v, start + 2, "unknown function type %u", (unsigned int) fntype);
+    } else if (namelen > ((end - start) - 4)) {
+        return verify_fail(v, start + 3, "function's name is longer than the function");
+    } else if (namelen > 0) {
+        const char *name = (const char *) (v->data + ((start + 4) * 4));
+        if (name[(namelen * 4) - 1] != '\0') {
+            return verify_fail(v, start + 4, "function's name isn't null-terminated");
+        } else if (fntype == SDL_SHADER_BCFNTYPE_NORMAL) {
+            return verify_fail(v, start + 4, "function has a name, but isn't an entry point");
+        } else if (v->directory && !verify_directory_finds(v, name, fnid)) {
+            return verify_fail(v, start + 4, "DIRECTORY can't find entry point '%s'", name);
+        }
+        v->num_exported++;
+    } else if (fntype != SDL_SHADER_BCFNTYPE_NORMAL) {
+        return verify_fail(v, start + 3, "entry point doesn't have a name");
+    }
+
+    if (!verify_function_details(v, &pos, end, 0xFFFFFFFF, &num_inputs) || !verify_function_details(v, &pos, end, 1, &num_outputs)) {
+        return SDL_FALSE;
+    }
+
+    /* constant pool: num_words, num_constants, then each one's opcode and value(s). */
+    if (((end - pos) < 2) || (verify_word(v, pos) < 2) || (verify_word(v, pos) > (end - pos))) {
+        return verify_fail(v, pos, "function's constant pool doesn't fit in it");
+    }
+    num_constants = verify_word(v, pos + 1);
+    {
+        const size_t constants_end = pos + verify_word(v, pos);
+        pos += 2;
+        for (i = 0; i < num_constants; i++) {
+            const Uint32 opcode = (pos < constants_end) ? verify_word(v, pos) : 0;
+            const size_t len = ((opcode == SDL_SHADER_BCTAG_OP_LITERALINT) || (opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT)) ? 2 :
+                               ((opcode == SDL_SHADER_BCTAG_OP_LITERALINT4) || (opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT4)) ? 5 : 0;
+            if (len == 0) {
+                return verify_fail(v, pos, "constant #%u isn't a literal", (unsigned int) i);
+            } else if (len > (constants_end - pos)) {
+                return verify_fail(v, pos, "constant #%u goes past the end of the constant pool", (unsigned int) i);
+            }
+            pos += len;
+        }
+        if (pos != constants_end) {
+            return verify_fail(v, pos, "constant pool has extra words at the end");
+        }
+    }
+
+    if ((((Uint64) num_inputs) + ((Uint64) num_constants)) >= 0xFFFFFFFF) {
+        return verify_fail(v, start, "function has too many SSA ids");
+    }
+    v->next_id = v->first_code_id = num_inputs + num_constants + 1;
+
+    /* anything that defines an id is at least five words long, so this is room for every id the code can define. */
+    if (((end - pos) / 5) >= v->id_levels_len) {
+        const size_t len = ((end - pos) / 5) + 1;
+        Uint8 *ptr = (Uint8 *) SDL_realloc(v->id_levels, len);
+        if (!ptr) {
+            return verify_fail(v, pos, "out of memory");
+        }
+        v->id_levels = ptr;
+        v->id_levels_len = len;
+    }
+
+    v->num_functions++;
+    return verify_code(v, pos, end, fntype);
+}
+
+static SDL_bool verify_types(Verifier *v, const size_t start, const size_t end)
+{
+    size_t pos = start + 3;
+    Uint32 count, i, j;
+
+    if ((end - start) < 3) {
+        return verify_fail(v, start, "TYPES is too small");
+    }
+
+    count = verify_word(v, start + 2);
+
+    for (i = 0; i < count; i++) {
+        Uint32 kind, num_words;
+
+        if ((end - pos) < 2) {
+            return verify_fail(v, pos, "TYPES has fewer entries than it says");
+        }
+        kind = verify_word(v, pos);
+        num_words = verify_word(v, pos + 1);
+        if ((num_words < 2) || (num_words > (end - pos))) {
+            return verify_fail(v, pos, "type #%u doesn't fit in TYPES", (unsigned int) (i + 1));
+        }
+
+        if (kind == SDL_SHADER_BCTYPE_VALUE) {
+            const Uint32 typeword = (num_words == 3) ? verify_word(v, pos + 2) : 0;
+            const Uint32 scalar = (Uint32) SDL_SHADER_BYTECODE_TYPEWORD_SCALAR(typeword);
+            const Uint32 elements = SDL_SHADER_BYTECODE_TYPEWORD_ELEMENTS(typeword);
+            const Uint32 rows = SDL_SHADER_BYTECODE_TYPEWORD_ROWS(typeword);
+            if ((num_words != 3) || (scalar == SDL_SHADER_BCSCALAR_NONE) || (scalar > SDL_SHADER_BCSCALAR_FLOAT) ||
+                (elements < 1) || (elements > 4) || (rows < 1) || (rows > 4) || (typeword >> 24)) {
+                return verify_fail(v, pos, "type #%u isn't a valid scalar, vector or matrix", (unsigned int) (i + 1));
+            }
+        } else if (kind == SDL_SHADER_BCTYPE_ARRAY) {
+            if ((num_words != 4) || (verify_word(v, pos + 2) == 0) || (verify_word(v, pos + 2) > i) || (verify_word(v, pos + 3) == 0)) {
+                return verify_fail(v, pos, "type #%u isn't a valid array", (unsigned int) (i + 1));
+            }
+        } else if (kind == SDL_SHADER_BCTYPE_STRUCT) {
+            if (num_words < 3) {
+                return verify_fail(v, pos, "type #%u is a struct with no members", (unsigned int) (i + 1));
+            }
+            for (j = 2; j < num_words; j++) {
+                if ((verify_word(v, pos + j) == 0) || (verify_word(v, pos + j) > i)) {
+                    return verify_fail(v, pos + j, "type #%u has a member of a type that isn't before it", (unsigned int) (i + 1));
+                }
+            }
+        } else {
+            return verify_fail(v, pos, "type #%u is unknown kind %u", (unsigned int) (i + 1), (unsigned int) kind);
+        }
+
+        pos += num_words;
+    }
+
+    if (pos != end) {
+        return verify_fail(v, pos, "TYPES has extra words at the end");
+    }
+    v->num_types = count;
+    return SDL_TRUE;
+}
+
+static SDL_bool verify_directory(Verifier *v, const size_t start, const size_t end)
+{
+    const size_t len = end - start;
+    Uint32 num_functions, num_buckets, i;
+
+    num_functions = (len >= 3) ? verify_word(v, start + 2) : 0;
+    if ((len < 4) || (num_functions > (len - 4))) {
+        return verify_fail(v, start, "DIRECTORY is too small");
+    }
+
+    /* (careful not to do `num_buckets * 2`, which can wrap around.) */
+    num_buckets = verify_word(v, start + 3 + num_functions);
+    if ((num_buckets & (num_buckets - 1)) || (num_buckets > ((len - 4 - num_functions) / 2)) || (len != (4 + num_functions + (((size_t) num_buckets) * 2)))) {
+        return verify_fail(v, start, "DIRECTORY's entry point table is corrupt");
+    }
+
+    for (i = 0; i < num_buckets; i++) {
+        const Uint32 fn = verify_word(v, start + 4 + num_functions + (i * 2) + 1);
+        if (fn == SDL_SHADER_BYTECODE_NO_FUNCTION) {
+            continue;
+        } else if (fn >= num_functions) {
+            return verify_fail(v, start + 4 + num_functions + (i * 2) + 1, "DIRECTORY's entry point table has function #%u, which doesn't exist", (unsigned int) fn);
+        }
+        v->directory_entry_points++;
+    }
+
+    v->directory = start;
+    v->directory_functions = num_functions;
+    v->directory_buckets = num_buckets;
+    return SDL_TRUE;
+}
+
+static SDL_bool verify_bytecode(Verifier *v, const void *bytecode, size_t bytecodelen)
+{
+    size_t pos = 5;
+    SDL_bool seen_types = SDL_FALSE;
+
+    if ((bytecode == NULL) || (bytecodelen < 20) || (bytecodelen % 4) || (SDL_memcmp(bytecode, SDL_SHADER_BYTECODE_MAGIC, 12) != 0)) {
+        return verify_fail(v, 0, "not shader bytecode");
+    }
+
+    v->version = verify_word(v, 3);
+    if ((v->version < 3) || (v->version > SDL_SHADER_BYTECODE_VERSION)) {
+        return verify_fail(v, 3, "can't verify bytecode format %u", (unsigned int) v->version);
+    } else if (verify_word(v, 4) != SDL_SHADER_BytecodeCrc32(0, v->data + 20, bytecodelen - 20)) {
+        return verify_fail(v, 4, "CRC-32 doesn't match");
+    }
+
+    while (pos < v->num_words) {
+        const Uint32 tag = verify_word(v, pos);
+        const Uint32 num_words = ((v->num_words - pos) >= 2) ? verify_word(v, pos + 1) : 0;
+        const size_t end = pos + num_words;
+
+        if ((num_words < 2) || (num_words > (v->num_words - pos))) {
+            return verify_fail(v, pos, "section doesn't fit in the file");
+        } else if ((tag == SDL_SHADER_BCTAG_DIRECTORY) && (v->version >= 4) && (pos == 5)) {
+            if (!verify_directory(v, pos, end)) {
+                return SDL_FALSE;
+            }
+        } else if ((tag == SDL_SHADER_BCTAG_TYPES) && !seen_types) {
+            if (!verify_types(v, pos, end)) {
+                return SDL_FALSE;
+            }
+            seen_types = SDL_TRUE;
+        } else if ((tag == SDL_SHADER_BCTAG_FUNCTION) && seen_types) {
+            if (num_words < 4) {
+                return verify_fail(v, pos, "function is too small");
+            } else if (!verify_function(v, pos, end)) {
+                return SDL_FALSE;
+            }
+        } else {
+            return verify_fail(v, pos, "didn't expect a section with tag %u here", (unsigned int) tag);
+        }
+
+        pos = end;
+    }
+
+    if (!seen_types) {
+        return verify_fail(v, pos, "there's no TYPES section");
+    } else if (v->directory && (v->num_functions != v->directory_functions)) {
+        return verify_fail(v, v->directory + 2, "DIRECTORY says there are %u functions, but there are %u", (unsigned int) v->directory_functions, (unsigned int) v->num_functions);
+    } else if (v->directory && (v->directory_entry_points != v->num_exported)) {
+        /* every entry point found itself in the table, so if the counts match, there's nothing else in it. */
+        return verify_fail(v, v->directory, "DIRECTORY's entry point table has %u entries, but there are %u entry points", (unsigned int) v->directory_entry_points, (unsigned int) v->num_exported);
+    } else if (v->max_call > v->num_functions) {
+        return verify_fail(v, pos, "a CALL is to function #%u, which doesn't exist", (unsigned int) (v->max_call - 1));
+    }
+
+    return SDL_TRUE;
+}
+
+SDL_bool SDL_SHADER_VerifyBytecode(const void *bytecode, size_t bytecodelen, char *errbuf, size_t errbuflen)
+{
+    Verifier v;
+    SDL_bool retval;
+
+    SDL_zero(v);
+    v.data = (const Uint8 *) bytecode;
+    v.num_words = bytecodelen / 4;
+    v.errbuf = errbuf;
+    v.errbuflen = errbuflen;
+
+    if (errbuf && (errbuflen > 0)) {
+        *errbuf = '\0';
+    }
+
+    retval = verify_bytecode(&v, bytecode, bytecodelen);
+    SDL_free(v.id_levels);
+    return retval;
+}
+
+
+/* Everything below trusts the bytecode, since SDL_SHADER_OpenBytecode() verified it (or the
+   caller of SDL_SHADER_OpenVerifiedBytecode() promised it did). */
+
+static SDL_bool bytecode_is_aligned(const void *bytecode, char *errbuf, size_t errbuflen)
+{
+    if (((size_t) bytecode) & 3) {
+        if (errbuf && (errbuflen > 0)) {
+            SDL_snprintf(errbuf, errbuflen, "bytecode isn't 4-byte aligned");
+        }
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+SDL_bool SDL_SHADER_OpenVerifiedBytecode(SDL_SHADER_BytecodeModule *module, const void *bytecode, size_t bytecodelen, char *errbuf, size_t errbuflen)
+{
+    const Uint32 *words = (const Uint32 *) bytecode;
+    size_t pos = 5;
+
+    SDL_zerop(module);
+
+    if (!bytecode_is_aligned(bytecode, errbuf, errbuflen)) {
+        return SDL_FALSE;
+    }
+
+    module->words = words;
+    module->num_words = bytecodelen / 4;
+    module->version = SDL_SHADER_BytecodeWord(words, 3);
+
+    /* the directory and types are first, then it's all functions, so we only need to count those. */
+    while (pos < module->num_words) {
+        const Uint32 tag = SDL_SHADER_BytecodeWord(words, pos);
+        if (tag == SDL_SHADER_BCTAG_DIRECTORY) {
+            module->directory = words + pos;
+        } else if (tag == SDL_SHADER_BCTAG_TYPES) {
+            module->types = words + pos;
+            module->num_types = SDL_SHADER_BytecodeWord(words, pos + 2);
+        } else {
+            if (!module->functions) {
+                module->functions = words + pos;
+            }
+            module->num_functions++;
+        }
+        pos += SDL_SHADER_BytecodeWord(words, pos + 1);
+    }
+
+    return SDL_TRUE;
+}
+
+SDL_bool SDL_SHADER_OpenBytecode(SDL_SHADER_BytecodeModule *module, const void *bytecode, size_t bytecodelen, char *errbuf, size_t errbuflen)
+{
+    SDL_zerop(module);
+    if (!bytecode_is_aligned(bytecode, errbuf, errbuflen) || !SDL_SHADER_VerifyBytecode(bytecode, bytecodelen, errbuf, errbuflen)) {
+        return SDL_FALSE;
+    }
+    return SDL_SHADER_OpenVerifiedBytecode(module, bytecode, bytecodelen, errbuf, errbuflen);
+}
+
+static void fill_bytecode_type(SDL_SHADER_BytecodeType *type, const Uint32 id, const Uint32 *words)
+{
+    type->id = id;
+    type->kind = (SDL_SHADER_BytecodeTypeKind) SDL_SHADER_BytecodeWord(words, 0);
+    type->values = words + 2;
+    type->num_values = SDL_SHADER_BytecodeWord(words, 1) - 2;
+    type->words = words;
+}
+
+SDL_bool SDL_SHADER_NextBytecodeType(const SDL_SHADER_BytecodeModule *module, SDL_SHADER_BytecodeType *type)
+{
+    if (type->id >= module->num_types) {
+        return SDL_FALSE;
+    } else if (type->id == 0) {
+        fill_bytecode_type(type, 1, module->types + 3);
+    } else {
+        fill_bytecode_type(type, type->id + 1, type->words + SDL_SHADER_BytecodeWord(type->words, 1));
+    }
+    return SDL_TRUE;
+}
+
+SDL_bool SDL_SHADER_GetBytecodeType(const SDL_SHADER_BytecodeModule *module, Uint32 id, SDL_SHADER_BytecodeType *type)
+{
+    if ((id == 0) || (id > module->num_types)) {
+        return SDL_FALSE;
+    }
+
+    SDL_zerop(type);
+    while (type->id < id) {
+        SDL_SHADER_NextBytecodeType(module, type);
+    }
+    return SDL_TRUE;
+}
+
+static void fill_bytecode_function(SDL_SHADER_BytecodeFunction *fn, const Uint32 index, const Uint32 *words)
+{
+    const Uint32 namelen = SDL_SHADER_BytecodeWord(words, 3);
+    const Uint32 *ptr = words + 4 + namelen;
+
+    fn->index = index;
+    fn->fntype = (SDL_SHADER_BytecodeFunctionType) SDL_SHADER_BytecodeWord(words, 2);
+    fn->name = namelen ? ((const char *) (words + 4)) : NULL;
+
+    fn->num_inputs = SDL_SHADER_BytecodeWord(ptr, 1);
+    fn->input_types = ptr + 2;
+    ptr += SDL_SHADER_BytecodeWord(ptr, 0);
+
+    fn->return_type = SDL_SHADER_BytecodeWord(ptr, 1) ? SDL_SHADER_BytecodeWord(ptr, 2) : 0;
+    ptr += SDL_SHADER_BytecodeWord(ptr, 0);
+
+    fn->num_constants = SDL_SHADER_BytecodeWord(ptr, 1);
+    fn->constants = ptr + 2;
+    ptr += SDL_SHADER_BytecodeWord(ptr, 0);
+
+    fn->first_id = fn->num_inputs + fn->num_constants + 1;
+    fn->code.pos = ptr;
+    fn->code.end = words + SDL_SHADER_BytecodeWord(words, 1);
+    fn->words = words;
+}
+
+SDL_bool SDL_SHADER_NextBytecodeFunction(const SDL_SHADER_BytecodeModule *module, SDL_SHADER_BytecodeFunction *fn)
+{
+    if (fn->words == NULL) {
+        if (module->num_functions == 0) {
+            return SDL_FALSE;
+        }
+        fill_bytecode_function(fn, 0, module->functions);
+    } else if ((fn->index + 1) >= module->num_functions) {
+        return SDL_FALSE;
+    } else {
+        fill_bytecode_function(fn, fn->index + 1, fn->code.end);
+    }
+    return SDL_TRUE;
+}
+
+SDL_bool SDL_SHADER_GetBytecodeFunction(const SDL_SHADER_BytecodeModule *module, Uint32 index, SDL_SHADER_BytecodeFunction *fn)
+{
+    if (index >= module->num_functions) {
+        return SDL_FALSE;
+    } else if (module->directory) {
+        fill_bytecode_function(fn, index, module->words + (SDL_SHADER_BytecodeWord(module->directory, 3 + index) / 4));
+        return SDL_TRUE;
+    }
+
+    SDL_zerop(fn);
+    do {
+        SDL_SHADER_NextBytecodeFunction(module, fn);
+    } while (fn->index < index);
+    return SDL_TRUE;
+}
+
+SDL_bool SDL_SHADER_FindBytecodeEntryPoint(const SDL_SHADER_BytecodeModule *module, const char *name, SDL_SHADER_BytecodeFunction *fn)
+{
+    SDL_SHADER_BytecodeFunction candidate;  /* so `fn` doesn't change unless we find it. */
+
+    if (module->directory) {
+        const Uint32 *buckets = module->directory + 4 + module->num_functions;
+        const Uint32 num_buckets = SDL_SHADER_BytecodeWord(module->directory, 3 + module->num_functions);
+        const Uint32 hash = SDL_SHADER_BytecodeHashName(name);
+        Uint32 bucket = hash & (num_buckets - 1);
+        Uint32 i;
+
+        for (i = 0; i < num_buckets; i++) {
+            const Uint32 index = SDL_SHADER_BytecodeWord(buckets, (bucket * 2) + 1);
+            if (index == SDL_SHADER_BYTECODE_NO_FUNCTION) {
+                break;
+            } else if (SDL_SHADER_BytecodeWord(buckets, bucket * 2) == hash) {
+                SDL_SHADER_GetBytecodeFunction(module, index, &candidate);
+                if (SDL_strcmp(candidate.name, name) == 0) {
+                    SDL_memcpy(fn, &candidate, sizeof (*fn));
+                    return SDL_TRUE;
+                }
+            }
+            bucket = (bucket + 1) & (num_buckets - 1);
+        }
+        return SDL_FALSE;
+    }
+
+    SDL_zero(candidate);
+    while (SDL_SHADER_NextBytecodeFunction(module, &candidate)) {
+        if (candidate.name && (SDL_strcmp(candidate.name, name) == 0)) {
+            SDL_memcpy(fn, &candidate, sizeof (*fn));
+            return SDL_TRUE;
+        }
+    }
+    return SDL_FALSE;
+}
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 #define SDL_SHADER_BYTECODE_MAGIC "SDLSHADERBC"
-#define SDL_SHADER_BYTECODE_VERSION 1
+#define SDL_SHADER_BYTECODE_VERSION 4
 
 typedef enum SDL_SHADER_BytecodeTag
 {
@@ -108,10 +108,303 @@ typedef enum SDL_SHADER_BytecodeTag
     SDL_SHADER_BCTAG_OP_REFRACT,
     SDL_SHADER_BCTAG_OP_TRANSPOSE,
     SDL_SHADER_BCTAG_OP_SAMPLE,
+    SDL_SHADER_BCTAG_OP_CONSTRUCT,
+    SDL_SHADER_BCTAG_OP_CONVERT,
+    SDL_SHADER_BCTAG_OP_EXTRACT,
+    SDL_SHADER_BCTAG_OP_INSERT,
+    SDL_SHADER_BCTAG_OP_SELECT,
+    SDL_SHADER_BCTAG_OP_MATMUL,
+    SDL_SHADER_BCTAG_TYPES,
+    SDL_SHADER_BCTAG_DIRECTORY,
     SDL_SHADER_BCTAG_TOTAL,
     SDL_SHADER_BCTAG_MAX = 0xFFFFFFFF
 } SDL_SHADER_BytecodeTag;
 
+typedef enum SDL_SHADER_BytecodeFunctionType
+{
+    SDL_SHADER_BCFNTYPE_NORMAL,
+    SDL_SHADER_BCFNTYPE_VERTEX,
+    SDL_SHADER_BCFNTYPE_FRAGMENT
+} SDL_SHADER_BytecodeFunctionType;
+
+/* Scalars, vectors and matrices in the type table are a "type word": the scalar type is in
+   the low 8 bits, the number of vector elements (1 for a scalar) in the next 8, and the
+   number of matrix rows (1 if not a matrix) in the next 8. (In format 2, CONSTRUCT and
+   CONVERT had one of these instead of a type id, and zero meant a struct or array.) */
+typedef enum SDL_SHADER_BytecodeScalarType
+{
+    SDL_SHADER_BCSCALAR_NONE,
+    SDL_SHADER_BCSCALAR_BOOL,
+    SDL_SHADER_BCSCALAR_INT,
+    SDL_SHADER_BCSCALAR_UINT,
+    SDL_SHADER_BCSCALAR_HALF,
+    SDL_SHADER_BCSCALAR_FLOAT
+} SDL_SHADER_BytecodeScalarType;
+
+#define SDL_SHADER_BYTECODE_TYPEWORD(scalar, elements, rows) (((Uint32) (scalar)) | (((Uint32) (elements)) << 8) | (((Uint32) (rows)) << 16))
+#define SDL_SHADER_BYTECODE_TYPEWORD_SCALAR(typeword) ((SDL_SHADER_BytecodeScalarType) ((typeword) & 0xFF))
+#define SDL_SHADER_BYTECODE_TYPEWORD_ELEMENTS(typeword) (((typeword) >> 8) & 0xFF)
+#define SDL_SHADER_BYTECODE_TYPEWORD_ROWS(typeword) (((typeword) >> 16) & 0xFF)
+
+/* What each entry in the TYPES section describes. Type ids count up from 1 in the order the
+   entries appear, and an entry only refers to ids that came before it. */
+typedef enum SDL_SHADER_BytecodeTypeKind
+{
+    SDL_SHADER_BCTYPE_NONE,
+    SDL_SHADER_BCTYPE_VALUE,   /* a scalar, vector or matrix: one type word. */
+    SDL_SHADER_BCTYPE_ARRAY,   /* the element's type id, then the number of elements. */
+    SDL_SHADER_BCTYPE_STRUCT   /* each member's type id, in order. */
+} SDL_SHADER_BytecodeTypeKind;
+
+/* The DIRECTORY's entry point table is open addressing: a name's first bucket is its hash
+   masked by the number of buckets (a power of two), and a lookup tries each bucket after
+   that in turn until it finds the name, or a bucket with this function index, which is empty. */
+#define SDL_SHADER_BYTECODE_NO_FUNCTION 0xFFFFFFFF
+
+/* The hash the DIRECTORY uses for entry point names (32-bit FNV-1a over the name's bytes,
+   without the null terminator). */
+SDL_FORCE_INLINE Uint32 SDL_SHADER_BytecodeHashName(const char *name)
+{
+    Uint32 hash = 0x811C9DC5;
+    while (*name) {
+        hash ^= (Uint32) (Uint8) *(name++);
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+/*
+ * Calculate the CRC-32 of some data, like the one in the bytecode's header.
+ *
+ * This is the same CRC-32 that zlib and PNG use. Pass zero for (crc) to
+ *  start fresh, or the return value of an earlier call to carry on from
+ *  where it left off, so the data doesn't have to be in memory all at once.
+ *
+ * This uses the CPU's carry-less multiply or CRC instructions where it can,
+ *  so it's cheap to check large files as they load.
+ *
+ * This function is thread safe.
+ */
+extern DECLSPEC Uint32 SDLCALL SDL_SHADER_BytecodeCrc32(Uint32 crc, const void *data, size_t len);
+
+/*
+ * If (crc1) is the CRC-32 of some data, and (crc2) is the CRC-32 of the
+ *  (len2) bytes that come after it, this returns the CRC-32 of both together,
+ *  without having to look at either of them again.
+ *
+ * This function is thread safe.
+ */
+extern DECLSPEC Uint32 SDLCALL SDL_SHADER_BytecodeCrc32Combine(Uint32 crc1, Uint32 crc2, size_t len2);
+
+/* SDL_SHADER_VerifyBytecode() won't accept IFs and LOOPs nested deeper than this. */
+#define SDL_SHADER_BYTECODE_MAX_NESTING 128
+
+/*
+ * Check that some bytecode is safe to load, so a program can use bytecode it
+ *  got from somewhere it doesn't trust without crashing on it.
+ *
+ * This checks the CRC-32, that every section and instruction fits where it
+ *  is and has the right number of words for what it is, that every SSA id is
+ *  defined once, and before anything uses it, and isn't used outside the IF or
+ *  LOOP that defined it (except as docs/README-bytecode-format.md allows, like
+ *  by a PHI), that every type id and CALL goes
+ *  somewhere that exists, that PHI, BREAK and CONTINUE only show up where they
+ *  are allowed, and that the directory (if there is one) is right. It doesn't
+ *  check that the types in an instruction make sense together.
+ *
+ * This makes one pass over the bytecode, and checking each SSA id it uses
+ *  takes constant time, so it's cheap enough to run on everything as it
+ *  loads. The only memory it allocates is a byte per SSA id in the biggest
+ *  function (never more than a twentieth of (bytecodelen)), which is freed
+ *  before it returns; if that allocation fails, so does verification. It can
+ *  verify bytecode format version 3 and later.
+ *
+ * If this returns SDL_FALSE and (errbuf) isn't NULL, a description of the
+ *  first problem found is written there, null-terminated and cut down to
+ *  fit in (errbuflen) bytes if it has to be.
+ *
+ * This function is thread safe.
+ */
+extern DECLSPEC SDL_bool SDLCALL SDL_SHADER_VerifyBytecode(const void *bytecode, size_t bytecodelen, char *errbuf, size_t errbuflen);
+
+
+/* Reading bytecode without copying it.
+
+   SDL_SHADER_OpenBytecode() fills in a SDL_SHADER_BytecodeModule that points into the
+   caller's buffer, and everything else here hands out pointers into that same buffer,
+   so nothing is copied or allocated, and the buffer has to stay around (and not change)
+   for as long as any of them are in use. It could be memory-mapped straight from a file.
+
+   Pointers to words (`const Uint32 *`) are in the file's byte order, which is little
+   endian; use SDL_SHADER_BytecodeWord() to read them, which is just a load on little
+   endian CPUs. The bytecode has to be 4-byte aligned, which anything from malloc() or
+   mmap() is.
+
+   Treat all of these structs as read-only. */
+
+typedef struct SDL_SHADER_BytecodeModule
+{
+    const Uint32 *words;  /* the whole file, starting at the magic. */
+    size_t num_words;
+    Uint32 version;
+    const Uint32 *directory;  /* the DIRECTORY section, starting at its tag, NULL if there isn't one. */
+    const Uint32 *types;  /* the TYPES section, starting at its tag. */
+    Uint32 num_types;
+    const Uint32 *functions;  /* the first FUNCTION section, starting at its tag, NULL if there aren't any. */
+    Uint32 num_functions;
+} SDL_SHADER_BytecodeModule;
+
+/* A run of instructions: a function's code, or the code inside an IF or LOOP. `pos` is the
+   next instruction, and it's done when `pos` gets to `end`. */
+typedef struct SDL_SHADER_BytecodeCode
+{
+    const Uint32 *pos;
+    const Uint32 *end;
+} SDL_SHADER_BytecodeCode;
+
+typedef struct SDL_SHADER_BytecodeType
+{
+    Uint32 id;  /* counts up from 1. */
+    SDL_SHADER_BytecodeTypeKind kind;
+    const Uint32 *values;  /* see SDL_SHADER_BytecodeTypeKind for what these are. */
+    Uint32 num_values;
+    const Uint32 *words;  /* the whole entry, starting at its kind. */
+} SDL_SHADER_BytecodeType;
+
+typedef struct SDL_SHADER_BytecodeFunction
+{
+    Uint32 index;  /* what CALL instructions use to refer to it. */
+    SDL_SHADER_BytecodeFunctionType fntype;
+    const char *name;  /* NULL if it isn't an entry point. */
+    const Uint32 *input_types;  /* a type id for each argument, in order. */
+    Uint32 num_inputs;
+    Uint32 return_type;  /* type id, zero if it doesn't return anything. */
+    const Uint32 *constants;  /* the constant pool's entries, laid out as README-bytecode-format.md says. */
+    Uint32 num_constants;
+    Uint32 first_id;  /* the first SSA id the code defines; the arguments and constants come before it. */
+    SDL_SHADER_BytecodeCode code;
+    const Uint32 *words;  /* the whole FUNCTION section, starting at its tag. */
+} SDL_SHADER_BytecodeFunction;
+
+typedef struct SDL_SHADER_BytecodeInstruction
+{
+    SDL_SHADER_BytecodeTag opcode;
+    Uint32 num_words;
+    const Uint32 *words;  /* the whole instruction, starting at its opcode, so the operands start at words[2]. */
+    SDL_SHADER_BytecodeCode body;  /* IF: the "true" code. LOOP: the loop's code. Empty for everything else. */
+    SDL_SHADER_BytecodeCode else_body;  /* IF: the "false" code. Empty for everything else. */
+} SDL_SHADER_BytecodeInstruction;
+
+/* Read word (i) from (words), which points into bytecode. */
+SDL_FORCE_INLINE Uint32 SDL_SHADER_BytecodeWord(const Uint32 *words, const size_t i)
+{
+    return SDL_SwapLE32(words[i]);
+}
+
+/*
+ * Get ready to read some bytecode, after checking it with SDL_SHADER_VerifyBytecode(),
+ *  so nothing else here has to check anything as it goes.
+ *
+ * Returns SDL_FALSE if the bytecode isn't 4-byte aligned or doesn't verify, with a
+ *  description of the problem in (errbuf), like SDL_SHADER_VerifyBytecode().
+ *
+ * This function is thread safe.
+ */
+extern DECLSPEC SDL_bool SDLCALL SDL_SHADER_OpenBytecode(SDL_SHADER_BytecodeModule *module, const void *bytecode, size_t bytecodelen, char *errbuf, size_t errbuflen);
+
+/*
+ * Like SDL_SHADER_OpenBytecode(), but without verifying the bytecode first, for bytecode
+ *  the program already checked with SDL_SHADER_VerifyBytecode() (when it was downloaded,
+ *  say, or at build time for bytecode built in to the program), so it doesn't pay for
+ *  that every time it loads.
+ *
+ * Nothing here checks the bytecode as it reads it, so this is only safe if the exact
+ *  bytes in (bytecode) passed SDL_SHADER_VerifyBytecode() and haven't changed since.
+ *  Anything else can make this and the functions below read out of bounds or crash;
+ *  if you can't be sure, use SDL_SHADER_OpenBytecode().
+ *
+ * Returns SDL_FALSE only if the bytecode isn't 4-byte aligned, with a description of
+ *  the problem in (errbuf), like SDL_SHADER_VerifyBytecode().
+ *
+ * This function is thread safe.
+ */
+extern DECLSPEC SDL_bool SDLCALL SDL_SHADER_OpenVerifiedBytecode(SDL_SHADER_BytecodeModule *module, const void *bytecode, size_t bytecodelen, char *errbuf, size_t errbuflen);
+
+/*
+ * Step through the types in order. Zero out (type) to start at the first one; each
+ *  call fills in the next one, and this returns SDL_FALSE when there aren't any more.
+ *
+ * This function is thread safe.
+ */
+extern DECLSPEC SDL_bool SDLCALL SDL_SHADER_NextBytecodeType(const SDL_SHADER_BytecodeModule *module, SDL_SHADER_BytecodeType *type);
+
+/*
+ * Look up a type id. This has to go through the types before it, so if you need all
+ *  of them, SDL_SHADER_NextBytecodeType() is faster.
+ *
+ * This function is thread safe.
+ */
+extern DECLSPEC SDL_bool SDLCALL SDL_SHADER_GetBytecodeType(const SDL_SHADER_BytecodeModule *module, Uint32 id, SDL_SHADER_BytecodeType *type);
+
+/*
+ * Step through the functions in order. Zero out (fn) to start at the first one; each
+ *  call fills in the next one, and this returns SDL_FALSE when there aren't any more.
+ *
+ * This function is thread safe.
+ */
+extern DECLSPEC SDL_bool SDLCALL SDL_SHADER_NextBytecodeFunction(const SDL_SHADER_BytecodeModule *module, SDL_SHADER_BytecodeFunction *fn);
+
+/*
+ * Look up a function by index, like a CALL instruction does. This is constant time if
+ *  the bytecode has a DIRECTORY, and has to go through the functions before it if not.
+ *
+ * This function is thread safe.
+ */
+extern DECLSPEC SDL_bool SDLCALL SDL_SHADER_GetBytecodeFunction(const SDL_SHADER_BytecodeModule *module, Uint32 index, SDL_SHADER_BytecodeFunction *fn);
+
+/*
+ * Look up an entry point by name. This uses the DIRECTORY's hash table if there is
+ *  one, and has to go through all the functions if not. If there's no entry point
+ *  by that name, this returns SDL_FALSE and (fn) isn't changed.
+ *
+ * This function is thread safe.
+ */
+extern DECLSPEC SDL_bool SDLCALL SDL_SHADER_FindBytecodeEntryPoint(const SDL_SHADER_BytecodeModule *module, const char *name, SDL_SHADER_BytecodeFunction *fn);
+
+/*
+ * Step through a run of instructions. Start with a function's `code`, and each call
+ *  fills in the next instruction and moves (code) past it, returning SDL_FALSE at the
+ *  end. An IF or LOOP counts as one instruction; to go into the code inside it, step
+ *  through a copy of its `body` (and `else_body`) the same way.
+ *
+ * This function is thread safe.
+ */
+SDL_FORCE_INLINE SDL_bool SDL_SHADER_NextBytecodeInstruction(SDL_SHADER_BytecodeCode *code, SDL_SHADER_BytecodeInstruction *inst)
+{
+    const Uint32 *words = code->pos;
+    const Uint32 *end;
+
+    if (words >= code->end) {
+        return SDL_FALSE;
+    }
+
+    inst->opcode = (SDL_SHADER_BytecodeTag) SDL_SHADER_BytecodeWord(words, 0);
+    inst->num_words = SDL_SHADER_BytecodeWord(words, 1);
+    inst->words = words;
+    end = words + inst->num_words;
+
+    inst->body.pos = inst->body.end = inst->else_body.pos = inst->else_body.end = end;
+    if (inst->opcode == SDL_SHADER_BCTAG_OP_IF) {
+        inst->body.pos = words + 4;
+        inst->body.end = inst->else_body.pos = words + 4 + SDL_SHADER_BytecodeWord(words, 3);
+    } else if (inst->opcode == SDL_SHADER_BCTAG_OP_LOOP) {
+        inst->body.pos = words + 2;
+    }
+
+    code->pos = end;
+    return SDL_TRUE;
+}
+
 #ifdef __cplusplus
 }
 #endif
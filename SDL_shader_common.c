@@ -588,6 +588,18 @@ size_t errorlist_count(ErrorList *list)
     return list ? list->count : 0;
 }
 
+void errorlist_splice(ErrorList *dst, ErrorList *src)
+{
+    if (src->count > 0) {
+        dst->tail->next = src->head.next;
+        dst->tail = src->tail;
+        dst->count += src->count;
+        src->count = 0;
+        src->head.next = NULL;
+        src->tail = &src->head;
+    }
+}
+
 SDL_SHADER_Error *errorlist_flatten(ErrorList *list)
 {
     SDL_SHADER_Error *retval = NULL;
@@ -1039,6 +1051,35 @@ void FreeContextBridge(void *ptr, void *data)
     Free((Context *) data, ptr);
 }
 
+Uint32 *wordbuffer_reserve(Context *ctx, WordBuffer *buffer, const Uint32 count)
+{
+    Uint32 *retval;
+
+    if ((buffer->len + count) > buffer->allocated) {
+        Uint32 allocated = buffer->allocated ? buffer->allocated : 256;
+        Uint32 *words;
+
+        while (allocated < (buffer->len + count)) {
+            allocated *= 2;
+        }
+
+        words = (Uint32 *) Malloc(ctx, allocated * sizeof (Uint32));
+        if (words == NULL) {
+            return NULL;  /* will have set the out_of_memory flag. */
+        } else if (buffer->words) {
+            SDL_memcpy(words, buffer->words, buffer->len * sizeof (Uint32));
+            Free(ctx, buffer->words);
+        }
+
+        buffer->words = words;
+        buffer->allocated = allocated;
+    }
+
+    retval = buffer->words + buffer->len;
+    buffer->len += count;
+    return retval;
+}
+
 char *StrDup(Context *ctx, const char *str)
 {
     const size_t slen = SDL_strlen(str) + 1;
@@ -30,6 +30,22 @@
     } \
 }
 
+/* When analyzing functions on worker threads, anything that touches the shared
+   datatypes hash or string cache has to hold this lock. It's a no-op otherwise. */
+static void lock_datatypes(Context *ctx)
+{
+    if (ctx->datatypes_lock) {
+        SDL_LockMutex(ctx->datatypes_lock);
+    }
+}
+
+static void unlock_datatypes(Context *ctx)
+{
+    if (ctx->datatypes_lock) {
+        SDL_UnlockMutex(ctx->datatypes_lock);
+    }
+}
+
 
 static ScopeItem *push_scope(Context *ctx, SDL_SHADER_AstNode *ast)
 {
@@ -125,6 +141,17 @@ static SDL_SHADER_AstNode *find_symbol_in_scope(Context *ctx, const char *sym)
     return NULL;
 }
 
+static SDL_SHADER_AstFunction *find_function(Context *ctx, const char *name)
+{
+    SDL_SHADER_AstFunction *i;
+    for (i = ctx->functions; i != NULL; i = i->nextfn) {
+        if (i->vardecl->name == name) {  /* strcache'd, we can compare pointers. */
+            return i;
+        }
+    }
+    return NULL;
+}
+
 static Uint32 datatype_element_count(const DataType *dt)
 {
     if (dt) {
@@ -182,7 +209,7 @@ static SDL_bool ast_calc_int(const void *_expr, Sint32 *_val)
         
         switch (asttype) {
             case SDL_SHADER_AST_OP_POSITIVE: *_val = x; return SDL_TRUE;
-            case SDL_SHADER_AST_OP_NEGATE: *_val = -x; return SDL_TRUE;
+            case SDL_SHADER_AST_OP_NEGATE: *_val = (Sint32) (0u - (Uint32) x); return SDL_TRUE;
             case SDL_SHADER_AST_OP_COMPLEMENT: *_val = ~x; return SDL_TRUE;
             case SDL_SHADER_AST_OP_PARENTHESES: *_val = x; return SDL_TRUE;
             /* rest of these are increment things (not constant!) or boolean things (not allowed on ints) */
@@ -193,14 +220,21 @@ static SDL_bool ast_calc_int(const void *_expr, Sint32 *_val)
         if (!ast_calc_int(expr->binary.left, &x) || !ast_calc_int(expr->binary.right, &y)) {
             return SDL_FALSE;
         }
+        /* do the math in Uint32 so overflow wraps instead of being undefined behavior, and
+           refuse to divide by zero or shift out of range, so we report it instead of crashing. */
         switch (asttype) {
-            case SDL_SHADER_AST_OP_MULTIPLY: *_val = x * y; return SDL_TRUE;
-            case SDL_SHADER_AST_OP_DIVIDE: *_val = x / y; return SDL_TRUE;
-            case SDL_SHADER_AST_OP_MODULO: *_val = x % y; return SDL_TRUE;
-            case SDL_SHADER_AST_OP_ADD: *_val = x + y; return SDL_TRUE;
-            case SDL_SHADER_AST_OP_SUBTRACT: *_val = x - y; return SDL_TRUE;
-            case SDL_SHADER_AST_OP_LSHIFT: *_val = x << y; return SDL_TRUE;
-            case SDL_SHADER_AST_OP_RSHIFT: *_val = x >> y; return SDL_TRUE;
+            case SDL_SHADER_AST_OP_MULTIPLY: *_val = (Sint32) (((Uint32) x) * ((Uint32) y)); return SDL_TRUE;
+            case SDL_SHADER_AST_OP_DIVIDE:
+            case SDL_SHADER_AST_OP_MODULO:
+                if ((y == 0) || ((x == SDL_MIN_SINT32) && (y == -1))) {
+                    return SDL_FALSE;
+                }
+                *_val = (asttype == SDL_SHADER_AST_OP_DIVIDE) ? (x / y) : (x % y);
+                return SDL_TRUE;
+            case SDL_SHADER_AST_OP_ADD: *_val = (Sint32) (((Uint32) x) + ((Uint32) y)); return SDL_TRUE;
+            case SDL_SHADER_AST_OP_SUBTRACT: *_val = (Sint32) (((Uint32) x) - ((Uint32) y)); return SDL_TRUE;
+            case SDL_SHADER_AST_OP_LSHIFT: if ((y < 0) || (y > 31)) { return SDL_FALSE; } *_val = (Sint32) (((Uint32) x) << y); return SDL_TRUE;
+            case SDL_SHADER_AST_OP_RSHIFT: if ((y < 0) || (y > 31)) { return SDL_FALSE; } *_val = (x < 0) ? ~((~x) >> y) : (x >> y); return SDL_TRUE;
             case SDL_SHADER_AST_OP_BINARYAND: *_val = x & y; return SDL_TRUE;
             case SDL_SHADER_AST_OP_BINARYXOR: *_val = x ^ y; return SDL_TRUE;
             case SDL_SHADER_AST_OP_BINARYOR: *_val = x | y; return SDL_TRUE;
@@ -395,6 +429,7 @@ static const DataType *resolve_datatype(Context *ctx, SDL_SHADER_AstVarDeclarati
     const DataType *dt = ast->dt;
 
     if (dt == NULL) {
+        lock_datatypes(ctx);  /* we might add a new array datatype here. */
         if (!hash_find(ctx->datatypes, vardecl->datatype_name, (const void **) &dt)) {
             failf_ast(ctx, ast, "Unknown data type '%s'", vardecl->datatype_name);
             dt = NULL;
@@ -421,6 +456,7 @@ static const DataType *resolve_datatype(Context *ctx, SDL_SHADER_AstVarDeclarati
                 dt = arraydt;
             }
         }
+        unlock_datatypes(ctx);
 
         ast->dt = dt;
     }
@@ -518,6 +554,8 @@ static void semantic_analysis_gather_datatypes(Context *ctx)
        compare pointers to decide if a datatype is equal! */
 }
 
+static void semantic_analysis_validate_function_at_attribute(Context *ctx, SDL_SHADER_AstFunction *fn);
+
 /* make sure function and parameter datatypes are resolved before we walk the AST,
    because we might call a function that hasn't been declared at a given point. */
 static void semantic_analysis_prepare_functions(Context *ctx)
@@ -532,11 +570,178 @@ static void semantic_analysis_prepare_functions(Context *ctx)
                     i->ast.dt = resolve_datatype(ctx, i->vardecl);
                 }
             }
+            semantic_analysis_validate_function_at_attribute(ctx, fn);  /* we need to know the entry points before we walk the tree. */
             push_scope(ctx, (SDL_SHADER_AstNode *) fn);
         }
     }
 }
 
+/* Walks a function's code, looking for calls to user-defined functions, and marks any it finds as reachable.
+   This runs before semantic_analysis_treewalk(), so nothing has been validated yet; it just looks at names.
+   Newly-reachable functions are added to `worklist`, so we don't recurse down the entire call graph. */
+static void find_reachable_calls(Context *ctx, const void *_ast, SDL_SHADER_AstFunction **worklist, Uint32 *worklist_len)
+{
+    const SDL_SHADER_AstNode *ast = (const SDL_SHADER_AstNode *) _ast;
+    const SDL_SHADER_AstNodeType asttype = ast ? ast->ast.type : SDL_SHADER_AST_STATEMENT_EMPTY;
+
+    if (!ast) {
+        return;
+    } else if (operator_is_unary(asttype)) {
+        find_reachable_calls(ctx, ast->unary.operand, worklist, worklist_len);
+        return;
+    } else if (operator_is_binary(asttype)) {
+        find_reachable_calls(ctx, ast->binary.left, worklist, worklist_len);
+        find_reachable_calls(ctx, ast->binary.right, worklist, worklist_len);
+        return;
+    } else if (operator_is_ternary(asttype)) {
+        find_reachable_calls(ctx, ast->ternary.left, worklist, worklist_len);
+        find_reachable_calls(ctx, ast->ternary.center, worklist, worklist_len);
+        find_reachable_calls(ctx, ast->ternary.right, worklist, worklist_len);
+        return;
+    }
+
+    switch (asttype) {
+        case SDL_SHADER_AST_OP_DEREF_STRUCT:
+            find_reachable_calls(ctx, ast->structderef.expr, worklist, worklist_len);
+            return;
+
+        case SDL_SHADER_AST_OP_CALLFUNC: {
+            SDL_SHADER_AstFunction *fn = find_function(ctx, ast->fncall.fnname);
+            const SDL_SHADER_AstArgument *arg;
+            if (fn && !fn->reachable) {
+                fn->reachable = SDL_TRUE;
+                worklist[(*worklist_len)++] = fn;
+            }
+            for (arg = ast->fncall.arguments ? ast->fncall.arguments->head : NULL; arg; arg = arg->next) {
+                find_reachable_calls(ctx, arg->arg, worklist, worklist_len);
+            }
+            return;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_VARDECL:
+            find_reachable_calls(ctx, ast->vardeclstmt.initializer, worklist, worklist_len);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_DO:
+            find_reachable_calls(ctx, ast->dostmt.code, worklist, worklist_len);
+            find_reachable_calls(ctx, ast->dostmt.condition, worklist, worklist_len);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_WHILE:
+            find_reachable_calls(ctx, ast->whilestmt.condition, worklist, worklist_len);
+            find_reachable_calls(ctx, ast->whilestmt.code, worklist, worklist_len);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_FOR:
+            find_reachable_calls(ctx, ast->forstmt.details->initializer, worklist, worklist_len);
+            find_reachable_calls(ctx, ast->forstmt.details->condition, worklist, worklist_len);
+            find_reachable_calls(ctx, ast->forstmt.details->step, worklist, worklist_len);
+            find_reachable_calls(ctx, ast->forstmt.code, worklist, worklist_len);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_IF:
+            find_reachable_calls(ctx, ast->ifstmt.condition, worklist, worklist_len);
+            find_reachable_calls(ctx, ast->ifstmt.code, worklist, worklist_len);
+            find_reachable_calls(ctx, ast->ifstmt.else_code, worklist, worklist_len);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_RETURN:
+            find_reachable_calls(ctx, ast->returnstmt.value, worklist, worklist_len);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_BLOCK: {
+            const SDL_SHADER_AstStatement *i;
+            for (i = ast->stmtblock.head; i != NULL; i = i->next) {
+                find_reachable_calls(ctx, i, worklist, worklist_len);
+            }
+            return;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_PREINCREMENT:
+        case SDL_SHADER_AST_STATEMENT_POSTINCREMENT:
+        case SDL_SHADER_AST_STATEMENT_PREDECREMENT:
+        case SDL_SHADER_AST_STATEMENT_POSTDECREMENT:
+            find_reachable_calls(ctx, ast->incrementstmt.assignment, worklist, worklist_len);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_FUNCTION_CALL:
+            find_reachable_calls(ctx, ast->fncallstmt.expr, worklist, worklist_len);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_ASSIGNMENT: {
+            const SDL_SHADER_AstAssignment *i;
+            for (i = ast->assignstmt.assignments ? ast->assignstmt.assignments->head : NULL; i != NULL; i = i->next) {
+                find_reachable_calls(ctx, i->expr, worklist, worklist_len);
+            }
+            find_reachable_calls(ctx, ast->assignstmt.value, worklist, worklist_len);
+            return;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNMUL:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNDIV:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNMOD:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNADD:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNSUB:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNLSHIFT:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNRSHIFT:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNAND:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNXOR:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNOR:
+            find_reachable_calls(ctx, ast->compoundassignstmt.assignment, worklist, worklist_len);
+            find_reachable_calls(ctx, ast->compoundassignstmt.value, worklist, worklist_len);
+            return;
+
+        default:
+            return;  /* literals, identifiers, break/continue/discard, etc: no calls in here. */
+    }
+}
+
+/* There's no `main`: entry points are functions marked with @vertex or @fragment. Anything
+   they can't (transitively) call will never be compiled, and depending on what the app asked
+   for, we might not bother to analyze it either. If there aren't any entry points at all,
+   we assume this is a library of functions and consider everything reachable. */
+static void semantic_analysis_find_reachable_functions(Context *ctx)
+{
+    SDL_SHADER_AstFunction **worklist;
+    SDL_SHADER_AstFunction *fn;
+    Uint32 num_functions = 0;
+    Uint32 worklist_len = 0;
+
+    for (fn = ctx->functions; fn != NULL; fn = fn->nextfn) {
+        num_functions++;
+    }
+
+    if (num_functions == 0) {
+        return;
+    }
+
+    /* each function goes on the worklist at most once, so this is always big enough. */
+    worklist = (SDL_SHADER_AstFunction **) Malloc(ctx, sizeof (SDL_SHADER_AstFunction *) * num_functions);
+    if (!worklist) {
+        return;  /* will have set the out_of_memory flag. */
+    }
+
+    for (fn = ctx->functions; fn != NULL; fn = fn->nextfn) {
+        if ((fn->fntype == SDL_SHADER_AST_FNTYPE_VERTEX) || (fn->fntype == SDL_SHADER_AST_FNTYPE_FRAGMENT)) {
+            fn->reachable = SDL_TRUE;
+            worklist[worklist_len++] = fn;
+        }
+    }
+
+    if (worklist_len == 0) {  /* no entry points? Everything is fair game. */
+        for (fn = ctx->functions; fn != NULL; fn = fn->nextfn) {
+            fn->reachable = SDL_TRUE;
+        }
+    }
+
+    while (worklist_len > 0) {
+        fn = worklist[--worklist_len];
+        find_reachable_calls(ctx, fn->code, worklist, &worklist_len);
+    }
+
+    Free(ctx, worklist);
+}
+
 static SDL_bool ast_is_integer(const void *_ast)
 {
     const SDL_SHADER_AstNode *ast = (SDL_SHADER_AstNode *) _ast;
@@ -668,6 +873,29 @@ static SDL_bool ast_is_lvalue(Context *ctx, const SDL_SHADER_AstExpression *expr
     return SDL_FALSE;
 }
 
+/* The variable at the root of an lvalue (`x` in `x.y[2] = 5;`). NULL if there isn't one, or it was undefined (we already reported that). */
+static SDL_SHADER_AstVarDeclaration *lvalue_vardecl(const SDL_SHADER_AstExpression *expr)
+{
+    while (expr != NULL) {
+        switch (expr->ast.type) {
+            case SDL_SHADER_AST_OP_IDENTIFIER: return ((const SDL_SHADER_AstIdentifierExpression *) expr)->vardecl;
+            case SDL_SHADER_AST_OP_DEREF_ARRAY: expr = ((const SDL_SHADER_AstBinaryExpression *) expr)->left; break;
+            case SDL_SHADER_AST_OP_DEREF_STRUCT: expr = ((const SDL_SHADER_AstStructDerefExpression *) expr)->expr; break;
+            default: return NULL;
+        }
+    }
+    return NULL;
+}
+
+/* Note that the variable at the root of an lvalue is written to. */
+static void mark_lvalue_assigned(SDL_SHADER_AstExpression *expr)
+{
+    SDL_SHADER_AstVarDeclaration *vardecl = lvalue_vardecl(expr);
+    if (vardecl) {
+        vardecl->assigned = SDL_TRUE;
+    }
+}
+
 static SDL_bool ast_literal_can_promote_to(const SDL_SHADER_AstNodeType asttype, const DataType *dt)
 {
     DataTypeType dtt;
@@ -738,6 +966,16 @@ static SDL_bool ast_datatypes_match(const void *_a, const void *_b)
     return SDL_FALSE;
 }
 
+/* For operators where both sides need matching datatypes, the result gets the datatype of
+   the side that isn't being promoted, so `1.0 + myfloat4` is a float4, not a float. */
+static const DataType *ast_binary_result_datatype(const SDL_SHADER_AstExpression *left, const SDL_SHADER_AstExpression *right)
+{
+    if (left->ast.dt && right->ast.dt && (left->ast.dt != right->ast.dt) && ast_literal_can_promote_to(left->ast.type, right->ast.dt)) {
+        return right->ast.dt;
+    }
+    return left->ast.dt;
+}
+
 static const char *ast_opstr(const SDL_SHADER_AstNodeType typ)
 {
     switch (typ) {
@@ -789,6 +1027,19 @@ static const char *ast_opstr(const SDL_SHADER_AstNodeType typ)
     return "[unexpected operator]";
 }
 
+/* maps a swizzle character to the vector element it selects ('y' and 'g' are 1, etc). Returns 4 for anything else. */
+static Uint32 swizzle_index(const char ch)
+{
+    switch (ch) {
+        case 'x': case 'r': return 0;
+        case 'y': case 'g': return 1;
+        case 'z': case 'b': return 2;
+        case 'w': case 'a': return 3;
+        default: break;
+    }
+    return 4;
+}
+
 static const DataType *semantic_analysis_typecheck_swizzle(Context *ctx, const SDL_SHADER_AstExpression *expr, const char *swizzle)
 {
     const DataType *retval;
@@ -827,6 +1078,11 @@ static const DataType *semantic_analysis_typecheck_swizzle(Context *ctx, const S
                 failf_ast(ctx, &expr->ast, "Invalid vector swizzle '%s'", swizzle);
                 return NULL;
         }
+
+        if (swizzle_index(ch) >= expr->ast.dt->info.vector.elements) {
+            failf_ast(ctx, &expr->ast, "Vector swizzle '%s' is out of range for datatype '%s'", swizzle, expr->ast.dt->name);
+            return NULL;
+        }
     }
 
     ICE_IF(ctx, &expr->ast, !has_rgba && !has_xyzw, "Unexpected case in swizzle validation!");
@@ -842,10 +1098,13 @@ static const DataType *semantic_analysis_typecheck_swizzle(Context *ctx, const S
         SDL_snprintf(newtype, sizeof (newtype), "%s%d", expr->ast.dt->info.vector.childdt->name, (int) slen);
     }
 
+    lock_datatypes(ctx);
     if (!hash_find(ctx->datatypes, stringcache(ctx->strcache, newtype), (const void **) &retval)) {
+        unlock_datatypes(ctx);
         ICE(ctx, &expr->ast, "Unexpected swizzled datatype!");
         return NULL;
     }
+    unlock_datatypes(ctx);
 
     ICE_IF(ctx, &expr->ast, retval == NULL, "Successfully looked up a datatype, but it's NULL!");
 
@@ -872,11 +1131,14 @@ static void semantic_analysis_validate_function_at_attribute(Context *ctx, SDL_S
     SDL_SHADER_AstAtAttribute *atattr = fn->vardecl->attribute;
 
     fn->fntype = SDL_SHADER_AST_FNTYPE_NORMAL;
+    fn->precise = SDL_FALSE;
     if (atattr) {
         if (semantic_analysis_validate_at_attribute(ctx, atattr, "vertex", SDL_FALSE)) {
             fn->fntype = SDL_SHADER_AST_FNTYPE_VERTEX;
         } else if (semantic_analysis_validate_at_attribute(ctx, atattr, "fragment", SDL_FALSE)) {
             fn->fntype = SDL_SHADER_AST_FNTYPE_FRAGMENT;
+        } else if (semantic_analysis_validate_at_attribute(ctx, atattr, "precise", SDL_FALSE)) {
+            fn->precise = SDL_TRUE;
         } else {
             failf_ast(ctx, &atattr->ast, "Unknown function attribute '@%s' on function '%s'", atattr->name, fn->vardecl->name);
         }
@@ -997,6 +1259,268 @@ static void semantic_analysis_validate_function_call_arguments(Context *ctx, SDL
     }
 }
 
+/* Intrinsic functions. A user-defined function with the same name wins, if there is one.
+   !!! FIXME: frexp needs an output parameter and sample needs texture types, and we have neither yet. */
+static const Intrinsic intrinsics[] = {
+    { "all", SDL_SHADER_BCTAG_OP_ALL, 1, INTRINSIC_RULE_BOOL_REDUCE },
+    { "any", SDL_SHADER_BCTAG_OP_ANY, 1, INTRINSIC_RULE_BOOL_REDUCE },
+    { "round", SDL_SHADER_BCTAG_OP_ROUND, 1, INTRINSIC_RULE_FLOAT },
+    { "roundeven", SDL_SHADER_BCTAG_OP_ROUNDEVEN, 1, INTRINSIC_RULE_FLOAT },
+    { "mod", SDL_SHADER_BCTAG_OP_MOD, 2, INTRINSIC_RULE_FLOAT },
+    { "trunc", SDL_SHADER_BCTAG_OP_TRUNC, 1, INTRINSIC_RULE_FLOAT },
+    { "abs", SDL_SHADER_BCTAG_OP_ABS, 1, INTRINSIC_RULE_NUMBER },
+    { "sign", SDL_SHADER_BCTAG_OP_SIGN, 1, INTRINSIC_RULE_NUMBER },
+    { "floor", SDL_SHADER_BCTAG_OP_FLOOR, 1, INTRINSIC_RULE_FLOAT },
+    { "ceil", SDL_SHADER_BCTAG_OP_CEIL, 1, INTRINSIC_RULE_FLOAT },
+    { "fract", SDL_SHADER_BCTAG_OP_FRACT, 1, INTRINSIC_RULE_FLOAT },
+    { "radians", SDL_SHADER_BCTAG_OP_RADIANS, 1, INTRINSIC_RULE_FLOAT },
+    { "degrees", SDL_SHADER_BCTAG_OP_DEGREES, 1, INTRINSIC_RULE_FLOAT },
+    { "sin", SDL_SHADER_BCTAG_OP_SIN, 1, INTRINSIC_RULE_FLOAT },
+    { "cos", SDL_SHADER_BCTAG_OP_COS, 1, INTRINSIC_RULE_FLOAT },
+    { "tan", SDL_SHADER_BCTAG_OP_TAN, 1, INTRINSIC_RULE_FLOAT },
+    { "asin", SDL_SHADER_BCTAG_OP_ASIN, 1, INTRINSIC_RULE_FLOAT },
+    { "acos", SDL_SHADER_BCTAG_OP_ACOS, 1, INTRINSIC_RULE_FLOAT },
+    { "atan", SDL_SHADER_BCTAG_OP_ATAN, 1, INTRINSIC_RULE_FLOAT },
+    { "sinh", SDL_SHADER_BCTAG_OP_SINH, 1, INTRINSIC_RULE_FLOAT },
+    { "cosh", SDL_SHADER_BCTAG_OP_COSH, 1, INTRINSIC_RULE_FLOAT },
+    { "tanh", SDL_SHADER_BCTAG_OP_TANH, 1, INTRINSIC_RULE_FLOAT },
+    { "asinh", SDL_SHADER_BCTAG_OP_ASINH, 1, INTRINSIC_RULE_FLOAT },
+    { "acosh", SDL_SHADER_BCTAG_OP_ACOSH, 1, INTRINSIC_RULE_FLOAT },
+    { "atanh", SDL_SHADER_BCTAG_OP_ATANH, 1, INTRINSIC_RULE_FLOAT },
+    { "atan2", SDL_SHADER_BCTAG_OP_ATAN2, 2, INTRINSIC_RULE_FLOAT },
+    { "pow", SDL_SHADER_BCTAG_OP_POW, 2, INTRINSIC_RULE_FLOAT },
+    { "exp", SDL_SHADER_BCTAG_OP_EXP, 1, INTRINSIC_RULE_FLOAT },
+    { "log", SDL_SHADER_BCTAG_OP_LOG, 1, INTRINSIC_RULE_FLOAT },
+    { "exp2", SDL_SHADER_BCTAG_OP_EXP2, 1, INTRINSIC_RULE_FLOAT },
+    { "log2", SDL_SHADER_BCTAG_OP_LOG2, 1, INTRINSIC_RULE_FLOAT },
+    { "sqrt", SDL_SHADER_BCTAG_OP_SQRT, 1, INTRINSIC_RULE_FLOAT },
+    { "rsqrt", SDL_SHADER_BCTAG_OP_RSQRT, 1, INTRINSIC_RULE_FLOAT },
+    { "min", SDL_SHADER_BCTAG_OP_MIN, 2, INTRINSIC_RULE_NUMBER },
+    { "max", SDL_SHADER_BCTAG_OP_MAX, 2, INTRINSIC_RULE_NUMBER },
+    { "clamp", SDL_SHADER_BCTAG_OP_CLAMP, 3, INTRINSIC_RULE_NUMBER },
+    { "mix", SDL_SHADER_BCTAG_OP_MIX, 3, INTRINSIC_RULE_FLOAT },
+    { "step", SDL_SHADER_BCTAG_OP_STEP, 2, INTRINSIC_RULE_FLOAT },
+    { "smoothstep", SDL_SHADER_BCTAG_OP_SMOOTHSTEP, 3, INTRINSIC_RULE_FLOAT },
+    { "mad", SDL_SHADER_BCTAG_OP_MAD, 3, INTRINSIC_RULE_FLOAT },
+    { "ldexp", SDL_SHADER_BCTAG_OP_LDEXP, 2, INTRINSIC_RULE_LDEXP },
+    { "length", SDL_SHADER_BCTAG_OP_LEN, 1, INTRINSIC_RULE_FLOAT_TO_SCALAR },
+    { "distance", SDL_SHADER_BCTAG_OP_DISTANCE, 2, INTRINSIC_RULE_FLOAT_TO_SCALAR },
+    { "dot", SDL_SHADER_BCTAG_OP_DOT, 2, INTRINSIC_RULE_FLOAT_TO_SCALAR },
+    { "cross", SDL_SHADER_BCTAG_OP_CROSS, 2, INTRINSIC_RULE_FLOAT3 },
+    { "normalize", SDL_SHADER_BCTAG_OP_NORMALIZE, 1, INTRINSIC_RULE_FLOAT },
+    { "faceforward", SDL_SHADER_BCTAG_OP_FACEFORWARD, 3, INTRINSIC_RULE_FLOAT },
+    { "reflect", SDL_SHADER_BCTAG_OP_REFLECT, 2, INTRINSIC_RULE_FLOAT },
+    { "refract", SDL_SHADER_BCTAG_OP_REFRACT, 3, INTRINSIC_RULE_REFRACT },
+    { "transpose", SDL_SHADER_BCTAG_OP_TRANSPOSE, 1, INTRINSIC_RULE_TRANSPOSE }
+};
+
+static const Intrinsic *find_intrinsic(const char *name)
+{
+    size_t i;
+    for (i = 0; i < SDL_arraysize(intrinsics); i++) {
+        if (SDL_strcmp(intrinsics[i].name, name) == 0) {
+            return &intrinsics[i];
+        }
+    }
+    return NULL;
+}
+
+/* the scalar datatype that makes up a scalar, vector or matrix. NULL for anything else. */
+static const DataType *datatype_component(const DataType *dt)
+{
+    if (dt) {
+        switch (dt->dtype) {
+            case DT_BOOLEAN:
+            case DT_INT:
+            case DT_UINT:
+            case DT_HALF:
+            case DT_FLOAT:
+                return dt;
+            case DT_VECTOR:
+                return dt->info.vector.childdt;
+            case DT_MATRIX:
+                return dt->info.matrix.childdt->info.vector.childdt;
+            default: break;
+        }
+    }
+    return NULL;
+}
+
+/* the scalar, vector or matrix of `compdt` that's `rows` rows of `elements` each, NULL if there isn't one. */
+static const DataType *datatype_with_shape(Context *ctx, const DataType *compdt, const Uint32 elements, const Uint32 rows)
+{
+    const DataType *retval = NULL;
+    char name[32];
+
+    if (rows > 1) {  /* a matrix's name has its elements (columns), then its rows. */
+        SDL_snprintf(name, sizeof (name), "%s%ux%u", compdt->name, (unsigned int) elements, (unsigned int) rows);
+    } else if (elements > 1) {
+        SDL_snprintf(name, sizeof (name), "%s%u", compdt->name, (unsigned int) elements);
+    } else {
+        return compdt;
+    }
+
+    lock_datatypes(ctx);
+    if (!hash_find(ctx->datatypes, stringcache(ctx->strcache, name), (const void **) &retval)) {
+        retval = NULL;
+    }
+    unlock_datatypes(ctx);
+    return retval;
+}
+
+static SDL_bool ast_is_int_or_float_literal(const SDL_SHADER_AstExpression *expr)
+{
+    return ((expr->ast.type == SDL_SHADER_AST_OP_INT_LITERAL) || (expr->ast.type == SDL_SHADER_AST_OP_FLOAT_LITERAL)) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* Most intrinsics need all their arguments to be the same datatype, but literals can promote,
+   so the first argument that isn't a literal decides what that datatype is (`pow(2, x)` uses x's).
+   If they're all literals, it's float if any of them are (or if the intrinsic only works with
+   floats, so `sin(1)` means `sin(1.0)`), otherwise it's the first one's. */
+static const DataType *intrinsic_argument_datatype(Context *ctx, SDL_SHADER_AstExpression **args, const Uint32 num_args, const SDL_bool need_float)
+{
+    const DataType *retval = need_float ? ctx->datatype_float : args[0]->ast.dt;
+    Uint32 i;
+    for (i = 0; i < num_args; i++) {
+        if (!ast_is_int_or_float_literal(args[i])) {
+            return args[i]->ast.dt;
+        } else if (args[i]->ast.type == SDL_SHADER_AST_OP_FLOAT_LITERAL) {
+            retval = ctx->datatype_float;
+        }
+    }
+    return retval;
+}
+
+static SDL_bool datatype_is_scalar_or_vector(const DataType *dt)
+{
+    return (dt && (dt->dtype != DT_MATRIX) && (datatype_component(dt) != NULL)) ? SDL_TRUE : SDL_FALSE;
+}
+
+static SDL_bool datatype_is_floatish(const DataType *dt)
+{
+    const DataType *compdt = datatype_component(dt);
+    return (compdt && ((compdt->dtype == DT_HALF) || (compdt->dtype == DT_FLOAT))) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* an argument is okay if it matches `dt` exactly, is a literal that can promote to it, or (if `allow_scalar`) is a scalar of dt's component type. */
+static SDL_bool intrinsic_argument_matches(const SDL_SHADER_AstExpression *arg, const DataType *dt, const SDL_bool allow_scalar)
+{
+    if ((arg->ast.dt == dt) || ast_literal_can_promote_to(arg->ast.type, dt)) {
+        return SDL_TRUE;
+    }
+    return (allow_scalar && (arg->ast.dt == datatype_component(dt))) ? SDL_TRUE : SDL_FALSE;
+}
+
+static void semantic_analysis_validate_intrinsic_call_arguments(Context *ctx, SDL_SHADER_AstFunctionCallExpression *fncall)
+{
+    const Intrinsic *intrinsic = fncall->intrinsic;
+    SDL_SHADER_AstExpression *args[3];  /* no intrinsic takes more than this. */
+    SDL_SHADER_AstArgument *arg;
+    const DataType *dt = NULL;
+    SDL_bool args_okay = SDL_TRUE;
+    Uint32 num_args = 0;
+    Uint32 i;
+
+    for (arg = fncall->arguments ? fncall->arguments->head : NULL; arg; arg = arg->next) {
+        semantic_analysis_treewalk(ctx, arg->arg);
+        if (num_args < SDL_arraysize(args)) {
+            args[num_args] = arg->arg;
+        }
+        if (arg->arg->ast.dt == NULL) {
+            args_okay = SDL_FALSE;  /* we reported this elsewhere, don't generate new errors. */
+        }
+        num_args++;
+    }
+
+    fncall->ast.dt = NULL;
+
+    if (num_args != intrinsic->num_args) {
+        failf_ast(ctx, &fncall->ast, "Function call expected %d arguments, had %d", (int) intrinsic->num_args, (int) num_args);
+        return;
+    } else if (!args_okay) {
+        return;
+    }
+
+    switch (intrinsic->rule) {
+        case INTRINSIC_RULE_FLOAT:
+        case INTRINSIC_RULE_NUMBER:
+        case INTRINSIC_RULE_FLOAT_TO_SCALAR:
+        case INTRINSIC_RULE_FLOAT3: {
+            const SDL_bool need_float = (intrinsic->rule != INTRINSIC_RULE_NUMBER) ? SDL_TRUE : SDL_FALSE;
+            const SDL_bool allow_scalar = ((intrinsic->rule == INTRINSIC_RULE_FLOAT) || (intrinsic->rule == INTRINSIC_RULE_NUMBER)) ? SDL_TRUE : SDL_FALSE;
+            dt = intrinsic_argument_datatype(ctx, args, num_args, need_float);
+            if (!datatype_is_scalar_or_vector(dt) || (datatype_component(dt)->dtype == DT_BOOLEAN) || (need_float && !datatype_is_floatish(dt))) {
+                failf_ast(ctx, &fncall->ast, "Can't use a datatype of '%s' with intrinsic function '%s'", dt->name, intrinsic->name);
+                return;
+            } else if ((intrinsic->rule == INTRINSIC_RULE_FLOAT3) && ((dt->dtype != DT_VECTOR) || (dt->info.vector.elements != 3))) {
+                failf_ast(ctx, &fncall->ast, "Intrinsic function '%s' requires 3-component vectors", intrinsic->name);
+                return;
+            }
+
+            for (i = 0; i < num_args; i++) {
+                if (!intrinsic_argument_matches(args[i], dt, allow_scalar)) {
+                    failf_ast(ctx, &args[i]->ast, "Argument #%d does not match intrinsic function '%s' datatype '%s'", (int) (i + 1), intrinsic->name, dt->name);
+                }
+            }
+
+            fncall->ast.dt = (intrinsic->rule == INTRINSIC_RULE_FLOAT_TO_SCALAR) ? datatype_component(dt) : dt;
+            return;
+        }
+
+        case INTRINSIC_RULE_BOOL_REDUCE:
+            dt = args[0]->ast.dt;
+            if (!datatype_is_scalar_or_vector(dt) || (datatype_component(dt)->dtype != DT_BOOLEAN)) {
+                failf_ast(ctx, &fncall->ast, "Can't use a datatype of '%s' with intrinsic function '%s'", dt->name, intrinsic->name);
+                return;
+            }
+            fncall->ast.dt = ctx->datatype_boolean;
+            return;
+
+        case INTRINSIC_RULE_REFRACT:
+            dt = args[0]->ast.dt;
+            if ((dt->dtype != DT_VECTOR) || !datatype_is_floatish(dt)) {
+                failf_ast(ctx, &fncall->ast, "Can't use a datatype of '%s' with intrinsic function '%s'", dt->name, intrinsic->name);
+                return;
+            } else if (!intrinsic_argument_matches(args[1], dt, SDL_FALSE)) {
+                failf_ast(ctx, &args[1]->ast, "Argument #%d does not match intrinsic function '%s' datatype '%s'", 2, intrinsic->name, dt->name);
+            } else if (!intrinsic_argument_matches(args[2], datatype_component(dt), SDL_FALSE)) {
+                failf_ast(ctx, &args[2]->ast, "Argument #%d does not match intrinsic function '%s' datatype '%s'", 3, intrinsic->name, datatype_component(dt)->name);
+            }
+            fncall->ast.dt = dt;
+            return;
+
+        case INTRINSIC_RULE_LDEXP: {
+            const DataType *expdt = args[1]->ast.dt;
+            dt = args[0]->ast.dt;
+            if ((args[0]->ast.type == SDL_SHADER_AST_OP_INT_LITERAL) && (dt == ctx->datatype_int)) {
+                dt = ctx->datatype_float;  /* `ldexp(1, x)` means `ldexp(1.0, x)`. */
+            }
+            if (!datatype_is_scalar_or_vector(dt) || !datatype_is_floatish(dt)) {
+                failf_ast(ctx, &fncall->ast, "Can't use a datatype of '%s' with intrinsic function '%s'", dt->name, intrinsic->name);
+                return;
+            } else if (!datatype_is_scalar_or_vector(expdt) || (datatype_component(expdt)->dtype != DT_INT) || (datatype_element_count(expdt) != datatype_element_count(dt))) {
+                failf_ast(ctx, &args[1]->ast, "Intrinsic function '%s' needs an int exponent for each component", intrinsic->name);
+            }
+            fncall->ast.dt = dt;
+            return;
+        }
+
+        case INTRINSIC_RULE_TRANSPOSE: {
+            dt = args[0]->ast.dt;
+            if (dt->dtype != DT_MATRIX) {
+                failf_ast(ctx, &fncall->ast, "Can't use a datatype of '%s' with intrinsic function '%s'", dt->name, intrinsic->name);
+                return;
+            }
+            /* a matrix of `rows` vectors with `elements` each, transposed, is a matrix of `elements` vectors with `rows` each. */
+            fncall->ast.dt = datatype_with_shape(ctx, datatype_component(dt), dt->info.matrix.rows, dt->info.matrix.childdt->info.vector.elements);
+            ICE_IF(ctx, &fncall->ast, fncall->ast.dt == NULL, "Couldn't find a transposed matrix datatype!");
+            return;
+        }
+    }
+
+    ICE(ctx, &fncall->ast, "Unexpected intrinsic function rule!");
+}
+
 
 static void semantic_analysis_validate_array_index(Context *ctx, SDL_SHADER_AstExpression *left, SDL_SHADER_AstExpression *right, Sint32 idx)
 {
@@ -1123,7 +1647,7 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
             }
 
             /* multiply will let you use any mathish thing, scalar, vector, or matrix, in either order, so we need some special cases here. */
-            /* This (mostly?) follows GLSL conventions. */
+            /* A matrix is rows of vectors. `m * v` treats v as a column, `v * m` treats it as a row, like the math textbooks do. */
             if (!inputs_okay) {
                 ast->ast.dt = NULL;
             } else {
@@ -1138,9 +1662,11 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
                         if (left->ast.dt != right->ast.dt) {
                             failf_ast(ctx, &ast->ast, "Vector datatypes must match with the '%s' operator", ast_opstr(asttype));
                         }
-                    } else if (rdtt == DT_MATRIX) {  /* (v * m) gives you datatype v */
-                        if (left->ast.dt != right->ast.dt->info.matrix.childdt) {
-                            failf_ast(ctx, &ast->ast, "Vector datatype must match matrix columns with the '%s' operator", ast_opstr(asttype));  /* !!! FIXME: decide if we're row or column major. :O */
+                    } else if (rdtt == DT_MATRIX) {  /* (v * m) gives you a vector as wide as m's rows */
+                        if ((left->ast.dt->info.vector.childdt != datatype_component(right->ast.dt)) || (left->ast.dt->info.vector.elements != right->ast.dt->info.matrix.rows)) {
+                            failf_ast(ctx, &ast->ast, "Vector datatype must match matrix rows with the '%s' operator", ast_opstr(asttype));
+                        } else {
+                            ast->ast.dt = right->ast.dt->info.matrix.childdt;
                         }
                     } else if (!ast_datatypes_match(left, right)) {  /* (v * s) gives you datatype v */
                         /* ast_datatypes_match will catch literals, but we need to check for non-literal scalars too. */
@@ -1149,15 +1675,17 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
                         }
                     }
                 } else if (ldtt == DT_MATRIX) {
-                    if (rdtt == DT_VECTOR) {  /* (m * v) gives you datatype v */
+                    if (rdtt == DT_VECTOR) {  /* (m * v) gives you a vector with one element per row of m */
                         if (left->ast.dt->info.matrix.childdt != right->ast.dt) {
-                            failf_ast(ctx, &ast->ast, "Vector datatype must match matrix columns with the '%s' operator", ast_opstr(asttype));  /* !!! FIXME: decide if we're row or column major. :O */
+                            failf_ast(ctx, &ast->ast, "Vector datatype must match matrix columns with the '%s' operator", ast_opstr(asttype));
                         } else {
-                            ast->ast.dt = right->ast.dt;  /* this needs to be a vector. */
+                            ast->ast.dt = datatype_with_shape(ctx, right->ast.dt->info.vector.childdt, left->ast.dt->info.matrix.rows, 1);
                         }
-                    } else if (rdtt == DT_MATRIX) {  /* (m * m) gives you datatype m */
-                        if (!ast_datatypes_match(left, right)) {
-                            failf_ast(ctx, &ast->ast, "Matrix datatypes must match with the '%s' operator", ast_opstr(asttype));
+                    } else if (rdtt == DT_MATRIX) {  /* (m * m) gives you the left's rows of the right's columns */
+                        if ((datatype_component(left->ast.dt) != datatype_component(right->ast.dt)) || (left->ast.dt->info.matrix.childdt->info.vector.elements != right->ast.dt->info.matrix.rows)) {
+                            failf_ast(ctx, &ast->ast, "Left matrix's columns must match right matrix's rows with the '%s' operator", ast_opstr(asttype));
+                        } else {
+                            ast->ast.dt = datatype_with_shape(ctx, datatype_component(right->ast.dt), right->ast.dt->info.matrix.childdt->info.vector.elements, left->ast.dt->info.matrix.rows);
                         }
                     } else if (!ast_datatypes_match(left, right)) {  /* (m * s) gives you datatype m */
                         /* ast_datatypes_match will catch literals, but we need to check for non-literal scalars too. */
@@ -1166,7 +1694,8 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
                         }
                     }
                 } else {
-                    ast->ast.dt = right->ast.dt;  /* this needs to be what we multiplied the scalar by. */
+                    /* this needs to be what we multiplied the scalar by, or for two scalars, whichever one a literal promoted to. */
+                    ast->ast.dt = ((rdtt == DT_VECTOR) || (rdtt == DT_MATRIX)) ? right->ast.dt : ast_binary_result_datatype(left, right);
                     if (rdtt == DT_VECTOR) {  /* (s * v) gives you datatype v */
                         if (left->ast.dt != right->ast.dt->info.vector.childdt) {
                             failf_ast(ctx, &ast->ast, "Scalar and vector datatypes must match with the '%s' operator", ast_opstr(asttype));
@@ -1197,7 +1726,7 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
             if (!ast_datatypes_match(ast->binary.left, ast->binary.right)) {
                 failf_ast(ctx, &ast->ast, "Datatypes must match with the '%s' operator", ast_opstr(asttype));
             }
-            ast->ast.dt = ast->binary.left->ast.dt;
+            ast->ast.dt = ast_binary_result_datatype(ast->binary.left, ast->binary.right);
             return;
 
         case SDL_SHADER_AST_OP_MODULO:
@@ -1217,7 +1746,7 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
             if (!ast_datatypes_match(ast->binary.left, ast->binary.right)) {
                 failf_ast(ctx, &ast->ast, "Datatypes must match with the '%s' operator", ast_opstr(asttype));
             }
-            ast->ast.dt = ast->binary.left->ast.dt;
+            ast->ast.dt = ast_binary_result_datatype(ast->binary.left, ast->binary.right);
             return;
 
         case SDL_SHADER_AST_OP_LESSTHAN:
@@ -1340,7 +1869,7 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
             if (!ast_datatypes_match(ast->ternary.center, ast->ternary.right)) {
                 failf_ast(ctx, &ast->ast, "Datatypes must match with the '%s' operator", ast_opstr(asttype));
             }
-            ast->ast.dt = ast->ternary.center->ast.dt;
+            ast->ast.dt = ast_binary_result_datatype(ast->ternary.center, ast->ternary.right);
             return;
 
         case SDL_SHADER_AST_OP_IDENTIFIER: {
@@ -1352,6 +1881,7 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
                     failf_ast(ctx, &ast->ast, "Trying to use function '%s' like a variable; did you mean to call this function?", sym);
                     ast->ast.dt = NULL;
                 } else {
+                    ast->identifier.vardecl = (obj->ast.type == SDL_SHADER_AST_FUNCTION_PARAM) ? obj->fnparam.vardecl : &obj->vardecl;
                     ast->ast.dt = obj->ast.dt;
                 }
             } else {
@@ -1380,12 +1910,18 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
             SDL_SHADER_AstNode *scoped_node;
             SDL_SHADER_AstFunction *i;
             SDL_bool walk_args = SDL_TRUE;
+            SDL_bool is_datatype = SDL_FALSE;
 
             ast->ast.dt = NULL;   /* until proven otherwise. */
 
-            for (i = ctx->functions; i != NULL; i = i->nextfn) {
-                if (i->vardecl->name == name) {  /* strcache'd, we can compare pointers. */
-                    break;
+            i = find_function(ctx, name);
+
+            if (i == NULL) {
+                fncall->intrinsic = find_intrinsic(name);
+                if (fncall->intrinsic == NULL) {
+                    lock_datatypes(ctx);
+                    is_datatype = hash_find(ctx->datatypes, name, (const void **) &fncall->ast.dt);
+                    unlock_datatypes(ctx);
                 }
             }
 
@@ -1394,10 +1930,10 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
                 fncall->ast.dt = i->ast.dt;
                 walk_args = SDL_FALSE;
                 semantic_analysis_validate_function_call_arguments(ctx, fncall);
-
-            // !!! FIXME: } else { search intrinsic functions
-
-            } else if (hash_find(ctx->datatypes, name, (const void **) &fncall->ast.dt)) {  /* if the name is a datatype, this is a constructor. */
+            } else if (fncall->intrinsic != NULL) {
+                walk_args = SDL_FALSE;
+                semantic_analysis_validate_intrinsic_call_arguments(ctx, fncall);
+            } else if (is_datatype) {  /* if the name is a datatype, this is a constructor. */
                 if (fncall->ast.dt == NULL) {
                     ICE(ctx, &ast->ast, "Successfully looked up datatype but the datatype turned out to be NULL!");
                 } else {
@@ -1493,9 +2029,18 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
 
         case SDL_SHADER_AST_STATEMENT_FOR:
             scope = push_scope(ctx, ast);  /* push a scope here for possible `for (var int i = 0; ...` syntax */
-            semantic_analysis_treewalk(ctx, ast->forstmt.details->initializer);
-            semantic_analysis_treewalk(ctx, ast->forstmt.details->condition);
-            semantic_analysis_treewalk(ctx, ast->forstmt.details->step);
+            if (ast->forstmt.details->initializer) {  /* all three parts of the for-loop details are optional. */
+                semantic_analysis_treewalk(ctx, ast->forstmt.details->initializer);
+            }
+            if (ast->forstmt.details->condition) {
+                semantic_analysis_treewalk(ctx, ast->forstmt.details->condition);
+                if (!ast_is_boolean(ast->forstmt.details->condition)) {
+                    fail_ast(ctx, &ast->forstmt.details->condition->ast, "Datatype for for-loop condition must be boolean");
+                }
+            }
+            if (ast->forstmt.details->step) {
+                semantic_analysis_treewalk(ctx, ast->forstmt.details->step);
+            }
             semantic_analysis_treewalk(ctx, ast->forstmt.code);
             pop_scope(ctx, scope);
             return;
@@ -1507,7 +2052,7 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
             }
             semantic_analysis_treewalk(ctx, ast->ifstmt.code);
             if (ast->ifstmt.else_code != NULL) {
-                semantic_analysis_treewalk(ctx, ast->ifstmt.code);
+                semantic_analysis_treewalk(ctx, ast->ifstmt.else_code);
             }
             return;  /* no data type on statements, nothing else to do. */
 
@@ -1552,6 +2097,7 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
             } else if (!ast_is_mathish(ast->incrementstmt.assignment)) {
                 failf_ast(ctx, &ast->unary.operand->ast, "Can't use a datatype of '%s' with the '%s' operator", ast->unary.operand->ast.dt->name, ast_opstr(asttype));
             }
+            mark_lvalue_assigned(ast->incrementstmt.assignment);
             return;
 
         case SDL_SHADER_AST_STATEMENT_FUNCTION_CALL:
@@ -1571,6 +2117,7 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
                     } else if (!ast_datatypes_match(i->expr, ast->assignstmt.value)) {
                         failf_ast(ctx, &i->expr->ast, "Datatypes must match with the '%s' operator", ast_opstr(asttype));
                     }
+                    mark_lvalue_assigned(i->expr);
                 }
             }
             return;
@@ -1592,19 +2139,21 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
             } else if (!ast_datatypes_match(ast->compoundassignstmt.assignment, ast->compoundassignstmt.value)) {
                 failf_ast(ctx, &ast->ast, "Datatypes must match with the '%s' operator", ast_opstr(asttype));
             }
+            mark_lvalue_assigned(ast->compoundassignstmt.assignment);
             return;
 
         case SDL_SHADER_AST_FUNCTION:
             /* we already pushed all functions onto the scope stack, for symbol resolution purposes, so don't do it again here. */
-            /* we already resolved the return value datatype in semantic_analysis_prepare_functions(), too. */
-            semantic_analysis_validate_function_at_attribute(ctx, &ast->fn);
+            /* we already resolved the return value datatype and validated the attributes in semantic_analysis_prepare_functions(), too. */
             if (ast->fn.params != NULL) {  /* NULL here means "void" */
                 SDL_SHADER_AstFunctionParam *i;
                 for (i = ast->fn.params->head; i != NULL; i = i->next) {
                     semantic_analysis_treewalk(ctx, i);
                 }
             }
-            semantic_analysis_treewalk(ctx, ast->fn.code);  /* analyze this function's code! */
+            if (ast->fn.reachable || (ctx->unreachable_functions == SDL_SHADER_UNREACHABLE_ANALYZE)) {
+                semantic_analysis_treewalk(ctx, ast->fn.code);  /* analyze this function's code! */
+            }
             return;
 
         case SDL_SHADER_AST_FUNCTION_PARAM:
@@ -1623,12 +2172,16 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
             return;
 
         case SDL_SHADER_AST_TRANSUNIT_FUNCTION:  /* just walk further into the contained AST node */
+            if (!ast->fnunit.fn->reachable && (ctx->unreachable_functions == SDL_SHADER_UNREACHABLE_SKIP)) {
+                return;  /* nothing uses this function and we were asked not to care about it. */
+            }
             /* the functions themselves are already in the global scope when walking the tree, for symbol resolution, so just push the translation unit
                here so we can know when walking the scope stack out of the current function and into the global namespace. */
             scope = push_scope(ctx, ast);
             semantic_analysis_treewalk(ctx, ast->fnunit.fn);
             pop_scope(ctx, scope);
             ctx->num_undefined_identifiers = 0;  /* reset for next function. */
+            ctx->reported_undefined = SDL_FALSE;
             return;
 
         case SDL_SHADER_AST_TRANSUNIT_STRUCT:  /* just walk further into the contained AST node */
@@ -1655,31 +2208,3013 @@ static void semantic_analysis_treewalk(Context *ctx, void *_ast)
     }
 }
 
-static void semantic_analysis(Context *ctx, const SDL_SHADER_CompilerParams *params)
-{
-    ScopeItem *scope;
 
-    ICE_IF(ctx, &ctx->ast_before, ctx->isfail, "Went on to semantic analysis even though parsing had failed!");
+/*
+ * Once semantic_analysis_prepare_functions() has run, function bodies only
+ * depend on the global function and struct lists, so we can analyze them
+ * in parallel. Each worker gets a private copy of the Context, with its own
+ * scope stack and error list; everything already on the scope stack (the
+ * shader and all the functions) is shared, read-only. The datatypes hash and
+ * string cache are shared too, but can still grow (new array types, etc), so
+ * they're guarded by ctx->datatypes_lock.
+ *
+ * Each translation unit gets its own error list, and they are merged back in
+ * source order once all the workers are done, so the results are identical
+ * to a single-threaded run.
+ */
+typedef struct SemanticAnalysisJob
+{
+    SDL_SHADER_AstTranslationUnit *unit;
+    ErrorList *errors;
+} SemanticAnalysisJob;
+
+typedef struct SemanticAnalysisWorker
+{
+    Context ctx;  /* private copy of the real Context. */
+    SemanticAnalysisJob *jobs;
+    int num_jobs;
+    SDL_atomic_t *next_job;
+    SDL_Thread *thread;
+} SemanticAnalysisWorker;
+
+static int SDLCALL semantic_analysis_worker(void *data)
+{
+    SemanticAnalysisWorker *worker = (SemanticAnalysisWorker *) data;
+    Context *ctx = &worker->ctx;
+    ScopeItem *base_scope = ctx->scope_stack;
+    int i;
+
+    while ((i = SDL_AtomicAdd(worker->next_job, 1)) < worker->num_jobs) {
+        SemanticAnalysisJob *job = &worker->jobs[i];
+        job->errors = errorlist_create(MallocContextBridge, FreeContextBridge, ctx);
+        if (!job->errors) {
+            continue;  /* will have set the out_of_memory flag. */
+        }
+        ctx->errors = job->errors;
+        ctx->num_undefined_identifiers = 0;
+        ctx->reported_undefined = SDL_FALSE;
+        semantic_analysis_treewalk(ctx, job->unit);
+        ICE_IF(ctx, &job->unit->ast, ctx->scope_stack != base_scope, "Worker's scope stack didn't unwind!");
+    }
+
+    return 0;
+}
+
+/* returns SDL_FALSE if we didn't do the work here, and the caller should walk the tree on this thread instead. */
+static SDL_bool semantic_analysis_treewalk_threaded(Context *ctx, int num_threads)
+{
+    SemanticAnalysisWorker *workers;
+    SemanticAnalysisJob *jobs;
+    SDL_SHADER_AstTranslationUnit *unit;
+    SDL_atomic_t next_job;
+    int num_jobs = 0;
+    int i;
+
+    if (num_threads < 0) {
+        num_threads = SDL_GetCPUCount();
+    }
+
+    for (unit = ctx->shader->units->head; unit != NULL; unit = unit->next) {
+        num_jobs++;
+    }
+
+    if (num_threads > num_jobs) {
+        num_threads = num_jobs;
+    }
+
+    if (num_threads <= 1) {
+        return SDL_FALSE;
+    }
+
+    jobs = (SemanticAnalysisJob *) Malloc(ctx, sizeof (SemanticAnalysisJob) * num_jobs);
+    if (!jobs) {
+        return SDL_TRUE;  /* will have set the out_of_memory flag. */
+    }
+
+    workers = (SemanticAnalysisWorker *) Malloc(ctx, sizeof (SemanticAnalysisWorker) * num_threads);
+    if (!workers) {
+        Free(ctx, jobs);
+        return SDL_TRUE;  /* will have set the out_of_memory flag. */
+    }
+
+    ctx->datatypes_lock = SDL_CreateMutex();
+    if (!ctx->datatypes_lock) {
+        Free(ctx, workers);
+        Free(ctx, jobs);
+        return SDL_FALSE;  /* oh well, do it the slow way. */
+    }
+
+    for (i = 0, unit = ctx->shader->units->head; unit != NULL; unit = unit->next, i++) {
+        jobs[i].unit = unit;
+        jobs[i].errors = NULL;
+    }
+
+    SDL_AtomicSet(&next_job, 0);
+
+    for (i = 0; i < num_threads; i++) {
+        SemanticAnalysisWorker *worker = &workers[i];
+        SDL_memcpy(&worker->ctx, ctx, sizeof (Context));
+        worker->ctx.scope_pool = NULL;
+        worker->jobs = jobs;
+        worker->num_jobs = num_jobs;
+        worker->next_job = &next_job;
+        worker->thread = NULL;
+    }
+
+    /* the calling thread is worker zero, so we make progress even if we can't spin up more threads. */
+    for (i = 1; i < num_threads; i++) {
+        workers[i].thread = SDL_CreateThread(semantic_analysis_worker, "SDLSL analysis", &workers[i]);
+    }
+
+    semantic_analysis_worker(&workers[0]);
+
+    for (i = 1; i < num_threads; i++) {
+        SDL_WaitThread(workers[i].thread, NULL);  /* NULL is a safe no-op if we failed to create this one. */
+    }
+
+    SDL_DestroyMutex(ctx->datatypes_lock);
+    ctx->datatypes_lock = NULL;
+
+    /* merge errors back in source order, no matter which worker handled them. */
+    for (i = 0; i < num_jobs; i++) {
+        if (jobs[i].errors) {
+            errorlist_splice(ctx->errors, jobs[i].errors);
+            errorlist_destroy(jobs[i].errors);
+        }
+    }
+
+    for (i = 0; i < num_threads; i++) {
+        Context *workerctx = &workers[i].ctx;
+        ScopeItem *scope;
+        ScopeItem *scopenext;
+
+        if (workerctx->isfail) { ctx->isfail = SDL_TRUE; }
+        if (workerctx->isiced) { ctx->isiced = SDL_TRUE; }
+        if (workerctx->out_of_memory) { ctx->out_of_memory = SDL_TRUE; }
+
+        for (scope = workerctx->scope_pool; scope != NULL; scope = scopenext) {
+            scopenext = scope->next;
+            Free(ctx, scope);
+        }
+    }
+
+    Free(ctx, workers);
+    Free(ctx, jobs);
+
+    return SDL_TRUE;
+}
+
+static void semantic_analysis(Context *ctx, const SDL_SHADER_CompilerParams *params)
+{
+    ScopeItem *scope;
+
+    ICE_IF(ctx, &ctx->ast_before, ctx->isfail, "Went on to semantic analysis even though parsing had failed!");
 
     if (!ctx->shader || !ctx->shader->units || !ctx->shader->units->head) {
         fail_ast(ctx, &ctx->ast_after, "Shader is empty?");
         return;
     }
 
-    scope = push_scope(ctx, (SDL_SHADER_AstNode *) ctx->shader);
-    if (!scope) {
-        return;  /* will have set the out_of_memory flag. */
+    scope = push_scope(ctx, (SDL_SHADER_AstNode *) ctx->shader);
+    if (!scope) {
+        return;  /* will have set the out_of_memory flag. */
+    }
+
+    semantic_analysis_build_globals_lists(ctx);
+    semantic_analysis_check_globals_for_duplicates(ctx);
+    semantic_analysis_gather_datatypes(ctx);
+    semantic_analysis_prepare_functions(ctx);
+    semantic_analysis_find_reachable_functions(ctx);
+
+    if (!semantic_analysis_treewalk_threaded(ctx, params->worker_threads)) {
+        semantic_analysis_treewalk(ctx, ctx->shader);
+    }
+
+    pop_scope(ctx, scope);
+
+    ICE_IF(ctx, &ctx->ast_after, ctx->scope_stack != NULL, "Scope stack isn't empty!");
+}
+
+/*
+ * Constant folding and propagation.
+ *
+ * This runs after semantic analysis succeeds, so every expression has a
+ * valid datatype. Anything whose value we can work out at compile time gets
+ * a Constant attached to its AST node (in node->ast.constant), so code
+ * generation can emit a literal instead of the instructions to calculate it.
+ * This includes constructors (`float4(1.0, 0.0, 0.0, 1.0)`), intrinsics on
+ * constants (`sin(0.5)`), and variables that are never written to after
+ * their declaration.
+ *
+ * Float math is done in single precision, one operation at a time, the same
+ * way the shader would do it: no reassociation, no fused multiply-adds. The
+ * transcendental intrinsics are calculated in double precision and rounded
+ * once. We never fold something that would produce a NaN or infinity (or
+ * that's undefined, like an int divide by zero); that's left for the GPU to
+ * deal with at runtime, and maybe we'll warn about it later. Half values are
+ * never folded, since we can't promise we'd round them the way a GPU would.
+ */
+
+static SDL_bool datatype_is_foldable(const DataType *dt)
+{
+    const DataType *compdt = datatype_component(dt);
+    return (compdt && (compdt->dtype != DT_HALF)) ? SDL_TRUE : SDL_FALSE;
+}
+
+static SDL_bool float_is_finite(const float f)
+{
+    return ((f - f) == 0.0f) ? SDL_TRUE : SDL_FALSE;  /* NaN and infinity both produce NaN here. */
+}
+
+/* copies a Constant built on the stack into ctx->constants, so an AST node can point to it. */
+static const Constant *keep_constant(Context *ctx, const Constant *c)
+{
+    Constant *retval;
+    if (ctx->constants == NULL) {
+        ctx->constants = buffer_create(sizeof (Constant) * 64, MallocContextBridge, FreeContextBridge, ctx);
+        if (ctx->constants == NULL) {
+            return NULL;  /* will have set the out_of_memory flag. */
+        }
+    }
+
+    retval = (Constant *) buffer_reserve(ctx->constants, sizeof (Constant));  /* every reservation is the same size, so these stay aligned. */
+    if (retval) {
+        SDL_memcpy(retval, c, sizeof (Constant));
+    }
+    return retval;
+}
+
+static void init_constant(Constant *c, const DataType *dt)
+{
+    SDL_zerop(c);
+    c->dt = dt;
+    c->num_components = datatype_element_count(dt);
+}
+
+static const Constant *fold_literal(Context *ctx, const SDL_SHADER_AstExpression *expr, const DataType *dt)
+{
+    const SDL_SHADER_AstNode *ast = (const SDL_SHADER_AstNode *) expr;
+    const DataType *compdt = datatype_component(dt);
+    ConstantValue val;
+    Constant c;
+    Uint32 i;
+
+    if (!datatype_is_foldable(dt)) {
+        return NULL;
+    }
+
+    switch (ast->ast.type) {
+        case SDL_SHADER_AST_OP_INT_LITERAL: {
+            const Sint64 v = ast->intliteral.value;
+            if (compdt->dtype == DT_FLOAT) {
+                val.f = (float) v;
+            } else if ((compdt->dtype != DT_INT) && (compdt->dtype != DT_UINT)) {
+                return NULL;
+            } else if ((v < SDL_MIN_SINT32) || (v > SDL_MAX_UINT32)) {
+                return NULL;  /* doesn't fit in 32 bits. */
+            } else {
+                val.u = (Uint32) v;
+            }
+            break;
+        }
+
+        case SDL_SHADER_AST_OP_FLOAT_LITERAL:
+            if (compdt->dtype != DT_FLOAT) {
+                return NULL;
+            }
+            val.f = (float) ast->floatliteral.value;
+            if (!float_is_finite(val.f)) {
+                return NULL;
+            }
+            break;
+
+        case SDL_SHADER_AST_OP_BOOLEAN_LITERAL:
+            if (compdt->dtype != DT_BOOLEAN) {
+                return NULL;
+            }
+            val.u = ast->boolliteral.value ? 1 : 0;
+            break;
+
+        default:
+            return NULL;
+    }
+
+    init_constant(&c, dt);
+    for (i = 0; i < c.num_components; i++) {
+        c.value[i] = val;
+    }
+    return keep_constant(ctx, &c);
+}
+
+/* The value of an already-folded expression as datatype `dt`, or NULL if it isn't known at compile time.
+   Literals promote (`5` can be a float4), and scalars splat to vectors and matrices (`myvec * 2.0`). */
+static const Constant *fold_operand(Context *ctx, const SDL_SHADER_AstExpression *expr, const DataType *dt)
+{
+    const Constant *c = expr->ast.constant;
+    Constant splat;
+    Uint32 i;
+
+    if ((c != NULL) && (c->dt == dt)) {
+        return c;
+    } else if (ast_is_int_or_float_literal(expr)) {
+        return fold_literal(ctx, expr, dt);
+    } else if ((c == NULL) || (c->num_components != 1) || (c->dt != datatype_component(dt))) {
+        return NULL;
+    }
+
+    init_constant(&splat, dt);
+    for (i = 0; i < splat.num_components; i++) {
+        splat.value[i] = c->value[0];
+    }
+    return keep_constant(ctx, &splat);
+}
+
+/* converts one component between scalar types, the way a constructor would. Fails if the result is undefined. */
+static SDL_bool fold_convert_component(const DataTypeType from, const DataTypeType to, const ConstantValue x, ConstantValue *r)
+{
+    if (from == to) {
+        *r = x;
+        return SDL_TRUE;
+    }
+
+    switch (to) {
+        case DT_BOOLEAN:
+            if (from == DT_FLOAT) {
+                if (!float_is_finite(x.f)) { return SDL_FALSE; }
+                r->u = (x.f != 0.0f) ? 1 : 0;
+            } else {
+                r->u = (x.u != 0) ? 1 : 0;
+            }
+            return SDL_TRUE;
+
+        case DT_INT:
+            if (from != DT_FLOAT) {
+                r->u = x.u;  /* bools are already 0 or 1, uint just reinterprets the bits. */
+            } else if ((x.f >= -2147483648.0f) && (x.f < 2147483648.0f)) {  /* this is also false for NaN. */
+                r->i = (Sint32) x.f;
+            } else {
+                return SDL_FALSE;
+            }
+            return SDL_TRUE;
+
+        case DT_UINT:
+            if (from != DT_FLOAT) {
+                r->u = x.u;
+            } else if ((x.f > -1.0f) && (x.f < 4294967296.0f)) {
+                r->u = (Uint32) x.f;
+            } else {
+                return SDL_FALSE;
+            }
+            return SDL_TRUE;
+
+        case DT_FLOAT:
+            switch (from) {
+                case DT_BOOLEAN: r->f = x.u ? 1.0f : 0.0f; return SDL_TRUE;
+                case DT_INT: r->f = (float) x.i; return SDL_TRUE;
+                case DT_UINT: r->f = (float) x.u; return SDL_TRUE;
+                default: break;
+            }
+            break;
+
+        default: break;
+    }
+
+    return SDL_FALSE;
+}
+
+static SDL_bool fold_binary_component(const SDL_SHADER_AstNodeType op, const DataTypeType dtt, const ConstantValue x, const ConstantValue y, ConstantValue *r)
+{
+    if (dtt == DT_FLOAT) {
+        switch (op) {
+            case SDL_SHADER_AST_OP_MULTIPLY: r->f = x.f * y.f; break;
+            case SDL_SHADER_AST_OP_DIVIDE: r->f = x.f / y.f; break;
+            case SDL_SHADER_AST_OP_ADD: r->f = x.f + y.f; break;
+            case SDL_SHADER_AST_OP_SUBTRACT: r->f = x.f - y.f; break;
+            default: return SDL_FALSE;
+        }
+        return float_is_finite(r->f);
+    } else if ((dtt == DT_INT) || (dtt == DT_UINT)) {
+        const SDL_bool is_signed = (dtt == DT_INT) ? SDL_TRUE : SDL_FALSE;
+        /* the math is done in Uint32 where we can, so overflow wraps like it would on the GPU. */
+        switch (op) {
+            case SDL_SHADER_AST_OP_MULTIPLY: r->u = x.u * y.u; return SDL_TRUE;
+            case SDL_SHADER_AST_OP_ADD: r->u = x.u + y.u; return SDL_TRUE;
+            case SDL_SHADER_AST_OP_SUBTRACT: r->u = x.u - y.u; return SDL_TRUE;
+            case SDL_SHADER_AST_OP_BINARYAND: r->u = x.u & y.u; return SDL_TRUE;
+            case SDL_SHADER_AST_OP_BINARYXOR: r->u = x.u ^ y.u; return SDL_TRUE;
+            case SDL_SHADER_AST_OP_BINARYOR: r->u = x.u | y.u; return SDL_TRUE;
+
+            case SDL_SHADER_AST_OP_DIVIDE:
+            case SDL_SHADER_AST_OP_MODULO:
+                if ((y.u == 0) || (is_signed && (x.i == SDL_MIN_SINT32) && (y.i == -1))) {
+                    return SDL_FALSE;  /* undefined, let it happen at runtime. */
+                } else if (op == SDL_SHADER_AST_OP_DIVIDE) {
+                    if (is_signed) { r->i = x.i / y.i; } else { r->u = x.u / y.u; }
+                } else {
+                    if (is_signed) { r->i = x.i % y.i; } else { r->u = x.u % y.u; }
+                }
+                return SDL_TRUE;
+
+            case SDL_SHADER_AST_OP_LSHIFT:
+            case SDL_SHADER_AST_OP_RSHIFT:
+                if (y.u >= 32) {  /* this catches negative shifts too. */
+                    return SDL_FALSE;
+                } else if (op == SDL_SHADER_AST_OP_LSHIFT) {
+                    r->u = x.u << y.u;
+                } else if (is_signed && (x.i < 0)) {
+                    r->i = ~((~x.i) >> y.u);  /* arithmetic shift, without relying on implementation-defined behavior. */
+                } else {
+                    r->u = x.u >> y.u;
+                }
+                return SDL_TRUE;
+
+            default: break;
+        }
+    }
+
+    return SDL_FALSE;
+}
+
+static SDL_bool fold_compare_component(const SDL_SHADER_AstNodeType op, const DataTypeType dtt, const ConstantValue x, const ConstantValue y)
+{
+    switch (dtt) {
+        case DT_FLOAT:
+            switch (op) {
+                case SDL_SHADER_AST_OP_LESSTHAN: return (x.f < y.f) ? SDL_TRUE : SDL_FALSE;
+                case SDL_SHADER_AST_OP_GREATERTHAN: return (x.f > y.f) ? SDL_TRUE : SDL_FALSE;
+                case SDL_SHADER_AST_OP_LESSTHANOREQUAL: return (x.f <= y.f) ? SDL_TRUE : SDL_FALSE;
+                case SDL_SHADER_AST_OP_GREATERTHANOREQUAL: return (x.f >= y.f) ? SDL_TRUE : SDL_FALSE;
+                default: return (x.f == y.f) ? SDL_TRUE : SDL_FALSE;
+            }
+
+        case DT_INT:
+            switch (op) {
+                case SDL_SHADER_AST_OP_LESSTHAN: return (x.i < y.i) ? SDL_TRUE : SDL_FALSE;
+                case SDL_SHADER_AST_OP_GREATERTHAN: return (x.i > y.i) ? SDL_TRUE : SDL_FALSE;
+                case SDL_SHADER_AST_OP_LESSTHANOREQUAL: return (x.i <= y.i) ? SDL_TRUE : SDL_FALSE;
+                case SDL_SHADER_AST_OP_GREATERTHANOREQUAL: return (x.i >= y.i) ? SDL_TRUE : SDL_FALSE;
+                default: return (x.i == y.i) ? SDL_TRUE : SDL_FALSE;
+            }
+
+        default:  /* uint and bool. */
+            switch (op) {
+                case SDL_SHADER_AST_OP_LESSTHAN: return (x.u < y.u) ? SDL_TRUE : SDL_FALSE;
+                case SDL_SHADER_AST_OP_GREATERTHAN: return (x.u > y.u) ? SDL_TRUE : SDL_FALSE;
+                case SDL_SHADER_AST_OP_LESSTHANOREQUAL: return (x.u <= y.u) ? SDL_TRUE : SDL_FALSE;
+                case SDL_SHADER_AST_OP_GREATERTHANOREQUAL: return (x.u >= y.u) ? SDL_TRUE : SDL_FALSE;
+                default: return (x.u == y.u) ? SDL_TRUE : SDL_FALSE;
+            }
+    }
+}
+
+static const Constant *fold_unary(Context *ctx, SDL_SHADER_AstNode *ast)
+{
+    const SDL_SHADER_AstNodeType op = ast->ast.type;
+    const Constant *x = fold_operand(ctx, ast->unary.operand, ast->ast.dt);
+    DataTypeType dtt;
+    Constant c;
+    Uint32 i;
+
+    if ((x == NULL) || (op == SDL_SHADER_AST_OP_POSITIVE) || (op == SDL_SHADER_AST_OP_PARENTHESES)) {
+        return x;
+    }
+
+    dtt = datatype_component(x->dt)->dtype;
+    init_constant(&c, x->dt);
+    for (i = 0; i < c.num_components; i++) {
+        switch (op) {
+            case SDL_SHADER_AST_OP_NEGATE:
+                if (dtt == DT_FLOAT) { c.value[i].f = -x->value[i].f; } else { c.value[i].u = 0u - x->value[i].u; }
+                break;
+            case SDL_SHADER_AST_OP_COMPLEMENT: c.value[i].u = ~x->value[i].u; break;
+            case SDL_SHADER_AST_OP_NOT: c.value[i].u = x->value[i].u ? 0 : 1; break;
+            default: return NULL;
+        }
+    }
+    return keep_constant(ctx, &c);
+}
+
+/* `left * right` where at least one is a matrix: each output element is a row of `left` (all of it, if it's a vector) times a column of `right` (all of it, if it's a vector). */
+static const Constant *fold_matrix_multiply(Context *ctx, const SDL_SHADER_AstExpression *left, const SDL_SHADER_AstExpression *right, const DataType *dt)
+{
+    const DataType *ldt = left->ast.dt;
+    const DataType *rdt = right->ast.dt;
+    const Uint32 rows = (ldt->dtype == DT_MATRIX) ? ldt->info.matrix.rows : 1;
+    const Uint32 inner = (rdt->dtype == DT_MATRIX) ? rdt->info.matrix.rows : rdt->info.vector.elements;
+    const Uint32 columns = (rdt->dtype == DT_MATRIX) ? rdt->info.matrix.childdt->info.vector.elements : 1;
+    const DataTypeType dtt = datatype_component(dt)->dtype;
+    const Constant *x = fold_operand(ctx, left, ldt);
+    const Constant *y = fold_operand(ctx, right, rdt);
+    ConstantValue product;
+    Constant c;
+    Uint32 i, j, k;
+
+    if (!x || !y) {
+        return NULL;
+    }
+
+    init_constant(&c, dt);
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < columns; j++) {
+            ConstantValue *sum = &c.value[(i * columns) + j];
+            if (!fold_binary_component(SDL_SHADER_AST_OP_MULTIPLY, dtt, x->value[i * inner], y->value[j], sum)) {
+                return NULL;
+            }
+            for (k = 1; k < inner; k++) {
+                if (!fold_binary_component(SDL_SHADER_AST_OP_MULTIPLY, dtt, x->value[(i * inner) + k], y->value[(k * columns) + j], &product) ||
+                    !fold_binary_component(SDL_SHADER_AST_OP_ADD, dtt, *sum, product, sum)) {
+                    return NULL;
+                }
+            }
+        }
+    }
+    return keep_constant(ctx, &c);
+}
+
+static const Constant *fold_binary(Context *ctx, SDL_SHADER_AstNode *ast)
+{
+    const SDL_SHADER_AstNodeType op = ast->ast.type;
+    SDL_SHADER_AstExpression *left = ast->binary.left;
+    SDL_SHADER_AstExpression *right = ast->binary.right;
+    const DataType *dt = ast->ast.dt;
+    const Constant *x;
+    const Constant *y;
+    DataTypeType dtt;
+    Constant c;
+    Uint32 i;
+
+    switch (op) {
+        case SDL_SHADER_AST_OP_LOGICALAND:
+        case SDL_SHADER_AST_OP_LOGICALOR:
+            /* these short-circuit, so `false && x` is false even if we don't know what x is. */
+            x = fold_operand(ctx, left, dt);
+            if (x == NULL) {
+                return NULL;
+            } else if ((x->value[0].u != 0) == (op == SDL_SHADER_AST_OP_LOGICALOR)) {
+                return x;
+            }
+            return fold_operand(ctx, right, dt);
+
+        case SDL_SHADER_AST_OP_LESSTHAN:
+        case SDL_SHADER_AST_OP_GREATERTHAN:
+        case SDL_SHADER_AST_OP_LESSTHANOREQUAL:
+        case SDL_SHADER_AST_OP_GREATERTHANOREQUAL:
+        case SDL_SHADER_AST_OP_EQUAL:
+        case SDL_SHADER_AST_OP_NOTEQUAL: {
+            const DataType *operanddt = ast_binary_result_datatype(left, right);
+            SDL_bool equal = SDL_TRUE;
+            x = fold_operand(ctx, left, operanddt);
+            y = fold_operand(ctx, right, operanddt);
+            if (!x || !y) {
+                return NULL;
+            }
+            dtt = datatype_component(operanddt)->dtype;
+            init_constant(&c, dt);
+            if ((op == SDL_SHADER_AST_OP_EQUAL) || (op == SDL_SHADER_AST_OP_NOTEQUAL)) {  /* these compare whole vectors, etc, and give you one bool. */
+                for (i = 0; i < x->num_components; i++) {
+                    if (!fold_compare_component(SDL_SHADER_AST_OP_EQUAL, dtt, x->value[i], y->value[i])) {
+                        equal = SDL_FALSE;
+                        break;
+                    }
+                }
+                c.value[0].u = (equal == (op == SDL_SHADER_AST_OP_EQUAL)) ? 1 : 0;
+            } else {
+                c.value[0].u = fold_compare_component(op, dtt, x->value[0], y->value[0]) ? 1 : 0;
+            }
+            return keep_constant(ctx, &c);
+        }
+
+        case SDL_SHADER_AST_OP_DEREF_ARRAY: {
+            const DataType *leftdt = left->ast.dt;
+            Uint32 stride = 1;
+            Uint32 max_range;
+            Sint32 idx;
+
+            y = fold_operand(ctx, right, right->ast.dt);
+            if (y == NULL) {
+                return NULL;
+            }
+
+            idx = y->value[0].i;  /* int or uint, either way, a negative int is out of range below. */
+            if (leftdt->dtype == DT_VECTOR) {
+                max_range = leftdt->info.vector.elements;
+            } else if (leftdt->dtype == DT_MATRIX) {
+                max_range = leftdt->info.matrix.rows;
+                stride = leftdt->info.matrix.childdt->info.vector.elements;
+            } else {
+                return NULL;  /* arrays aren't folded (yet?). */
+            }
+
+            if ((idx < 0) || (((Uint32) idx) >= max_range)) {
+                Sint32 literal_idx;
+                if (!ast_calc_int(right, &literal_idx)) {  /* if ast_calc_int could handle it, we already complained during semantic analysis. */
+                    semantic_analysis_validate_array_index(ctx, left, right, idx);
+                }
+                return NULL;
+            }
+
+            x = fold_operand(ctx, left, leftdt);
+            if (x == NULL) {
+                return NULL;
+            }
+
+            init_constant(&c, dt);
+            SDL_memcpy(c.value, &x->value[((Uint32) idx) * stride], sizeof (ConstantValue) * c.num_components);
+            return keep_constant(ctx, &c);
+        }
+
+        case SDL_SHADER_AST_OP_MULTIPLY:
+            if ( ((left->ast.dt->dtype == DT_MATRIX) && (right->ast.dt->dtype >= DT_VECTOR)) ||
+                 ((right->ast.dt->dtype == DT_MATRIX) && (left->ast.dt->dtype >= DT_VECTOR)) ) {
+                return fold_matrix_multiply(ctx, left, right, dt);
+            }
+            break;  /* everything else is component-wise. */
+
+        default: break;
+    }
+
+    x = fold_operand(ctx, left, dt);
+    y = fold_operand(ctx, right, dt);
+    if (!x || !y) {
+        return NULL;
+    }
+
+    dtt = datatype_component(dt)->dtype;
+    init_constant(&c, dt);
+    for (i = 0; i < c.num_components; i++) {
+        if (!fold_binary_component(op, dtt, x->value[i], y->value[i], &c.value[i])) {
+            return NULL;
+        }
+    }
+    return keep_constant(ctx, &c);
+}
+
+static const Constant *fold_swizzle(Context *ctx, SDL_SHADER_AstNode *ast)
+{
+    const SDL_SHADER_AstExpression *expr = ast->structderef.expr;
+    const char *swizzle = ast->structderef.field;
+    const Constant *x;
+    Constant c;
+    Uint32 i;
+
+    if (expr->ast.dt->dtype != DT_VECTOR) {
+        return NULL;  /* struct dereference; we don't fold structs. */
+    } else if ((x = fold_operand(ctx, expr, expr->ast.dt)) == NULL) {
+        return NULL;
+    }
+
+    init_constant(&c, ast->ast.dt);
+    for (i = 0; i < c.num_components; i++) {
+        const Uint32 idx = swizzle_index(swizzle[i]);
+        if (idx >= x->num_components) {
+            return NULL;  /* semantic analysis should have caught this. */
+        }
+        c.value[i] = x->value[idx];
+    }
+    return keep_constant(ctx, &c);
+}
+
+static const Constant *fold_constructor(Context *ctx, SDL_SHADER_AstFunctionCallExpression *fncall)
+{
+    const DataType *dt = fncall->ast.dt;
+    const SDL_SHADER_AstArgument *arg;
+    Uint32 total = 0;
+    Constant c;
+    Uint32 i;
+
+    if (!datatype_is_foldable(dt)) {
+        return NULL;
+    }
+
+    /* components are taken from each argument in order: `float4(myfloat2, 1.0, 0.0)` */
+    init_constant(&c, dt);
+    for (arg = fncall->arguments ? fncall->arguments->head : NULL; arg; arg = arg->next) {
+        const Constant *x = arg->arg->ast.constant;
+        DataTypeType from;
+        if (x == NULL) {
+            return NULL;
+        }
+        from = datatype_component(x->dt)->dtype;
+        for (i = 0; i < x->num_components; i++, total++) {
+            if ((total >= c.num_components) || !fold_convert_component(from, datatype_component(dt)->dtype, x->value[i], &c.value[total])) {
+                return NULL;
+            }
+        }
+    }
+
+    if ((total == 1) && (dt->dtype == DT_VECTOR)) {  /* `float4(1.0)` fills every component. */
+        for (i = 1; i < c.num_components; i++) {
+            c.value[i] = c.value[0];
+        }
+    } else if (total != c.num_components) {
+        return NULL;
+    }
+
+    return keep_constant(ctx, &c);
+}
+
+static SDL_bool fold_float_intrinsic_component(const SDL_SHADER_BytecodeTag op, const float x, const float y, const float z, float *_r)
+{
+    float r;
+    switch (op) {
+        case SDL_SHADER_BCTAG_OP_ROUND: r = SDL_roundf(x); break;  /* halfway cases round away from zero. */
+        case SDL_SHADER_BCTAG_OP_ROUNDEVEN:
+            r = (SDL_fabsf(x - SDL_truncf(x)) == 0.5f) ? (2.0f * SDL_roundf(x * 0.5f)) : SDL_roundf(x);
+            break;
+        case SDL_SHADER_BCTAG_OP_TRUNC: r = SDL_truncf(x); break;
+        case SDL_SHADER_BCTAG_OP_FLOOR: r = SDL_floorf(x); break;
+        case SDL_SHADER_BCTAG_OP_CEIL: r = SDL_ceilf(x); break;
+        case SDL_SHADER_BCTAG_OP_FRACT: r = x - SDL_floorf(x); break;
+        case SDL_SHADER_BCTAG_OP_MOD: r = x - y * SDL_floorf(x / y); break;
+        case SDL_SHADER_BCTAG_OP_ABS: r = SDL_fabsf(x); break;
+        case SDL_SHADER_BCTAG_OP_SIGN: r = (x > 0.0f) ? 1.0f : ((x < 0.0f) ? -1.0f : x); break;  /* keeps the sign of zero. */
+        case SDL_SHADER_BCTAG_OP_RADIANS: r = x * 0.017453292519943295f; break;
+        case SDL_SHADER_BCTAG_OP_DEGREES: r = x * 57.295779513082320f; break;
+        case SDL_SHADER_BCTAG_OP_SIN: r = (float) SDL_sin((double) x); break;
+        case SDL_SHADER_BCTAG_OP_COS: r = (float) SDL_cos((double) x); break;
+        case SDL_SHADER_BCTAG_OP_TAN: r = (float) SDL_tan((double) x); break;
+        case SDL_SHADER_BCTAG_OP_ASIN: r = (float) SDL_asin((double) x); break;
+        case SDL_SHADER_BCTAG_OP_ACOS: r = (float) SDL_acos((double) x); break;
+        case SDL_SHADER_BCTAG_OP_ATAN: r = (float) SDL_atan((double) x); break;
+        case SDL_SHADER_BCTAG_OP_ATAN2: r = (float) SDL_atan2((double) x, (double) y); break;
+        case SDL_SHADER_BCTAG_OP_POW:
+            if ((x < 0.0f) || ((x == 0.0f) && (y <= 0.0f))) {
+                return SDL_FALSE;  /* undefined. */
+            }
+            r = (float) SDL_pow((double) x, (double) y);
+            break;
+        case SDL_SHADER_BCTAG_OP_EXP: r = (float) SDL_exp((double) x); break;
+        case SDL_SHADER_BCTAG_OP_LOG: r = (float) SDL_log((double) x); break;
+        case SDL_SHADER_BCTAG_OP_EXP2: r = (float) SDL_pow(2.0, (double) x); break;
+        case SDL_SHADER_BCTAG_OP_LOG2: r = (float) (SDL_log((double) x) / SDL_log(2.0)); break;
+        case SDL_SHADER_BCTAG_OP_SQRT: r = SDL_sqrtf(x); break;
+        case SDL_SHADER_BCTAG_OP_RSQRT: r = (float) (1.0 / SDL_sqrt((double) x)); break;
+        case SDL_SHADER_BCTAG_OP_MIN: r = (y < x) ? y : x; break;
+        case SDL_SHADER_BCTAG_OP_MAX: r = (x < y) ? y : x; break;
+        case SDL_SHADER_BCTAG_OP_CLAMP:
+            if (y > z) {
+                return SDL_FALSE;  /* undefined. */
+            }
+            r = (x < y) ? y : x;
+            r = (z < r) ? z : r;
+            break;
+        case SDL_SHADER_BCTAG_OP_MIX: r = x * (1.0f - z) + y * z; break;
+        case SDL_SHADER_BCTAG_OP_STEP: r = (y < x) ? 0.0f : 1.0f; break;
+        case SDL_SHADER_BCTAG_OP_SMOOTHSTEP: {
+            float t;
+            if (!(x < y)) {
+                return SDL_FALSE;  /* undefined. */
+            }
+            t = (z - x) / (y - x);
+            t = (t < 0.0f) ? 0.0f : ((t > 1.0f) ? 1.0f : t);
+            r = t * t * (3.0f - 2.0f * t);
+            break;
+        }
+        case SDL_SHADER_BCTAG_OP_MAD: r = x * y + z; break;
+        default: return SDL_FALSE;  /* the hyperbolic functions aren't folded, since SDL doesn't offer them. */
+    }
+
+    *_r = r;
+    return float_is_finite(r);
+}
+
+static SDL_bool fold_int_intrinsic_component(const SDL_SHADER_BytecodeTag op, const SDL_bool is_signed, const ConstantValue x, const ConstantValue y, const ConstantValue z, ConstantValue *r)
+{
+    #define LESS(a, b) (is_signed ? ((a).i < (b).i) : ((a).u < (b).u))
+    switch (op) {
+        case SDL_SHADER_BCTAG_OP_ABS: r->u = (is_signed && (x.i < 0)) ? (0u - x.u) : x.u; return SDL_TRUE;
+        case SDL_SHADER_BCTAG_OP_SIGN: r->i = is_signed ? ((x.i > 0) - (x.i < 0)) : (x.u != 0); return SDL_TRUE;
+        case SDL_SHADER_BCTAG_OP_MIN: *r = LESS(y, x) ? y : x; return SDL_TRUE;
+        case SDL_SHADER_BCTAG_OP_MAX: *r = LESS(x, y) ? y : x; return SDL_TRUE;
+        case SDL_SHADER_BCTAG_OP_CLAMP:
+            if (LESS(z, y)) {
+                return SDL_FALSE;  /* undefined. */
+            }
+            *r = LESS(x, y) ? y : x;
+            *r = LESS(z, *r) ? z : *r;
+            return SDL_TRUE;
+        default: break;
+    }
+    #undef LESS
+    return SDL_FALSE;
+}
+
+static float fold_dot(const Constant *x, const Constant *y)
+{
+    float r = x->value[0].f * y->value[0].f;
+    Uint32 i;
+    for (i = 1; i < x->num_components; i++) {
+        r += x->value[i].f * y->value[i].f;
+    }
+    return r;
+}
+
+/* the datatype an intrinsic works on argument `idx` in; literal arguments promote to it. */
+static const DataType *intrinsic_operand_datatype(Context *ctx, const SDL_SHADER_AstFunctionCallExpression *fncall, SDL_SHADER_AstExpression **args, const Uint32 num_args, const Uint32 idx)
+{
+    const DataType *dt = fncall->ast.dt;
+    switch (fncall->intrinsic->rule) {
+        case INTRINSIC_RULE_FLOAT_TO_SCALAR: return intrinsic_argument_datatype(ctx, args, num_args, SDL_TRUE);
+        case INTRINSIC_RULE_FLOAT:
+        case INTRINSIC_RULE_NUMBER:
+        case INTRINSIC_RULE_FLOAT3: return dt;
+        case INTRINSIC_RULE_REFRACT: return (idx == 2) ? datatype_component(dt) : dt;
+        case INTRINSIC_RULE_LDEXP: return (idx == 0) ? dt : args[idx]->ast.dt;
+        case INTRINSIC_RULE_BOOL_REDUCE:
+        case INTRINSIC_RULE_TRANSPOSE: return args[idx]->ast.dt;
+    }
+    return dt;
+}
+
+static const Constant *fold_intrinsic(Context *ctx, SDL_SHADER_AstFunctionCallExpression *fncall)
+{
+    const Intrinsic *intrinsic = fncall->intrinsic;
+    const DataType *dt = fncall->ast.dt;
+    SDL_SHADER_AstExpression *args[3];
+    const Constant *x[3] = { NULL, NULL, NULL };
+    const SDL_SHADER_AstArgument *arg;
+    const DataType *argdt;
+    Uint32 num_args = 0;
+    Constant c;
+    Uint32 i;
+
+    for (arg = fncall->arguments ? fncall->arguments->head : NULL; arg && (num_args < SDL_arraysize(args)); arg = arg->next) {
+        args[num_args++] = arg->arg;
+    }
+
+    if ((num_args != intrinsic->num_args) || !datatype_is_foldable(dt)) {
+        return NULL;
+    }
+
+    /* get each argument's value in the datatype the intrinsic works in. */
+    argdt = intrinsic_operand_datatype(ctx, fncall, args, num_args, 0);
+    for (i = 0; i < num_args; i++) {
+        x[i] = fold_operand(ctx, args[i], intrinsic_operand_datatype(ctx, fncall, args, num_args, i));
+        if (x[i] == NULL) {
+            return NULL;
+        }
+    }
+
+    init_constant(&c, dt);
+
+    switch (intrinsic->opcode) {
+        case SDL_SHADER_BCTAG_OP_ALL:
+        case SDL_SHADER_BCTAG_OP_ANY: {
+            const Uint32 want = (intrinsic->opcode == SDL_SHADER_BCTAG_OP_ANY) ? 1 : 0;
+            c.value[0].u = want ? 0 : 1;
+            for (i = 0; i < x[0]->num_components; i++) {
+                if (x[0]->value[i].u == want) {
+                    c.value[0].u = want;
+                    break;
+                }
+            }
+            break;
+        }
+
+        case SDL_SHADER_BCTAG_OP_LEN:
+        case SDL_SHADER_BCTAG_OP_DISTANCE:
+        case SDL_SHADER_BCTAG_OP_NORMALIZE: {
+            Constant diff;
+            const Constant *v = x[0];
+            float len;
+            if (intrinsic->opcode == SDL_SHADER_BCTAG_OP_DISTANCE) {
+                init_constant(&diff, argdt);
+                for (i = 0; i < diff.num_components; i++) {
+                    diff.value[i].f = x[0]->value[i].f - x[1]->value[i].f;
+                }
+                v = &diff;
+            }
+            len = SDL_sqrtf(fold_dot(v, v));
+            if (!float_is_finite(len)) {
+                return NULL;
+            } else if (intrinsic->opcode != SDL_SHADER_BCTAG_OP_NORMALIZE) {
+                c.value[0].f = len;
+            } else if (len == 0.0f) {
+                return NULL;  /* undefined. */
+            } else {
+                for (i = 0; i < c.num_components; i++) {
+                    c.value[i].f = v->value[i].f / len;
+                }
+            }
+            break;
+        }
+
+        case SDL_SHADER_BCTAG_OP_DOT:
+            c.value[0].f = fold_dot(x[0], x[1]);
+            break;
+
+        case SDL_SHADER_BCTAG_OP_CROSS:
+            c.value[0].f = x[0]->value[1].f * x[1]->value[2].f - x[1]->value[1].f * x[0]->value[2].f;
+            c.value[1].f = x[0]->value[2].f * x[1]->value[0].f - x[1]->value[2].f * x[0]->value[0].f;
+            c.value[2].f = x[0]->value[0].f * x[1]->value[1].f - x[1]->value[0].f * x[0]->value[1].f;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_FACEFORWARD: {  /* faceforward(N, I, Nref) */
+            const SDL_bool keep = (fold_dot(x[2], x[1]) < 0.0f) ? SDL_TRUE : SDL_FALSE;
+            for (i = 0; i < c.num_components; i++) {
+                c.value[i].f = keep ? x[0]->value[i].f : -x[0]->value[i].f;
+            }
+            break;
+        }
+
+        case SDL_SHADER_BCTAG_OP_REFLECT: {  /* reflect(I, N) */
+            const float d2 = 2.0f * fold_dot(x[1], x[0]);
+            for (i = 0; i < c.num_components; i++) {
+                c.value[i].f = x[0]->value[i].f - d2 * x[1]->value[i].f;
+            }
+            break;
+        }
+
+        case SDL_SHADER_BCTAG_OP_REFRACT: {  /* refract(I, N, eta) */
+            const float d = fold_dot(x[1], x[0]);
+            const float eta = x[2]->value[0].f;
+            const float k = 1.0f - eta * eta * (1.0f - d * d);
+            if (k >= 0.0f) {  /* otherwise it's total internal reflection, and the result is all zeroes. */
+                const float scale = eta * d + SDL_sqrtf(k);
+                for (i = 0; i < c.num_components; i++) {
+                    c.value[i].f = eta * x[0]->value[i].f - scale * x[1]->value[i].f;
+                }
+            }
+            break;
+        }
+
+        case SDL_SHADER_BCTAG_OP_LDEXP:
+            for (i = 0; i < c.num_components; i++) {
+                c.value[i].f = (float) SDL_scalbn((double) x[0]->value[i].f, (int) x[1]->value[i].i);
+            }
+            break;
+
+        case SDL_SHADER_BCTAG_OP_TRANSPOSE: {
+            const Uint32 rows = x[0]->dt->info.matrix.rows;
+            const Uint32 columns = x[0]->dt->info.matrix.childdt->info.vector.elements;
+            Uint32 j;
+            for (i = 0; i < rows; i++) {
+                for (j = 0; j < columns; j++) {
+                    c.value[(j * rows) + i] = x[0]->value[(i * columns) + j];
+                }
+            }
+            break;
+        }
+
+        default: {  /* everything else is component-wise. */
+            const DataTypeType dtt = datatype_component(dt)->dtype;
+            const ConstantValue zero = { 0 };
+            for (i = 0; i < c.num_components; i++) {
+                const ConstantValue a = x[0]->value[i];
+                const ConstantValue b = x[1] ? x[1]->value[i] : zero;
+                const ConstantValue d = x[2] ? x[2]->value[i] : zero;
+                if (dtt == DT_FLOAT) {
+                    if (!fold_float_intrinsic_component(intrinsic->opcode, a.f, b.f, d.f, &c.value[i].f)) {
+                        return NULL;
+                    }
+                } else if (!fold_int_intrinsic_component(intrinsic->opcode, (dtt == DT_INT) ? SDL_TRUE : SDL_FALSE, a, b, d, &c.value[i])) {
+                    return NULL;
+                }
+            }
+            break;
+        }
+    }
+
+    /* anything that did float math has to have a finite result. */
+    if (datatype_component(dt)->dtype == DT_FLOAT) {
+        for (i = 0; i < c.num_components; i++) {
+            if (!float_is_finite(c.value[i].f)) {
+                return NULL;
+            }
+        }
+    }
+
+    return keep_constant(ctx, &c);
+}
+
+static void fold_constants_treewalk(Context *ctx, void *_ast)
+{
+    SDL_SHADER_AstNode *ast = (SDL_SHADER_AstNode *) _ast;
+    SDL_SHADER_AstNodeType asttype;
+
+    if (ast == NULL) {
+        return;
+    }
+
+    asttype = ast->ast.type;
+
+    if (operator_is_unary(asttype)) {
+        fold_constants_treewalk(ctx, ast->unary.operand);
+        ast->ast.constant = fold_unary(ctx, ast);
+        return;
+    } else if (operator_is_binary(asttype)) {
+        fold_constants_treewalk(ctx, ast->binary.left);
+        fold_constants_treewalk(ctx, ast->binary.right);
+        ast->ast.constant = fold_binary(ctx, ast);
+        return;
+    } else if (operator_is_ternary(asttype)) {  /* the only ternary operator is `?:` */
+        const Constant *cond;
+        fold_constants_treewalk(ctx, ast->ternary.left);
+        fold_constants_treewalk(ctx, ast->ternary.center);
+        fold_constants_treewalk(ctx, ast->ternary.right);
+        cond = fold_operand(ctx, ast->ternary.left, ctx->datatype_boolean);
+        if (cond) {  /* only the chosen side gets evaluated, so it doesn't matter if we know the other one. */
+            ast->ast.constant = fold_operand(ctx, cond->value[0].u ? ast->ternary.center : ast->ternary.right, ast->ast.dt);
+        }
+        return;
+    }
+
+    switch (asttype) {
+        case SDL_SHADER_AST_OP_INT_LITERAL:
+        case SDL_SHADER_AST_OP_FLOAT_LITERAL:
+        case SDL_SHADER_AST_OP_BOOLEAN_LITERAL:
+            ast->ast.constant = fold_literal(ctx, &ast->expression, ast->ast.dt);
+            return;
+
+        case SDL_SHADER_AST_OP_IDENTIFIER: {
+            const SDL_SHADER_AstVarDeclaration *vardecl = ast->identifier.vardecl;
+            if (vardecl && !vardecl->assigned) {
+                ast->ast.constant = vardecl->ast.constant;  /* NULL if the initializer isn't constant. */
+            }
+            return;
+        }
+
+        case SDL_SHADER_AST_OP_DEREF_STRUCT:
+            fold_constants_treewalk(ctx, ast->structderef.expr);
+            ast->ast.constant = fold_swizzle(ctx, ast);
+            return;
+
+        case SDL_SHADER_AST_OP_CALLFUNC: {
+            SDL_SHADER_AstArgument *arg;
+            for (arg = ast->fncall.arguments ? ast->fncall.arguments->head : NULL; arg; arg = arg->next) {
+                fold_constants_treewalk(ctx, arg->arg);
+            }
+            if (ast->fncall.intrinsic) {
+                ast->ast.constant = fold_intrinsic(ctx, &ast->fncall);
+            } else if (!ast->fncall.fn) {
+                ast->ast.constant = fold_constructor(ctx, &ast->fncall);
+            }
+            return;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_VARDECL: {
+            SDL_SHADER_AstVarDeclaration *vardecl = ast->vardeclstmt.vardecl;
+            fold_constants_treewalk(ctx, ast->vardeclstmt.initializer);
+            /* if nothing ever writes to this variable, its value is whatever it was initialized to, everywhere it's used. */
+            if (!vardecl->assigned) {
+                if (ast->vardeclstmt.initializer) {
+                    vardecl->ast.constant = fold_operand(ctx, ast->vardeclstmt.initializer, vardecl->ast.dt);
+                } else if (datatype_is_foldable(vardecl->ast.dt)) {  /* uninitialized variables are zero. */
+                    Constant c;
+                    init_constant(&c, vardecl->ast.dt);
+                    vardecl->ast.constant = keep_constant(ctx, &c);
+                }
+            }
+            return;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_DO:
+            fold_constants_treewalk(ctx, ast->dostmt.code);
+            fold_constants_treewalk(ctx, ast->dostmt.condition);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_WHILE:
+            fold_constants_treewalk(ctx, ast->whilestmt.condition);
+            fold_constants_treewalk(ctx, ast->whilestmt.code);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_FOR:
+            fold_constants_treewalk(ctx, ast->forstmt.details->initializer);
+            fold_constants_treewalk(ctx, ast->forstmt.details->condition);
+            fold_constants_treewalk(ctx, ast->forstmt.details->step);
+            fold_constants_treewalk(ctx, ast->forstmt.code);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_IF:
+            fold_constants_treewalk(ctx, ast->ifstmt.condition);
+            fold_constants_treewalk(ctx, ast->ifstmt.code);
+            fold_constants_treewalk(ctx, ast->ifstmt.else_code);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_RETURN:
+            fold_constants_treewalk(ctx, ast->returnstmt.value);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_BLOCK: {
+            SDL_SHADER_AstStatement *i;
+            for (i = ast->stmtblock.head; i != NULL; i = i->next) {
+                fold_constants_treewalk(ctx, i);
+            }
+            return;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_PREINCREMENT:
+        case SDL_SHADER_AST_STATEMENT_POSTINCREMENT:
+        case SDL_SHADER_AST_STATEMENT_PREDECREMENT:
+        case SDL_SHADER_AST_STATEMENT_POSTDECREMENT:
+            fold_constants_treewalk(ctx, ast->incrementstmt.assignment);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_FUNCTION_CALL:
+            fold_constants_treewalk(ctx, ast->fncallstmt.expr);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_ASSIGNMENT: {
+            SDL_SHADER_AstAssignment *i;
+            for (i = ast->assignstmt.assignments->head; i != NULL; i = i->next) {
+                fold_constants_treewalk(ctx, i->expr);
+            }
+            fold_constants_treewalk(ctx, ast->assignstmt.value);
+            return;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNMUL:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNDIV:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNMOD:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNADD:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNSUB:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNLSHIFT:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNRSHIFT:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNAND:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNXOR:
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNOR:
+            fold_constants_treewalk(ctx, ast->compoundassignstmt.assignment);
+            fold_constants_treewalk(ctx, ast->compoundassignstmt.value);
+            return;
+
+        default:
+            return;  /* break/continue/discard/empty statements have nothing to fold. */
+    }
+}
+
+/* only functions that will actually be compiled are worth folding. */
+static void fold_constants(Context *ctx)
+{
+    SDL_SHADER_AstFunction *fn;
+    for (fn = ctx->functions; fn != NULL; fn = fn->nextfn) {
+        if (fn->reachable) {
+            fold_constants_treewalk(ctx, fn->code);
+        }
+    }
+}
+
+/* Code generation! This turns the analyzed (and folded) AST into the
+   intermediate representation (see SDL_shader_ir.c), which is serialized as
+   bytecode at the end; see docs/README-bytecode-format.md for what that looks
+   like. There are no variables: every value gets a new SSA id, and we track
+   which id holds each variable's current value as we walk the code, adding PHIs
+   where control flow comes back together. */
+
+/* Snapshots of every variable's current SSA id (so we can merge them after an
+   `if`, etc) live in ctx->scratch. Each one is a word that links to another
+   snapshot (for lists of `break`s, etc) followed by ctx->num_vars words of
+   values. We refer to them by offset, since ctx->scratch can move as it grows.
+   The snapshot at offset 0 is always all zeros, so if we run out of memory, we
+   have something safe to look at until we can give up. */
+
+typedef struct CodegenLoop
+{
+    const SDL_SHADER_AstStatement *step;  /* for-loops run this before they loop again. NULL otherwise. */
+    const SDL_SHADER_AstExpression *condition;  /* do-loops test this before they loop again. NULL otherwise. */
+    Uint32 entry_values;  /* snapshot of everything before the loop. */
+    Uint32 header_phis;  /* the PHI each variable gets at the top of the loop, or zero if it doesn't change in the loop. */
+    Uint32 continues;  /* linked snapshots of everything at each place that loops again, most recent first. */
+    Uint32 num_continues;
+    Uint32 breaks;  /* linked snapshots of everything at each `break`, most recent first. */
+    Uint32 num_breaks;
+    struct CodegenLoop *parent;
+} CodegenLoop;
+
+/* reserves `count` words of scratch space and returns their offset. Returns the end of the buffer if out of memory, so writes through codegen_scratch_set() go nowhere. */
+static Uint32 codegen_scratch(Context *ctx, const Uint32 count)
+{
+    const Uint32 retval = ctx->scratch.len;
+    Uint32 *words = wordbuffer_reserve(ctx, &ctx->scratch, count);
+    if (words) {
+        SDL_memset(words, '\0', count * sizeof (Uint32));
+    }
+    return retval;
+}
+
+static void codegen_scratch_set(Context *ctx, const Uint32 offset, const Uint32 value)
+{
+    if (offset < ctx->scratch.len) {
+        ctx->scratch.words[offset] = value;
+    }
+}
+
+/* each variable's value in a snapshot. */
+static Uint32 *codegen_snapshot_values(Context *ctx, const Uint32 snapshot)
+{
+    return ctx->scratch.words + snapshot + 1;
+}
+
+static Uint32 codegen_snapshot(Context *ctx)
+{
+    const Uint32 retval = ctx->scratch.len;
+    Uint32 *words = wordbuffer_reserve(ctx, &ctx->scratch, ctx->num_vars + 1);
+    if (words == NULL) {
+        return 0;
+    }
+    words[0] = 0;
+    SDL_memcpy(words + 1, ctx->var_values, ctx->num_vars * sizeof (Uint32));
+    return retval;
+}
+
+/* adds a snapshot to the front of a list, like `loop->breaks`. */
+static void codegen_snapshot_link(Context *ctx, Uint32 *list, Uint32 *count)
+{
+    const Uint32 snapshot = codegen_snapshot(ctx);
+    if (snapshot != 0) {
+        ctx->scratch.words[snapshot] = *list;
+        *list = snapshot;
+        (*count)++;
+    }
+}
+
+static void codegen_restore(Context *ctx, const Uint32 snapshot)
+{
+    SDL_memcpy(ctx->var_values, codegen_snapshot_values(ctx, snapshot), ctx->num_vars * sizeof (Uint32));
+}
+
+static Uint32 codegen_new_ssa(Context *ctx)
+{
+    return ctx->next_ssa++;
+}
+
+/* adds an instruction to the end of the current block, and returns where its operands go (NULL if out of memory).
+   `num_words` is its size in bytecode, opcode and num_words included. */
+static Uint32 *codegen_emit(Context *ctx, const SDL_SHADER_BytecodeTag opcode, const Uint32 num_words)
+{
+    IrInstruction *insn = ir_instruction_create(ctx, opcode, num_words - 2);
+    if (insn == NULL) {
+        return NULL;
+    }
+    ir_insert_before(ctx->codegen_block, NULL, insn);
+    return insn->operands;
+}
+
+static void codegen_emit_simple(Context *ctx, const SDL_SHADER_BytecodeTag opcode)  /* DISCARD, BREAK, etc. */
+{
+    codegen_emit(ctx, opcode, 2);
+}
+
+static Uint32 codegen_unary(Context *ctx, const SDL_SHADER_BytecodeTag opcode, const Uint32 input)
+{
+    const Uint32 retval = codegen_new_ssa(ctx);
+    Uint32 *words = codegen_emit(ctx, opcode, 4);
+    if (words) {
+        words[0] = retval;
+        words[1] = input;
+    }
+    return retval;
+}
+
+static Uint32 codegen_binary(Context *ctx, const SDL_SHADER_BytecodeTag opcode, const Uint32 input1, const Uint32 input2)
+{
+    const Uint32 retval = codegen_new_ssa(ctx);
+    Uint32 *words = codegen_emit(ctx, opcode, 5);
+    if (words) {
+        words[0] = retval;
+        words[1] = input1;
+        words[2] = input2;
+    }
+    return retval;
+}
+
+static Uint32 codegen_ternary(Context *ctx, const SDL_SHADER_BytecodeTag opcode, const Uint32 input1, const Uint32 input2, const Uint32 input3)
+{
+    const Uint32 retval = codegen_new_ssa(ctx);
+    Uint32 *words = codegen_emit(ctx, opcode, 6);
+    if (words) {
+        words[0] = retval;
+        words[1] = input1;
+        words[2] = input2;
+        words[3] = input3;
+    }
+    return retval;
+}
+
+/* CONSTRUCT, CALL, etc: an instruction with two fixed operands, then a list of SSA ids from `count` words of scratch space at `list`. */
+static void codegen_list(Context *ctx, const SDL_SHADER_BytecodeTag opcode, const Uint32 operand1, const Uint32 operand2, const Uint32 list, const Uint32 count)
+{
+    Uint32 *words;
+    if ((list + count) > ctx->scratch.len) {
+        return;  /* we ran out of memory building the list. */
+    } else if ((words = codegen_emit(ctx, opcode, count + 4)) != NULL) {
+        words[0] = operand1;
+        words[1] = operand2;
+        SDL_memcpy(words + 2, ctx->scratch.words + list, count * sizeof (Uint32));
+    }
+}
+
+/* remembers `dt` as the datatype of `id`, if it was the last thing we generated, for the optimizer's benefit. */
+static void codegen_set_datatype(Context *ctx, const Uint32 id, const DataType *dt)
+{
+    IrInstruction *last = ctx->codegen_block ? ctx->codegen_block->last : NULL;
+    if (last && !last->dt && (id != 0) && (ir_output(last) == id)) {
+        last->dt = dt;
+    }
+}
+
+static SDL_SHADER_BytecodeScalarType codegen_scalar_type(const DataType *dt)
+{
+    switch (dt ? dt->dtype : DT_VOID) {
+        case DT_BOOLEAN: return SDL_SHADER_BCSCALAR_BOOL;
+        case DT_INT: return SDL_SHADER_BCSCALAR_INT;
+        case DT_UINT: return SDL_SHADER_BCSCALAR_UINT;
+        case DT_HALF: return SDL_SHADER_BCSCALAR_HALF;
+        case DT_FLOAT: return SDL_SHADER_BCSCALAR_FLOAT;
+        default: break;
+    }
+    return SDL_SHADER_BCSCALAR_NONE;
+}
+
+static Uint32 codegen_typeword(const DataType *dt)
+{
+    switch (dt->dtype) {
+        case DT_VECTOR:
+            return SDL_SHADER_BYTECODE_TYPEWORD(codegen_scalar_type(dt->info.vector.childdt), dt->info.vector.elements, 1);
+        case DT_MATRIX:
+            return SDL_SHADER_BYTECODE_TYPEWORD(codegen_scalar_type(datatype_component(dt)), dt->info.matrix.childdt->info.vector.elements, dt->info.matrix.rows);
+        case DT_ARRAY:
+        case DT_STRUCT:
+            return 0;
+        default: break;
+    }
+    return SDL_SHADER_BYTECODE_TYPEWORD(codegen_scalar_type(dt), 1, 1);
+}
+
+static Uint32 codegen_literal(Context *ctx, const SDL_bool is_float, const ConstantValue *values, const Uint32 count)
+{
+    const SDL_SHADER_BytecodeTag opcode = (count == 4) ? (is_float ? SDL_SHADER_BCTAG_OP_LITERALFLOAT4 : SDL_SHADER_BCTAG_OP_LITERALINT4) : (is_float ? SDL_SHADER_BCTAG_OP_LITERALFLOAT : SDL_SHADER_BCTAG_OP_LITERALINT);
+    IrFunction *irfn = ctx->ir_last_function;  /* the function we're generating is always the newest one. */
+    const IrInstruction *existing;
+    IrInstruction *insn;
+    Uint32 words[4];
+    Uint32 i;
+
+    for (i = 0; i < count; i++) {
+        words[i] = values[i].u;
+    }
+
+    /* literals go in the function's constant pool, once per value, instead of in the code. */
+    existing = ir_find_constant(irfn, opcode, words);
+    if (existing) {
+        return existing->operands[0];
+    } else if ((insn = ir_instruction_create(ctx, opcode, count + 1)) == NULL) {
+        return 0;
+    }
+
+    insn->operands[0] = codegen_new_ssa(ctx);
+    SDL_memcpy(insn->operands + 1, words, count * sizeof (Uint32));
+    ir_add_constant(ctx, irfn, insn);
+    return insn->operands[0];
+}
+
+static Uint32 codegen_int(Context *ctx, const Uint32 value)
+{
+    ConstantValue val;
+    val.u = value;
+    return codegen_literal(ctx, SDL_FALSE, &val, 1);
+}
+
+/* scalars and four-element vectors have literal instructions, everything else is CONSTRUCTed from them. */
+static Uint32 codegen_constant_values(Context *ctx, const DataType *dt, const ConstantValue *values)
+{
+    const DataType *compdt = datatype_component(dt);
+    const SDL_bool is_float = ((compdt->dtype == DT_FLOAT) || (compdt->dtype == DT_HALF)) ? SDL_TRUE : SDL_FALSE;
+    const Uint32 mark = ctx->scratch.len;
+    Uint32 count, stride, list, i;
+
+    if (dt == compdt) {
+        return codegen_literal(ctx, is_float, values, 1);
+    } else if ((dt->dtype == DT_VECTOR) && (dt->info.vector.elements == 4)) {
+        return codegen_literal(ctx, is_float, values, 4);
+    } else if (dt->dtype == DT_VECTOR) {
+        count = dt->info.vector.elements;
+        stride = 1;
+    } else {  /* matrix: build it from its child vectors. */
+        count = dt->info.matrix.rows;
+        stride = dt->info.matrix.childdt->info.vector.elements;
+    }
+
+    list = codegen_scratch(ctx, count);
+    for (i = 0; i < count; i++) {
+        const Uint32 id = (stride == 1) ? codegen_literal(ctx, is_float, &values[i], 1) : codegen_constant_values(ctx, dt->info.matrix.childdt, &values[i * stride]);
+        codegen_scratch_set(ctx, list + i, id);
+    }
+
+    i = codegen_new_ssa(ctx);
+    codegen_list(ctx, SDL_SHADER_BCTAG_OP_CONSTRUCT, i, codegen_typeword(dt), list, count);
+    codegen_set_datatype(ctx, i, dt);
+    ctx->scratch.len = mark;
+    return i;
+}
+
+static Uint32 codegen_constant(Context *ctx, const Constant *c)
+{
+    return codegen_constant_values(ctx, c->dt, c->value);
+}
+
+/* variables without an initializer start out as zero. */
+static Uint32 codegen_zero(Context *ctx, const DataType *dt)
+{
+    const Uint32 mark = ctx->scratch.len;
+    Uint32 count, list, retval, i;
+
+    if (datatype_component(dt) != NULL) {
+        ConstantValue zeros[16];
+        SDL_memset(zeros, '\0', sizeof (zeros));
+        return codegen_constant_values(ctx, dt, zeros);
+    } else if (dt->dtype == DT_STRUCT) {
+        count = dt->info.structure.num_members;
+        list = codegen_scratch(ctx, count);
+        for (i = 0; i < count; i++) {
+            codegen_scratch_set(ctx, list + i, codegen_zero(ctx, dt->info.structure.members[i].dt));
+        }
+    } else if (dt->dtype == DT_ARRAY) {
+        const Uint32 zero = codegen_zero(ctx, dt->info.array.childdt);  /* it's SSA, every element can share one value. */
+        count = dt->info.array.elements;
+        list = codegen_scratch(ctx, count);
+        for (i = 0; i < count; i++) {
+            codegen_scratch_set(ctx, list + i, zero);
+        }
+    } else {
+        return 0;  /* void? */
+    }
+
+    retval = codegen_new_ssa(ctx);
+    codegen_list(ctx, SDL_SHADER_BCTAG_OP_CONSTRUCT, retval, 0, list, count);
+    codegen_set_datatype(ctx, retval, dt);
+    ctx->scratch.len = mark;
+    return retval;
+}
+
+static Uint32 codegen_swizzle(Context *ctx, const Uint32 input, const char *swizzle)
+{
+    Uint32 swizvals = 0xFFFFFFFF;
+    Uint32 i;
+    for (i = 0; (i < 4) && swizzle[i]; i++) {
+        swizvals &= ~(0xFFu << (i * 8));
+        swizvals |= swizzle_index(swizzle[i]) << (i * 8);
+    }
+    return codegen_binary(ctx, SDL_SHADER_BCTAG_OP_SWIZZLE, input, swizvals);  /* not really an SSA id, but it's laid out the same. */
+}
+
+static Uint32 codegen_struct_member_index(const DataType *dt, const char *field)
+{
+    Uint32 i;
+    for (i = 0; i < dt->info.structure.num_members; i++) {
+        if (SDL_strcmp(dt->info.structure.members[i].name, field) == 0) {
+            return i;
+        }
+    }
+    return 0;  /* semantic analysis should have caught this. */
+}
+
+/* `x += y;` is `x = x + y;` */
+static SDL_SHADER_AstNodeType codegen_compound_operator(const SDL_SHADER_AstNodeType asttype)
+{
+    switch (asttype) {
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNMUL: return SDL_SHADER_AST_OP_MULTIPLY;
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNDIV: return SDL_SHADER_AST_OP_DIVIDE;
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNMOD: return SDL_SHADER_AST_OP_MODULO;
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNADD: return SDL_SHADER_AST_OP_ADD;
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNSUB: return SDL_SHADER_AST_OP_SUBTRACT;
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNLSHIFT: return SDL_SHADER_AST_OP_LSHIFT;
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNRSHIFT: return SDL_SHADER_AST_OP_RSHIFT;
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNAND: return SDL_SHADER_AST_OP_BINARYAND;
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNXOR: return SDL_SHADER_AST_OP_BINARYXOR;
+        case SDL_SHADER_AST_STATEMENT_COMPOUNDASSIGNOR: return SDL_SHADER_AST_OP_BINARYOR;
+        default: break;
+    }
+    return asttype;
+}
+
+static SDL_SHADER_BytecodeTag codegen_opcode(const SDL_SHADER_AstNodeType asttype)
+{
+    switch (asttype) {
+        case SDL_SHADER_AST_OP_NEGATE: return SDL_SHADER_BCTAG_OP_NEGATE;
+        case SDL_SHADER_AST_OP_COMPLEMENT: return SDL_SHADER_BCTAG_OP_COMPLEMENT;
+        case SDL_SHADER_AST_OP_NOT: return SDL_SHADER_BCTAG_OP_NOT;
+        case SDL_SHADER_AST_OP_MULTIPLY: return SDL_SHADER_BCTAG_OP_MULTIPLY;
+        case SDL_SHADER_AST_OP_DIVIDE: return SDL_SHADER_BCTAG_OP_DIVIDE;
+        case SDL_SHADER_AST_OP_MODULO: return SDL_SHADER_BCTAG_OP_MODULO;
+        case SDL_SHADER_AST_OP_ADD: return SDL_SHADER_BCTAG_OP_ADD;
+        case SDL_SHADER_AST_OP_SUBTRACT: return SDL_SHADER_BCTAG_OP_SUBTRACT;
+        case SDL_SHADER_AST_OP_LSHIFT: return SDL_SHADER_BCTAG_OP_SHIFTLEFT;
+        case SDL_SHADER_AST_OP_RSHIFT: return SDL_SHADER_BCTAG_OP_SHIFTRIGHT;
+        case SDL_SHADER_AST_OP_LESSTHAN: return SDL_SHADER_BCTAG_OP_LESSTHAN;
+        case SDL_SHADER_AST_OP_GREATERTHAN: return SDL_SHADER_BCTAG_OP_GREATERTHAN;
+        case SDL_SHADER_AST_OP_LESSTHANOREQUAL: return SDL_SHADER_BCTAG_OP_LESSTHANOREQUAL;
+        case SDL_SHADER_AST_OP_GREATERTHANOREQUAL: return SDL_SHADER_BCTAG_OP_GREATERTHANOREQUAL;
+        case SDL_SHADER_AST_OP_EQUAL: return SDL_SHADER_BCTAG_OP_EQUAL;
+        case SDL_SHADER_AST_OP_NOTEQUAL: return SDL_SHADER_BCTAG_OP_NOTEQUAL;
+        case SDL_SHADER_AST_OP_BINARYAND: return SDL_SHADER_BCTAG_OP_BINARYAND;
+        case SDL_SHADER_AST_OP_BINARYXOR: return SDL_SHADER_BCTAG_OP_BINARYXOR;
+        case SDL_SHADER_AST_OP_BINARYOR: return SDL_SHADER_BCTAG_OP_BINARYOR;
+        case SDL_SHADER_AST_OP_LOGICALAND: return SDL_SHADER_BCTAG_OP_LOGICALAND;
+        case SDL_SHADER_AST_OP_LOGICALOR: return SDL_SHADER_BCTAG_OP_LOGICALOR;
+        default: break;
+    }
+    return SDL_SHADER_BCTAG_OP_NOP;  /* shouldn't happen. */
+}
+
+/* IF and LOOP own blocks of code; these make new instructions go into them until codegen_end().
+   If we're out of memory, these return NULL and everything goes where it was going before. */
+static IrInstruction *codegen_begin_block(Context *ctx, const SDL_SHADER_BytecodeTag opcode, const Uint32 num_operands)
+{
+    IrInstruction *insn = ir_instruction_create(ctx, opcode, num_operands);
+    if (insn) {
+        ir_insert_before(ctx->codegen_block, NULL, insn);
+        ctx->codegen_block = &insn->children[0];
+    }
+    return insn;
+}
+
+static IrInstruction *codegen_begin_if(Context *ctx, const Uint32 condition)
+{
+    IrInstruction *insn = codegen_begin_block(ctx, SDL_SHADER_BCTAG_OP_IF, 2);
+    if (insn) {
+        insn->operands[0] = condition;
+    }
+    return insn;
+}
+
+static void codegen_else(Context *ctx, IrInstruction *ifinsn)
+{
+    if (ifinsn) {
+        ctx->codegen_block = &ifinsn->children[1];
+    }
+}
+
+static void codegen_end(Context *ctx, IrInstruction *insn)  /* finishes an IF or LOOP. */
+{
+    if (insn) {
+        ctx->codegen_block = insn->block;
+    }
+}
+
+/* PHI of one variable's value in each of a list of linked snapshots, in the order they happened. */
+static Uint32 codegen_phi_from_list(Context *ctx, const Uint32 list, const Uint32 count, const Uint32 varidx)
+{
+    const Uint32 retval = codegen_new_ssa(ctx);
+    Uint32 *words = codegen_emit(ctx, SDL_SHADER_BCTAG_OP_PHI, count + 3);
+    Uint32 snapshot = list;
+    Uint32 i;
+
+    if (words) {
+        words[0] = retval;
+        for (i = count; i > 0; i--) {  /* the list is most-recent-first. */
+            words[i] = codegen_snapshot_values(ctx, snapshot)[varidx];
+            snapshot = ctx->scratch.words[snapshot];
+        }
+    }
+    codegen_set_datatype(ctx, retval, ctx->var_dts[varidx]);
+    return retval;
+}
+
+/* after several paths come back together (the `break`s out of a loop, etc), each variable
+   that existed before they split gets a PHI if the paths don't agree on its value. */
+static void codegen_merge(Context *ctx, const Uint32 before, const Uint32 list, const Uint32 count)
+{
+    Uint32 v;
+
+    if (count == 0) {
+        return;
+    }
+
+    for (v = 0; v < ctx->num_vars; v++) {
+        const Uint32 first = codegen_snapshot_values(ctx, list)[v];
+        SDL_bool same = SDL_TRUE;
+        Uint32 snapshot;
+
+        if (codegen_snapshot_values(ctx, before)[v] == 0) {
+            continue;  /* declared inside the paths, so it's out of scope now. */
+        }
+
+        for (snapshot = ctx->scratch.words[list]; snapshot != 0; snapshot = ctx->scratch.words[snapshot]) {
+            if (codegen_snapshot_values(ctx, snapshot)[v] != first) {
+                same = SDL_FALSE;
+                break;
+            }
+        }
+
+        ctx->var_values[v] = same ? first : codegen_phi_from_list(ctx, list, count, v);
+    }
+}
+
+static Uint32 codegen_expression(Context *ctx, const SDL_SHADER_AstExpression *expr);
+static SDL_bool codegen_statement(Context *ctx, const SDL_SHADER_AstStatement *stmt);
+
+/* generates `expr` as datatype `dt`, which only differs from expr's own datatype when it's a literal being promoted, or a scalar constant splatting to a vector. */
+static Uint32 codegen_operand(Context *ctx, const SDL_SHADER_AstExpression *expr, const DataType *dt)
+{
+    const Constant *c = fold_operand(ctx, expr, dt);
+    const DataType *compdt = datatype_component(dt);
+
+    if (c) {
+        return codegen_constant(ctx, c);
+    } else if (ast_is_int_or_float_literal(expr) && compdt && (compdt->dtype == DT_HALF)) {  /* we don't fold halfs, but literals still have to become one. */
+        const SDL_SHADER_AstNode *ast = (const SDL_SHADER_AstNode *) expr;
+        ConstantValue values[16];
+        Uint32 i;
+        for (i = 0; i < datatype_element_count(dt); i++) {
+            values[i].f = (expr->ast.type == SDL_SHADER_AST_OP_INT_LITERAL) ? (float) ast->intliteral.value : (float) ast->floatliteral.value;
+        }
+        return codegen_constant_values(ctx, dt, values);
+    }
+
+    return codegen_expression(ctx, expr);
+}
+
+static SDL_bool codegen_returns_value(Context *ctx, const SDL_SHADER_AstFunction *fn)
+{
+    return (fn->ast.dt && (fn->ast.dt != ctx->datatype_void)) ? SDL_TRUE : SDL_FALSE;
+}
+
+static Uint32 codegen_count_arguments(const SDL_SHADER_AstFunctionCallExpression *fncall)
+{
+    const SDL_SHADER_AstArgument *arg;
+    Uint32 retval = 0;
+    for (arg = fncall->arguments ? fncall->arguments->head : NULL; arg; arg = arg->next) {
+        retval++;
+    }
+    return retval;
+}
+
+/* does evaluating this expression do anything beyond producing a value? Only calls to user functions can (they might `discard`). */
+static SDL_bool codegen_has_side_effects(const SDL_SHADER_AstExpression *expr)
+{
+    const SDL_SHADER_AstNode *ast = (const SDL_SHADER_AstNode *) expr;
+    const SDL_SHADER_AstNodeType asttype = expr->ast.type;
+    const SDL_SHADER_AstArgument *arg;
+
+    if (expr->ast.constant) {
+        return SDL_FALSE;
+    } else if (operator_is_unary(asttype)) {
+        return codegen_has_side_effects(ast->unary.operand);
+    } else if (operator_is_binary(asttype)) {
+        return (codegen_has_side_effects(ast->binary.left) || codegen_has_side_effects(ast->binary.right)) ? SDL_TRUE : SDL_FALSE;
+    } else if (operator_is_ternary(asttype)) {
+        return (codegen_has_side_effects(ast->ternary.left) || codegen_has_side_effects(ast->ternary.center) || codegen_has_side_effects(ast->ternary.right)) ? SDL_TRUE : SDL_FALSE;
+    } else if (asttype == SDL_SHADER_AST_OP_DEREF_STRUCT) {
+        return codegen_has_side_effects(ast->structderef.expr);
+    } else if (asttype == SDL_SHADER_AST_OP_CALLFUNC) {
+        if (ast->fncall.fn) {
+            return SDL_TRUE;
+        }
+        for (arg = ast->fncall.arguments ? ast->fncall.arguments->head : NULL; arg; arg = arg->next) {
+            if (codegen_has_side_effects(arg->arg)) {
+                return SDL_TRUE;
+            }
+        }
+    }
+    return SDL_FALSE;
+}
+
+/* `cond ? a : b`, and `&&` and `||` when the right side has to be skipped, become an IF that PHIs the results together. */
+static Uint32 codegen_select(Context *ctx, const Uint32 condition, const SDL_SHADER_AstExpression *iftrue, const Uint32 iftrue_value, const SDL_SHADER_AstExpression *iffalse, const Uint32 iffalse_value, const DataType *dt)
+{
+    IrInstruction *ifinsn = codegen_begin_if(ctx, condition);
+    const Uint32 a = iftrue ? codegen_operand(ctx, iftrue, dt) : iftrue_value;
+    Uint32 b, retval;
+    Uint32 *words;
+
+    codegen_else(ctx, ifinsn);
+    b = iffalse ? codegen_operand(ctx, iffalse, dt) : iffalse_value;
+    codegen_end(ctx, ifinsn);
+
+    retval = codegen_new_ssa(ctx);
+    words = codegen_emit(ctx, SDL_SHADER_BCTAG_OP_PHI, 5);
+    if (words) {
+        words[0] = retval;
+        words[1] = a;
+        words[2] = b;
+    }
+    codegen_set_datatype(ctx, retval, dt);
+    return retval;
+}
+
+/* row `row` of `m`, or all of it if it's a vector (which is one row). */
+static Uint32 codegen_matrix_row(Context *ctx, const Uint32 m, const DataType *dt, const Uint32 row)
+{
+    Uint32 retval;
+    if (dt->dtype != DT_MATRIX) {
+        return m;
+    }
+    retval = codegen_binary(ctx, SDL_SHADER_BCTAG_OP_EXTRACT, m, codegen_int(ctx, row));
+    codegen_set_datatype(ctx, retval, dt->info.matrix.childdt);
+    return retval;
+}
+
+static Uint32 codegen_transpose(Context *ctx, const Uint32 m, const DataType *dt, const DataType **transposeddt)
+{
+    const Uint32 retval = codegen_unary(ctx, SDL_SHADER_BCTAG_OP_TRANSPOSE, m);
+    *transposeddt = datatype_with_shape(ctx, datatype_component(dt), dt->info.matrix.rows, dt->info.matrix.childdt->info.vector.elements);
+    codegen_set_datatype(ctx, retval, *transposeddt);
+    return retval;
+}
+
+/* `sum + (a * b)`, or just `a * b` if `sum` is zero. */
+static Uint32 codegen_multiply_add(Context *ctx, const Uint32 a, const Uint32 b, const Uint32 sum, const DataType *dt)
+{
+    Uint32 retval;
+    if (sum == 0) {
+        retval = codegen_binary(ctx, SDL_SHADER_BCTAG_OP_MULTIPLY, a, b);
+    } else if (datatype_is_floatish(dt)) {
+        retval = codegen_ternary(ctx, SDL_SHADER_BCTAG_OP_MAD, a, b, sum);
+    } else {  /* MAD is only for floats. */
+        retval = codegen_binary(ctx, SDL_SHADER_BCTAG_OP_MULTIPLY, a, b);
+        codegen_set_datatype(ctx, retval, dt);
+        retval = codegen_binary(ctx, SDL_SHADER_BCTAG_OP_ADD, sum, retval);
+    }
+    codegen_set_datatype(ctx, retval, dt);
+    return retval;
+}
+
+/* `row * m`: the rows of `m`, each scaled by the matching element of `row`, added together. */
+static Uint32 codegen_matrix_multiply_mad(Context *ctx, const Uint32 row, const Uint32 m, const DataType *mdt)
+{
+    const DataType *rowdt = mdt->info.matrix.childdt;
+    const Uint32 columns = rowdt->info.vector.elements;
+    Uint32 sum = 0;
+    Uint32 i, j;
+
+    for (i = 0; i < mdt->info.matrix.rows; i++) {
+        Uint32 swizvals = 0xFFFFFFFF;
+        Uint32 splat;
+        for (j = 0; j < columns; j++) {
+            swizvals &= ~(0xFFu << (j * 8));
+            swizvals |= i << (j * 8);
+        }
+        splat = codegen_binary(ctx, SDL_SHADER_BCTAG_OP_SWIZZLE, row, swizvals);
+        codegen_set_datatype(ctx, splat, rowdt);
+        sum = codegen_multiply_add(ctx, codegen_matrix_row(ctx, m, mdt, i), splat, sum, rowdt);
+    }
+
+    return sum;
+}
+
+/* `left * right`, where at least one of them is a matrix. Matrices are rows of vectors, a vector on the left is one row, and a vector on the right is one column. */
+static Uint32 codegen_matrix_multiply(Context *ctx, const Uint32 l, const DataType *ldt, const Uint32 r, const DataType *rdt, const DataType *dt)
+{
+    const DataType *compdt = datatype_component(dt);
+    const Uint32 rows = (ldt->dtype == DT_MATRIX) ? ldt->info.matrix.rows : 1;
+    const Uint32 columns = (rdt->dtype == DT_MATRIX) ? rdt->info.matrix.childdt->info.vector.elements : 1;
+    const Uint32 mark = ctx->scratch.len;
+    SDL_SHADER_MatrixMultiply how = ctx->matrix_multiply;
+    const DataType *transposeddt = NULL;
+    Uint32 transposed = 0;
+    Uint32 retval, list, count, i, j;
+
+    if ((how == SDL_SHADER_MATRIX_MULTIPLY_DOT) && !datatype_is_floatish(dt)) {
+        how = SDL_SHADER_MATRIX_MULTIPLY_MAD;  /* DOT is only for floats. */
+    }
+
+    if (how == SDL_SHADER_MATRIX_MULTIPLY_NATIVE) {
+        retval = codegen_binary(ctx, SDL_SHADER_BCTAG_OP_MATMUL, l, r);
+        codegen_set_datatype(ctx, retval, dt);
+        return retval;
+    } else if ((how == SDL_SHADER_MATRIX_MULTIPLY_MAD) && (rdt->dtype != DT_MATRIX)) {
+        /* `m * v` is `v * transpose(m)`, which is rows of vectors we can scale and add. */
+        transposed = codegen_transpose(ctx, l, ldt, &transposeddt);
+        return codegen_matrix_multiply_mad(ctx, r, transposed, transposeddt);
+    } else if (how == SDL_SHADER_MATRIX_MULTIPLY_MAD) {
+        count = rows;
+        list = codegen_scratch(ctx, count);
+        for (i = 0; i < rows; i++) {
+            codegen_scratch_set(ctx, list + i, codegen_matrix_multiply_mad(ctx, codegen_matrix_row(ctx, l, ldt, i), r, rdt));
+        }
+    } else {
+        /* each element is a DOT of one of the left's rows and one of the right's columns, which are rows once it's transposed. */
+        const Uint32 cols = codegen_scratch(ctx, columns);
+        if (rdt->dtype == DT_MATRIX) {
+            transposed = codegen_transpose(ctx, r, rdt, &transposeddt);
+        }
+        for (j = 0; j < columns; j++) {
+            codegen_scratch_set(ctx, cols + j, transposed ? codegen_matrix_row(ctx, transposed, transposeddt, j) : r);
+        }
+        list = codegen_scratch(ctx, rows * columns);
+        for (i = 0; i < rows; i++) {
+            const Uint32 row = codegen_matrix_row(ctx, l, ldt, i);
+            for (j = 0; j < columns; j++) {
+                const Uint32 col = ((cols + j) < ctx->scratch.len) ? ctx->scratch.words[cols + j] : 0;
+                const Uint32 id = codegen_binary(ctx, SDL_SHADER_BCTAG_OP_DOT, row, col);
+                codegen_set_datatype(ctx, id, compdt);
+                codegen_scratch_set(ctx, list + (i * columns) + j, id);
+            }
+        }
+
+        count = rows * columns;
+        if ((rows > 1) && (columns > 1)) {  /* a matrix: make each row from its elements, then the matrix from the rows. */
+            const DataType *rowdt = dt->info.matrix.childdt;
+            for (i = 0; i < rows; i++) {
+                retval = codegen_new_ssa(ctx);
+                codegen_list(ctx, SDL_SHADER_BCTAG_OP_CONSTRUCT, retval, codegen_typeword(rowdt), list + (i * columns), columns);
+                codegen_set_datatype(ctx, retval, rowdt);
+                codegen_scratch_set(ctx, list + i, retval);
+            }
+            count = rows;
+        }
+    }
+
+    if (count == 1) {  /* `v * m` in MAD mode is just the one row. */
+        retval = (list < ctx->scratch.len) ? ctx->scratch.words[list] : 0;
+    } else {
+        retval = codegen_new_ssa(ctx);
+        codegen_list(ctx, SDL_SHADER_BCTAG_OP_CONSTRUCT, retval, codegen_typeword(dt), list, count);
+        codegen_set_datatype(ctx, retval, dt);
+    }
+
+    ctx->scratch.len = mark;
+    return retval;
+}
+
+static Uint32 codegen_binary_expression(Context *ctx, const SDL_SHADER_AstNodeType op, const SDL_SHADER_AstExpression *left, const SDL_SHADER_AstExpression *right, const DataType *dt)
+{
+    const DataType *leftdt = dt;
+    const DataType *rightdt = dt;
+
+    switch (op) {
+        case SDL_SHADER_AST_OP_LESSTHAN:
+        case SDL_SHADER_AST_OP_GREATERTHAN:
+        case SDL_SHADER_AST_OP_LESSTHANOREQUAL:
+        case SDL_SHADER_AST_OP_GREATERTHANOREQUAL:
+        case SDL_SHADER_AST_OP_EQUAL:
+        case SDL_SHADER_AST_OP_NOTEQUAL:
+            leftdt = rightdt = ast_binary_result_datatype(left, right);
+            break;
+
+        case SDL_SHADER_AST_OP_MULTIPLY:
+        case SDL_SHADER_AST_OP_DIVIDE:
+            if ((left->ast.dt->dtype == DT_MATRIX) || (right->ast.dt->dtype == DT_MATRIX)) {  /* matrix math isn't component-wise, so don't splat a scalar into a matrix. */
+                leftdt = (left->ast.dt->dtype == DT_MATRIX) ? left->ast.dt : (left->ast.dt->dtype == DT_VECTOR) ? left->ast.dt : datatype_component(dt);
+                rightdt = (right->ast.dt->dtype == DT_MATRIX) ? right->ast.dt : (right->ast.dt->dtype == DT_VECTOR) ? right->ast.dt : datatype_component(dt);
+            }
+            break;
+
+        case SDL_SHADER_AST_OP_LOGICALAND:
+        case SDL_SHADER_AST_OP_LOGICALOR:
+            if (codegen_has_side_effects(right)) {  /* the right side only runs if the left side didn't decide the result. */
+                const Uint32 l = codegen_operand(ctx, left, dt);
+                if (op == SDL_SHADER_AST_OP_LOGICALAND) {
+                    return codegen_select(ctx, l, right, 0, NULL, l, dt);
+                }
+                return codegen_select(ctx, l, NULL, l, right, 0, dt);
+            }
+            break;
+
+        default: break;
+    }
+
+    {
+        const Uint32 l = codegen_operand(ctx, left, leftdt);
+        const Uint32 r = codegen_operand(ctx, right, rightdt);
+        Uint32 retval;
+        if ((op == SDL_SHADER_AST_OP_MULTIPLY) && (leftdt->dtype >= DT_VECTOR) && (rightdt->dtype >= DT_VECTOR) && ((leftdt->dtype == DT_MATRIX) || (rightdt->dtype == DT_MATRIX))) {
+            return codegen_matrix_multiply(ctx, l, leftdt, r, rightdt, dt);
+        }
+        retval = codegen_binary(ctx, codegen_opcode(op), l, r);
+        codegen_set_datatype(ctx, retval, dt);
+        return retval;
+    }
+}
+
+static Uint32 codegen_call(Context *ctx, const SDL_SHADER_AstFunctionCallExpression *fncall, const SDL_bool want_result)
+{
+    const SDL_SHADER_AstFunction *fn = fncall->fn;
+    const SDL_SHADER_AstFunctionParam *param = fn->params ? fn->params->head : NULL;
+    const Uint32 mark = ctx->scratch.len;
+    const Uint32 count = codegen_count_arguments(fncall);
+    const Uint32 list = codegen_scratch(ctx, count);
+    const SDL_SHADER_AstArgument *arg;
+    Uint32 retval = 0;
+    Uint32 i = 0;
+
+    for (arg = fncall->arguments ? fncall->arguments->head : NULL; arg; arg = arg->next, i++) {
+        const DataType *dt = param ? param->vardecl->ast.dt : arg->arg->ast.dt;
+        codegen_scratch_set(ctx, list + i, codegen_operand(ctx, arg->arg, dt));
+        param = param ? param->next : NULL;
+    }
+
+    if (want_result && codegen_returns_value(ctx, fn)) {
+        retval = codegen_new_ssa(ctx);
+    }
+
+    codegen_list(ctx, SDL_SHADER_BCTAG_OP_CALL, fn->fnindex, retval, list, count);
+    ctx->scratch.len = mark;
+    return retval;
+}
+
+static Uint32 codegen_intrinsic(Context *ctx, const SDL_SHADER_AstFunctionCallExpression *fncall)
+{
+    const Intrinsic *intrinsic = fncall->intrinsic;
+    SDL_SHADER_AstExpression *args[3];
+    Uint32 ids[3] = { 0, 0, 0 };
+    const SDL_SHADER_AstArgument *arg;
+    Uint32 num_args = 0;
+    Uint32 i;
+
+    for (arg = fncall->arguments ? fncall->arguments->head : NULL; arg && (num_args < SDL_arraysize(args)); arg = arg->next) {
+        args[num_args++] = arg->arg;
+    }
+
+    for (i = 0; i < num_args; i++) {
+        ids[i] = codegen_operand(ctx, args[i], intrinsic_operand_datatype(ctx, fncall, args, num_args, i));
+    }
+
+    switch (num_args) {
+        case 1: return codegen_unary(ctx, intrinsic->opcode, ids[0]);
+        case 2: return codegen_binary(ctx, intrinsic->opcode, ids[0], ids[1]);
+        default: break;
+    }
+    return codegen_ternary(ctx, intrinsic->opcode, ids[0], ids[1], ids[2]);
+}
+
+static Uint32 codegen_constructor(Context *ctx, const SDL_SHADER_AstFunctionCallExpression *fncall)
+{
+    const DataType *dt = fncall->ast.dt;
+    const DataType *compdt = datatype_component(dt);
+    const Uint32 mark = ctx->scratch.len;
+    const Uint32 count = codegen_count_arguments(fncall);
+    const SDL_SHADER_AstArgument *arg;
+    Uint32 list, retval, i;
+
+    if (count == 1) {  /* a copy (`float4(myfloat4)`), a conversion (`float4(myint4)`), or a splat (`float4(1.0)`). */
+        const SDL_SHADER_AstExpression *expr = fncall->arguments->head->arg;
+        const DataType *argdt = expr->ast.dt;
+        if (ast_is_int_or_float_literal(expr) && compdt) {
+            return codegen_operand(ctx, expr, dt);
+        } else if (argdt == dt) {
+            return codegen_expression(ctx, expr);
+        } else if (compdt && (datatype_element_count(argdt) == datatype_element_count(dt))) {
+            const Uint32 input = codegen_expression(ctx, expr);
+            return codegen_binary(ctx, SDL_SHADER_BCTAG_OP_CONVERT, codegen_typeword(dt), input);
+        }
+    }
+
+    /* components are taken from each argument in order: `float4(myfloat2, 1.0, 0.0)`. Structs and arrays take one argument per member. */
+    list = codegen_scratch(ctx, count);
+    i = 0;
+    for (arg = fncall->arguments ? fncall->arguments->head : NULL; arg; arg = arg->next, i++) {
+        const DataType *argdt = arg->arg->ast.dt;
+        if (compdt) {
+            argdt = ast_is_int_or_float_literal(arg->arg) ? compdt : argdt;
+        } else if ((dt->dtype == DT_STRUCT) && (i < dt->info.structure.num_members)) {
+            argdt = dt->info.structure.members[i].dt;
+        } else if (dt->dtype == DT_ARRAY) {
+            argdt = dt->info.array.childdt;
+        }
+        codegen_scratch_set(ctx, list + i, codegen_operand(ctx, arg->arg, argdt));
+    }
+
+    retval = codegen_new_ssa(ctx);
+    codegen_list(ctx, SDL_SHADER_BCTAG_OP_CONSTRUCT, retval, codegen_typeword(dt), list, count);
+    ctx->scratch.len = mark;
+    return retval;
+}
+
+static Uint32 codegen_expression_value(Context *ctx, const SDL_SHADER_AstExpression *expr)
+{
+    const SDL_SHADER_AstNode *ast = (const SDL_SHADER_AstNode *) expr;
+    const SDL_SHADER_AstNodeType asttype = expr->ast.type;
+    const DataType *dt = expr->ast.dt;
+
+    if (expr->ast.constant) {
+        return codegen_constant(ctx, expr->ast.constant);
+    }
+
+    switch (asttype) {
+        case SDL_SHADER_AST_OP_POSITIVE:
+        case SDL_SHADER_AST_OP_PARENTHESES:
+            return codegen_operand(ctx, ast->unary.operand, dt);
+
+        case SDL_SHADER_AST_OP_NEGATE:
+        case SDL_SHADER_AST_OP_COMPLEMENT:
+        case SDL_SHADER_AST_OP_NOT:
+            return codegen_unary(ctx, codegen_opcode(asttype), codegen_operand(ctx, ast->unary.operand, dt));
+
+        case SDL_SHADER_AST_OP_DEREF_ARRAY: {
+            const Uint32 base = codegen_expression(ctx, ast->binary.left);
+            const Uint32 idx = codegen_operand(ctx, ast->binary.right, ast->binary.right->ast.dt);
+            return codegen_binary(ctx, SDL_SHADER_BCTAG_OP_EXTRACT, base, idx);
+        }
+
+        case SDL_SHADER_AST_OP_CONDITIONAL: {
+            const Constant *cond = fold_operand(ctx, ast->ternary.left, ctx->datatype_boolean);
+            if (cond) {  /* only the chosen side gets evaluated. */
+                return codegen_operand(ctx, cond->value[0].u ? ast->ternary.center : ast->ternary.right, dt);
+            }
+            return codegen_select(ctx, codegen_operand(ctx, ast->ternary.left, ctx->datatype_boolean), ast->ternary.center, 0, ast->ternary.right, 0, dt);
+        }
+
+        case SDL_SHADER_AST_OP_IDENTIFIER: {
+            const SDL_SHADER_AstVarDeclaration *vardecl = ast->identifier.vardecl;
+            const Uint32 retval = (vardecl->varindex < ctx->num_vars) ? ctx->var_values[vardecl->varindex] : 0;
+            ICE_IF(ctx, &expr->ast, (retval == 0) && !ctx->out_of_memory, "Variable used without a value");
+            return retval;
+        }
+
+        case SDL_SHADER_AST_OP_INT_LITERAL:  /* these only get here if they couldn't fold (halfs, etc). */
+        case SDL_SHADER_AST_OP_FLOAT_LITERAL:
+        case SDL_SHADER_AST_OP_BOOLEAN_LITERAL: {
+            ConstantValue val;
+            if (asttype == SDL_SHADER_AST_OP_FLOAT_LITERAL) {
+                val.f = (float) ast->floatliteral.value;
+            } else if (asttype == SDL_SHADER_AST_OP_INT_LITERAL) {
+                val.u = (Uint32) ast->intliteral.value;
+            } else {
+                val.u = ast->boolliteral.value ? 1 : 0;
+            }
+            return codegen_literal(ctx, (asttype == SDL_SHADER_AST_OP_FLOAT_LITERAL) ? SDL_TRUE : SDL_FALSE, &val, 1);
+        }
+
+        case SDL_SHADER_AST_OP_DEREF_STRUCT: {
+            const SDL_SHADER_AstExpression *base = ast->structderef.expr;
+            const Uint32 input = codegen_expression(ctx, base);
+            if (base->ast.dt->dtype == DT_VECTOR) {
+                return codegen_swizzle(ctx, input, ast->structderef.field);
+            }
+            return codegen_binary(ctx, SDL_SHADER_BCTAG_OP_EXTRACT, input, codegen_int(ctx, codegen_struct_member_index(base->ast.dt, ast->structderef.field)));
+        }
+
+        case SDL_SHADER_AST_OP_CALLFUNC:
+            if (ast->fncall.fn) {
+                return codegen_call(ctx, &ast->fncall, SDL_TRUE);
+            } else if (ast->fncall.intrinsic) {
+                return codegen_intrinsic(ctx, &ast->fncall);
+            }
+            return codegen_constructor(ctx, &ast->fncall);
+
+        default:
+            if (operator_is_binary(asttype)) {
+                return codegen_binary_expression(ctx, asttype, ast->binary.left, ast->binary.right, dt);
+            }
+            break;
+    }
+
+    ICE(ctx, &expr->ast, "Unexpected expression type");
+    return 0;
+}
+
+static Uint32 codegen_expression(Context *ctx, const SDL_SHADER_AstExpression *expr)
+{
+    const Uint32 retval = codegen_expression_value(ctx, expr);
+    codegen_set_datatype(ctx, retval, expr->ast.dt);
+    return retval;
+}
+
+/* writes `value` to an lvalue. Writing part of something makes a new value of the whole thing with that part replaced, so `x.y[2] = 5;` is really `x = x with (x.y with [2] replaced) replaced`. */
+static void codegen_store(Context *ctx, const SDL_SHADER_AstExpression *lvalue, const Uint32 value)
+{
+    const SDL_SHADER_AstNode *ast = (const SDL_SHADER_AstNode *) lvalue;
+
+    switch (lvalue->ast.type) {
+        case SDL_SHADER_AST_OP_IDENTIFIER: {
+            const Uint32 varidx = ast->identifier.vardecl->varindex;
+            if (varidx < ctx->num_vars) {
+                ctx->var_values[varidx] = value;
+            }
+            return;
+        }
+
+        case SDL_SHADER_AST_OP_DEREF_ARRAY: {
+            const Uint32 base = codegen_expression(ctx, ast->binary.left);
+            const Uint32 idx = codegen_operand(ctx, ast->binary.right, ast->binary.right->ast.dt);
+            codegen_store(ctx, ast->binary.left, codegen_ternary(ctx, SDL_SHADER_BCTAG_OP_INSERT, base, idx, value));
+            return;
+        }
+
+        case SDL_SHADER_AST_OP_DEREF_STRUCT: {
+            const SDL_SHADER_AstExpression *expr = ast->structderef.expr;
+            const char *field = ast->structderef.field;
+            Uint32 base = codegen_expression(ctx, expr);
+            if (expr->ast.dt->dtype == DT_VECTOR) {  /* a swizzle: `v.zx = x;` puts value.x in v.z and value.y in v.x. */
+                const Uint32 len = (Uint32) SDL_strlen(field);
+                Uint32 i;
+                for (i = 0; i < len; i++) {
+                    static const char *lanes[] = { "x", "y", "z", "w" };
+                    const Uint32 lane = swizzle_index(field[i]);
+                    Uint32 component = value;
+                    if (len > 1) {
+                        component = codegen_swizzle(ctx, value, lanes[i]);
+                        codegen_set_datatype(ctx, component, expr->ast.dt->info.vector.childdt);
+                    }
+                    base = codegen_ternary(ctx, SDL_SHADER_BCTAG_OP_INSERT, base, codegen_int(ctx, lane), component);
+                }
+            } else {
+                base = codegen_ternary(ctx, SDL_SHADER_BCTAG_OP_INSERT, base, codegen_int(ctx, codegen_struct_member_index(expr->ast.dt, field)), value);
+            }
+            codegen_store(ctx, expr, base);
+            return;
+        }
+
+        default: break;
+    }
+
+    ICE(ctx, &lvalue->ast, "Unexpected lvalue type");
+}
+
+/* PHIs that turn out to be pointless (every input is the same value, or the PHI itself) get
+   replaced by that value; this follows the chain of replacements to whatever an SSA id means now. */
+static Uint32 codegen_resolve(Context *ctx, Uint32 id)
+{
+    const WordBuffer *replacements = &ctx->ssa_replacements;
+    while ((id < replacements->len) && (replacements->words[id] != 0)) {
+        id = replacements->words[id];
+    }
+    return id;
+}
+
+static void codegen_replace(Context *ctx, const Uint32 id, const Uint32 replacement)
+{
+    WordBuffer *replacements = &ctx->ssa_replacements;
+    if (id >= replacements->len) {
+        const Uint32 oldlen = replacements->len;
+        if (wordbuffer_reserve(ctx, replacements, (id + 1) - oldlen) == NULL) {
+            return;  /* out of memory, we'll just leave it. */
+        }
+        SDL_memset(replacements->words + oldlen, '\0', (replacements->len - oldlen) * sizeof (Uint32));
+    }
+    replacements->words[id] = replacement;
+}
+
+/* points every input in a block of code (and anything nested in it) at whatever its SSA id was replaced with. */
+static void codegen_apply_replacements(Context *ctx, const IrBlock *block)
+{
+    IrInstruction *insn;
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        Uint32 i, end;
+        for (ir_inputs(insn, &i, &end); i < end; i++) {
+            insn->operands[i] = codegen_resolve(ctx, insn->operands[i]);
+        }
+        for (i = 0; i < ir_num_children(insn); i++) {
+            codegen_apply_replacements(ctx, &insn->children[i]);
+        }
+    }
+}
+
+/* If all of a PHI's inputs, other than itself, are the same value, it's that value. Returns zero if it's a real PHI. */
+static Uint32 codegen_trivial_phi(Context *ctx, const Uint32 phi, const Uint32 *inputs, const Uint32 num_inputs)
+{
+    Uint32 same = 0;
+    Uint32 i;
+    for (i = 0; i < num_inputs; i++) {
+        const Uint32 input = codegen_resolve(ctx, inputs[i]);
+        if ((input == phi) || (input == same)) {
+            continue;
+        } else if (same != 0) {
+            return 0;
+        }
+        same = input;
+    }
+    return same;
+}
+
+/* notes every variable written to in a loop, since they'll need a PHI at the top of it. */
+static void codegen_find_assigned_variables(Context *ctx, const SDL_SHADER_AstStatement *stmt, const Uint32 flags)
+{
+    const SDL_SHADER_AstNode *ast = (const SDL_SHADER_AstNode *) stmt;
+    const SDL_SHADER_AstExpression *lvalue = NULL;
+
+    if (stmt == NULL) {
+        return;
+    }
+
+    switch (stmt->ast.type) {
+        case SDL_SHADER_AST_STATEMENT_BLOCK: {
+            const SDL_SHADER_AstStatement *i;
+            for (i = ast->stmtblock.head; i != NULL; i = i->next) {
+                codegen_find_assigned_variables(ctx, i, flags);
+            }
+            return;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_IF:
+            codegen_find_assigned_variables(ctx, (const SDL_SHADER_AstStatement *) ast->ifstmt.code, flags);
+            codegen_find_assigned_variables(ctx, (const SDL_SHADER_AstStatement *) ast->ifstmt.else_code, flags);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_DO: codegen_find_assigned_variables(ctx, (const SDL_SHADER_AstStatement *) ast->dostmt.code, flags); return;
+        case SDL_SHADER_AST_STATEMENT_WHILE: codegen_find_assigned_variables(ctx, (const SDL_SHADER_AstStatement *) ast->whilestmt.code, flags); return;
+
+        case SDL_SHADER_AST_STATEMENT_FOR:
+            codegen_find_assigned_variables(ctx, ast->forstmt.details->initializer, flags);
+            codegen_find_assigned_variables(ctx, ast->forstmt.details->step, flags);
+            codegen_find_assigned_variables(ctx, (const SDL_SHADER_AstStatement *) ast->forstmt.code, flags);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_ASSIGNMENT: {
+            const SDL_SHADER_AstAssignment *i;
+            for (i = ast->assignstmt.assignments->head; i != NULL; i = i->next) {
+                const SDL_SHADER_AstVarDeclaration *vardecl = lvalue_vardecl(i->expr);
+                if (vardecl && (vardecl->varindex < ctx->num_vars)) {
+                    codegen_scratch_set(ctx, flags + vardecl->varindex, 1);
+                }
+            }
+            return;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_PREINCREMENT:
+        case SDL_SHADER_AST_STATEMENT_POSTINCREMENT:
+        case SDL_SHADER_AST_STATEMENT_PREDECREMENT:
+        case SDL_SHADER_AST_STATEMENT_POSTDECREMENT:
+            lvalue = ast->incrementstmt.assignment;
+            break;
+
+        default:
+            if ((stmt->ast.type > SDL_SHADER_AST_STATEMENT_ASSIGNMENT) && (stmt->ast.type < SDL_SHADER_AST_STATEMENT_ASSIGNMENT_END_RANGE)) {
+                lvalue = ast->compoundassignstmt.assignment;  /* compound assignment. */
+            }
+            break;
+    }
+
+    if (lvalue) {
+        const SDL_SHADER_AstVarDeclaration *vardecl = lvalue_vardecl(lvalue);
+        if (vardecl && (vardecl->varindex < ctx->num_vars)) {
+            codegen_scratch_set(ctx, flags + vardecl->varindex, 1);
+        }
+    }
+}
+
+/* `IF %condition {} ELSE { BREAK }` */
+static void codegen_break_unless(Context *ctx, const SDL_SHADER_AstExpression *condition)
+{
+    CodegenLoop *loop = ctx->codegen_loop;
+    IrInstruction *ifinsn = codegen_begin_if(ctx, codegen_operand(ctx, condition, ctx->datatype_boolean));
+    codegen_else(ctx, ifinsn);
+    codegen_snapshot_link(ctx, &loop->breaks, &loop->num_breaks);
+    codegen_emit_simple(ctx, SDL_SHADER_BCTAG_OP_BREAK);
+    codegen_end(ctx, ifinsn);
+}
+
+/* what every path that loops again has to do first (run a for-loop's step, check a do-loop's condition). Returns SDL_FALSE if it can't loop again after all. */
+static SDL_bool codegen_loop_again(Context *ctx)
+{
+    CodegenLoop *loop = ctx->codegen_loop;
+    const SDL_SHADER_AstExpression *condition = loop->condition;
+
+    if (loop->step) {
+        codegen_statement(ctx, loop->step);
+    }
+
+    if (condition) {
+        const Constant *c = fold_operand(ctx, condition, ctx->datatype_boolean);
+        if (c && !c->value[0].u) {
+            codegen_snapshot_link(ctx, &loop->breaks, &loop->num_breaks);
+            codegen_emit_simple(ctx, SDL_SHADER_BCTAG_OP_BREAK);
+            return SDL_FALSE;
+        } else if (!c) {
+            codegen_break_unless(ctx, condition);
+        }
+    }
+
+    codegen_snapshot_link(ctx, &loop->continues, &loop->num_continues);
+    return SDL_TRUE;
+}
+
+/* what a variable's PHI at the top of a loop sees: its value before the loop, then its value each time the loop goes around again, in order. */
+static void codegen_loop_phi_inputs(Context *ctx, const CodegenLoop *loop, const Uint32 varidx, Uint32 *inputs)
+{
+    Uint32 snapshot = loop->continues;
+    Uint32 i;
+
+    inputs[0] = codegen_resolve(ctx, codegen_snapshot_values(ctx, loop->entry_values)[varidx]);
+    for (i = loop->num_continues; i > 0; i--) {  /* the list is most-recent-first. */
+        inputs[i] = codegen_resolve(ctx, codegen_snapshot_values(ctx, snapshot)[varidx]);
+        snapshot = ctx->scratch.words[snapshot];
+    }
+}
+
+/* every kind of loop becomes a LOOP that runs until something BREAKs out of it:
+   `while (x) { y; }` is `LOOP { IF %x {} ELSE { BREAK } y }`, `do { y; } while (x);` is
+   `LOOP { y IF %x {} ELSE { BREAK } }`, and for-loops are while-loops that run their step at
+   the end of the body (and before a `continue`). */
+static SDL_bool codegen_loop(Context *ctx, const SDL_SHADER_AstExpression *precondition, const SDL_SHADER_AstStatementBlock *code, const SDL_SHADER_AstStatement *step, const SDL_SHADER_AstExpression *postcondition)
+{
+    const Uint32 mark = ctx->scratch.len;
+    const Constant *c = precondition ? fold_operand(ctx, precondition, ctx->datatype_boolean) : NULL;
+    IrInstruction *loopinsn, *first;
+    Uint32 inputs, v;
+    SDL_bool replaced = SDL_FALSE;
+    CodegenLoop loop;
+
+    if (c && !c->value[0].u) {
+        return SDL_TRUE;  /* `while (false)` never runs at all. */
+    }
+
+    SDL_zero(loop);
+    loop.step = step;
+    loop.condition = postcondition;
+    loop.parent = ctx->codegen_loop;
+    loop.entry_values = codegen_snapshot(ctx);
+    loop.header_phis = codegen_scratch(ctx, ctx->num_vars);
+
+    /* anything written in the loop that already existed before it might need a PHI at the top,
+       since it might come from the previous iteration. We hand out the PHI's id now, but won't know
+       if it's really needed until we've seen the whole loop. */
+    codegen_find_assigned_variables(ctx, (const SDL_SHADER_AstStatement *) code, loop.header_phis);
+    codegen_find_assigned_variables(ctx, step, loop.header_phis);
+    for (v = 0; (v < ctx->num_vars) && ((loop.header_phis + ctx->num_vars) <= ctx->scratch.len); v++) {
+        Uint32 *phi = &ctx->scratch.words[loop.header_phis + v];
+        if (*phi && codegen_snapshot_values(ctx, loop.entry_values)[v]) {
+            *phi = ctx->var_values[v] = codegen_new_ssa(ctx);
+        } else {
+            *phi = 0;
+        }
+    }
+
+    loopinsn = codegen_begin_block(ctx, SDL_SHADER_BCTAG_OP_LOOP, 0);
+    ctx->codegen_loop = &loop;
+
+    if (precondition && !c) {
+        codegen_break_unless(ctx, precondition);
+    }
+
+    if (codegen_statement(ctx, (const SDL_SHADER_AstStatement *) code)) {
+        codegen_loop_again(ctx);
+    }
+
+    ctx->codegen_loop = loop.parent;
+
+    /* now that we've seen every way back to the top of the loop, we know what each PHI there
+       would see. Some only ever see one value (the variable only changes right before a `break`,
+       say), so they aren't needed after all, and dropping one can make others pointless too. */
+    inputs = codegen_scratch(ctx, loop.num_continues + 1);
+    if ((inputs + loop.num_continues + 1) <= ctx->scratch.len) {
+        SDL_bool changed;
+        do {
+            changed = SDL_FALSE;
+            for (v = 0; v < ctx->num_vars; v++) {
+                const Uint32 phi = ctx->scratch.words[loop.header_phis + v];
+                Uint32 replacement;
+                if (phi != 0) {
+                    codegen_loop_phi_inputs(ctx, &loop, v, ctx->scratch.words + inputs);
+                    replacement = codegen_trivial_phi(ctx, phi, ctx->scratch.words + inputs, loop.num_continues + 1);
+                    if (replacement != 0) {
+                        codegen_replace(ctx, phi, replacement);
+                        ctx->scratch.words[loop.header_phis + v] = 0;
+                        replaced = changed = SDL_TRUE;
+                    }
+                }
+            }
+        } while (changed);
+    }
+
+    /* The PHIs that are left go at the top of the loop. Their inputs are the value before the loop, then the value from each time it loops again, in order. */
+    first = ctx->codegen_block->first;
+    for (v = 0; (v < ctx->num_vars) && loopinsn; v++) {
+        const Uint32 phi = ctx->scratch.words[loop.header_phis + v];
+        IrInstruction *insn;
+        if ((phi != 0) && ((insn = ir_instruction_create(ctx, SDL_SHADER_BCTAG_OP_PHI, loop.num_continues + 2)) != NULL)) {
+            insn->operands[0] = phi;
+            insn->dt = ctx->var_dts[v];
+            codegen_loop_phi_inputs(ctx, &loop, v, insn->operands + 1);
+            ir_insert_before(ctx->codegen_block, first, insn);
+        }
+    }
+
+    /* anything that used a PHI we dropped uses what replaced it instead. */
+    if (replaced) {
+        Uint32 snapshot;
+        codegen_apply_replacements(ctx, ctx->codegen_block);
+        for (snapshot = loop.breaks; snapshot != 0; snapshot = ctx->scratch.words[snapshot]) {
+            Uint32 *values = codegen_snapshot_values(ctx, snapshot);
+            for (v = 0; v < ctx->num_vars; v++) {
+                values[v] = codegen_resolve(ctx, values[v]);
+            }
+        }
+        for (v = 0; v < ctx->num_vars; v++) {
+            ctx->var_values[v] = codegen_resolve(ctx, ctx->var_values[v]);
+        }
+    }
+
+    codegen_end(ctx, loopinsn);
+
+    /* after the loop, everything has whatever value it had at the `break` that got us out. */
+    codegen_merge(ctx, loop.entry_values, loop.breaks, loop.num_breaks);
+    ctx->scratch.len = mark;
+
+    return (loop.num_breaks > 0) ? SDL_TRUE : SDL_FALSE;  /* no breaks means it never comes out of the loop (it RETURNs, DISCARDs or runs forever). */
+}
+
+static SDL_bool codegen_if(Context *ctx, const SDL_SHADER_AstIfStatement *stmt)
+{
+    const Constant *c = fold_operand(ctx, stmt->condition, ctx->datatype_boolean);
+    IrInstruction *ifinsn;
+    Uint32 before, after_true;
+    SDL_bool true_falls_through, false_falls_through;
+
+    if (c) {  /* only the chosen side ever runs, so it's the only side we generate. */
+        const SDL_SHADER_AstStatementBlock *code = c->value[0].u ? stmt->code : stmt->else_code;
+        return code ? codegen_statement(ctx, (const SDL_SHADER_AstStatement *) code) : SDL_TRUE;
+    }
+
+    ifinsn = codegen_begin_if(ctx, codegen_operand(ctx, stmt->condition, ctx->datatype_boolean));
+    before = codegen_snapshot(ctx);
+    true_falls_through = codegen_statement(ctx, (const SDL_SHADER_AstStatement *) stmt->code);
+    after_true = codegen_snapshot(ctx);
+    codegen_else(ctx, ifinsn);
+    codegen_restore(ctx, before);
+    false_falls_through = stmt->else_code ? codegen_statement(ctx, (const SDL_SHADER_AstStatement *) stmt->else_code) : SDL_TRUE;
+    codegen_end(ctx, ifinsn);
+
+    if (true_falls_through && false_falls_through) {
+        Uint32 v;
+        for (v = 0; v < ctx->num_vars; v++) {
+            const Uint32 a = codegen_snapshot_values(ctx, after_true)[v];
+            const Uint32 b = ctx->var_values[v];
+            if ((codegen_snapshot_values(ctx, before)[v] != 0) && (a != b)) {
+                ctx->var_values[v] = codegen_binary(ctx, SDL_SHADER_BCTAG_OP_PHI, a, b);
+                codegen_set_datatype(ctx, ctx->var_values[v], ctx->var_dts[v]);
+            }
+        }
+    } else if (true_falls_through) {
+        codegen_restore(ctx, after_true);
+    }
+
+    return (true_falls_through || false_falls_through) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* generates a statement, returning SDL_FALSE if the code after it can't run (it always returns, breaks, etc). */
+static SDL_bool codegen_statement(Context *ctx, const SDL_SHADER_AstStatement *stmt)
+{
+    const SDL_SHADER_AstNode *ast = (const SDL_SHADER_AstNode *) stmt;
+    const SDL_SHADER_AstNodeType asttype = stmt->ast.type;
+
+    switch (asttype) {
+        case SDL_SHADER_AST_STATEMENT_EMPTY:
+            return SDL_TRUE;
+
+        case SDL_SHADER_AST_STATEMENT_BREAK: {
+            CodegenLoop *loop = ctx->codegen_loop;
+            codegen_snapshot_link(ctx, &loop->breaks, &loop->num_breaks);
+            codegen_emit_simple(ctx, SDL_SHADER_BCTAG_OP_BREAK);
+            return SDL_FALSE;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_CONTINUE:
+            if (codegen_loop_again(ctx)) {
+                codegen_emit_simple(ctx, SDL_SHADER_BCTAG_OP_CONTINUE);
+            }
+            return SDL_FALSE;
+
+        case SDL_SHADER_AST_STATEMENT_DISCARD:
+            codegen_emit_simple(ctx, SDL_SHADER_BCTAG_OP_DISCARD);
+            return SDL_FALSE;
+
+        case SDL_SHADER_AST_STATEMENT_VARDECL: {
+            const SDL_SHADER_AstVarDeclaration *vardecl = ast->vardeclstmt.vardecl;
+            const SDL_SHADER_AstExpression *initializer = ast->vardeclstmt.initializer;
+            Uint32 value;
+            if (vardecl->ast.constant && !vardecl->assigned) {
+                return SDL_TRUE;  /* every use of this already became the constant. */
+            }
+            value = initializer ? codegen_operand(ctx, initializer, vardecl->ast.dt) : codegen_zero(ctx, vardecl->ast.dt);
+            if (vardecl->varindex < ctx->num_vars) {
+                ctx->var_values[vardecl->varindex] = value;
+            }
+            return SDL_TRUE;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_DO:
+            return codegen_loop(ctx, NULL, ast->dostmt.code, NULL, ast->dostmt.condition);
+
+        case SDL_SHADER_AST_STATEMENT_WHILE:
+            return codegen_loop(ctx, ast->whilestmt.condition, ast->whilestmt.code, NULL, NULL);
+
+        case SDL_SHADER_AST_STATEMENT_FOR: {
+            const SDL_SHADER_AstForDetails *details = ast->forstmt.details;
+            if (details->initializer) {
+                codegen_statement(ctx, details->initializer);
+            }
+            return codegen_loop(ctx, details->condition, ast->forstmt.code, details->step, NULL);
+        }
+
+        case SDL_SHADER_AST_STATEMENT_IF:
+            return codegen_if(ctx, &ast->ifstmt);
+
+        case SDL_SHADER_AST_STATEMENT_RETURN: {
+            const SDL_SHADER_AstExpression *value = ast->returnstmt.value;
+            const Uint32 retval = value ? codegen_operand(ctx, value, ctx->codegen_function->ast.dt) : 0;
+            Uint32 *words = codegen_emit(ctx, SDL_SHADER_BCTAG_OP_RETURN, 3);
+            if (words) {
+                words[0] = retval;
+            }
+            return SDL_FALSE;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_BLOCK: {
+            const SDL_SHADER_AstStatement *i;
+            for (i = ast->stmtblock.head; i != NULL; i = i->next) {
+                if (!codegen_statement(ctx, i)) {
+                    return SDL_FALSE;  /* anything after this can't run. */
+                }
+            }
+            return SDL_TRUE;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_PREINCREMENT:
+        case SDL_SHADER_AST_STATEMENT_POSTINCREMENT:
+        case SDL_SHADER_AST_STATEMENT_PREDECREMENT:
+        case SDL_SHADER_AST_STATEMENT_POSTDECREMENT: {
+            const SDL_SHADER_AstExpression *lvalue = ast->incrementstmt.assignment;
+            const DataType *dt = lvalue->ast.dt;
+            const SDL_bool is_float = (datatype_component(dt)->dtype >= DT_HALF) ? SDL_TRUE : SDL_FALSE;
+            const SDL_bool increment = ((asttype == SDL_SHADER_AST_STATEMENT_PREINCREMENT) || (asttype == SDL_SHADER_AST_STATEMENT_POSTINCREMENT)) ? SDL_TRUE : SDL_FALSE;
+            ConstantValue ones[16];
+            Uint32 i, one, current, id;
+            for (i = 0; i < SDL_arraysize(ones); i++) {
+                if (is_float) { ones[i].f = 1.0f; } else { ones[i].u = 1; }
+            }
+            current = codegen_expression(ctx, lvalue);
+            one = codegen_constant_values(ctx, dt, ones);
+            id = codegen_binary(ctx, increment ? SDL_SHADER_BCTAG_OP_ADD : SDL_SHADER_BCTAG_OP_SUBTRACT, current, one);
+            codegen_set_datatype(ctx, id, dt);
+            codegen_store(ctx, lvalue, id);
+            return SDL_TRUE;
+        }
+
+        case SDL_SHADER_AST_STATEMENT_FUNCTION_CALL:
+            if (ast->fncallstmt.expr->fn) {
+                codegen_call(ctx, ast->fncallstmt.expr, SDL_FALSE);
+            } else if (codegen_has_side_effects((const SDL_SHADER_AstExpression *) ast->fncallstmt.expr)) {  /* `sin(x);` does nothing, but `sin(f());` still has to call f. */
+                codegen_expression(ctx, (const SDL_SHADER_AstExpression *) ast->fncallstmt.expr);
+            }
+            return SDL_TRUE;
+
+        case SDL_SHADER_AST_STATEMENT_ASSIGNMENT: {
+            const SDL_SHADER_AstAssignment *i;
+            const SDL_SHADER_AstAssignment *first = ast->assignstmt.assignments->head;
+            const Uint32 value = codegen_operand(ctx, ast->assignstmt.value, first->expr->ast.dt);
+            for (i = first; i != NULL; i = i->next) {
+                codegen_store(ctx, i->expr, value);
+            }
+            return SDL_TRUE;
+        }
+
+        default:
+            if ((asttype > SDL_SHADER_AST_STATEMENT_ASSIGNMENT) && (asttype < SDL_SHADER_AST_STATEMENT_ASSIGNMENT_END_RANGE)) {
+                const SDL_SHADER_AstExpression *lvalue = ast->compoundassignstmt.assignment;
+                const SDL_SHADER_AstExpression *value = ast->compoundassignstmt.value;
+                const Uint32 result = codegen_binary_expression(ctx, codegen_compound_operator(asttype), lvalue, value, lvalue->ast.dt);
+                codegen_store(ctx, lvalue, result);
+                return SDL_TRUE;
+            }
+            break;
+    }
+
+    ICE(ctx, &stmt->ast, "Unexpected statement type");
+    return SDL_TRUE;
+}
+
+/* every variable and parameter in a function gets an index, so we can track its current value in an array. */
+static void codegen_number_variables(Context *ctx, const SDL_SHADER_AstStatement *stmt)
+{
+    const SDL_SHADER_AstNode *ast = (const SDL_SHADER_AstNode *) stmt;
+
+    if (stmt == NULL) {
+        return;
+    }
+
+    switch (stmt->ast.type) {
+        case SDL_SHADER_AST_STATEMENT_VARDECL:
+            if (ctx->var_dts) {
+                ctx->var_dts[ctx->num_vars] = ast->vardeclstmt.vardecl->ast.dt;
+            }
+            ast->vardeclstmt.vardecl->varindex = ctx->num_vars++;
+            return;
+        case SDL_SHADER_AST_STATEMENT_DO: codegen_number_variables(ctx, (const SDL_SHADER_AstStatement *) ast->dostmt.code); return;
+        case SDL_SHADER_AST_STATEMENT_WHILE: codegen_number_variables(ctx, (const SDL_SHADER_AstStatement *) ast->whilestmt.code); return;
+
+        case SDL_SHADER_AST_STATEMENT_FOR:
+            codegen_number_variables(ctx, ast->forstmt.details->initializer);
+            codegen_number_variables(ctx, (const SDL_SHADER_AstStatement *) ast->forstmt.code);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_IF:
+            codegen_number_variables(ctx, (const SDL_SHADER_AstStatement *) ast->ifstmt.code);
+            codegen_number_variables(ctx, (const SDL_SHADER_AstStatement *) ast->ifstmt.else_code);
+            return;
+
+        case SDL_SHADER_AST_STATEMENT_BLOCK: {
+            const SDL_SHADER_AstStatement *i;
+            for (i = ast->stmtblock.head; i != NULL; i = i->next) {
+                codegen_number_variables(ctx, i);
+            }
+            return;
+        }
+
+        default: return;
+    }
+}
+
+/* once a section of the bytecode is done, it won't change again, so it can be byteswapped to its final form and added to the checksum. */
+static void codegen_finish_section(Context *ctx, const Uint32 start)
+{
+    Uint32 *words = ctx->bytecode.words + start;
+    const Uint32 len = ctx->bytecode.len - start;
+    Uint32 i;
+
+    for (i = 0; i < len; i++) {
+        words[i] = SDL_SwapLE32(words[i]);
     }
+    ctx->bytecode_crc32 = SDL_SHADER_BytecodeCrc32(ctx->bytecode_crc32, words, len * sizeof (Uint32));
+}
 
-    semantic_analysis_build_globals_lists(ctx);
-    semantic_analysis_check_globals_for_duplicates(ctx);
-    semantic_analysis_gather_datatypes(ctx);
-    semantic_analysis_prepare_functions(ctx);
-    semantic_analysis_treewalk(ctx, ctx->shader);
+/* Once a function's code is all there, tidy up its SSA: dropping a loop's PHIs can make PHIs
+   after an IF pointless in turn, and some PHIs are never read at all (the variable is always
+   written again before anything looks at it). Then the ids that are left get renumbered in
+   order, so there are no gaps. */
+static void codegen_finish_function(Context *ctx, IrFunction *irfn)
+{
+    const Uint32 num_ids = ctx->next_ssa;
+    IrInstruction *insn, *next;
+    Uint32 *uses;
+    Uint32 i, end;
+    SDL_bool changed;
+
+    do {
+        changed = SDL_FALSE;
+        for (insn = irfn->body.first; insn != NULL; insn = next) {
+            next = ir_walk(insn);
+            if (insn->opcode == SDL_SHADER_BCTAG_OP_PHI) {
+                const Uint32 replacement = codegen_trivial_phi(ctx, insn->operands[0], insn->operands + 1, insn->num_operands - 1);
+                if (replacement != 0) {
+                    codegen_replace(ctx, insn->operands[0], replacement);
+                    ir_unlink(insn);
+                    changed = SDL_TRUE;
+                }
+            }
+        }
+    } while (changed);
 
-    pop_scope(ctx, scope);
+    codegen_apply_replacements(ctx, &irfn->body);
 
-    ICE_IF(ctx, &ctx->ast_after, ctx->scope_stack != NULL, "Scope stack isn't empty!");
+    ctx->scratch.len = 0;  /* we're done with the snapshots. */
+    uses = wordbuffer_reserve(ctx, &ctx->scratch, num_ids);
+    if (uses == NULL) {
+        return;
+    }
+    SDL_memset(uses, '\0', num_ids * sizeof (Uint32));
+
+    for (insn = irfn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        for (ir_inputs(insn, &i, &end); i < end; i++) {
+            const Uint32 id = insn->operands[i];
+            if ((id < num_ids) && (id != ir_output(insn))) {  /* a PHI reading itself doesn't count. */
+                uses[id]++;
+            }
+        }
+    }
+
+    do {
+        changed = SDL_FALSE;
+        for (insn = irfn->body.first; insn != NULL; insn = next) {
+            next = ir_walk(insn);
+            if ((insn->opcode == SDL_SHADER_BCTAG_OP_PHI) && (uses[insn->operands[0]] == 0)) {
+                for (i = 1; i < insn->num_operands; i++) {
+                    const Uint32 id = insn->operands[i];
+                    if ((id < num_ids) && (id != insn->operands[0])) {
+                        uses[id]--;
+                    }
+                }
+                ir_unlink(insn);
+                changed = SDL_TRUE;
+            }
+        }
+    } while (changed);
+
+    irfn->num_ids = num_ids;
+    ir_build_uses(ctx, irfn);
+    ir_remove_unused_constants(irfn);  /* (only the PHIs we just dropped might have read them.) */
+
+    /* a PHI or INSERT has the datatype of its inputs; some PHIs only learn theirs from PHIs further down. */
+    do {
+        changed = SDL_FALSE;
+        for (insn = irfn->body.first; insn != NULL; insn = ir_walk(insn)) {
+            if (insn->dt) {
+                continue;
+            } else if (insn->opcode == SDL_SHADER_BCTAG_OP_INSERT) {
+                insn->dt = ir_datatype(irfn, insn->operands[1]);
+            } else if (insn->opcode == SDL_SHADER_BCTAG_OP_PHI) {
+                for (i = 1; (i < insn->num_operands) && !insn->dt; i++) {
+                    insn->dt = ir_datatype(irfn, insn->operands[i]);
+                }
+            }
+            changed = (insn->dt != NULL) || changed;
+        }
+    } while (changed);
+
+    ir_renumber(ctx, irfn);
+}
+
+static void codegen_function(Context *ctx, SDL_SHADER_AstFunction *fn)
+{
+    const SDL_bool exported = ((fn->fntype == SDL_SHADER_AST_FNTYPE_VERTEX) || (fn->fntype == SDL_SHADER_AST_FNTYPE_FRAGMENT)) ? SDL_TRUE : SDL_FALSE;
+    const SDL_SHADER_BytecodeFunctionType fntype = (fn->fntype == SDL_SHADER_AST_FNTYPE_VERTEX) ? SDL_SHADER_BCFNTYPE_VERTEX : (fn->fntype == SDL_SHADER_AST_FNTYPE_FRAGMENT) ? SDL_SHADER_BCFNTYPE_FRAGMENT : SDL_SHADER_BCFNTYPE_NORMAL;
+    const char *name = fn->vardecl->name;
+    SDL_SHADER_AstFunctionParam *param;
+    IrFunction *irfn;
+    Uint32 num_params = 0;
+    Uint32 *words;
+
+    /* number the variables once to count them, then again to fill in their datatypes. */
+    ctx->var_dts = NULL;
+    ctx->num_vars = 0;
+    for (param = fn->params ? fn->params->head : NULL; param; param = param->next) {
+        ctx->num_vars++;
+    }
+    num_params = ctx->num_vars;
+    codegen_number_variables(ctx, (const SDL_SHADER_AstStatement *) fn->code);
+
+    ctx->var_values = (Uint32 *) Malloc(ctx, (ctx->num_vars + 1) * sizeof (Uint32));
+    ctx->var_dts = (const DataType **) Malloc(ctx, (ctx->num_vars + 1) * sizeof (const DataType *));
+    ctx->scratch.len = 0;
+    if ((ctx->var_values == NULL) || (ctx->var_dts == NULL) || (codegen_scratch(ctx, ctx->num_vars + 1) != 0) || (ctx->scratch.len == 0)) {
+        return;  /* out of memory. The all-zeros snapshot at offset 0 has to exist. */
+    }
+    SDL_memset(ctx->var_values, '\0', (ctx->num_vars + 1) * sizeof (Uint32));
+
+    ctx->num_vars = 0;
+    for (param = fn->params ? fn->params->head : NULL; param; param = param->next) {
+        ctx->var_dts[ctx->num_vars] = param->vardecl->ast.dt;
+        param->vardecl->varindex = ctx->num_vars++;
+    }
+    codegen_number_variables(ctx, (const SDL_SHADER_AstStatement *) fn->code);
+
+    irfn = ir_function_create(ctx, exported ? name : NULL, fntype, num_params, codegen_returns_value(ctx, fn));
+    if (irfn == NULL) {
+        return;
+    }
+
+    irfn->param_dts = (const DataType **) ir_alloc(ctx, (num_params + 1) * sizeof (const DataType *));
+    if (irfn->param_dts == NULL) {
+        return;
+    }
+
+    irfn->return_dt = codegen_returns_value(ctx, fn) ? fn->ast.dt : NULL;
+    irfn->fast_math = fn->precise ? SDL_SHADER_FASTMATH_NONE : ctx->fast_math;
+    irfn->half_tolerance = fn->precise ? 0.0f : ctx->half_precision_tolerance;
+
+    /* parameters are SSA ids 1 through num_params. */
+    ctx->next_ssa = 1;
+    ctx->ssa_replacements.len = 0;
+    ctx->codegen_function = fn;
+    ctx->codegen_loop = NULL;
+    ctx->codegen_block = &irfn->body;
+    for (param = fn->params ? fn->params->head : NULL; param; param = param->next) {
+        irfn->param_dts[ctx->next_ssa - 1] = param->vardecl->ast.dt;
+        ctx->var_values[param->vardecl->varindex] = codegen_new_ssa(ctx);
+    }
+
+    if (codegen_statement(ctx, (const SDL_SHADER_AstStatement *) fn->code)) {  /* the end of the function is reachable. */
+        if (codegen_returns_value(ctx, fn)) {
+            failf_ast(ctx, &fn->vardecl->ast, "Not all code paths in function '%s' return a value", name);
+        } else if ((words = codegen_emit(ctx, SDL_SHADER_BCTAG_OP_RETURN, 3)) != NULL) {
+            words[0] = 0;
+        }
+    }
+
+    Free(ctx, ctx->var_values);
+    ctx->var_values = NULL;
+    Free(ctx, ctx->var_dts);
+    ctx->var_dts = NULL;
+    ctx->codegen_function = NULL;
+    ctx->codegen_block = NULL;
+
+    if (!ctx->out_of_memory) {
+        codegen_finish_function(ctx, irfn);
+    }
+}
+
+static void codegen(Context *ctx)
+{
+    SDL_SHADER_AstFunction *fn;
+    Uint32 fnindex = 0;
+
+    /* CALL instructions refer to functions by their position in the bytecode, so number them all first. */
+    for (fn = ctx->functions; fn != NULL; fn = fn->nextfn) {
+        if (fn->reachable) {
+            fn->fnindex = fnindex++;
+        }
+    }
+
+    for (fn = ctx->functions; fn != NULL; fn = fn->nextfn) {
+        if (fn->reachable && !ctx->out_of_memory) {
+            codegen_function(ctx, fn);
+        }
+    }
+}
+
+/* The TYPES section lists every datatype the bytecode uses, so whatever reads it knows the
+   type of every SSA id when it's defined, instead of working it out from the inputs. Each
+   type comes after anything it's made of, so the table can be read in one pass, too. */
+static void bytecode_type_ids_nuke(const void *key, const void *value, void *data)
+{
+    (void) key;  /* datatype names are stringcache'd, and the values are just numbers. */
+    (void) value;
+    (void) data;
+}
+
+Uint32 bytecode_type_id(Context *ctx, const DataType *dt)
+{
+    const void *value = NULL;
+    Uint32 data[3];
+    Uint32 num_data = 0;
+    SDL_SHADER_BytecodeTypeKind kind;
+    Uint32 *words;
+    Uint32 i;
+
+    if ((dt == NULL) || (dt->dtype == DT_VOID)) {
+        return 0;
+    } else if (ctx->bytecode_type_ids == NULL) {
+        ctx->bytecode_type_ids = hash_create(ctx, hash_hash_string, hash_keymatch_string, bytecode_type_ids_nuke, SDL_FALSE, MallocContextBridge, FreeContextBridge, ctx);
+        if (ctx->bytecode_type_ids == NULL) {
+            return 0;
+        }
+    }
+
+    if (hash_find(ctx->bytecode_type_ids, dt->name, &value)) {
+        return (Uint32) (size_t) value;
+    }
+
+    switch (dt->dtype) {
+        case DT_ARRAY:
+            kind = SDL_SHADER_BCTYPE_ARRAY;
+            data[num_data++] = bytecode_type_id(ctx, dt->info.array.childdt);
+            data[num_data++] = dt->info.array.elements;
+            break;
+
+        case DT_STRUCT:
+            kind = SDL_SHADER_BCTYPE_STRUCT;
+            for (i = 0; i < dt->info.structure.num_members; i++) {
+                bytecode_type_id(ctx, dt->info.structure.members[i].dt);  /* members go first; we'll look them up again below. */
+            }
+            break;
+
+        default:
+            kind = SDL_SHADER_BCTYPE_VALUE;
+            data[num_data++] = codegen_typeword(dt);
+            break;
+    }
+
+    words = wordbuffer_reserve(ctx, &ctx->bytecode_types, 2 + ((kind == SDL_SHADER_BCTYPE_STRUCT) ? dt->info.structure.num_members : num_data));
+    if ((words == NULL) || (hash_insert(ctx->bytecode_type_ids, dt->name, (const void *) (size_t) (ctx->bytecode_num_types + 1)) != 1)) {
+        return 0;
+    }
+
+    *(words++) = (Uint32) kind;
+    if (kind == SDL_SHADER_BCTYPE_STRUCT) {
+        *(words++) = 2 + dt->info.structure.num_members;
+        for (i = 0; i < dt->info.structure.num_members; i++) {
+            *(words++) = bytecode_type_id(ctx, dt->info.structure.members[i].dt);
+        }
+    } else {
+        *(words++) = 2 + num_data;
+        SDL_memcpy(words, data, num_data * sizeof (Uint32));
+    }
+
+    return ++ctx->bytecode_num_types;
+}
+
+/* puts every type a function uses in the type table, so it's complete before any function is written. */
+static void add_function_types(Context *ctx, const IrFunction *irfn)
+{
+    const IrInstruction *insn;
+    Uint32 i;
+
+    for (i = 0; i < irfn->num_params; i++) {
+        bytecode_type_id(ctx, irfn->param_dts ? irfn->param_dts[i] : NULL);
+    }
+    bytecode_type_id(ctx, irfn->return_dt);
+    for (insn = irfn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        if (ir_output(insn) != 0) {
+            bytecode_type_id(ctx, insn->dt);
+        }
+    }
+}
+
+/* The DIRECTORY goes first, so a reader can find any function (and any entry point by name)
+   without walking every section before it. Its size only depends on how many functions and
+   entry points there are, so we save room for it here and fill it in once the functions are
+   written and we know where they ended up. Returns how many words it needs. */
+static Uint32 directory_size(const Context *ctx, Uint32 *_num_functions, Uint32 *_num_buckets)
+{
+    const IrFunction *irfn;
+    Uint32 num_functions = 0;
+    Uint32 num_entry_points = 0;
+    Uint32 num_buckets = 0;
+
+    for (irfn = ctx->ir_functions; irfn != NULL; irfn = irfn->next) {
+        num_functions++;
+        if (irfn->name) {
+            num_entry_points++;
+        }
+    }
+
+    if (num_entry_points > 0) {
+        num_buckets = 1;
+        while (num_buckets < (num_entry_points * 2)) {  /* keep it no more than half full, so probes stay short. */
+            num_buckets <<= 1;
+        }
+    }
+
+    *_num_functions = num_functions;
+    *_num_buckets = num_buckets;
+    return 4 + num_functions + (num_buckets * 2);  /* tag, num_words, num_functions, offsets, num_buckets, buckets. */
+}
+
+static void fill_directory(Context *ctx, const Uint32 start, const Uint32 num_words, const Uint32 num_functions, const Uint32 num_buckets)
+{
+    Uint32 *words = ctx->bytecode.words + start;
+    Uint32 *buckets = words + 4 + num_functions;
+    const IrFunction *irfn;
+    Uint32 i;
+
+    words[0] = SDL_SHADER_BCTAG_DIRECTORY;
+    words[1] = num_words;
+    words[2] = num_functions;
+    words[3 + num_functions] = num_buckets;  /* (the offsets in between were filled in as the functions were written.) */
+
+    for (i = 0; i < num_buckets; i++) {
+        buckets[(i * 2) + 0] = 0;
+        buckets[(i * 2) + 1] = SDL_SHADER_BYTECODE_NO_FUNCTION;
+    }
+
+    for (irfn = ctx->ir_functions, i = 0; irfn != NULL; irfn = irfn->next, i++) {
+        if (irfn->name) {
+            const Uint32 hash = SDL_SHADER_BytecodeHashName(irfn->name);
+            Uint32 bucket = hash & (num_buckets - 1);
+            while (buckets[(bucket * 2) + 1] != SDL_SHADER_BYTECODE_NO_FUNCTION) {
+                bucket = (bucket + 1) & (num_buckets - 1);
+            }
+            buckets[(bucket * 2) + 0] = hash;
+            buckets[(bucket * 2) + 1] = i;
+        }
+    }
+}
+
+/* serializes the intermediate representation into the final bytecode. */
+static void write_bytecode(Context *ctx)
+{
+    IrFunction *irfn;
+    Uint32 *header;
+    Uint32 *words;
+    Uint32 num_functions, num_buckets, dirlen, types_start, fnid, i;
+
+    /* magic, version, crc32. */
+    header = wordbuffer_reserve(ctx, &ctx->bytecode, 5);
+    if (header == NULL) {
+        return;
+    }
+
+    /* DIRECTORY: we fill it in at the end. */
+    dirlen = directory_size(ctx, &num_functions, &num_buckets);
+    if (wordbuffer_reserve(ctx, &ctx->bytecode, dirlen) == NULL) {
+        return;
+    }
+
+    /* TYPES: tag, num_words, num_types, then the entries. */
+    for (irfn = ctx->ir_functions; irfn != NULL; irfn = irfn->next) {
+        add_function_types(ctx, irfn);
+    }
+    types_start = ctx->bytecode.len;
+    words = wordbuffer_reserve(ctx, &ctx->bytecode, 3 + ctx->bytecode_types.len);
+    if ((words == NULL) || ctx->out_of_memory) {
+        return;
+    }
+    words[0] = SDL_SHADER_BCTAG_TYPES;
+    words[1] = 3 + ctx->bytecode_types.len;
+    words[2] = ctx->bytecode_num_types;
+    if (ctx->bytecode_types.len > 0) {
+        SDL_memcpy(words + 3, ctx->bytecode_types.words, ctx->bytecode_types.len * sizeof (Uint32));
+    }
+    ctx->bytecode_crc32 = 0;
+    codegen_finish_section(ctx, types_start);
+
+    for (irfn = ctx->ir_functions, fnid = 0; irfn != NULL; irfn = irfn->next, fnid++) {
+        const Uint32 start = ctx->bytecode.len;
+        ir_renumber(ctx, irfn);  /* constants are numbered by their place in the pool, so make sure the ids are in order. */
+        ir_serialize(ctx, irfn, &ctx->bytecode);
+        if (ctx->out_of_memory) {
+            return;
+        }
+        ctx->bytecode.words[5 + 3 + fnid] = start * sizeof (Uint32);  /* its byte offset in the file, in the DIRECTORY. */
+        codegen_finish_section(ctx, start);
+    }
+
+    /* the directory comes first in the file but was finished last, so its CRC goes in front of everything else's. */
+    fill_directory(ctx, 5, dirlen, num_functions, num_buckets);
+    for (i = 0; i < dirlen; i++) {
+        ctx->bytecode.words[5 + i] = SDL_SwapLE32(ctx->bytecode.words[5 + i]);
+    }
+    ctx->bytecode_crc32 = SDL_SHADER_BytecodeCrc32Combine(SDL_SHADER_BytecodeCrc32(0, ctx->bytecode.words + 5, dirlen * sizeof (Uint32)), ctx->bytecode_crc32, (ctx->bytecode.len - types_start) * sizeof (Uint32));
+
+    header = ctx->bytecode.words;
+    SDL_memcpy(header, SDL_SHADER_BYTECODE_MAGIC, 12);  /* this includes the null terminator. */
+    header[3] = SDL_SwapLE32(SDL_SHADER_BYTECODE_VERSION);
+    header[4] = SDL_SwapLE32(ctx->bytecode_crc32);
+
+    ctx->compile_output = (Uint8 *) ctx->bytecode.words;
+    ctx->compile_output_len = ctx->bytecode.len * sizeof (Uint32);
+    SDL_zero(ctx->bytecode);  /* compile_output owns this now. */
 }
 
 static void datatypes_nuke(const void *key, const void *value, void *data)
@@ -1714,6 +5249,40 @@ void compiler_end(Context *ctx)
     }
 
     hash_destroy(ctx->datatypes);
+    if (ctx->constants) {
+        buffer_destroy(ctx->constants);
+    }
+
+    if (ctx->bytecode.words) {
+        Free(ctx, ctx->bytecode.words);
+    }
+    if (ctx->scratch.words) {
+        Free(ctx, ctx->scratch.words);
+    }
+    if (ctx->ssa_replacements.words) {
+        Free(ctx, ctx->ssa_replacements.words);
+    }
+    if (ctx->bytecode_types.words) {
+        Free(ctx, ctx->bytecode_types.words);
+    }
+    if (ctx->bytecode_type_ids) {
+        hash_destroy(ctx->bytecode_type_ids);
+    }
+    if (ctx->ir_arena) {
+        buffer_destroy(ctx->ir_arena);
+    }
+    if (ctx->optimization_stats) {
+        Free(ctx, ctx->optimization_stats);
+    }
+    if (ctx->var_values) {
+        Free(ctx, ctx->var_values);
+    }
+    if (ctx->var_dts) {
+        Free(ctx, ctx->var_dts);
+    }
+    if (ctx->compile_output) {
+        Free(ctx, ctx->compile_output);
+    }
 
     for (scope = ctx->scope_stack; scope != NULL; scope = scopenext) {
         scopenext = scope->next;
@@ -1730,7 +5299,7 @@ void compiler_end(Context *ctx)
 
 
 static const SDL_SHADER_CompileData SDL_SHADER_out_of_mem_data_compile = {
-    1, &SDL_SHADER_out_of_mem_error, NULL, NULL, 0, NULL, NULL, NULL
+    1, &SDL_SHADER_out_of_mem_error, NULL, NULL, 0, NULL, NULL, NULL, 0, NULL
 };
 
 static const SDL_SHADER_CompileData *build_compiledata(Context *ctx)
@@ -1764,6 +5333,10 @@ static const SDL_SHADER_CompileData *build_compiledata(Context *ctx)
         retval->output_len = ctx->compile_output_len;
         ctx->compile_output = NULL;  /* owned by retval now. Null out so we don't free it. */
         ctx->compile_output_len = 0;
+        retval->optimization_stats = ctx->optimization_stats;
+        retval->optimization_stats_count = ctx->optimization_stats_count;
+        ctx->optimization_stats = NULL;  /* owned by retval now, too. */
+        ctx->optimization_stats_count = 0;
     }
 
     return retval;
@@ -1787,17 +5360,40 @@ const SDL_SHADER_CompileData *SDL_SHADER_Compile(const SDL_SHADER_CompilerParams
         ctx->ast_before.type = ctx->ast_after.type = SDL_SHADER_AST_SHADER;
         ctx->ast_before.filename = ctx->ast_after.filename = stringcache(ctx->strcache, params->filename);
         ctx->ast_before.dt = ctx->ast_after.dt = NULL;
+        ctx->ast_before.constant = ctx->ast_after.constant = NULL;
         ctx->ast_before.line = SDL_SHADER_POSITION_BEFORE;
         ctx->ast_after.line = SDL_SHADER_POSITION_AFTER;
         ctx->datatypes = hash_create(ctx, hash_hash_string, hash_keymatch_datatypes, datatypes_nuke, SDL_FALSE, MallocContextBridge, FreeContextBridge, ctx);
         ctx->scope_stack = NULL;
         ctx->scope_pool = NULL;
+        ctx->unreachable_functions = params->unreachable_functions;
+        ctx->matrix_multiply = params->matrix_multiply;
+        ctx->optimization_level = params->optimization_level;
+        ctx->optimization_passes = params->optimization_passes;
+        ctx->fast_math = params->fast_math;
+        ctx->half_precision_tolerance = params->half_precision_tolerance;
     }
 
     if (!ctx->isfail) {
         semantic_analysis(ctx, params);
     }
 
+    if (!ctx->isfail) {
+        fold_constants(ctx);
+    }
+
+    if (!ctx->isfail) {
+        codegen(ctx);
+    }
+
+    if (!ctx->isfail) {
+        optimize(ctx);
+    }
+
+    if (!ctx->isfail) {
+        write_bytecode(ctx);
+    }
+
     retval = build_compiledata(ctx);
     SDL_assert(retval != NULL);  /* should never return NULL, even if out of memory! */
 
@@ -1823,6 +5419,7 @@ void SDL_SHADER_FreeCompileData(const SDL_SHADER_CompileData *_data)
 
         f((void *) data->errors, d);
         f((void *) data->output, d);
+        f((void *) data->optimization_stats, d);
         f(data, d);
     }
 }
@@ -186,6 +186,61 @@ typedef void (SDLCALL *SDL_SHADER_IncludeClose)(const char *data,
                             SDL_SHADER_Malloc m, SDL_SHADER_Free f, void *d);
 
 
+/*
+ * What to do with functions that can't be reached from any @vertex or
+ *  @fragment function. These never make it into the compiled output either
+ *  way, this just decides how much effort we spend looking for errors in them.
+ *  If a shader has no entry points at all, every function is analyzed.
+ */
+typedef enum SDL_SHADER_UnreachableFunctions
+{
+    SDL_SHADER_UNREACHABLE_ANALYZE,  /* check them just like everything else (the default). */
+    SDL_SHADER_UNREACHABLE_CHECK,    /* check their signatures, but not the code inside them. */
+    SDL_SHADER_UNREACHABLE_SKIP      /* don't look at them at all. */
+} SDL_SHADER_UnreachableFunctions;
+
+/* How codegen does `matrix * vector`, `vector * matrix` and `matrix * matrix`. */
+typedef enum SDL_SHADER_MatrixMultiply
+{
+    SDL_SHADER_MATRIX_MULTIPLY_NATIVE,  /* a MATMUL instruction (the default). */
+    SDL_SHADER_MATRIX_MULTIPLY_DOT,  /* a DOT of a row and a column for each element of the result. */
+    SDL_SHADER_MATRIX_MULTIPLY_MAD   /* each row of the result is a MULTIPLY and a chain of MADs of whole row vectors. */
+} SDL_SHADER_MatrixMultiply;
+
+/*
+ * Optimization passes the compiler can run on the code it generates. Each
+ *  one is a bit in SDL_SHADER_CompilerParams::optimization_passes, and each
+ *  only runs at or above a certain optimization_level.
+ */
+#define SDL_SHADER_OPTPASS_ALL 0  /* as optimization_passes: whatever the optimization level allows. */
+#define SDL_SHADER_OPTPASS_DCE (1u << 0)  /* remove code that doesn't affect the output, level 1. */
+#define SDL_SHADER_OPTPASS_GVN (1u << 1)  /* merge instructions that compute the same value, level 1. */
+#define SDL_SHADER_OPTPASS_INLINE (1u << 2)  /* replace calls to small functions with their code, level 2. */
+#define SDL_SHADER_OPTPASS_UNROLL (1u << 3)  /* unroll loops that run a constant number of times, level 2. */
+#define SDL_SHADER_OPTPASS_LICM (1u << 4)  /* move code that doesn't change inside a loop to before it, level 1. */
+#define SDL_SHADER_OPTPASS_PEEPHOLE (1u << 5)  /* simplify math (x*1, !(a<b), fusing multiply-add, etc), level 1. */
+#define SDL_SHADER_OPTPASS_SWIZZLE (1u << 6)  /* merge chains of swizzles and remove ones that change nothing, level 1. */
+#define SDL_SHADER_OPTPASS_NARROW (1u << 7)  /* only compute the vector lanes something reads, level 2. */
+#define SDL_SHADER_OPTPASS_IFCONVERT (1u << 8)  /* turn small IFs into SELECTs that run both sides, level 2. */
+#define SDL_SHADER_OPTPASS_HALF (1u << 9)  /* do float math in half precision where it stays within half_precision_tolerance, level 2. */
+
+/*
+ * Float math the optimizer may do even though it can change results. Each
+ *  one is a bit in SDL_SHADER_CompilerParams::fast_math. By default, float
+ *  results are exactly what the source code asks for. Functions with a
+ *  `@precise` attribute always get exact results, whatever these say.
+ */
+#define SDL_SHADER_FASTMATH_NONE 0
+#define SDL_SHADER_FASTMATH_REASSOCIATE (1u << 0)  /* algebra that's true for real numbers, if not always for floats: x+0.0 is x, (x+1.0)+2.0 is x+3.0... */
+#define SDL_SHADER_FASTMATH_RECIPROCAL (1u << 1)  /* approximate reciprocals: 1.0/sqrt(x) can be rsqrt(x). */
+#define SDL_SHADER_FASTMATH_NO_NANS (1u << 2)  /* assume nothing is NaN, so !(a < b) is a >= b and x == x is true. */
+#define SDL_SHADER_FASTMATH_NO_INFS (1u << 3)  /* assume nothing is infinite; with NO_NANS, x - x is zero. */
+#define SDL_SHADER_FASTMATH_CONTRACT (1u << 4)  /* a*b+c can become mad(a, b, c), which might not round in between. */
+#define SDL_SHADER_FASTMATH_ALL 0xFFFFFFFFu
+
+/* a half_precision_tolerance of about one step of an 8-bit color channel. */
+#define SDL_SHADER_HALF_TOLERANCE_COLOR (1.0f / 256.0f)
+
 /* there's too many options to a compiler, so now they all live in a struct
    so you don't call these APIs with 17 different parameters. */
 typedef struct SDL_SHADER_CompilerParams
@@ -207,6 +262,13 @@ typedef struct SDL_SHADER_CompilerParams
     SDL_SHADER_Malloc allocate;
     SDL_SHADER_Free deallocate;
     void *allocate_data;
+    int worker_threads;  /* 0 or 1 to analyze everything on the calling thread, > 1 for that many threads, < 0 for one per CPU core. */
+    SDL_SHADER_UnreachableFunctions unreachable_functions;  /* how much work to spend on functions no entry point uses. */
+    SDL_SHADER_MatrixMultiply matrix_multiply;  /* what instructions matrix multiplies turn into, for targets that prefer one or the other. */
+    int optimization_level;  /* 0 (the default) runs no optimization passes at all, 1 runs the cheap ones, 2 runs everything. */
+    Uint32 optimization_passes;  /* SDL_SHADER_OPTPASS_* flags for the passes that may run. SDL_SHADER_OPTPASS_ALL (zero) for no restrictions. */
+    Uint32 fast_math;  /* SDL_SHADER_FASTMATH_* flags for float shortcuts the optimizer may take. SDL_SHADER_FASTMATH_NONE (zero) for exact results. */
+    float half_precision_tolerance;  /* most any float value may change by if the optimizer does its math in half precision instead. 0.0 (the default) never does. */
 } SDL_SHADER_CompilerParams;
 
 
@@ -279,6 +341,16 @@ extern DECLSPEC void SDLCALL SDL_SHADER_FreePreprocessData(const SDL_SHADER_Prep
 
 /* Compiler interface... */
 
+/* What an optimization pass did, for people tuning the compiler. */
+typedef struct SDL_SHADER_OptimizationStats
+{
+    const char *pass;  /* the pass's name, like "dce". This is static data, don't free it. */
+    Uint64 nanoseconds;  /* time spent in this pass, across every function. */
+    SDL_bool changed;  /* SDL_TRUE if the pass changed anything at all. */
+    Uint32 instructions_before;  /* instructions in every function before this pass ran... */
+    Uint32 instructions_after;  /* ...and after. */
+} SDL_SHADER_OptimizationStats;
+
 /* Structure used to return data from parsing of a shader... */
 typedef struct SDL_SHADER_CompileData
 {
@@ -324,6 +396,18 @@ typedef struct SDL_SHADER_CompileData
      * This is the pointer you passed as opaque data for your allocator.
      */
     void *malloc_data;
+
+    /*
+     * The number of elements pointed to by (optimization_stats).
+     */
+    size_t optimization_stats_count;
+
+    /*
+     * (optimization_stats_count) elements, one for each optimization pass
+     *  that ran, in the order they ran. Passes that weren't enabled (and
+     *  everything at optimization level 0) aren't listed.
+     */
+    const SDL_SHADER_OptimizationStats *optimization_stats;
 } SDL_SHADER_CompileData;
 
 
@@ -355,6 +439,18 @@ typedef struct SDL_SHADER_CompileData
  *  behaviour for #include statements. Both are optional and can be NULL, but
  *  both must be specified if either is specified.
  *
+ * (worker_threads) lets the compiler analyze function bodies in parallel,
+ *  which helps with shaders that have hundreds of functions. Zero (the
+ *  default) does all the work on the calling thread. If you ask for worker
+ *  threads, your allocator must be thread safe. The results, including the
+ *  order of any errors, are the same either way.
+ *
+ * (optimization_level) decides how hard we try to make the output smaller
+ *  and faster. Level 0 skips optimization entirely, which is the best choice
+ *  when compiling at runtime and latency matters more than the output.
+ *  Offline builds should use level 2. (optimization_passes) can turn off
+ *  individual passes, if you're hunting down a problem in one.
+ *
  * This will return a SDL_SHADER_CompileData.
  *  When you are done with this data, pass it to SDL_SHADER_FreeCompileData()
  *  to deallocate resources.
@@ -18,6 +18,7 @@
 
 #include "SDL_shader_compiler.h"
 #include "SDL_shader_ast.h"
+#include "SDL_shader_bytecode.h"
 
 #define DEBUG_LEXER 0
 #define DEBUG_PREPROCESSOR 0
@@ -113,6 +114,7 @@ SDL_bool errorlist_add(ErrorList *list, const SDL_bool is_error, const char *fna
 SDL_bool errorlist_add_fmt(ErrorList *list, const SDL_bool is_error, const char *fname, const Sint32 errpos, SDL_PRINTF_FORMAT_STRING const char *fmt, ...) SDL_PRINTF_VARARG_FUNC(5);
 SDL_bool errorlist_add_va(ErrorList *list, const SDL_bool is_error, const char *_fname, const Sint32 errpos, SDL_PRINTF_FORMAT_STRING const char *fmt, va_list va);
 size_t errorlist_count(ErrorList *list);
+void errorlist_splice(ErrorList *dst, ErrorList *src);  // moves everything in src to the end of dst. Must share an allocator!
 SDL_SHADER_Error *errorlist_flatten(ErrorList *list); // resets the list!
 void errorlist_destroy(ErrorList *list);
 
@@ -319,6 +321,129 @@ struct SDL_SHADER_AstDataType
     } info;
 };
 
+/* Intrinsic functions (sin, dot, etc). These are a static table, never allocated. */
+
+typedef SDL_SHADER_AstIntrinsic Intrinsic;
+
+typedef enum IntrinsicRule
+{
+    INTRINSIC_RULE_FLOAT,          /* args are all the same half/float scalar or vector; returns that type. */
+    INTRINSIC_RULE_NUMBER,         /* args are all the same int/uint/half/float scalar or vector; returns that type. */
+    INTRINSIC_RULE_FLOAT_TO_SCALAR, /* args are all the same half/float scalar or vector; returns the scalar type. */
+    INTRINSIC_RULE_FLOAT3,         /* args are all the same half3 or float3; returns that type. */
+    INTRINSIC_RULE_BOOL_REDUCE,    /* one bool scalar or vector; returns bool. */
+    INTRINSIC_RULE_REFRACT,        /* two of the same half/float vector, then a scalar of the same component type; returns the vector type. */
+    INTRINSIC_RULE_LDEXP,          /* a half/float scalar or vector, then an int scalar or vector of the same size; returns the first type. */
+    INTRINSIC_RULE_TRANSPOSE       /* one matrix; returns the transposed matrix type. */
+} IntrinsicRule;
+
+struct SDL_SHADER_AstIntrinsic
+{
+    const char *name;
+    SDL_SHADER_BytecodeTag opcode;
+    Uint32 num_args;
+    IntrinsicRule rule;
+};
+
+
+/* Values that semantic analysis worked out at compile time. Scalars, vectors
+   and matrices only; a matrix's components are stored one child vector after
+   another. Bools are stored as 0 or 1 in `u`. Half values are never folded. */
+
+typedef SDL_SHADER_AstConstant Constant;
+
+typedef union ConstantValue
+{
+    Sint32 i;
+    Uint32 u;
+    float f;
+} ConstantValue;
+
+struct SDL_SHADER_AstConstant
+{
+    const DataType *dt;
+    Uint32 num_components;
+    ConstantValue value[16];  /* enough for a 4x4 matrix. */
+};
+
+/* Code generation... */
+
+typedef struct WordBuffer  /* a growable array of Uint32s that we can patch in place, unlike Buffer. */
+{
+    Uint32 *words;
+    Uint32 len;  /* in words, not bytes. */
+    Uint32 allocated;  /* in words, not bytes. */
+} WordBuffer;
+
+struct CodegenLoop;
+
+/* Intermediate representation...
+
+   Code generation turns the AST into this, optimization passes work on it, and then it's
+   serialized as bytecode. It's SSA, structured the same way the bytecode is: an IF owns two
+   blocks of instructions (the code for true, then for false), a LOOP owns one, and there are no
+   gotos. Instruction operands are laid out exactly like the bytecode's (see
+   docs/README-bytecode-format.md), minus the opcode and num_words, so SSA ids are just operand
+   words, and every instruction that defines one is listed in its function's `defs`. Everything
+   is allocated from ctx->ir_arena and freed all at once when the compile is done. */
+
+typedef struct IrInstruction IrInstruction;
+
+typedef struct IrBlock
+{
+    IrInstruction *first;
+    IrInstruction *last;
+    IrInstruction *owner;  /* the IF or LOOP this block belongs to, NULL for a function's body. */
+} IrBlock;
+
+typedef struct IrUse
+{
+    IrInstruction *user;
+    Uint32 operand;  /* index into user->operands. */
+    struct IrUse *next;
+} IrUse;
+
+struct IrInstruction
+{
+    SDL_SHADER_BytecodeTag opcode;
+    Uint32 num_operands;
+    Uint32 *operands;  /* IF's second operand (the size of its true code) is only filled in when serialized. */
+    IrBlock *block;  /* the block this instruction is in. */
+    IrBlock *children;  /* IF has two (true, then false), LOOP has one, anything else has none. */
+    IrInstruction *prev;
+    IrInstruction *next;
+    IrUse *uses;  /* every operand that reads this instruction's output, after ir_build_uses(). */
+    IrInstruction *idom;  /* immediate dominator, after ir_build_dominators(). NULL for the function's first instruction. */
+    Uint32 order;  /* position in the function, after ir_build_dominators(). */
+    Uint32 dominates_until;  /* after ir_build_dominators(), this dominates every instruction whose `order` is between its own and this. */
+    Uint32 mark;  /* optimization passes can use this however they like. It's garbage when a pass starts. */
+    const DataType *dt;  /* datatype of its output, NULL if codegen didn't say. Constants never have one; see ir_datatype(). */
+};
+
+typedef struct IrFunction
+{
+    const char *name;  /* NULL if it isn't exported. */
+    SDL_SHADER_BytecodeFunctionType fntype;
+    Uint32 num_params;  /* parameters are SSA ids 1 through num_params, and have no defining instruction. */
+    const DataType **param_dts;  /* datatype of each parameter; [0] is SSA id 1. */
+    SDL_bool returns_value;
+    const DataType *return_dt;  /* NULL if it doesn't return a value. */
+    Uint32 fast_math;  /* SDL_SHADER_FASTMATH_* shortcuts the optimizer may take in this function; none if it's @precise. */
+    float half_tolerance;  /* how far off the optimizer may let float values get by doing their math in half precision; zero if it's @precise. */
+    IrBlock body;
+    IrBlock constants;  /* the constant pool: LITERAL* instructions, one per distinct value, defined before any code. */
+    IrInstruction **constant_hash;  /* finds constants by value; see ir_find_constant(). */
+    Uint32 constant_hash_size;  /* a power of two, or zero. */
+    Uint32 num_constants;
+    IrInstruction **defs;  /* indexed by SSA id, after ir_build_uses(). NULL for parameters and unused ids. */
+    Uint32 num_ids;  /* ids run from 1 to num_ids-1; 0 means "none". */
+    Uint32 allocated_ids;  /* size of `defs`. */
+    IrUse *free_uses;  /* IrUses that were removed, to reuse. */
+    Uint32 index;  /* CALL refers to functions by this. */
+    SDL_bool has_side_effects;  /* SDL_TRUE if calling this can DISCARD, so the CALL has to stay even if nothing uses its result. */
+    struct IrFunction *next;
+} IrFunction;
+
 typedef struct ScopeItem
 {
     SDL_SHADER_AstNode *ast;
@@ -382,6 +507,35 @@ typedef struct Context
     SDL_bool reported_undefined;
     const char *undefined_identifiers[16];
     size_t num_undefined_identifiers;
+    SDL_SHADER_UnreachableFunctions unreachable_functions;
+    SDL_SHADER_MatrixMultiply matrix_multiply;
+    SDL_mutex *datatypes_lock;  /* only non-NULL while worker threads are analyzing functions. Guards `datatypes` and `strcache`. */
+    Buffer *constants;  /* the Constants that AST nodes point to are allocated from here. */
+    WordBuffer bytecode;  /* code generation writes the final output here. */
+    WordBuffer scratch;  /* code generation's working space (snapshots of variable values at branches, etc). */
+    Uint32 *var_values;  /* the SSA id that currently holds each variable's value, indexed by vardecl->varindex. */
+    const DataType **var_dts;  /* each variable's datatype, indexed by vardecl->varindex, so PHIs of constants still know their type. */
+    Uint32 num_vars;  /* number of variables (and function parameters) in the function being generated. */
+    Uint32 next_ssa;  /* next unused SSA id in the function being generated. */
+    WordBuffer ssa_replacements;  /* indexed by SSA id: what a PHI that turned out to be unnecessary was replaced with, zero if it wasn't. */
+    SDL_SHADER_AstFunction *codegen_function;  /* function being generated. */
+    struct CodegenLoop *codegen_loop;  /* innermost loop being generated, NULL if none. */
+    WordBuffer bytecode_types;  /* entries of the TYPES section, added as bytecode_type_id() finds new types. */
+    Uint32 bytecode_num_types;
+    HashTable *bytecode_type_ids;  /* datatype name -> its id in bytecode_types. */
+    Uint32 bytecode_crc32;  /* running CRC-32 of finished sections in `bytecode` (not counting the directory). */
+    Buffer *ir_arena;  /* everything in the intermediate representation is allocated from here. */
+    IrFunction *ir_functions;  /* every function we're generating code for, in order. */
+    IrFunction *ir_last_function;  /* so we can append to ir_functions. */
+    IrFunction **ir_function_table;  /* ir_functions, indexed by IrFunction::index. */
+    Uint32 ir_num_functions;
+    IrBlock *codegen_block;  /* code generation appends instructions here. */
+    int optimization_level;
+    Uint32 optimization_passes;  /* SDL_SHADER_OPTPASS_* flags, or SDL_SHADER_OPTPASS_ALL. */
+    Uint32 fast_math;  /* SDL_SHADER_FASTMATH_* flags. */
+    float half_precision_tolerance;
+    SDL_SHADER_OptimizationStats *optimization_stats;
+    size_t optimization_stats_count;
 
 #if 0 /* !!! FIXME, compiler code isn't built into the project yet! */
     SymbolMap variables;
@@ -409,6 +563,44 @@ const char *preprocessor_nexttoken(Context *ctx, size_t *_len, Token *_token);
 void ast_end(Context *ctx);
 void compiler_end(Context *ctx);
 
+/* grows a WordBuffer by `count` words, returns a pointer to the first new one. NULL if out of memory. */
+Uint32 *wordbuffer_reserve(Context *ctx, WordBuffer *buffer, const Uint32 count);
+
+/* Intermediate representation (see SDL_shader_ir.c). */
+void *ir_alloc(Context *ctx, const size_t len);  /* zeroed, from ctx->ir_arena. Never freed on its own. */
+IrFunction *ir_function_create(Context *ctx, const char *name, const SDL_SHADER_BytecodeFunctionType fntype, const Uint32 num_params, const SDL_bool returns_value);
+IrFunction *ir_function_at(Context *ctx, const Uint32 index);  /* NULL if there isn't one. */
+SDL_bool ir_remove_uncalled_functions(Context *ctx);  /* drops functions no entry point can reach, renumbering CALLs. */
+IrInstruction *ir_instruction_create(Context *ctx, const SDL_SHADER_BytecodeTag opcode, const Uint32 num_operands);
+IrInstruction *ir_find_constant(const IrFunction *fn, const SDL_SHADER_BytecodeTag opcode, const Uint32 *values);  /* NULL if it's not in the pool. */
+SDL_bool ir_add_constant(Context *ctx, IrFunction *fn, IrInstruction *insn);  /* adds a LITERAL* instruction to the pool; its output id is up to the caller. */
+Uint32 ir_constant(Context *ctx, IrFunction *fn, const SDL_SHADER_BytecodeTag opcode, const Uint32 *values);  /* SSA id of a constant, adding it to the pool if needed. */
+SDL_bool ir_remove_unused_constants(IrFunction *fn);  /* the only way constants should leave the pool. */
+void ir_insert_before(IrBlock *block, IrInstruction *before, IrInstruction *insn);  /* `before` == NULL appends to the block. */
+void ir_unlink(IrInstruction *insn);  /* takes it out of its block, without touching use lists. */
+void ir_remove(IrFunction *fn, IrInstruction *insn);  /* takes it (and any code it owns) out of the function, fixing up use lists. */
+Uint32 ir_num_children(const IrInstruction *insn);
+IrInstruction *ir_walk(const IrInstruction *insn);  /* next instruction in order, stepping into IF and LOOP code. */
+Uint32 ir_output(const IrInstruction *insn);  /* SSA id this defines, 0 if none. */
+Uint32 ir_output_operand(const IrInstruction *insn);  /* which operand ir_output() comes from, num_operands if none. */
+const DataType *ir_datatype(const IrFunction *fn, const Uint32 id);  /* NULL if we don't know (constants, for one). */
+void ir_inputs(const IrInstruction *insn, Uint32 *first, Uint32 *end);  /* range of operands that are SSA ids it reads (some may be 0, meaning none). */
+Uint32 ir_new_id(Context *ctx, IrFunction *fn);
+SDL_bool ir_build_uses(Context *ctx, IrFunction *fn);
+void ir_set_input(Context *ctx, IrFunction *fn, IrInstruction *insn, const Uint32 operand, const Uint32 id);
+void ir_replace_uses(Context *ctx, IrFunction *fn, const Uint32 id, const Uint32 replacement);
+void ir_renumber(Context *ctx, IrFunction *fn);
+void ir_build_dominators(IrFunction *fn);
+SDL_bool ir_dominates(const IrInstruction *a, const IrInstruction *b);
+void ir_serialize(Context *ctx, const IrFunction *fn, WordBuffer *output);  /* every type it uses must already be in the type table. */
+Uint32 ir_count_instructions(const IrFunction *fn);
+
+/* The bytecode's type table (see SDL_shader_compiler.c). */
+Uint32 bytecode_type_id(Context *ctx, const DataType *dt);  /* adds it to the table if needed. 0 for NULL or void. */
+
+/* Optimization (see SDL_shader_optimizer.c). */
+void optimize(Context *ctx);
+
 Context *parse_to_ast(const SDL_SHADER_CompilerParams *params);
 
 
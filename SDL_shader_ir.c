@@ -0,0 +1,852 @@
+/**
+ * SDL_shader_tools; tools for SDL GPU shader support.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+#define __SDL_SHADER_INTERNAL__ 1
+#include "SDL_shader_internal.h"
+
+/* The intermediate representation lives between code generation and the
+   bytecode writer, so optimization passes have something better to work on
+   than the AST or a pile of serialized words. See SDL_shader_internal.h for
+   what the pieces look like. Nothing here is freed on its own: it all comes
+   from ctx->ir_arena, which goes away at the end of the compile. */
+
+void *ir_alloc(Context *ctx, const size_t len)
+{
+    /* every reservation is a multiple of the pointer size, so these all stay aligned. */
+    const size_t aligned = (len + (sizeof (void *) - 1)) & ~(sizeof (void *) - 1);
+    void *retval;
+
+    if (ctx->ir_arena == NULL) {
+        ctx->ir_arena = buffer_create(64 * 1024, MallocContextBridge, FreeContextBridge, ctx);
+        if (ctx->ir_arena == NULL) {
+            return NULL;  /* will have set the out_of_memory flag. */
+        }
+    }
+
+    retval = (aligned > 0) ? buffer_reserve(ctx->ir_arena, aligned) : NULL;
+    if (retval) {
+        SDL_memset(retval, '\0', aligned);
+    }
+    return retval;
+}
+
+IrFunction *ir_function_create(Context *ctx, const char *name, const SDL_SHADER_BytecodeFunctionType fntype, const Uint32 num_params, const SDL_bool returns_value)
+{
+    IrFunction *fn = (IrFunction *) ir_alloc(ctx, sizeof (IrFunction));
+    if (fn == NULL) {
+        return NULL;
+    }
+
+    fn->name = name;
+    fn->fntype = fntype;
+    fn->num_params = num_params;
+    fn->returns_value = returns_value;
+    fn->num_ids = num_params + 1;
+    fn->index = ctx->ir_num_functions;
+
+    /* the table only ever grows, so it doubles in size whenever the count is a power of two. */
+    if ((ctx->ir_num_functions & (ctx->ir_num_functions - 1)) == 0) {
+        const Uint32 allocated = ctx->ir_num_functions ? ctx->ir_num_functions * 2 : 1;
+        IrFunction **table = (IrFunction **) ir_alloc(ctx, allocated * sizeof (IrFunction *));
+        if (table == NULL) {
+            return NULL;
+        } else if (ctx->ir_function_table) {
+            SDL_memcpy(table, ctx->ir_function_table, ctx->ir_num_functions * sizeof (IrFunction *));
+        }
+        ctx->ir_function_table = table;
+    }
+    ctx->ir_function_table[ctx->ir_num_functions++] = fn;
+
+    if (ctx->ir_last_function) {
+        ctx->ir_last_function->next = fn;
+    } else {
+        ctx->ir_functions = fn;
+    }
+    ctx->ir_last_function = fn;
+
+    return fn;
+}
+
+IrFunction *ir_function_at(Context *ctx, const Uint32 index)
+{
+    return (index < ctx->ir_num_functions) ? ctx->ir_function_table[index] : NULL;
+}
+
+/* Drops functions that no entry point can reach (after inlining, say), and
+   renumbers the CALLs to the ones that are left. If there are no entry
+   points, everything stays, the same as when we decided what to generate. */
+SDL_bool ir_remove_uncalled_functions(Context *ctx)
+{
+    const Uint32 total = ctx->ir_num_functions;
+    Uint32 *newindex = (Uint32 *) ir_alloc(ctx, (total + 1) * sizeof (Uint32));
+    IrFunction **worklist = (IrFunction **) ir_alloc(ctx, (total + 1) * sizeof (IrFunction *));
+    Uint32 worklist_len = 0;
+    IrFunction *fn;
+    IrFunction *prev = NULL;
+    IrInstruction *insn;
+    Uint32 count = 0;
+    Uint32 i;
+
+    if ((newindex == NULL) || (worklist == NULL)) {
+        return SDL_FALSE;
+    }
+
+    /* newindex[] is 1 for reachable functions until we know their new index. */
+    for (i = 0; i < total; i++) {
+        fn = ctx->ir_function_table[i];
+        if (fn->fntype != SDL_SHADER_BCFNTYPE_NORMAL) {
+            newindex[i] = 1;
+            worklist[worklist_len++] = fn;
+        }
+    }
+
+    if (worklist_len == 0) {
+        return SDL_FALSE;
+    }
+
+    while (worklist_len > 0) {
+        fn = worklist[--worklist_len];
+        for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+            if ((insn->opcode == SDL_SHADER_BCTAG_OP_CALL) && (insn->operands[0] < total) && !newindex[insn->operands[0]]) {
+                newindex[insn->operands[0]] = 1;
+                worklist[worklist_len++] = ctx->ir_function_table[insn->operands[0]];
+            }
+        }
+    }
+
+    for (i = 0; i < total; i++) {
+        if (newindex[i]) {
+            newindex[i] = count++;
+        } else {
+            newindex[i] = total;  /* gone. */
+        }
+    }
+
+    if (count == total) {
+        return SDL_FALSE;
+    }
+
+    ctx->ir_functions = NULL;
+    for (i = 0; i < total; i++) {
+        fn = ctx->ir_function_table[i];
+        if (newindex[i] < total) {
+            fn->index = newindex[i];
+            fn->next = NULL;
+            ctx->ir_function_table[fn->index] = fn;  /* never moves a function forward, so this is safe. */
+            if (prev) {
+                prev->next = fn;
+            } else {
+                ctx->ir_functions = fn;
+            }
+            prev = fn;
+        }
+    }
+    ctx->ir_last_function = prev;
+    ctx->ir_num_functions = count;
+
+    for (fn = ctx->ir_functions; fn != NULL; fn = fn->next) {
+        for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+            if ((insn->opcode == SDL_SHADER_BCTAG_OP_CALL) && (insn->operands[0] < total)) {
+                insn->operands[0] = newindex[insn->operands[0]];
+            }
+        }
+    }
+
+    return SDL_TRUE;
+}
+
+/* The constant pool...
+
+   Literals don't go in a function's code; each distinct value is defined
+   once, in the function's constant pool, and everything that wants that value
+   reads the same SSA id. A little hash table (open addressing, in the arena)
+   finds an existing constant by value, since shaders tend to use `0.0` and
+   `1.0` all over the place. */
+
+static Uint32 ir_hash_constant(const SDL_SHADER_BytecodeTag opcode, const Uint32 *values, const Uint32 num_values)
+{
+    Uint32 hash = 5381 ^ (Uint32) opcode;
+    Uint32 i;
+    for (i = 0; i < num_values; i++) {
+        hash = ((hash << 5) + hash) ^ values[i];
+    }
+    return hash;
+}
+
+static Uint32 ir_constant_num_values(const SDL_SHADER_BytecodeTag opcode)
+{
+    return ((opcode == SDL_SHADER_BCTAG_OP_LITERALINT4) || (opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT4)) ? 4 : 1;
+}
+
+static void ir_hash_insert_constant(IrFunction *fn, IrInstruction *insn)
+{
+    const Uint32 mask = fn->constant_hash_size - 1;
+    Uint32 i = ir_hash_constant(insn->opcode, insn->operands + 1, insn->num_operands - 1) & mask;
+    while (fn->constant_hash[i] != NULL) {
+        i = (i + 1) & mask;
+    }
+    fn->constant_hash[i] = insn;
+}
+
+static void ir_rehash_constants(IrFunction *fn)
+{
+    IrInstruction *insn;
+    SDL_memset(fn->constant_hash, '\0', fn->constant_hash_size * sizeof (IrInstruction *));
+    for (insn = fn->constants.first; insn != NULL; insn = insn->next) {
+        ir_hash_insert_constant(fn, insn);
+    }
+}
+
+IrInstruction *ir_find_constant(const IrFunction *fn, const SDL_SHADER_BytecodeTag opcode, const Uint32 *values)
+{
+    const Uint32 num_values = ir_constant_num_values(opcode);
+    const Uint32 mask = fn->constant_hash_size - 1;
+    Uint32 i;
+
+    if (fn->constant_hash_size == 0) {
+        return NULL;
+    }
+
+    for (i = ir_hash_constant(opcode, values, num_values) & mask; fn->constant_hash[i] != NULL; i = (i + 1) & mask) {
+        IrInstruction *insn = fn->constant_hash[i];
+        if ((insn->opcode == opcode) && (SDL_memcmp(insn->operands + 1, values, num_values * sizeof (Uint32)) == 0)) {
+            return insn;
+        }
+    }
+    return NULL;
+}
+
+SDL_bool ir_add_constant(Context *ctx, IrFunction *fn, IrInstruction *insn)
+{
+    /* keep the table no more than half full, so probing stays short. */
+    if (((fn->num_constants + 1) * 2) > fn->constant_hash_size) {
+        const Uint32 size = fn->constant_hash_size ? fn->constant_hash_size * 2 : 64;
+        IrInstruction **table = (IrInstruction **) ir_alloc(ctx, size * sizeof (IrInstruction *));
+        if (table == NULL) {
+            return SDL_FALSE;
+        }
+        fn->constant_hash = table;
+        fn->constant_hash_size = size;
+        ir_rehash_constants(fn);
+    }
+
+    ir_insert_before(&fn->constants, NULL, insn);
+    ir_hash_insert_constant(fn, insn);
+    fn->num_constants++;
+    return SDL_TRUE;
+}
+
+Uint32 ir_constant(Context *ctx, IrFunction *fn, const SDL_SHADER_BytecodeTag opcode, const Uint32 *values)
+{
+    const Uint32 num_values = ir_constant_num_values(opcode);
+    IrInstruction *insn = ir_find_constant(fn, opcode, values);
+    Uint32 id;
+
+    if (insn) {
+        return insn->operands[0];
+    } else if ((id = ir_new_id(ctx, fn)) == 0) {
+        return 0;
+    } else if ((insn = ir_instruction_create(ctx, opcode, num_values + 1)) == NULL) {
+        return 0;
+    }
+
+    insn->operands[0] = id;
+    SDL_memcpy(insn->operands + 1, values, num_values * sizeof (Uint32));
+    if (!ir_add_constant(ctx, fn, insn)) {
+        return 0;
+    }
+    fn->defs[id] = insn;
+    return id;
+}
+
+SDL_bool ir_remove_unused_constants(IrFunction *fn)
+{
+    SDL_bool changed = SDL_FALSE;
+    IrInstruction *insn = fn->constants.first;
+
+    while (insn != NULL) {
+        IrInstruction *next = insn->next;
+        if (insn->uses == NULL) {
+            ir_remove(fn, insn);
+            fn->num_constants--;
+            changed = SDL_TRUE;
+        }
+        insn = next;
+    }
+
+    if (changed) {
+        ir_rehash_constants(fn);
+    }
+
+    return changed;
+}
+
+Uint32 ir_num_children(const IrInstruction *insn)
+{
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_IF: return 2;
+        case SDL_SHADER_BCTAG_OP_LOOP: return 1;
+        default: break;
+    }
+    return 0;
+}
+
+IrInstruction *ir_instruction_create(Context *ctx, const SDL_SHADER_BytecodeTag opcode, const Uint32 num_operands)
+{
+    IrInstruction *insn = (IrInstruction *) ir_alloc(ctx, sizeof (IrInstruction));
+    Uint32 i;
+
+    if (insn == NULL) {
+        return NULL;
+    }
+
+    insn->opcode = opcode;
+    insn->num_operands = num_operands;
+    if (num_operands > 0) {
+        insn->operands = (Uint32 *) ir_alloc(ctx, num_operands * sizeof (Uint32));
+        if (insn->operands == NULL) {
+            return NULL;
+        }
+    }
+
+    if (ir_num_children(insn) > 0) {
+        insn->children = (IrBlock *) ir_alloc(ctx, ir_num_children(insn) * sizeof (IrBlock));
+        if (insn->children == NULL) {
+            return NULL;
+        }
+        for (i = 0; i < ir_num_children(insn); i++) {
+            insn->children[i].owner = insn;
+        }
+    }
+
+    return insn;
+}
+
+void ir_insert_before(IrBlock *block, IrInstruction *before, IrInstruction *insn)
+{
+    insn->block = block;
+    insn->next = before;
+    insn->prev = before ? before->prev : block->last;
+
+    if (insn->prev) {
+        insn->prev->next = insn;
+    } else {
+        block->first = insn;
+    }
+
+    if (before) {
+        before->prev = insn;
+    } else {
+        block->last = insn;
+    }
+}
+
+void ir_unlink(IrInstruction *insn)
+{
+    IrBlock *block = insn->block;
+
+    if (insn->prev) {
+        insn->prev->next = insn->next;
+    } else {
+        block->first = insn->next;
+    }
+
+    if (insn->next) {
+        insn->next->prev = insn->prev;
+    } else {
+        block->last = insn->prev;
+    }
+
+    insn->prev = insn->next = NULL;
+}
+
+IrInstruction *ir_walk(const IrInstruction *insn)
+{
+    const IrBlock *block;
+    Uint32 i;
+
+    for (i = 0; i < ir_num_children(insn); i++) {
+        if (insn->children[i].first) {
+            return insn->children[i].first;
+        }
+    }
+
+    while (insn) {
+        if (insn->next) {
+            return insn->next;
+        }
+
+        /* end of a block: go on to the next block its owner has, or past the owner. */
+        block = insn->block;
+        insn = block->owner;
+        if (insn) {
+            for (i = (Uint32) (block - insn->children) + 1; i < ir_num_children(insn); i++) {
+                if (insn->children[i].first) {
+                    return insn->children[i].first;
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* like ir_walk(), but starting with the constant pool, so it sees everything that defines an id. Pass NULL to start. */
+static IrInstruction *ir_walk_function(const IrFunction *fn, const IrInstruction *insn)
+{
+    if (insn == NULL) {
+        return fn->constants.first ? fn->constants.first : fn->body.first;
+    } else if (insn->block == &fn->constants) {
+        return insn->next ? insn->next : fn->body.first;
+    }
+    return ir_walk(insn);
+}
+
+/* SDL_TRUE if `opcode` has an output operand, even if it's zero (a CALL whose result isn't used, say). */
+static SDL_bool ir_has_output_operand(const SDL_SHADER_BytecodeTag opcode)
+{
+    switch (opcode) {
+        case SDL_SHADER_BCTAG_OP_NOP:
+        case SDL_SHADER_BCTAG_OP_DISCARD:
+        case SDL_SHADER_BCTAG_OP_BREAK:
+        case SDL_SHADER_BCTAG_OP_CONTINUE:
+        case SDL_SHADER_BCTAG_OP_LOOP:
+        case SDL_SHADER_BCTAG_OP_IF:
+        case SDL_SHADER_BCTAG_OP_RETURN:
+            return SDL_FALSE;
+        default: break;
+    }
+    return SDL_TRUE;
+}
+
+Uint32 ir_output(const IrInstruction *insn)
+{
+    if (!ir_has_output_operand(insn->opcode)) {
+        return 0;
+    } else if (insn->opcode == SDL_SHADER_BCTAG_OP_CALL) {
+        return (insn->num_operands > 1) ? insn->operands[1] : 0;
+    }
+    return (insn->num_operands > 0) ? insn->operands[0] : 0;
+}
+
+/* which operand holds the output, or num_operands if none. */
+Uint32 ir_output_operand(const IrInstruction *insn)
+{
+    if (ir_output(insn) == 0) {
+        return insn->num_operands;
+    }
+    return (insn->opcode == SDL_SHADER_BCTAG_OP_CALL) ? 1 : 0;
+}
+
+/* literals are shared by every type with the same bits (an int 1 and a bool true, say), so they don't have one. */
+const DataType *ir_datatype(const IrFunction *fn, const Uint32 id)
+{
+    const IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+    if ((id >= 1) && (id <= fn->num_params)) {
+        return fn->param_dts ? fn->param_dts[id - 1] : NULL;
+    }
+    return def ? def->dt : NULL;
+}
+
+void ir_inputs(const IrInstruction *insn, Uint32 *first, Uint32 *end)
+{
+    *first = 1;
+    *end = insn->num_operands;
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_NOP:
+        case SDL_SHADER_BCTAG_OP_DISCARD:
+        case SDL_SHADER_BCTAG_OP_BREAK:
+        case SDL_SHADER_BCTAG_OP_CONTINUE:
+        case SDL_SHADER_BCTAG_OP_LOOP:
+        case SDL_SHADER_BCTAG_OP_LITERALINT:
+        case SDL_SHADER_BCTAG_OP_LITERALINT4:
+        case SDL_SHADER_BCTAG_OP_LITERALFLOAT:
+        case SDL_SHADER_BCTAG_OP_LITERALFLOAT4:
+            *first = *end = 0;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_IF:
+        case SDL_SHADER_BCTAG_OP_RETURN:
+            *first = 0;
+            *end = 1;
+            break;
+
+        case SDL_SHADER_BCTAG_OP_CALL:
+        case SDL_SHADER_BCTAG_OP_CONSTRUCT:
+        case SDL_SHADER_BCTAG_OP_CONVERT:
+            *first = 2;  /* skip the function index or type word, and the output. */
+            break;
+
+        case SDL_SHADER_BCTAG_OP_SWIZZLE:
+            *end = 2;  /* skip the lanes. */
+            break;
+
+        default: break;
+    }
+
+    if (*end > insn->num_operands) {
+        *end = insn->num_operands;
+    }
+    if (*first > *end) {
+        *first = *end;
+    }
+}
+
+static SDL_bool ir_reserve_ids(Context *ctx, IrFunction *fn, const Uint32 count)
+{
+    if (count > fn->allocated_ids) {
+        Uint32 allocated = fn->allocated_ids ? fn->allocated_ids : 64;
+        IrInstruction **defs;
+        while (allocated < count) {
+            allocated *= 2;
+        }
+        defs = (IrInstruction **) ir_alloc(ctx, allocated * sizeof (IrInstruction *));
+        if (defs == NULL) {
+            return SDL_FALSE;
+        } else if (fn->defs) {
+            SDL_memcpy(defs, fn->defs, fn->allocated_ids * sizeof (IrInstruction *));
+        }
+        fn->defs = defs;
+        fn->allocated_ids = allocated;
+    }
+    return SDL_TRUE;
+}
+
+Uint32 ir_new_id(Context *ctx, IrFunction *fn)
+{
+    if (!ir_reserve_ids(ctx, fn, fn->num_ids + 1)) {
+        return 0;
+    }
+    fn->defs[fn->num_ids] = NULL;  /* might be left over from before the last ir_renumber(). */
+    return fn->num_ids++;
+}
+
+static void ir_add_use(Context *ctx, IrFunction *fn, IrInstruction *insn, const Uint32 operand)
+{
+    const Uint32 id = insn->operands[operand];
+    IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+    IrUse *use;
+
+    if (def == NULL) {
+        return;  /* nothing, or a function parameter. */
+    } else if (fn->free_uses) {
+        use = fn->free_uses;
+        fn->free_uses = use->next;
+    } else if ((use = (IrUse *) ir_alloc(ctx, sizeof (IrUse))) == NULL) {
+        return;
+    }
+
+    use->user = insn;
+    use->operand = operand;
+    use->next = def->uses;
+    def->uses = use;
+}
+
+static void ir_drop_use(IrFunction *fn, IrInstruction *insn, const Uint32 operand)
+{
+    const Uint32 id = insn->operands[operand];
+    IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+    IrUse **prev;
+
+    if (def == NULL) {
+        return;
+    }
+
+    for (prev = &def->uses; *prev != NULL; prev = &(*prev)->next) {
+        IrUse *use = *prev;
+        if ((use->user == insn) && (use->operand == operand)) {
+            *prev = use->next;
+            use->next = fn->free_uses;
+            fn->free_uses = use;
+            return;
+        }
+    }
+}
+
+SDL_bool ir_build_uses(Context *ctx, IrFunction *fn)
+{
+    IrInstruction *insn;
+    Uint32 i, end;
+
+    if (!ir_reserve_ids(ctx, fn, fn->num_ids)) {
+        return SDL_FALSE;
+    }
+
+    SDL_memset(fn->defs, '\0', fn->allocated_ids * sizeof (IrInstruction *));
+    for (insn = ir_walk_function(fn, NULL); insn != NULL; insn = ir_walk_function(fn, insn)) {
+        const Uint32 id = ir_output(insn);
+        IrUse *use;
+        while ((use = insn->uses) != NULL) {
+            insn->uses = use->next;
+            use->next = fn->free_uses;
+            fn->free_uses = use;
+        }
+        if ((id != 0) && (id < fn->num_ids)) {
+            fn->defs[id] = insn;
+        }
+    }
+
+    /* uses can come before their definitions (a PHI at the top of a loop), so this is a second pass. */
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        for (ir_inputs(insn, &i, &end); i < end; i++) {
+            ir_add_use(ctx, fn, insn, i);
+        }
+    }
+
+    return ctx->out_of_memory ? SDL_FALSE : SDL_TRUE;
+}
+
+void ir_set_input(Context *ctx, IrFunction *fn, IrInstruction *insn, const Uint32 operand, const Uint32 id)
+{
+    ir_drop_use(fn, insn, operand);
+    insn->operands[operand] = id;
+    ir_add_use(ctx, fn, insn, operand);
+}
+
+void ir_replace_uses(Context *ctx, IrFunction *fn, const Uint32 id, const Uint32 replacement)
+{
+    IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+    IrUse *use;
+
+    if ((def == NULL) || (id == replacement)) {
+        return;
+    }
+
+    while ((use = def->uses) != NULL) {
+        def->uses = use->next;
+        use->user->operands[use->operand] = replacement;
+        use->next = fn->free_uses;
+        fn->free_uses = use;
+        ir_add_use(ctx, fn, use->user, use->operand);
+    }
+}
+
+static void ir_remove_block(IrFunction *fn, IrBlock *block)
+{
+    while (block->first) {
+        ir_remove(fn, block->first);
+    }
+}
+
+void ir_remove(IrFunction *fn, IrInstruction *insn)
+{
+    const Uint32 id = ir_output(insn);
+    Uint32 i, end;
+
+    for (i = 0; i < ir_num_children(insn); i++) {
+        ir_remove_block(fn, &insn->children[i]);
+    }
+
+    for (ir_inputs(insn, &i, &end); i < end; i++) {
+        ir_drop_use(fn, insn, i);
+    }
+
+    if ((id != 0) && (id < fn->num_ids) && (fn->defs[id] == insn)) {
+        fn->defs[id] = NULL;  /* anything still reading it should have been pointed elsewhere by now. */
+    }
+
+    ir_unlink(insn);
+}
+
+/* gives everything that's still defined a new SSA id, in the order they're defined, so there are no gaps. Parameters keep theirs. */
+void ir_renumber(Context *ctx, IrFunction *fn)
+{
+    const Uint32 num_ids = fn->num_ids;
+    Uint32 *newids = (Uint32 *) ir_alloc(ctx, num_ids * sizeof (Uint32));
+    IrInstruction *insn;
+    Uint32 next = fn->num_params + 1;
+    Uint32 i, end;
+
+    if ((newids == NULL) || !ir_reserve_ids(ctx, fn, num_ids)) {
+        return;
+    }
+
+    for (i = 0; i <= fn->num_params; i++) {
+        newids[i] = i;
+    }
+
+    /* the constant pool's ids come first, right after the parameters, in order: the bytecode numbers them implicitly. */
+    SDL_memset(fn->defs, '\0', fn->allocated_ids * sizeof (IrInstruction *));
+    for (insn = ir_walk_function(fn, NULL); insn != NULL; insn = ir_walk_function(fn, insn)) {
+        const Uint32 operand = ir_output_operand(insn);
+        if (operand < insn->num_operands) {
+            const Uint32 id = insn->operands[operand];
+            if (id < num_ids) {
+                newids[id] = next;
+                insn->operands[operand] = next;
+                fn->defs[next++] = insn;  /* there can't be more of these than there were ids. */
+            }
+        }
+    }
+
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        for (ir_inputs(insn, &i, &end); i < end; i++) {
+            const Uint32 id = insn->operands[i];
+            insn->operands[i] = (id < num_ids) ? newids[id] : 0;
+        }
+    }
+
+    fn->num_ids = next;
+}
+
+/* The code is structured, so dominance is simple: an instruction dominates the
+   rest of its block, including any code nested in it. Numbering instructions
+   in order makes that a range check. */
+static Uint32 ir_build_dominators_block(IrBlock *block, Uint32 order)
+{
+    IrInstruction *idom = block->owner;
+    IrInstruction *insn;
+    Uint32 i;
+
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        insn->order = order++;
+        insn->idom = idom;
+        idom = insn;
+        for (i = 0; i < ir_num_children(insn); i++) {
+            order = ir_build_dominators_block(&insn->children[i], order);
+        }
+    }
+
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        insn->dominates_until = order - 1;
+    }
+
+    return order;
+}
+
+void ir_build_dominators(IrFunction *fn)
+{
+    const Uint32 end = ir_build_dominators_block(&fn->body, 1);
+    IrInstruction *insn;
+
+    /* constants are defined before any code runs, so they dominate all of it. */
+    for (insn = fn->constants.first; insn != NULL; insn = insn->next) {
+        insn->order = 0;
+        insn->idom = NULL;
+        insn->dominates_until = end - 1;
+    }
+}
+
+SDL_bool ir_dominates(const IrInstruction *a, const IrInstruction *b)
+{
+    return ((a->order <= b->order) && (b->order <= a->dominates_until)) ? SDL_TRUE : SDL_FALSE;
+}
+
+Uint32 ir_count_instructions(const IrFunction *fn)
+{
+    const IrInstruction *insn;
+    Uint32 retval = 0;
+    for (insn = ir_walk_function(fn, NULL); insn != NULL; insn = ir_walk_function(fn, insn)) {
+        retval++;
+    }
+    return retval;
+}
+
+static void ir_serialize_block(Context *ctx, const IrBlock *block, WordBuffer *output)
+{
+    const IrInstruction *insn;
+
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        /* anything with an output has its type id right after it. CONSTRUCT and CONVERT already have a type word there, which the id replaces. */
+        const Uint32 out = !ir_has_output_operand(insn->opcode) ? insn->num_operands : (insn->opcode == SDL_SHADER_BCTAG_OP_CALL) ? 1 : 0;
+        const SDL_bool replaces = ((insn->opcode == SDL_SHADER_BCTAG_OP_CONSTRUCT) || (insn->opcode == SDL_SHADER_BCTAG_OP_CONVERT)) ? SDL_TRUE : SDL_FALSE;
+        const Uint32 extra = ((out < insn->num_operands) && !replaces) ? 1 : 0;
+        const Uint32 type = (out < insn->num_operands) ? bytecode_type_id(ctx, insn->operands[out] ? insn->dt : NULL) : 0;
+        const Uint32 start = output->len;
+        Uint32 *words = wordbuffer_reserve(ctx, output, insn->num_operands + extra + 2);
+        if (words == NULL) {
+            return;
+        }
+
+        words[0] = (Uint32) insn->opcode;
+        words[1] = insn->num_operands + extra + 2;
+        if (out < insn->num_operands) {
+            const Uint32 rest = replaces ? (out + 2) : (out + 1);  /* the first operand after the type. */
+            SDL_memcpy(words + 2, insn->operands, (out + 1) * sizeof (Uint32));
+            words[out + 3] = type;
+            if (rest < insn->num_operands) {
+                SDL_memcpy(words + out + 4, insn->operands + rest, (insn->num_operands - rest) * sizeof (Uint32));
+            }
+        } else if (insn->num_operands > 0) {
+            SDL_memcpy(words + 2, insn->operands, insn->num_operands * sizeof (Uint32));
+        }
+
+        /* IF and LOOP are followed by their code, and their sizes include it. */
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_IF) {
+            ir_serialize_block(ctx, &insn->children[0], output);
+            if (!ctx->out_of_memory) {
+                output->words[start + 3] = output->len - (start + 4);
+            }
+            ir_serialize_block(ctx, &insn->children[1], output);
+        } else if (insn->opcode == SDL_SHADER_BCTAG_OP_LOOP) {
+            ir_serialize_block(ctx, &insn->children[0], output);
+        }
+
+        if (!ctx->out_of_memory) {
+            output->words[start + 1] = output->len - start;
+        }
+    }
+}
+
+/* writes a whole FUNCTION section, in native byte order. */
+void ir_serialize(Context *ctx, const IrFunction *fn, WordBuffer *output)
+{
+    const Uint32 namelen = fn->name ? (Uint32) SDL_strlen(fn->name) + 1 : 0;  /* include the null terminator. */
+    const Uint32 namewords = (namelen + 3) / 4;
+    const Uint32 num_outputs = fn->returns_value ? 1 : 0;
+    const Uint32 start = output->len;
+    const Uint32 constants_at = start + 4 + namewords + (2 + fn->num_params) + (2 + num_outputs);
+    const IrInstruction *insn;
+    Uint32 *words = wordbuffer_reserve(ctx, output, constants_at - start);
+    Uint32 i;
+
+    if (words == NULL) {
+        return;
+    }
+
+    *(words++) = SDL_SHADER_BCTAG_FUNCTION;
+    *(words++) = 0;  /* num_words; we'll fill this in at the end. */
+    *(words++) = (Uint32) fn->fntype;
+    *(words++) = namewords;
+    if (namewords) {
+        words[namewords - 1] = 0;  /* zero the padding. */
+        SDL_memcpy(words, fn->name, namelen);
+        words += namewords;
+    }
+    *(words++) = 2 + fn->num_params;  /* Inputs: num_words, num_inputs, then each one's type id. */
+    *(words++) = fn->num_params;
+    for (i = 0; i < fn->num_params; i++) {
+        *(words++) = bytecode_type_id(ctx, fn->param_dts ? fn->param_dts[i] : NULL);
+    }
+    *(words++) = 2 + num_outputs;  /* Outputs: the same. */
+    *(words++) = num_outputs;
+    if (num_outputs) {
+        *(words++) = bytecode_type_id(ctx, fn->return_dt);
+    }
+
+    /* Constants: num_words, num_constants, then each one's opcode and value(s). Their ids are implicit. */
+    if ((words = wordbuffer_reserve(ctx, output, 2)) == NULL) {
+        return;
+    }
+    words[1] = fn->num_constants;
+    for (insn = fn->constants.first; insn != NULL; insn = insn->next) {
+        if ((words = wordbuffer_reserve(ctx, output, insn->num_operands)) == NULL) {
+            return;
+        }
+        words[0] = (Uint32) insn->opcode;
+        SDL_memcpy(words + 1, insn->operands + 1, (insn->num_operands - 1) * sizeof (Uint32));
+    }
+    output->words[constants_at] = output->len - constants_at;
+
+    ir_serialize_block(ctx, &fn->body, output);
+
+    if (!ctx->out_of_memory) {
+        output->words[start + 1] = output->len - start;
+    }
+}
+
+/* end of SDL_shader_ir.c ... */
@@ -0,0 +1,3425 @@
+/**
+ * SDL_shader_tools; tools for SDL GPU shader support.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+#define __SDL_SHADER_INTERNAL__ 1
+#include "SDL_shader_internal.h"
+
+/* Optimization passes run on the intermediate representation (see
+   SDL_shader_ir.c) after code generation and before it's written out as
+   bytecode. Each pass is listed in the table at the bottom of this file, and
+   they run in that order. A pass can work on one function at a time, on the
+   whole program at once, or both; either way, it returns SDL_TRUE if it
+   changed anything. */
+
+typedef SDL_bool (*OptimizationFunctionPass)(Context *ctx, IrFunction *fn);
+typedef SDL_bool (*OptimizationProgramPass)(Context *ctx);
+
+typedef struct OptimizationPass
+{
+    const char *name;  /* this shows up in SDL_SHADER_OptimizationStats. */
+    Uint32 flag;  /* SDL_SHADER_OPTPASS_* */
+    int min_level;  /* lowest optimization_level that runs this. */
+    OptimizationProgramPass program;  /* runs first, if not NULL. */
+    OptimizationFunctionPass function;  /* then runs on each function, if not NULL. */
+} OptimizationPass;
+
+/* Several passes need to know which CALLs have to stay (and can't be merged
+   with each other): the ones to functions that can DISCARD, or that call
+   something that can. This is a program pass that sets has_side_effects. */
+static SDL_bool find_side_effects(Context *ctx)
+{
+    IrFunction *fn;
+    const IrInstruction *insn;
+    SDL_bool changed;
+
+    for (fn = ctx->ir_functions; fn != NULL; fn = fn->next) {
+        fn->has_side_effects = SDL_FALSE;
+        for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+            if (insn->opcode == SDL_SHADER_BCTAG_OP_DISCARD) {
+                fn->has_side_effects = SDL_TRUE;
+                break;
+            }
+        }
+    }
+
+    do {
+        changed = SDL_FALSE;
+        for (fn = ctx->ir_functions; fn != NULL; fn = fn->next) {
+            for (insn = fn->body.first; (insn != NULL) && !fn->has_side_effects; insn = ir_walk(insn)) {
+                if (insn->opcode == SDL_SHADER_BCTAG_OP_CALL) {
+                    const IrFunction *callee = ir_function_at(ctx, insn->operands[0]);
+                    if (!callee || callee->has_side_effects) {
+                        fn->has_side_effects = changed = SDL_TRUE;
+                    }
+                }
+            }
+        }
+    } while (changed);
+
+    return SDL_FALSE;  /* this only looks, it doesn't change anything. */
+}
+
+/* Dead code elimination...
+
+   This is mark-and-sweep: anything with an effect outside the function
+   (RETURN, DISCARD, a CALL that can DISCARD) is alive, so is anything those
+   need to get their inputs, and so is whatever control flow decides if they
+   run at all. Everything else goes. */
+
+static SDL_bool is_terminator(const IrInstruction *insn)
+{
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_RETURN:
+        case SDL_SHADER_BCTAG_OP_DISCARD:
+        case SDL_SHADER_BCTAG_OP_BREAK:
+        case SDL_SHADER_BCTAG_OP_CONTINUE:
+            return SDL_TRUE;
+        default: break;
+    }
+    return SDL_FALSE;
+}
+
+static SDL_bool block_falls_through(const IrBlock *block);
+
+/* SDL_FALSE if running this instruction means the code after it never runs. */
+static SDL_bool falls_through(const IrInstruction *insn)
+{
+    if (is_terminator(insn)) {
+        return SDL_FALSE;
+    } else if (insn->opcode == SDL_SHADER_BCTAG_OP_IF) {
+        return (block_falls_through(&insn->children[0]) || block_falls_through(&insn->children[1])) ? SDL_TRUE : SDL_FALSE;
+    }
+    return SDL_TRUE;  /* a LOOP without a BREAK never ends, but a shader that does that has bigger problems. */
+}
+
+static SDL_bool block_falls_through(const IrBlock *block)
+{
+    return (block->last == NULL) || falls_through(block->last);
+}
+
+static SDL_bool remove_unreachable_code(IrFunction *fn, IrBlock *block)
+{
+    SDL_bool changed = SDL_FALSE;
+    IrInstruction *insn;
+    Uint32 i;
+
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        for (i = 0; i < ir_num_children(insn); i++) {
+            changed = remove_unreachable_code(fn, &insn->children[i]) || changed;
+        }
+        if (!falls_through(insn)) {
+            while (insn->next) {
+                ir_remove(fn, insn->next);
+                changed = SDL_TRUE;
+            }
+            break;
+        }
+    }
+
+    return changed;
+}
+
+/* SDL_TRUE if `id` is a LITERALINT, and stores its value in `val`. */
+static SDL_bool literal_int(const IrFunction *fn, const Uint32 id, Sint32 *val)
+{
+    const IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+    if (!def || (def->opcode != SDL_SHADER_BCTAG_OP_LITERALINT)) {
+        return SDL_FALSE;
+    }
+    *val = (Sint32) def->operands[1];
+    return SDL_TRUE;
+}
+
+/* the scalar type of a scalar or vector, NULL for anything else (matrix math isn't component-wise). */
+static const DataType *scalar_type(const DataType *dt)
+{
+    switch (dt ? dt->dtype : DT_VOID) {
+        case DT_BOOLEAN:
+        case DT_INT:
+        case DT_UINT:
+        case DT_HALF:
+        case DT_FLOAT:
+            return dt;
+        case DT_VECTOR:
+            return dt->info.vector.childdt;
+        default: break;
+    }
+    return NULL;
+}
+
+/* the `num_lanes`-wide version of scalar or vector `dt`, NULL if there isn't one. */
+static const DataType *narrow_datatype(Context *ctx, const DataType *dt, const Uint32 num_lanes)
+{
+    const DataType *scalar = scalar_type(dt);
+    const DataType *retval = NULL;
+    const char *name;
+
+    if (!scalar) {
+        return NULL;
+    } else if (num_lanes == 1) {
+        return scalar;
+    }
+
+    name = stringcache_fmt(ctx->strcache, "%s%u", scalar->name, (unsigned int) num_lanes);
+    if (!name || !hash_find(ctx->datatypes, name, (const void **) &retval)) {
+        return NULL;
+    }
+    return retval;
+}
+
+static SDL_bool is_float_type(const DataType *dt)
+{
+    const DataType *scalar = scalar_type(dt);
+    return (scalar && ((scalar->dtype == DT_FLOAT) || (scalar->dtype == DT_HALF))) ? SDL_TRUE : SDL_FALSE;
+}
+
+static SDL_bool is_int_type(const DataType *dt)
+{
+    const DataType *scalar = scalar_type(dt);
+    return (scalar && ((scalar->dtype == DT_INT) || (scalar->dtype == DT_UINT))) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* SDL_TRUE if two SSA ids are known to be the same integer: the same id, or literals with the same value. */
+static SDL_bool same_int(const IrFunction *fn, const Uint32 a, const Uint32 b)
+{
+    const IrInstruction *adef = (a < fn->num_ids) ? fn->defs[a] : NULL;
+    const IrInstruction *bdef = (b < fn->num_ids) ? fn->defs[b] : NULL;
+    if (a == b) {
+        return SDL_TRUE;
+    } else if (!adef || !bdef || (adef->opcode != SDL_SHADER_BCTAG_OP_LITERALINT) || (bdef->opcode != SDL_SHADER_BCTAG_OP_LITERALINT)) {
+        return SDL_FALSE;
+    }
+    return (adef->operands[1] == bdef->operands[1]) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* Dead stores: `INSERT %b, %a, idx, %x` followed by `INSERT %c, %b, idx, %y`
+   overwrites the same element before anything else looks at %b, so %c can
+   build on %a directly, and the first INSERT is left for the sweep. */
+static SDL_bool remove_dead_stores(Context *ctx, IrFunction *fn)
+{
+    SDL_bool changed = SDL_FALSE;
+    IrInstruction *insn;
+
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_INSERT) {
+            const Uint32 base = insn->operands[1];
+            const IrInstruction *prev = (base < fn->num_ids) ? fn->defs[base] : NULL;
+            if (prev && (prev->opcode == SDL_SHADER_BCTAG_OP_INSERT) && prev->uses && !prev->uses->next && same_int(fn, prev->operands[2], insn->operands[2])) {
+                ir_set_input(ctx, fn, insn, 1, prev->operands[1]);
+                changed = SDL_TRUE;
+            }
+        }
+    }
+
+    return changed;
+}
+
+typedef struct DceWorklist
+{
+    IrInstruction **items;
+    Uint32 count;
+} DceWorklist;
+
+static void dce_mark(DceWorklist *worklist, IrInstruction *insn)
+{
+    if (insn && !insn->mark) {
+        insn->mark = 1;
+        worklist->items[worklist->count++] = insn;  /* each instruction only gets marked once, so this can't overflow. */
+    }
+}
+
+/* a live LOOP needs every way out of (and back to the top of) itself, or it would behave differently. */
+static void dce_mark_loop_exits(DceWorklist *worklist, IrBlock *block)
+{
+    IrInstruction *insn;
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        if ((insn->opcode == SDL_SHADER_BCTAG_OP_BREAK) || (insn->opcode == SDL_SHADER_BCTAG_OP_CONTINUE)) {
+            dce_mark(worklist, insn);
+        } else if (insn->opcode == SDL_SHADER_BCTAG_OP_IF) {
+            dce_mark_loop_exits(worklist, &insn->children[0]);
+            dce_mark_loop_exits(worklist, &insn->children[1]);
+        }  /* BREAKs in a nested LOOP belong to that loop. */
+    }
+}
+
+static void dce_sweep(IrFunction *fn, IrBlock *block, SDL_bool *changed)
+{
+    IrInstruction *insn = block->first;
+    while (insn != NULL) {
+        IrInstruction *next = insn->next;
+        if (!insn->mark) {
+            ir_remove(fn, insn);
+            *changed = SDL_TRUE;
+        } else {
+            Uint32 i;
+            for (i = 0; i < ir_num_children(insn); i++) {
+                dce_sweep(fn, &insn->children[i], changed);
+            }
+        }
+        insn = next;
+    }
+}
+
+static SDL_bool dce(Context *ctx, IrFunction *fn)
+{
+    SDL_bool changed = SDL_FALSE;
+    DceWorklist worklist;
+    IrInstruction *insn;
+    Uint32 i, end;
+
+    changed = remove_unreachable_code(fn, &fn->body) || changed;
+    changed = remove_dead_stores(ctx, fn) || changed;
+
+    worklist.count = 0;
+    worklist.items = (IrInstruction **) ir_alloc(ctx, (ir_count_instructions(fn) + 1) * sizeof (IrInstruction *));
+    if (worklist.items == NULL) {
+        return changed;
+    }
+
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        insn->mark = 0;
+    }
+
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        if ((insn->opcode == SDL_SHADER_BCTAG_OP_RETURN) || (insn->opcode == SDL_SHADER_BCTAG_OP_DISCARD)) {
+            dce_mark(&worklist, insn);
+        } else if (insn->opcode == SDL_SHADER_BCTAG_OP_CALL) {
+            const IrFunction *callee = ir_function_at(ctx, insn->operands[0]);
+            if (!callee || callee->has_side_effects) {
+                dce_mark(&worklist, insn);
+            }
+        }
+    }
+
+    while (worklist.count > 0) {
+        insn = worklist.items[--worklist.count];
+
+        for (ir_inputs(insn, &i, &end); i < end; i++) {
+            const Uint32 id = insn->operands[i];
+            dce_mark(&worklist, (id < fn->num_ids) ? fn->defs[id] : NULL);
+        }
+
+        /* it only runs if the IF or LOOP around it does. */
+        dce_mark(&worklist, insn->block->owner);
+
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_LOOP) {
+            dce_mark_loop_exits(&worklist, &insn->children[0]);
+        } else if (insn->opcode == SDL_SHADER_BCTAG_OP_PHI) {
+            /* a PHI after an IF or LOOP picks a value by which way we went through it, so that has to stay too. */
+            IrInstruction *merge = insn->prev;
+            while (merge && (merge->opcode == SDL_SHADER_BCTAG_OP_PHI)) {
+                merge = merge->prev;
+            }
+            if (merge && ((merge->opcode == SDL_SHADER_BCTAG_OP_IF) || (merge->opcode == SDL_SHADER_BCTAG_OP_LOOP))) {
+                dce_mark(&worklist, merge);
+            }
+        }
+    }
+
+    dce_sweep(fn, &fn->body, &changed);
+    changed = ir_remove_unused_constants(fn) || changed;
+
+    if (changed) {
+        ir_renumber(ctx, fn);
+    }
+
+    return changed;
+}
+
+/* Global value numbering...
+
+   Two pure instructions that do the same thing to the same inputs produce the
+   same value, so if one of them dominates the other, the second one can go and
+   everything that used it can use the first one instead. We walk the function
+   in order, so inputs have already been merged by the time we look at what
+   reads them, and `normalize(v) * dot(normalize(v), n)` only normalizes once.
+
+   Not everything is pure: PHIs depend on which way control flow went, CALLs
+   to functions that can DISCARD have to happen every time, and SAMPLE's
+   implicit derivatives depend on which pixels are running it, so we only
+   merge a SAMPLE with another one in the same block.
+
+   Some values are known without looking anything up: math on two constants
+   is a constant, and an EXTRACT from an INSERT at the same constant index is
+   the value that was inserted, and a SELECT on a constant condition (or
+   between two of the same thing) is whichever it picks, and a CONVERT of a
+   constant is a constant, which is what an unrolled loop's counter turns into
+   when the body uses it as a float. Unrolled loops are full of these. Float
+   math is folded one operation at a time in single precision, like the AST's
+   constant folding does, and never to a NaN or infinity.
+
+   A few more depend on the function's SDL_SHADER_FASTMATH_* flags, since they
+   are always true for ints but not for floats:
+
+   - (x + 1) + 2 is x + 3, and the same for multiplies (REASSOCIATE).
+   - x - x is zero (NO_NANS and NO_INFS: inf - inf is NaN).
+   - x == x is true, x < x is false, etc (NO_NANS). */
+
+static SDL_bool gvn_is_commutative(const IrInstruction *insn)
+{
+    if (insn->num_operands != 3) {
+        return SDL_FALSE;
+    }
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_MULTIPLY:
+        case SDL_SHADER_BCTAG_OP_ADD:
+        case SDL_SHADER_BCTAG_OP_EQUAL:
+        case SDL_SHADER_BCTAG_OP_NOTEQUAL:
+        case SDL_SHADER_BCTAG_OP_BINARYAND:
+        case SDL_SHADER_BCTAG_OP_BINARYOR:
+        case SDL_SHADER_BCTAG_OP_BINARYXOR:
+        case SDL_SHADER_BCTAG_OP_LOGICALAND:
+        case SDL_SHADER_BCTAG_OP_LOGICALOR:
+        case SDL_SHADER_BCTAG_OP_MIN:
+        case SDL_SHADER_BCTAG_OP_MAX:
+        case SDL_SHADER_BCTAG_OP_DOT:
+            return SDL_TRUE;
+        default: break;
+    }
+    return SDL_FALSE;
+}
+
+/* SDL_TRUE if `insn` makes a value from nothing but its inputs. SAMPLE counts, but see above. */
+static SDL_bool is_pure(Context *ctx, const IrInstruction *insn)
+{
+    if (ir_output(insn) == 0) {
+        return SDL_FALSE;
+    } else if (insn->opcode == SDL_SHADER_BCTAG_OP_PHI) {
+        return SDL_FALSE;
+    } else if (insn->opcode == SDL_SHADER_BCTAG_OP_CALL) {
+        const IrFunction *callee = ir_function_at(ctx, insn->operands[0]);
+        return (callee && !callee->has_side_effects) ? SDL_TRUE : SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+/* the value of operand `i`, with the inputs of commutative operations in a consistent order. */
+static Uint32 gvn_operand(const IrInstruction *insn, const Uint32 i)
+{
+    if (gvn_is_commutative(insn) && (i > 0)) {
+        const Uint32 a = insn->operands[1];
+        const Uint32 b = insn->operands[2];
+        return ((i == 1) == (a < b)) ? a : b;
+    }
+    return insn->operands[i];
+}
+
+static Uint32 hash_gvn(const void *key, void *data)
+{
+    const IrInstruction *insn = (const IrInstruction *) key;
+    const Uint32 output = ir_output_operand(insn);
+    Uint32 hash = 5381 ^ (Uint32) insn->opcode;
+    Uint32 i;
+
+    (void) data;
+
+    for (i = 0; i < insn->num_operands; i++) {
+        if (i != output) {
+            hash = ((hash << 5) + hash) ^ gvn_operand(insn, i);
+        }
+    }
+    return hash;
+}
+
+static int hash_keymatch_gvn(const void *_a, const void *_b, void *data)
+{
+    const IrInstruction *a = (const IrInstruction *) _a;
+    const IrInstruction *b = (const IrInstruction *) _b;
+    const Uint32 output = ir_output_operand(a);
+    Uint32 i;
+
+    (void) data;
+
+    if ((a->opcode != b->opcode) || (a->num_operands != b->num_operands)) {
+        return 0;
+    }
+
+    for (i = 0; i < a->num_operands; i++) {
+        if ((i != output) && (gvn_operand(a, i) != gvn_operand(b, i))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void nuke_gvn(const void *key, const void *value, void *data)
+{
+    (void) key;  /* nothing to free, it's all in the arena. */
+    (void) value;
+    (void) data;
+}
+
+/* SDL_TRUE if `id` is a LITERAL* constant with every component the same, and stores which opcode in `opcode` and the value in `val`. */
+static SDL_bool gvn_literal(const IrFunction *fn, const Uint32 id, SDL_SHADER_BytecodeTag *opcode, ConstantValue *val)
+{
+    const IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+    Uint32 i;
+
+    if (!def) {
+        return SDL_FALSE;
+    }
+
+    switch (def->opcode) {
+        case SDL_SHADER_BCTAG_OP_LITERALINT:
+        case SDL_SHADER_BCTAG_OP_LITERALFLOAT:
+            break;
+        case SDL_SHADER_BCTAG_OP_LITERALINT4:
+        case SDL_SHADER_BCTAG_OP_LITERALFLOAT4:
+            for (i = 2; i < def->num_operands; i++) {
+                if (def->operands[i] != def->operands[1]) {
+                    return SDL_FALSE;
+                }
+            }
+            break;
+        default: return SDL_FALSE;
+    }
+
+    *opcode = def->opcode;
+    val->u = def->operands[1];
+    return SDL_TRUE;
+}
+
+/* SSA id of a constant like the ones gvn_literal() finds. */
+static Uint32 gvn_constant(Context *ctx, IrFunction *fn, const SDL_SHADER_BytecodeTag opcode, const ConstantValue val)
+{
+    const Uint32 values[4] = { val.u, val.u, val.u, val.u };
+    return ir_constant(ctx, fn, opcode, values);
+}
+
+static SDL_bool gvn_literal_is_float(const SDL_SHADER_BytecodeTag opcode)
+{
+    return ((opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT) || (opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT4)) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* does `opcode` to two scalar constants. SDL_FALSE if it's not something we fold. */
+static SDL_bool gvn_fold(const SDL_SHADER_BytecodeTag opcode, const SDL_bool is_float, const ConstantValue x, const ConstantValue y, ConstantValue *r)
+{
+    if (is_float) {
+        switch (opcode) {
+            case SDL_SHADER_BCTAG_OP_ADD: r->f = x.f + y.f; break;
+            case SDL_SHADER_BCTAG_OP_SUBTRACT: r->f = x.f - y.f; break;
+            case SDL_SHADER_BCTAG_OP_MULTIPLY: r->f = x.f * y.f; break;
+            case SDL_SHADER_BCTAG_OP_DIVIDE: r->f = x.f / y.f; break;
+            default: return SDL_FALSE;
+        }
+        return ((r->f - r->f) == 0.0f) ? SDL_TRUE : SDL_FALSE;  /* NaN and infinity both produce NaN here. */
+    }
+
+    switch (opcode) {  /* unsigned, so it wraps like the GPU would. */
+        case SDL_SHADER_BCTAG_OP_ADD: r->u = x.u + y.u; break;
+        case SDL_SHADER_BCTAG_OP_SUBTRACT: r->u = x.u - y.u; break;
+        case SDL_SHADER_BCTAG_OP_MULTIPLY: r->u = x.u * y.u; break;
+        default: return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+/* a scalar CONVERT of a scalar literal, as a literal. 0 if we can't tell what it makes at compile time. */
+static Uint32 gvn_convert(Context *ctx, IrFunction *fn, const IrInstruction *insn)
+{
+    const Uint32 typeword = insn->operands[1];
+    const IrInstruction *def = (insn->operands[2] < fn->num_ids) ? fn->defs[insn->operands[2]] : NULL;
+    ConstantValue x, r;
+
+    if (!def || ((def->opcode != SDL_SHADER_BCTAG_OP_LITERALINT) && (def->opcode != SDL_SHADER_BCTAG_OP_LITERALFLOAT))) {
+        return 0;
+    } else if ((SDL_SHADER_BYTECODE_TYPEWORD_ELEMENTS(typeword) != 1) || (SDL_SHADER_BYTECODE_TYPEWORD_ROWS(typeword) != 1)) {
+        return 0;  /* a splat, we only make scalars here. */
+    }
+
+    x.u = def->operands[1];
+
+    if (def->opcode == SDL_SHADER_BCTAG_OP_LITERALINT) {
+        /* literals don't know if they're a bool, int or uint, but below 2^31 those all convert the same way. */
+        if (x.u >= 0x80000000) {
+            return 0;
+        }
+        switch (SDL_SHADER_BYTECODE_TYPEWORD_SCALAR(typeword)) {
+            case SDL_SHADER_BCSCALAR_BOOL: r.u = (x.u != 0) ? 1 : 0; break;
+            case SDL_SHADER_BCSCALAR_INT:
+            case SDL_SHADER_BCSCALAR_UINT: return insn->operands[2];
+            case SDL_SHADER_BCSCALAR_FLOAT: r.f = (float) x.u; return gvn_constant(ctx, fn, SDL_SHADER_BCTAG_OP_LITERALFLOAT, r);
+            default: return 0;  /* there aren't half literals. */
+        }
+        return gvn_constant(ctx, fn, SDL_SHADER_BCTAG_OP_LITERALINT, r);
+    }
+
+    switch (SDL_SHADER_BYTECODE_TYPEWORD_SCALAR(typeword)) {
+        case SDL_SHADER_BCSCALAR_BOOL:
+            if ((x.f - x.f) != 0.0f) {
+                return 0;  /* NaN or infinity. */
+            }
+            r.u = (x.f != 0.0f) ? 1 : 0;
+            break;
+        case SDL_SHADER_BCSCALAR_INT:
+            if (!((x.f >= -2147483648.0f) && (x.f < 2147483648.0f))) {  /* this is also true for NaN. */
+                return 0;  /* undefined, let it happen at runtime. */
+            }
+            r.i = (Sint32) x.f;
+            break;
+        case SDL_SHADER_BCSCALAR_UINT:
+            if (!((x.f > -1.0f) && (x.f < 4294967296.0f))) {
+                return 0;
+            }
+            r.u = (Uint32) x.f;
+            break;
+        case SDL_SHADER_BCSCALAR_FLOAT: return insn->operands[2];
+        default: return 0;
+    }
+    return gvn_constant(ctx, fn, SDL_SHADER_BCTAG_OP_LITERALINT, r);
+}
+
+/* `x op x`, for the ops where that doesn't depend on x. 0 if it does, or if the fast-math flags don't let us assume it. */
+static Uint32 gvn_same_operands(Context *ctx, IrFunction *fn, const IrInstruction *insn)
+{
+    const DataType *dt = ir_datatype(fn, insn->operands[1]);
+    const SDL_bool is_float = is_float_type(dt);
+    Uint32 value = 0;
+
+    if (!is_float && !is_int_type(dt) && (!dt || (dt->dtype != DT_BOOLEAN))) {
+        return 0;  /* a matrix or struct (or we don't know), leave it alone. */
+    }
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_SUBTRACT:
+            if (is_float && ((fn->fast_math & (SDL_SHADER_FASTMATH_NO_NANS | SDL_SHADER_FASTMATH_NO_INFS)) != (SDL_SHADER_FASTMATH_NO_NANS | SDL_SHADER_FASTMATH_NO_INFS))) {
+                return 0;
+            } else if ((insn->dt != dt) || (scalar_type(dt) != dt)) {
+                return 0;  /* we only make scalar zeroes here. */
+            }
+            return ir_constant(ctx, fn, is_float ? SDL_SHADER_BCTAG_OP_LITERALFLOAT : SDL_SHADER_BCTAG_OP_LITERALINT, &value);  /* +0.0f is all zero bits, too. */
+
+        case SDL_SHADER_BCTAG_OP_EQUAL:
+        case SDL_SHADER_BCTAG_OP_NOTEQUAL:
+        case SDL_SHADER_BCTAG_OP_LESSTHAN:
+        case SDL_SHADER_BCTAG_OP_GREATERTHAN:
+        case SDL_SHADER_BCTAG_OP_LESSTHANOREQUAL:
+        case SDL_SHADER_BCTAG_OP_GREATERTHANOREQUAL:
+            if (is_float && !(fn->fast_math & SDL_SHADER_FASTMATH_NO_NANS)) {
+                return 0;  /* NaN isn't equal to anything, not even itself. */
+            } else if (!insn->dt || (insn->dt->dtype != DT_BOOLEAN)) {
+                return 0;  /* a vector of results, we only make scalars here. */
+            }
+            value = ((insn->opcode == SDL_SHADER_BCTAG_OP_EQUAL) || (insn->opcode == SDL_SHADER_BCTAG_OP_LESSTHANOREQUAL) || (insn->opcode == SDL_SHADER_BCTAG_OP_GREATERTHANOREQUAL)) ? 1 : 0;
+            return ir_constant(ctx, fn, SDL_SHADER_BCTAG_OP_LITERALINT, &value);
+
+        default: break;
+    }
+
+    return 0;
+}
+
+/* turns `(x op c1) op c2` into `x op (c1 op c2)`, for an `op` that can be regrouped like that. */
+static SDL_bool gvn_reassociate(Context *ctx, IrFunction *fn, IrInstruction *insn)
+{
+    const IrInstruction *def;
+    SDL_SHADER_BytecodeTag op1, op2;
+    ConstantValue c1, c2, c;
+    Uint32 x = insn->operands[1];
+    Uint32 i;
+
+    if ((insn->opcode != SDL_SHADER_BCTAG_OP_ADD) && (insn->opcode != SDL_SHADER_BCTAG_OP_MULTIPLY)) {
+        return SDL_FALSE;
+    } else if (!gvn_literal(fn, insn->operands[2], &op2, &c2)) {
+        if (!gvn_literal(fn, insn->operands[1], &op2, &c2)) {
+            return SDL_FALSE;
+        }
+        x = insn->operands[2];  /* c2 op (x op c1) */
+    }
+
+    def = (x < fn->num_ids) ? fn->defs[x] : NULL;
+    if (!def || (def->opcode != insn->opcode) || (def->num_operands != 3)) {
+        return SDL_FALSE;
+    } else if (gvn_literal_is_float(op2) && !(fn->fast_math & SDL_SHADER_FASTMATH_REASSOCIATE)) {
+        return SDL_FALSE;  /* the sum of the constants is rounded differently than adding them one at a time. */
+    }
+
+    for (i = 1; i <= 2; i++) {
+        if (gvn_literal(fn, def->operands[i], &op1, &c1) && (op1 == op2)) {
+            if (!gvn_fold(insn->opcode, gvn_literal_is_float(op2), c1, c2, &c)) {
+                return SDL_FALSE;
+            }
+            ir_set_input(ctx, fn, insn, 1, def->operands[3 - i]);
+            ir_set_input(ctx, fn, insn, 2, gvn_constant(ctx, fn, op2, c));
+            return SDL_TRUE;
+        }
+    }
+
+    return SDL_FALSE;
+}
+
+/* an SSA id that `insn` can be replaced with outright, or 0 if there isn't one. */
+static Uint32 gvn_simplify(Context *ctx, IrFunction *fn, IrInstruction *insn, SDL_bool *changed)
+{
+    SDL_SHADER_BytecodeTag op1, op2;
+    ConstantValue x, y, r;
+    Sint32 a, b;
+
+    if (insn->opcode == SDL_SHADER_BCTAG_OP_EXTRACT) {
+        Uint32 base = insn->operands[1];
+        const IrInstruction *def;
+        while (((def = ((base < fn->num_ids) ? fn->defs[base] : NULL)) != NULL) && (def->opcode == SDL_SHADER_BCTAG_OP_INSERT)) {
+            if (same_int(fn, def->operands[2], insn->operands[2])) {
+                return def->operands[3];
+            } else if (!literal_int(fn, def->operands[2], &a) || !literal_int(fn, insn->operands[2], &b)) {
+                break;  /* might be the same element, we can't tell. */
+            }
+            base = def->operands[1];  /* a different element, so look past it. */
+        }
+        if (base != insn->operands[1]) {
+            ir_set_input(ctx, fn, insn, 1, base);
+            *changed = SDL_TRUE;
+        }
+    } else if (insn->opcode == SDL_SHADER_BCTAG_OP_SELECT) {
+        if (literal_int(fn, insn->operands[1], &a)) {
+            return insn->operands[a ? 2 : 3];
+        }
+        return (insn->operands[2] == insn->operands[3]) ? insn->operands[2] : 0;
+    } else if (insn->opcode == SDL_SHADER_BCTAG_OP_CONVERT) {
+        return gvn_convert(ctx, fn, insn);
+    } else if (insn->num_operands != 3) {
+        return 0;
+    } else if (gvn_literal(fn, insn->operands[1], &op1, &x) && gvn_literal(fn, insn->operands[2], &op2, &y)) {
+        if ((op1 == op2) && gvn_fold(insn->opcode, gvn_literal_is_float(op1), x, y, &r)) {
+            return gvn_constant(ctx, fn, op1, r);
+        }
+    } else if (insn->operands[1] == insn->operands[2]) {
+        return gvn_same_operands(ctx, fn, insn);
+    } else if (gvn_reassociate(ctx, fn, insn)) {
+        *changed = SDL_TRUE;
+    }
+
+    return 0;
+}
+
+static SDL_bool gvn(Context *ctx, IrFunction *fn)
+{
+    SDL_bool changed = SDL_FALSE;
+    HashTable *values;
+    IrInstruction *insn;
+    IrInstruction *next;
+
+    values = hash_create(ctx, hash_gvn, hash_keymatch_gvn, nuke_gvn, SDL_TRUE, MallocContextBridge, FreeContextBridge, ctx);
+    if (values == NULL) {
+        return SDL_FALSE;
+    }
+
+    ir_build_dominators(fn);
+
+    for (insn = fn->body.first; insn != NULL; insn = next) {
+        next = ir_walk(insn);
+        if (is_pure(ctx, insn)) {
+            const Uint32 known = gvn_simplify(ctx, fn, insn, &changed);
+            const void *value = NULL;
+            void *iter = NULL;
+            const IrInstruction *existing = NULL;
+
+            if (known != 0) {
+                ir_replace_uses(ctx, fn, ir_output(insn), known);
+                ir_remove(fn, insn);
+                changed = SDL_TRUE;
+                continue;
+            }
+
+            while (hash_iter(values, insn, &value, &iter)) {
+                const IrInstruction *candidate = (const IrInstruction *) value;
+                if (!ir_dominates(candidate, insn)) {
+                    continue;  /* it's in code that might not have run, like the other side of an IF. */
+                } else if ((insn->opcode == SDL_SHADER_BCTAG_OP_SAMPLE) && (candidate->block != insn->block)) {
+                    continue;
+                }
+                existing = candidate;
+                break;
+            }
+
+            if (existing) {
+                ir_replace_uses(ctx, fn, ir_output(insn), ir_output(existing));
+                ir_remove(fn, insn);
+                changed = SDL_TRUE;
+            } else if (hash_insert(values, insn, insn) == -1) {
+                break;  /* out of memory, just stop here. */
+            }
+        }
+    }
+
+    hash_destroy(values);
+
+    if (changed) {
+        ir_renumber(ctx, fn);
+    }
+
+    return changed;
+}
+
+/* Loop-invariant code motion...
+
+   A pure instruction in a LOOP whose inputs all come from outside of it makes
+   the same value on every trip, so we move it to just before the LOOP and
+   compute it once. Inner loops go first, so something that doesn't change in
+   either loop moves out of both.
+
+   The loop might not run its body at all, or might only get to an IF arm on
+   some trips, so moving code out of it runs that code when it otherwise might
+   not have. That's fine for nearly everything, but not for these:
+
+   - DIVIDE and MODULO by an integer zero is undefined, so they only move when
+     we can tell they're dividing floats or the divisor is a nonzero constant.
+   - SAMPLE's implicit derivatives depend on which pixels are running it, so
+     it only moves if it's not inside an IF and the loop can't DISCARD. */
+
+/* SDL_TRUE if `insn` is somewhere inside `loop`, including its nested code. */
+static SDL_bool licm_inside(const IrInstruction *insn, const IrInstruction *loop)
+{
+    const IrBlock *block;
+    for (block = insn->block; (block != NULL) && (block->owner != NULL); block = block->owner->block) {
+        if (block->owner == loop) {
+            return SDL_TRUE;
+        }
+    }
+    return SDL_FALSE;
+}
+
+/* SDL_TRUE if anything in `block` can DISCARD, including in functions it calls. */
+static SDL_bool licm_can_discard(Context *ctx, const IrBlock *block)
+{
+    const IrInstruction *insn;
+    Uint32 i;
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_DISCARD) {
+            return SDL_TRUE;
+        } else if (insn->opcode == SDL_SHADER_BCTAG_OP_CALL) {
+            const IrFunction *callee = ir_function_at(ctx, insn->operands[0]);
+            if (!callee || callee->has_side_effects) {
+                return SDL_TRUE;
+            }
+        }
+        for (i = 0; i < ir_num_children(insn); i++) {
+            if (licm_can_discard(ctx, &insn->children[i])) {
+                return SDL_TRUE;
+            }
+        }
+    }
+    return SDL_FALSE;
+}
+
+/* SDL_TRUE if there's a CONTINUE in `block` for the loop it's in. */
+static SDL_bool licm_has_continue(const IrBlock *block)
+{
+    const IrInstruction *insn;
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_CONTINUE) {
+            return SDL_TRUE;
+        } else if ((insn->opcode == SDL_SHADER_BCTAG_OP_IF) && (licm_has_continue(&insn->children[0]) || licm_has_continue(&insn->children[1]))) {
+            return SDL_TRUE;
+        }
+    }
+    return SDL_FALSE;
+}
+
+static SDL_bool licm_is_float(const IrFunction *fn, const Uint32 id)
+{
+    const IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+    return (def && ((def->opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT) || (def->opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT4))) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* SDL_FALSE if running `insn` in places it wouldn't have run might be undefined (dividing an int by zero). */
+static SDL_bool can_speculate(const IrFunction *fn, const IrInstruction *insn)
+{
+    Sint32 divisor;
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_DIVIDE:
+        case SDL_SHADER_BCTAG_OP_MODULO:
+            if (licm_is_float(fn, insn->operands[1]) || licm_is_float(fn, insn->operands[2])) {
+                return SDL_TRUE;  /* both sides have the same type, so this is float math, which can't trap. */
+            }
+            return (literal_int(fn, insn->operands[2], &divisor) && (divisor != 0)) ? SDL_TRUE : SDL_FALSE;
+        default: break;
+    }
+
+    return SDL_TRUE;
+}
+
+static SDL_bool licm_can_hoist(Context *ctx, const IrFunction *fn, const IrInstruction *loop, const IrInstruction *insn, const SDL_bool can_discard)
+{
+    Uint32 i, end;
+
+    if (!is_pure(ctx, insn) || !can_speculate(fn, insn)) {
+        return SDL_FALSE;
+    }
+
+    for (ir_inputs(insn, &i, &end); i < end; i++) {
+        const Uint32 id = insn->operands[i];
+        const IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+        if (def && licm_inside(def, loop)) {
+            return SDL_FALSE;
+        }
+    }
+
+    if (insn->opcode == SDL_SHADER_BCTAG_OP_SAMPLE) {
+        return ((insn->block == &loop->children[0]) && !can_discard) ? SDL_TRUE : SDL_FALSE;
+    }
+
+    return SDL_TRUE;
+}
+
+/* moves what it can from `block` (part of `loop`) to just before `loop`. Nested LOOPs were already done. */
+static SDL_bool licm_hoist(Context *ctx, IrFunction *fn, IrInstruction *loop, IrBlock *block, const SDL_bool can_discard)
+{
+    SDL_bool changed = SDL_FALSE;
+    IrInstruction *insn;
+    IrInstruction *next;
+
+    for (insn = block->first; insn != NULL; insn = next) {
+        next = insn->next;
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_IF) {
+            changed = licm_hoist(ctx, fn, loop, &insn->children[0], can_discard) || changed;
+            changed = licm_hoist(ctx, fn, loop, &insn->children[1], can_discard) || changed;
+        } else if (licm_can_hoist(ctx, fn, loop, insn, can_discard)) {
+            ir_unlink(insn);
+            ir_insert_before(loop->block, loop, insn);
+            changed = SDL_TRUE;
+        }
+    }
+
+    return changed;
+}
+
+static SDL_bool licm_block(Context *ctx, IrFunction *fn, IrBlock *block)
+{
+    SDL_bool changed = SDL_FALSE;
+    IrInstruction *insn;
+    Uint32 i;
+
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        for (i = 0; i < ir_num_children(insn); i++) {
+            changed = licm_block(ctx, fn, &insn->children[i]) || changed;
+        }
+        if ((insn->opcode == SDL_SHADER_BCTAG_OP_LOOP) && !block_falls_through(&insn->children[0]) && !licm_has_continue(&insn->children[0])) {
+            continue;  /* it only runs once (the inliner makes these), so there's nothing to gain. */
+        } else if (insn->opcode == SDL_SHADER_BCTAG_OP_LOOP) {
+            const SDL_bool can_discard = licm_can_discard(ctx, &insn->children[0]);
+            changed = licm_hoist(ctx, fn, insn, &insn->children[0], can_discard) || changed;
+        }
+    }
+
+    return changed;
+}
+
+static SDL_bool licm(Context *ctx, IrFunction *fn)
+{
+    const SDL_bool changed = licm_block(ctx, fn, &fn->body);
+    if (changed) {
+        ir_renumber(ctx, fn);
+    }
+    return changed;
+}
+
+/* Inlining...
+
+   CALL is a real call in the bytecode, and plenty of targets either pay for
+   that or have to inline it themselves, so we replace calls with a copy of
+   the function's code. Tiny functions (think `saturate`) and functions that
+   are only called from one place always get inlined; other small functions
+   get inlined as long as the caller doesn't grow past a budget. Functions
+   that nothing calls afterwards are removed.
+
+   A function that RETURNs from the middle of its code is wrapped in a LOOP
+   that runs once, with each RETURN turned into a BREAK, and a PHI after the
+   LOOP picks up the return value. That doesn't work for a RETURN inside one
+   of the function's own loops (a BREAK there would only leave that loop), so
+   those functions aren't inlined. Neither are recursive ones, nor ones that
+   can't take fast-math shortcuts the caller can (like a @precise function
+   called from anything else), or can't be as far off in half precision,
+   since their code would get those shortcuts. */
+
+#define INLINE_ALWAYS_SIZE 8  /* functions this many instructions or smaller always get inlined. */
+#define INLINE_MAX_SIZE 64  /* functions bigger than this only get inlined if there's one call to them. */
+#define INLINE_GROWTH_BUDGET 256  /* how many instructions inlining bigger functions can add to any one function. */
+
+typedef struct InlineInfo
+{
+    Uint32 size;  /* instructions, not counting constants. */
+    Uint32 num_calls;  /* CALLs to this function, anywhere. */
+    Uint32 num_returns;
+    SDL_bool inlinable;
+    SDL_bool visiting;  /* used while looking for recursion. */
+    SDL_bool ordered;  /* already in the order we inline things. */
+} InlineInfo;
+
+/* SDL_FALSE if there's a RETURN inside a LOOP, which we can't turn into a BREAK. Counts the RETURNs in any case. */
+static SDL_bool inline_check_returns(const IrBlock *block, const SDL_bool in_loop, Uint32 *num_returns)
+{
+    const IrInstruction *insn;
+    Uint32 i;
+
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_RETURN) {
+            (*num_returns)++;
+            if (in_loop) {
+                return SDL_FALSE;
+            }
+        }
+        for (i = 0; i < ir_num_children(insn); i++) {
+            if (!inline_check_returns(&insn->children[i], in_loop || (insn->opcode == SDL_SHADER_BCTAG_OP_LOOP), num_returns)) {
+                return SDL_FALSE;
+            }
+        }
+    }
+
+    return SDL_TRUE;
+}
+
+/* SDL_TRUE if `fn` can end up calling `target`. */
+static SDL_bool inline_calls(Context *ctx, InlineInfo *info, const IrFunction *fn, const IrFunction *target)
+{
+    const IrInstruction *insn;
+    SDL_bool retval = SDL_FALSE;
+
+    if (info[fn->index].visiting) {
+        return SDL_FALSE;  /* already looking at this one. */
+    }
+
+    info[fn->index].visiting = SDL_TRUE;
+    for (insn = fn->body.first; (insn != NULL) && !retval; insn = ir_walk(insn)) {
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_CALL) {
+            const IrFunction *callee = ir_function_at(ctx, insn->operands[0]);
+            retval = (callee == target) || (callee && inline_calls(ctx, info, callee, target));
+        }
+    }
+    info[fn->index].visiting = SDL_FALSE;
+
+    return retval;
+}
+
+/* puts `fn` in `order` after everything it calls, so callees get their own calls inlined before they're copied anywhere. */
+static void inline_order(Context *ctx, InlineInfo *info, IrFunction *fn, IrFunction **order, Uint32 *count)
+{
+    const IrInstruction *insn;
+
+    if (info[fn->index].ordered) {
+        return;
+    }
+
+    info[fn->index].ordered = SDL_TRUE;  /* set this first, so recursion doesn't recurse forever here. */
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_CALL) {
+            IrFunction *callee = ir_function_at(ctx, insn->operands[0]);
+            if (callee) {
+                inline_order(ctx, info, callee, order, count);
+            }
+        }
+    }
+    order[(*count)++] = fn;
+}
+
+/* copies the code from `first` up to `stop` (or the end of its block if NULL), from `srcfn`, into `dst`,
+   before `before`, giving everything new SSA ids from `idmap`. If `returns` isn't NULL, RETURNs become
+   BREAKs, and the values they returned get added to it. Inlining and loop unrolling both use this. */
+static void copy_code(Context *ctx, const IrFunction *srcfn, const IrInstruction *first, const IrInstruction *stop, IrBlock *dst, IrInstruction *before, const Uint32 *idmap, Uint32 *returns, Uint32 *num_returns)
+{
+    const IrInstruction *insn;
+    Uint32 i, end;
+
+    for (insn = first; (insn != stop) && !ctx->out_of_memory; insn = insn->next) {
+        IrInstruction *copy;
+
+        if (returns && (insn->opcode == SDL_SHADER_BCTAG_OP_RETURN)) {
+            if ((copy = ir_instruction_create(ctx, SDL_SHADER_BCTAG_OP_BREAK, 0)) == NULL) {
+                return;
+            }
+            returns[(*num_returns)++] = (insn->operands[0] < srcfn->num_ids) ? idmap[insn->operands[0]] : 0;
+            ir_insert_before(dst, before, copy);
+            continue;
+        }
+
+        if ((copy = ir_instruction_create(ctx, insn->opcode, insn->num_operands)) == NULL) {
+            return;
+        }
+
+        if (insn->num_operands > 0) {
+            SDL_memcpy(copy->operands, insn->operands, insn->num_operands * sizeof (Uint32));
+        }
+        copy->dt = insn->dt;
+
+        if ((i = ir_output_operand(insn)) < insn->num_operands) {
+            copy->operands[i] = idmap[insn->operands[i]];
+        }
+
+        for (ir_inputs(insn, &i, &end); i < end; i++) {
+            const Uint32 id = insn->operands[i];
+            copy->operands[i] = (id < srcfn->num_ids) ? idmap[id] : 0;
+        }
+
+        ir_insert_before(dst, before, copy);
+
+        for (i = 0; i < ir_num_children(insn); i++) {
+            copy_code(ctx, srcfn, insn->children[i].first, NULL, &copy->children[i], NULL, idmap, returns, num_returns);
+        }
+    }
+}
+
+/* replaces `call` (in `fn`) with a copy of `callee`'s code. */
+static void inline_call(Context *ctx, IrFunction *fn, IrInstruction *call, const IrFunction *callee, const InlineInfo *info)
+{
+    Uint32 *idmap = (Uint32 *) ir_alloc(ctx, callee->num_ids * sizeof (Uint32));
+    const IrInstruction *insn;
+    Uint32 result = 0;
+    Uint32 i;
+
+    if (idmap == NULL) {
+        return;
+    }
+
+    /* parameters become the arguments, constants go in our own pool, everything else gets a new id. */
+    for (i = 1; (i <= callee->num_params) && (i < callee->num_ids); i++) {
+        idmap[i] = ((i + 1) < call->num_operands) ? call->operands[i + 1] : 0;
+    }
+
+    for (insn = callee->constants.first; insn != NULL; insn = insn->next) {
+        idmap[insn->operands[0]] = ir_constant(ctx, fn, insn->opcode, insn->operands + 1);
+    }
+
+    for (insn = callee->body.first; insn != NULL; insn = ir_walk(insn)) {
+        const Uint32 id = ir_output(insn);
+        if ((id != 0) && (id < callee->num_ids)) {
+            idmap[id] = ir_new_id(ctx, fn);
+        }
+    }
+
+    if (ctx->out_of_memory) {
+        return;
+    }
+
+    if ((info->num_returns == 1) && callee->body.last && (callee->body.last->opcode == SDL_SHADER_BCTAG_OP_RETURN)) {
+        /* it only returns at the end, so the code can just go right where the CALL was. */
+        const Uint32 retval = callee->body.last->operands[0];
+        copy_code(ctx, callee, callee->body.first, callee->body.last, call->block, call, idmap, NULL, NULL);
+        result = (retval < callee->num_ids) ? idmap[retval] : 0;
+    } else {
+        IrInstruction *loop = ir_instruction_create(ctx, SDL_SHADER_BCTAG_OP_LOOP, 0);
+        Uint32 *returns = (Uint32 *) ir_alloc(ctx, (info->num_returns + 1) * sizeof (Uint32));
+        Uint32 num_returns = 0;
+
+        if ((loop == NULL) || (returns == NULL)) {
+            return;
+        }
+
+        ir_insert_before(call->block, call, loop);
+        copy_code(ctx, callee, callee->body.first, NULL, &loop->children[0], NULL, idmap, returns, &num_returns);
+
+        if (callee->returns_value && (num_returns > 0)) {
+            result = returns[0];
+            for (i = 1; i < num_returns; i++) {
+                if (returns[i] != result) {
+                    IrInstruction *phi = ir_instruction_create(ctx, SDL_SHADER_BCTAG_OP_PHI, num_returns + 1);
+                    if (phi == NULL) {
+                        return;
+                    }
+                    phi->operands[0] = result = ir_new_id(ctx, fn);
+                    phi->dt = call->dt;
+                    SDL_memcpy(phi->operands + 1, returns, num_returns * sizeof (Uint32));
+                    ir_insert_before(call->block, call, phi);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (ctx->out_of_memory) {
+        return;
+    }
+
+    ir_replace_uses(ctx, fn, ir_output(call), result);
+    ir_remove(fn, call);
+}
+
+static SDL_bool inline_functions(Context *ctx)
+{
+    InlineInfo *info = (InlineInfo *) ir_alloc(ctx, (ctx->ir_num_functions + 1) * sizeof (InlineInfo));
+    IrInstruction **calls;
+    IrFunction **order;
+    IrFunction *fn;
+    IrInstruction *insn;
+    Uint32 num_ordered = 0;
+    Uint32 max_calls = 0;
+    SDL_bool changed = SDL_FALSE;
+    Uint32 i, j;
+
+    if (info == NULL) {
+        return SDL_FALSE;
+    }
+
+    for (fn = ctx->ir_functions; fn != NULL; fn = fn->next) {
+        InlineInfo *fninfo = &info[fn->index];
+        Uint32 num_calls = 0;
+        fninfo->size = ir_count_instructions(fn) - fn->num_constants;
+        fninfo->inlinable = inline_check_returns(&fn->body, SDL_FALSE, &fninfo->num_returns);
+        for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+            if (insn->opcode == SDL_SHADER_BCTAG_OP_CALL) {
+                if (insn->operands[0] < ctx->ir_num_functions) {
+                    info[insn->operands[0]].num_calls++;
+                }
+                num_calls++;
+            }
+        }
+        if (num_calls > max_calls) {
+            max_calls = num_calls;
+        }
+    }
+
+    for (fn = ctx->ir_functions; fn != NULL; fn = fn->next) {
+        if (info[fn->index].inlinable && inline_calls(ctx, info, fn, fn)) {
+            info[fn->index].inlinable = SDL_FALSE;  /* recursive. */
+        }
+    }
+
+    calls = (IrInstruction **) ir_alloc(ctx, (max_calls + 1) * sizeof (IrInstruction *));
+    order = (IrFunction **) ir_alloc(ctx, (ctx->ir_num_functions + 1) * sizeof (IrFunction *));
+    if ((calls == NULL) || (order == NULL)) {
+        return SDL_FALSE;
+    }
+
+    for (fn = ctx->ir_functions; fn != NULL; fn = fn->next) {
+        inline_order(ctx, info, fn, order, &num_ordered);
+    }
+
+    for (j = 0; (j < num_ordered) && !ctx->out_of_memory; j++) {
+        Uint32 growth = 0;
+        Uint32 num_calls = 0;
+        SDL_bool inlined = SDL_FALSE;
+
+        fn = order[j];
+        for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+            if (insn->opcode == SDL_SHADER_BCTAG_OP_CALL) {
+                calls[num_calls++] = insn;
+            }
+        }
+
+        for (i = 0; (i < num_calls) && !ctx->out_of_memory; i++) {
+            IrFunction *callee = ir_function_at(ctx, calls[i]->operands[0]);
+            InlineInfo *calleeinfo = callee ? &info[callee->index] : NULL;
+            if (!calleeinfo || !calleeinfo->inlinable || (callee == fn)) {
+                continue;
+            } else if ((fn->fast_math & ~callee->fast_math) || (fn->half_tolerance > callee->half_tolerance)) {
+                continue;
+            } else if ((calleeinfo->size > INLINE_ALWAYS_SIZE) && (calleeinfo->num_calls > 1)) {
+                if ((calleeinfo->size > INLINE_MAX_SIZE) || ((growth + calleeinfo->size) > INLINE_GROWTH_BUDGET)) {
+                    continue;
+                }
+                growth += calleeinfo->size;
+            }
+
+            inline_call(ctx, fn, calls[i], callee, calleeinfo);
+            info[fn->index].size += calleeinfo->size;
+            inlined = changed = SDL_TRUE;
+        }
+
+        if (inlined && !ctx->out_of_memory) {
+            ir_build_uses(ctx, fn);
+            ir_renumber(ctx, fn);
+        }
+    }
+
+    if (changed) {
+        ir_remove_uncalled_functions(ctx);
+    }
+
+    return changed;
+}
+
+/* Loop unrolling...
+
+   A `for` loop that counts from one constant to another runs a known number
+   of times. If that number is small, we paste the body in that many times and
+   drop the LOOP. The counter is a different constant in each copy, so array
+   indices (and anything else computed from it) are constants too, and GVN can
+   see through them. A loop that's too big for that, but whose trip count is a
+   multiple of a few, gets its body pasted a few times inside a new LOOP
+   instead, so it only checks its condition every few trips.
+
+   This only looks for loops in the shape codegen makes for `for` loops: PHIs
+   at the top, one of them compared against a constant, an IF that BREAKs when
+   that fails, and no other BREAK or CONTINUE. The counter has to start at a
+   constant and have a constant added to (or subtracted from) it each trip. */
+
+#define UNROLL_MAX_TRIPS 32  /* loops that run more times than this are never fully unrolled. */
+#define UNROLL_MAX_FACTOR 4  /* most copies of the body that partial unrolling makes. */
+#define UNROLL_BUDGET 256  /* most instructions the copies of a loop's body can add up to. */
+#define UNROLL_MAX_COUNT 65536  /* we give up on counting trips after this many. */
+
+typedef struct UnrollLoop
+{
+    IrInstruction *loop;
+    IrInstruction *cond;  /* the IF that BREAKs out of the loop. */
+    IrInstruction *counter;  /* the PHI that counts trips. */
+    Sint32 start;
+    Sint32 step;
+    Uint32 num_phis;
+    Uint32 trips;
+    Uint32 size;  /* instructions in the body after `cond`. */
+} UnrollLoop;
+
+static SDL_bool unroll_is_comparison(const SDL_SHADER_BytecodeTag opcode)
+{
+    switch (opcode) {
+        case SDL_SHADER_BCTAG_OP_LESSTHAN:
+        case SDL_SHADER_BCTAG_OP_GREATERTHAN:
+        case SDL_SHADER_BCTAG_OP_LESSTHANOREQUAL:
+        case SDL_SHADER_BCTAG_OP_GREATERTHANOREQUAL:
+        case SDL_SHADER_BCTAG_OP_EQUAL:
+        case SDL_SHADER_BCTAG_OP_NOTEQUAL:
+            return SDL_TRUE;
+        default: break;
+    }
+    return SDL_FALSE;
+}
+
+static SDL_bool unroll_compare(const SDL_SHADER_BytecodeTag opcode, const Sint64 a, const Sint64 b)
+{
+    switch (opcode) {
+        case SDL_SHADER_BCTAG_OP_LESSTHAN: return (a < b) ? SDL_TRUE : SDL_FALSE;
+        case SDL_SHADER_BCTAG_OP_GREATERTHAN: return (a > b) ? SDL_TRUE : SDL_FALSE;
+        case SDL_SHADER_BCTAG_OP_LESSTHANOREQUAL: return (a <= b) ? SDL_TRUE : SDL_FALSE;
+        case SDL_SHADER_BCTAG_OP_GREATERTHANOREQUAL: return (a >= b) ? SDL_TRUE : SDL_FALSE;
+        case SDL_SHADER_BCTAG_OP_EQUAL: return (a == b) ? SDL_TRUE : SDL_FALSE;
+        case SDL_SHADER_BCTAG_OP_NOTEQUAL: return (a != b) ? SDL_TRUE : SDL_FALSE;
+        default: break;
+    }
+    return SDL_FALSE;
+}
+
+/* SDL_FALSE if anything but `skip` can BREAK or CONTINUE out of the loop this block is in. */
+static SDL_bool unroll_check_exits(const IrBlock *block, const IrInstruction *skip)
+{
+    const IrInstruction *insn;
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        if ((insn->opcode == SDL_SHADER_BCTAG_OP_BREAK) || (insn->opcode == SDL_SHADER_BCTAG_OP_CONTINUE)) {
+            return SDL_FALSE;
+        } else if ((insn->opcode == SDL_SHADER_BCTAG_OP_IF) && (insn != skip)) {
+            if (!unroll_check_exits(&insn->children[0], NULL) || !unroll_check_exits(&insn->children[1], NULL)) {
+                return SDL_FALSE;
+            }
+        }  /* BREAKs in a nested LOOP belong to that loop. */
+    }
+    return SDL_TRUE;
+}
+
+/* instructions from `first` to the end of its block, including any code they own. */
+static Uint32 unroll_count(const IrInstruction *first)
+{
+    const IrInstruction *insn;
+    Uint32 retval = 0;
+    Uint32 i;
+    for (insn = first; insn != NULL; insn = insn->next) {
+        for (i = 0; i < ir_num_children(insn); i++) {
+            retval += unroll_count(insn->children[i].first);
+        }
+        retval++;
+    }
+    return retval;
+}
+
+/* gives everything from `first` up to `stop` (and any code they own) a new SSA id in `idmap`. */
+static void unroll_new_ids(Context *ctx, IrFunction *fn, const IrInstruction *first, const IrInstruction *stop, Uint32 *idmap)
+{
+    const IrInstruction *insn;
+    Uint32 i;
+    for (insn = first; insn != stop; insn = insn->next) {
+        const Uint32 id = ir_output(insn);
+        if (id != 0) {
+            idmap[id] = ir_new_id(ctx, fn);
+        }
+        for (i = 0; i < ir_num_children(insn); i++) {
+            unroll_new_ids(ctx, fn, insn->children[i].first, NULL, idmap);
+        }
+    }
+}
+
+/* SDL_TRUE if `loop` is a loop we know how to unroll, and fills in `info` about it. */
+static SDL_bool unroll_analyze(const IrFunction *fn, IrInstruction *loop, UnrollLoop *info)
+{
+    IrBlock *body = &loop->children[0];
+    const IrInstruction *cmp;
+    const IrInstruction *next;
+    IrInstruction *insn;
+    Uint32 counter, back;
+    Sint32 bound, step;
+    SDL_bool swapped;
+    Sint64 i;
+
+    SDL_zerop(info);
+    info->loop = loop;
+
+    for (insn = body->first; insn && (insn->opcode == SDL_SHADER_BCTAG_OP_PHI); insn = insn->next) {
+        if (insn->num_operands != 3) {
+            return SDL_FALSE;  /* something CONTINUEs to the top of the loop. */
+        }
+        info->num_phis++;
+    }
+
+    cmp = insn;
+    if (!cmp || (cmp->num_operands != 3) || !unroll_is_comparison(cmp->opcode)) {
+        return SDL_FALSE;
+    } else if (!cmp->uses || cmp->uses->next) {
+        return SDL_FALSE;  /* something besides the IF wants the condition. */
+    }
+
+    info->cond = cmp->next;
+    if (!info->cond || (info->cond->opcode != SDL_SHADER_BCTAG_OP_IF) || (info->cond->operands[0] != ir_output(cmp))) {
+        return SDL_FALSE;
+    } else if (info->cond->children[0].first || !info->cond->children[1].first || (info->cond->children[1].first != info->cond->children[1].last)) {
+        return SDL_FALSE;
+    } else if (info->cond->children[1].first->opcode != SDL_SHADER_BCTAG_OP_BREAK) {
+        return SDL_FALSE;
+    } else if (!unroll_check_exits(body, info->cond)) {
+        return SDL_FALSE;
+    } else if (loop->next && (loop->next->opcode == SDL_SHADER_BCTAG_OP_PHI)) {
+        return SDL_FALSE;  /* we only BREAK in one place, but be careful anyhow. */
+    }
+
+    /* one side of the comparison is a constant, the other is one of our PHIs. */
+    swapped = literal_int(fn, cmp->operands[1], &bound);
+    if (!swapped && !literal_int(fn, cmp->operands[2], &bound)) {
+        return SDL_FALSE;
+    }
+
+    counter = cmp->operands[swapped ? 2 : 1];
+    info->counter = (counter < fn->num_ids) ? fn->defs[counter] : NULL;
+    if (!info->counter || (info->counter->opcode != SDL_SHADER_BCTAG_OP_PHI) || (info->counter->block != body)) {
+        return SDL_FALSE;
+    } else if (!literal_int(fn, info->counter->operands[1], &info->start)) {
+        return SDL_FALSE;
+    }
+
+    back = info->counter->operands[2];
+    next = (back < fn->num_ids) ? fn->defs[back] : NULL;
+    if (!next || (next->num_operands != 3)) {
+        return SDL_FALSE;
+    } else if ((next->opcode == SDL_SHADER_BCTAG_OP_ADD) && (next->operands[1] == counter) && literal_int(fn, next->operands[2], &step)) {
+        info->step = step;
+    } else if ((next->opcode == SDL_SHADER_BCTAG_OP_ADD) && (next->operands[2] == counter) && literal_int(fn, next->operands[1], &step)) {
+        info->step = step;
+    } else if ((next->opcode == SDL_SHADER_BCTAG_OP_SUBTRACT) && (next->operands[1] == counter) && literal_int(fn, next->operands[2], &step) && (step != SDL_MIN_SINT32)) {
+        info->step = -step;
+    } else {
+        return SDL_FALSE;
+    }
+
+    if (info->step == 0) {
+        return SDL_FALSE;
+    }
+
+    /* just run the loop to count the trips, so we don't have to think hard about every comparison. */
+    for (i = info->start; swapped ? unroll_compare(cmp->opcode, bound, i) : unroll_compare(cmp->opcode, i, bound); i += info->step) {
+        if (++info->trips > UNROLL_MAX_COUNT) {
+            return SDL_FALSE;
+        } else if (((i + info->step) < SDL_MIN_SINT32) || ((i + info->step) > SDL_MAX_SINT32)) {
+            return SDL_FALSE;  /* it would overflow, don't try to guess what the GPU does then. */
+        }
+    }
+
+    info->size = unroll_count(info->cond->next);
+    return SDL_TRUE;
+}
+
+/* value of the counter on trip `trip`, in `fn`'s constant pool. */
+static Uint32 unroll_counter_value(Context *ctx, IrFunction *fn, const UnrollLoop *info, const Uint32 trip)
+{
+    const Uint32 value = (Uint32) (Sint32) (((Sint64) info->start) + (((Sint64) trip) * info->step));  /* unroll_analyze() made sure this fits. */
+    return ir_constant(ctx, fn, SDL_SHADER_BCTAG_OP_LITERALINT, &value);
+}
+
+/* makes `factor` copies of the loop's body. If that's every trip, the LOOP goes away, otherwise they go in a new LOOP that replaces it. */
+static void unroll_loop(Context *ctx, IrFunction *fn, const UnrollLoop *info, const Uint32 factor)
+{
+    const SDL_bool full = (factor == info->trips) ? SDL_TRUE : SDL_FALSE;
+    IrInstruction *loop = info->loop;
+    const IrInstruction *work = info->cond->next;  /* the loop's body, after the condition. */
+    Uint32 *idmap = (Uint32 *) ir_alloc(ctx, fn->num_ids * sizeof (Uint32));
+    Uint32 *values = (Uint32 *) ir_alloc(ctx, info->num_phis * sizeof (Uint32));
+    Uint32 *nextvalues = (Uint32 *) ir_alloc(ctx, info->num_phis * sizeof (Uint32));
+    IrInstruction *newloop = NULL;
+    IrBlock *dst = loop->block;
+    IrInstruction *before = loop;
+    const IrInstruction *phi;
+    Uint32 i, j;
+
+    if (!idmap || !values || !nextvalues) {
+        return;
+    }
+
+    for (i = 0; i < fn->num_ids; i++) {
+        idmap[i] = i;  /* anything from outside the loop stays as it is. */
+    }
+
+    if (!full) {
+        if ((newloop = ir_instruction_create(ctx, SDL_SHADER_BCTAG_OP_LOOP, 0)) == NULL) {
+            return;
+        }
+        ir_insert_before(loop->block, loop, newloop);
+        unroll_new_ids(ctx, fn, loop->children[0].first, work, idmap);
+        copy_code(ctx, fn, loop->children[0].first, work, &newloop->children[0], NULL, idmap, NULL, NULL);
+        dst = &newloop->children[0];
+        before = NULL;
+    }
+
+    for (j = 0, phi = loop->children[0].first; j < info->num_phis; j++, phi = phi->next) {
+        values[j] = full ? phi->operands[1] : idmap[phi->operands[0]];
+    }
+
+    for (i = 0; (i < factor) && !ctx->out_of_memory; i++) {
+        for (j = 0, phi = loop->children[0].first; j < info->num_phis; j++, phi = phi->next) {
+            idmap[phi->operands[0]] = (full && (phi == info->counter)) ? unroll_counter_value(ctx, fn, info, i) : values[j];
+        }
+        unroll_new_ids(ctx, fn, work, NULL, idmap);
+        copy_code(ctx, fn, work, NULL, dst, before, idmap, NULL, NULL);
+        for (j = 0, phi = loop->children[0].first; j < info->num_phis; j++, phi = phi->next) {
+            nextvalues[j] = idmap[phi->operands[2]];
+        }
+        SDL_memcpy(values, nextvalues, info->num_phis * sizeof (Uint32));
+    }
+
+    if (ctx->out_of_memory) {
+        return;
+    }
+
+    /* code after the loop sees the PHIs' values from when the condition failed. */
+    for (j = 0, phi = loop->children[0].first; j < info->num_phis; j++, phi = phi->next) {
+        Uint32 exitvalue;
+        if (newloop) {
+            IrInstruction *newphi = newloop->children[0].first;
+            for (i = 0; i < j; i++) {
+                newphi = newphi->next;
+            }
+            newphi->operands[2] = values[j];  /* the next trip starts with the last copy's values. */
+            exitvalue = newphi->operands[0];
+        } else {
+            exitvalue = (phi == info->counter) ? unroll_counter_value(ctx, fn, info, info->trips) : values[j];
+        }
+        ir_replace_uses(ctx, fn, phi->operands[0], exitvalue);
+    }
+
+    ir_remove(fn, loop);
+    ir_build_uses(ctx, fn);
+}
+
+/* unrolls what it can in `block`, innermost loops first, so outer loops see how big they really are. */
+static SDL_bool unroll_block(Context *ctx, IrFunction *fn, IrBlock *block)
+{
+    SDL_bool changed = SDL_FALSE;
+    IrInstruction *insn;
+    IrInstruction *next;
+    UnrollLoop info;
+    Uint32 factor;
+    Uint32 i;
+
+    for (insn = block->first; (insn != NULL) && !ctx->out_of_memory; insn = next) {
+        next = insn->next;
+        for (i = 0; i < ir_num_children(insn); i++) {
+            changed = unroll_block(ctx, fn, &insn->children[i]) || changed;
+        }
+
+        if ((insn->opcode != SDL_SHADER_BCTAG_OP_LOOP) || !unroll_analyze(fn, insn, &info)) {
+            continue;
+        }
+
+        if ((info.trips <= UNROLL_MAX_TRIPS) && ((info.trips * info.size) <= UNROLL_BUDGET)) {
+            factor = info.trips;
+        } else {
+            for (factor = UNROLL_MAX_FACTOR; factor > 1; factor--) {
+                if (((info.trips % factor) == 0) && ((factor * info.size) <= UNROLL_BUDGET)) {
+                    break;
+                }
+            }
+            if (factor <= 1) {
+                continue;
+            }
+        }
+
+        unroll_loop(ctx, fn, &info, factor);
+        changed = SDL_TRUE;
+    }
+
+    return changed;
+}
+
+static SDL_bool unroll(Context *ctx, IrFunction *fn)
+{
+    const SDL_bool changed = unroll_block(ctx, fn, &fn->body);
+    if (changed) {
+        ir_remove_unused_constants(fn);
+        ir_renumber(ctx, fn);
+    }
+    return changed;
+}
+
+/* Peephole simplification...
+
+   Codegen writes out exactly what the source says, and inlining and unrolling
+   leave more of the same behind, so this looks at one instruction at a time
+   (and whatever makes its inputs) for something cheaper that means the same:
+
+   - x*1, x/1, x+0, x-0, -(-x), ~(~x) and !(!x) are all just x.
+   - !(a < b) is a >= b, and so on for the other comparisons.
+   - int and uint multiplies by a power of two are left shifts, and so are
+     uint divides (right shifts, then). Signed divides round toward zero and
+     shifts don't, so those stay.
+   - pow(x, 2.0) is x*x, 1.0/sqrt(x) is rsqrt(x), and a*b+c is mad(a, b, c).
+
+   Some of these can change a float result (x+0.0 when x is -0.0, !(a < b) when
+   a is NaN, mad() not rounding a*b first...), so those only happen when the
+   matching SDL_SHADER_FASTMATH_* flag is set for the function (never, in a
+   @precise one). All of this needs datatypes, so anything codegen didn't give
+   one to is left alone. */
+
+/* SDL_TRUE if `id` is a constant with every component the same, and stores those bits in `bits`. */
+static SDL_bool peephole_splat(const IrFunction *fn, const Uint32 id, Uint32 *bits)
+{
+    const IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+    Uint32 i;
+
+    if (!def) {
+        return SDL_FALSE;
+    }
+
+    switch (def->opcode) {
+        case SDL_SHADER_BCTAG_OP_LITERALINT:
+        case SDL_SHADER_BCTAG_OP_LITERALFLOAT:
+            *bits = def->operands[1];
+            return SDL_TRUE;
+
+        case SDL_SHADER_BCTAG_OP_LITERALINT4:
+        case SDL_SHADER_BCTAG_OP_LITERALFLOAT4:
+            *bits = def->operands[1];
+            return ((def->operands[2] == *bits) && (def->operands[3] == *bits) && (def->operands[4] == *bits)) ? SDL_TRUE : SDL_FALSE;
+
+        case SDL_SHADER_BCTAG_OP_CONSTRUCT:  /* codegen builds float2 and float3 constants out of scalar literals. */
+            if ((def->operands[1] == 0) || (def->num_operands < 3) || !peephole_splat(fn, def->operands[2], bits)) {
+                return SDL_FALSE;
+            }
+            for (i = 3; i < def->num_operands; i++) {
+                if (def->operands[i] != def->operands[2]) {
+                    return SDL_FALSE;
+                }
+            }
+            return SDL_TRUE;
+
+        default: break;
+    }
+
+    return SDL_FALSE;
+}
+
+static SDL_bool peephole_splat_is(const IrFunction *fn, const Uint32 id, const Uint32 want)
+{
+    Uint32 bits;
+    return (peephole_splat(fn, id, &bits) && (bits == want)) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* SDL_TRUE if `id` is known to be datatype `dt`. Literals don't have one, but a literal the right shape for a float or int `dt` counts. */
+static SDL_bool peephole_has_type(const IrFunction *fn, const Uint32 id, const DataType *dt)
+{
+    const IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+    const SDL_bool vec4 = (dt && (dt->dtype == DT_VECTOR) && (dt->info.vector.elements == 4)) ? SDL_TRUE : SDL_FALSE;
+    const SDL_bool scalar = (dt && (scalar_type(dt) == dt)) ? SDL_TRUE : SDL_FALSE;
+
+    if (!dt) {
+        return SDL_FALSE;
+    } else if (ir_datatype(fn, id) == dt) {
+        return SDL_TRUE;
+    } else if (!def) {
+        return SDL_FALSE;
+    }
+
+    switch (def->opcode) {
+        case SDL_SHADER_BCTAG_OP_LITERALFLOAT: return (scalar && is_float_type(dt)) ? SDL_TRUE : SDL_FALSE;
+        case SDL_SHADER_BCTAG_OP_LITERALFLOAT4: return (vec4 && is_float_type(dt)) ? SDL_TRUE : SDL_FALSE;
+        case SDL_SHADER_BCTAG_OP_LITERALINT: return (scalar && is_int_type(dt)) ? SDL_TRUE : SDL_FALSE;
+        case SDL_SHADER_BCTAG_OP_LITERALINT4: return (vec4 && is_int_type(dt)) ? SDL_TRUE : SDL_FALSE;
+        default: break;
+    }
+
+    return SDL_FALSE;
+}
+
+/* log2 of `bits` if it's a power of two greater than one, otherwise zero. */
+static Uint32 peephole_log2(const Uint32 bits)
+{
+    Uint32 retval = 0;
+    if ((bits < 2) || ((bits & (bits - 1)) != 0)) {
+        return 0;
+    }
+    while ((1u << retval) != bits) {
+        retval++;
+    }
+    return retval;
+}
+
+/* a shift count for `value`, the same shape as the constant `like`. */
+static Uint32 peephole_shift_count(Context *ctx, IrFunction *fn, const Uint32 like, const Uint32 count)
+{
+    const Uint32 values[4] = { count, count, count, count };
+    switch (fn->defs[like]->opcode) {
+        case SDL_SHADER_BCTAG_OP_LITERALINT: return ir_constant(ctx, fn, SDL_SHADER_BCTAG_OP_LITERALINT, values);
+        case SDL_SHADER_BCTAG_OP_LITERALINT4: return ir_constant(ctx, fn, SDL_SHADER_BCTAG_OP_LITERALINT4, values);
+        default: break;
+    }
+    return 0;  /* a CONSTRUCTed int2 or int3; we'd have to build one, so don't bother. */
+}
+
+/* adds `opcode %new, a, b[, c]` before `insn`, with `insn`'s datatype, and returns %new (or 0 if we're out of memory). */
+static Uint32 peephole_emit(Context *ctx, IrFunction *fn, IrInstruction *insn, const SDL_SHADER_BytecodeTag opcode, const Uint32 num_inputs, const Uint32 a, const Uint32 b, const Uint32 c)
+{
+    const Uint32 inputs[3] = { a, b, c };
+    IrInstruction *newinsn = ir_instruction_create(ctx, opcode, num_inputs + 1);
+    const Uint32 id = ir_new_id(ctx, fn);
+    Uint32 i;
+
+    if (!newinsn || !id) {
+        return 0;
+    }
+
+    newinsn->operands[0] = id;
+    newinsn->dt = insn->dt;
+    ir_insert_before(insn->block, insn, newinsn);
+    fn->defs[id] = newinsn;
+    for (i = 0; i < num_inputs; i++) {
+        ir_set_input(ctx, fn, newinsn, i + 1, inputs[i]);
+    }
+    return id;
+}
+
+static SDL_SHADER_BytecodeTag peephole_inverse_comparison(const SDL_SHADER_BytecodeTag opcode)
+{
+    switch (opcode) {
+        case SDL_SHADER_BCTAG_OP_LESSTHAN: return SDL_SHADER_BCTAG_OP_GREATERTHANOREQUAL;
+        case SDL_SHADER_BCTAG_OP_GREATERTHAN: return SDL_SHADER_BCTAG_OP_LESSTHANOREQUAL;
+        case SDL_SHADER_BCTAG_OP_LESSTHANOREQUAL: return SDL_SHADER_BCTAG_OP_GREATERTHAN;
+        case SDL_SHADER_BCTAG_OP_GREATERTHANOREQUAL: return SDL_SHADER_BCTAG_OP_LESSTHAN;
+        case SDL_SHADER_BCTAG_OP_EQUAL: return SDL_SHADER_BCTAG_OP_NOTEQUAL;
+        case SDL_SHADER_BCTAG_OP_NOTEQUAL: return SDL_SHADER_BCTAG_OP_EQUAL;
+        default: break;
+    }
+    return SDL_SHADER_BCTAG_OP_NOP;
+}
+
+/* `!(a < b)` and friends. Only EQUAL and NOTEQUAL flip exactly when a float might be NaN. */
+static Uint32 peephole_not_comparison(Context *ctx, IrFunction *fn, IrInstruction *insn, const IrInstruction *cmp)
+{
+    const SDL_SHADER_BytecodeTag inverse = peephole_inverse_comparison(cmp->opcode);
+    const Uint32 a = cmp->operands[1];
+    const Uint32 b = cmp->operands[2];
+    const DataType *dt = ir_datatype(fn, a) ? ir_datatype(fn, a) : ir_datatype(fn, b);
+    const IrInstruction *adef = (a < fn->num_ids) ? fn->defs[a] : NULL;
+    SDL_bool is_float;
+
+    if (inverse == SDL_SHADER_BCTAG_OP_NOP) {
+        return 0;
+    } else if (dt) {
+        is_float = is_float_type(dt);
+    } else if (adef && ((adef->opcode == SDL_SHADER_BCTAG_OP_LITERALINT) || (adef->opcode == SDL_SHADER_BCTAG_OP_LITERALINT4))) {
+        is_float = SDL_FALSE;
+    } else {
+        return 0;  /* we can't tell. */
+    }
+
+    if (is_float && (inverse != SDL_SHADER_BCTAG_OP_EQUAL) && (inverse != SDL_SHADER_BCTAG_OP_NOTEQUAL) && !(fn->fast_math & SDL_SHADER_FASTMATH_NO_NANS)) {
+        return 0;
+    }
+
+    return peephole_emit(ctx, fn, insn, inverse, 2, a, b, 0);
+}
+
+/* `a*b+c`, where `mul` is `a*b` and nothing else uses it. */
+static Uint32 peephole_mad(Context *ctx, IrFunction *fn, IrInstruction *insn, const Uint32 mul, const Uint32 c)
+{
+    const IrInstruction *def = (mul < fn->num_ids) ? fn->defs[mul] : NULL;
+    if (!def || (def->opcode != SDL_SHADER_BCTAG_OP_MULTIPLY) || (def->dt != insn->dt) || !def->uses || def->uses->next) {
+        return 0;
+    } else if (!peephole_has_type(fn, def->operands[1], insn->dt) || !peephole_has_type(fn, def->operands[2], insn->dt) || !peephole_has_type(fn, c, insn->dt)) {
+        return 0;  /* mad() wants three of the same thing, it doesn't splat scalars like `*` and `+` do. */
+    }
+    return peephole_emit(ctx, fn, insn, SDL_SHADER_BCTAG_OP_MAD, 3, def->operands[1], def->operands[2], c);
+}
+
+/* an SSA id `insn` can be replaced with, or 0 if it can't. This might add an instruction for it. */
+static Uint32 peephole_simplify(Context *ctx, IrFunction *fn, IrInstruction *insn)
+{
+    const DataType *dt = insn->dt;
+    const SDL_bool is_float = is_float_type(dt);
+    const SDL_bool is_int = is_int_type(dt);
+    const Uint32 one = is_float ? 0x3F800000 : 1;
+    const Uint32 a = (insn->num_operands > 1) ? insn->operands[1] : 0;
+    const Uint32 b = (insn->num_operands > 2) ? insn->operands[2] : 0;
+    const IrInstruction *adef = (a < fn->num_ids) ? fn->defs[a] : NULL;
+    const IrInstruction *bdef = (b < fn->num_ids) ? fn->defs[b] : NULL;
+    Uint32 bits, retval;
+
+    if (!is_float && !is_int && (scalar_type(dt) == NULL)) {
+        return 0;  /* matrices, structs, things codegen didn't give a datatype... */
+    }
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_NEGATE:
+        case SDL_SHADER_BCTAG_OP_COMPLEMENT:
+        case SDL_SHADER_BCTAG_OP_NOT:
+            if (adef && (adef->opcode == insn->opcode)) {
+                return adef->operands[1];
+            } else if (adef && (insn->opcode == SDL_SHADER_BCTAG_OP_NOT)) {
+                return peephole_not_comparison(ctx, fn, insn, adef);
+            }
+            break;
+
+        case SDL_SHADER_BCTAG_OP_MULTIPLY:
+            if ((is_float || is_int) && peephole_splat_is(fn, b, one) && (ir_datatype(fn, a) == dt)) {
+                return a;
+            } else if ((is_float || is_int) && peephole_splat_is(fn, a, one) && (ir_datatype(fn, b) == dt)) {
+                return b;
+            } else if (is_int && peephole_splat(fn, b, &bits) && peephole_log2(bits) && (ir_datatype(fn, a) == dt) && ((retval = peephole_shift_count(ctx, fn, b, peephole_log2(bits))) != 0)) {
+                return peephole_emit(ctx, fn, insn, SDL_SHADER_BCTAG_OP_SHIFTLEFT, 2, a, retval, 0);
+            } else if (is_int && peephole_splat(fn, a, &bits) && peephole_log2(bits) && (ir_datatype(fn, b) == dt) && ((retval = peephole_shift_count(ctx, fn, a, peephole_log2(bits))) != 0)) {
+                return peephole_emit(ctx, fn, insn, SDL_SHADER_BCTAG_OP_SHIFTLEFT, 2, b, retval, 0);
+            }
+            break;
+
+        case SDL_SHADER_BCTAG_OP_DIVIDE:
+            if ((is_float || is_int) && peephole_splat_is(fn, b, one) && (ir_datatype(fn, a) == dt)) {
+                return a;
+            } else if (is_int && (scalar_type(dt)->dtype == DT_UINT) && peephole_splat(fn, b, &bits) && peephole_log2(bits) && (ir_datatype(fn, a) == dt) && ((retval = peephole_shift_count(ctx, fn, b, peephole_log2(bits))) != 0)) {
+                return peephole_emit(ctx, fn, insn, SDL_SHADER_BCTAG_OP_SHIFTRIGHT, 2, a, retval, 0);
+            } else if (is_float && (fn->fast_math & SDL_SHADER_FASTMATH_RECIPROCAL) && peephole_splat_is(fn, a, 0x3F800000) && bdef && (bdef->opcode == SDL_SHADER_BCTAG_OP_SQRT) && (bdef->dt == dt)) {
+                return peephole_emit(ctx, fn, insn, SDL_SHADER_BCTAG_OP_RSQRT, 1, bdef->operands[1], 0, 0);
+            }
+            break;
+
+        case SDL_SHADER_BCTAG_OP_ADD:
+            /* x + -0.0 is always x, but x + 0.0 isn't when x is -0.0. */
+            if (is_int && peephole_splat_is(fn, b, 0) && (ir_datatype(fn, a) == dt)) {
+                return a;
+            } else if (is_int && peephole_splat_is(fn, a, 0) && (ir_datatype(fn, b) == dt)) {
+                return b;
+            } else if (is_float && (peephole_splat_is(fn, b, 0x80000000) || ((fn->fast_math & SDL_SHADER_FASTMATH_REASSOCIATE) && peephole_splat_is(fn, b, 0))) && (ir_datatype(fn, a) == dt)) {
+                return a;
+            } else if (is_float && (peephole_splat_is(fn, a, 0x80000000) || ((fn->fast_math & SDL_SHADER_FASTMATH_REASSOCIATE) && peephole_splat_is(fn, a, 0))) && (ir_datatype(fn, b) == dt)) {
+                return b;
+            } else if (is_float && (fn->fast_math & SDL_SHADER_FASTMATH_CONTRACT)) {
+                if ((retval = peephole_mad(ctx, fn, insn, a, b)) != 0) {
+                    return retval;
+                }
+                return peephole_mad(ctx, fn, insn, b, a);
+            }
+            break;
+
+        case SDL_SHADER_BCTAG_OP_SUBTRACT:
+            if ((is_float || is_int) && peephole_splat_is(fn, b, 0) && (ir_datatype(fn, a) == dt)) {
+                return a;  /* x - 0.0 is x, even for -0.0. */
+            }
+            break;
+
+        case SDL_SHADER_BCTAG_OP_POW:
+            if (is_float && (fn->fast_math & SDL_SHADER_FASTMATH_REASSOCIATE) && peephole_splat_is(fn, b, 0x40000000) && (ir_datatype(fn, a) == dt)) {
+                return peephole_emit(ctx, fn, insn, SDL_SHADER_BCTAG_OP_MULTIPLY, 2, a, a, 0);
+            }
+            break;
+
+        default: break;
+    }
+
+    return 0;
+}
+
+static SDL_bool peephole(Context *ctx, IrFunction *fn)
+{
+    SDL_bool changed = SDL_FALSE;
+    IrInstruction *insn;
+    IrInstruction *next;
+
+    for (insn = fn->body.first; (insn != NULL) && !ctx->out_of_memory; insn = next) {
+        const Uint32 replacement = peephole_simplify(ctx, fn, insn);
+        next = ir_walk(insn);
+        if (replacement != 0) {
+            ir_replace_uses(ctx, fn, ir_output(insn), replacement);
+            ir_remove(fn, insn);
+            changed = SDL_TRUE;
+        }
+    }
+
+    if (changed) {
+        ir_remove_unused_constants(fn);
+        ir_renumber(ctx, fn);
+    }
+
+    return changed;
+}
+
+/* Swizzles...
+
+   Codegen makes a SWIZZLE for every `.xyz` in the source, so `v.xyzw.zyx.x` is
+   three of them, and `.xyz` on a float3 is one that doesn't change anything.
+   This pass composes chains of swizzles into one, drops the ones that put every
+   lane back where it was, and picks a single lane straight out of whatever
+   built the vector (a constant, a CONSTRUCT of scalars, or INSERTs at constant
+   lanes, which is what `v.y = x;` makes) instead of swizzling it.
+
+   A swizzle of component-wise math, like `(a.zyx * s).x`, can also be pushed
+   into the math's inputs, so it becomes `a.z * s`: the swizzle on `a` merges
+   with the one we pushed in, scalars like `s` don't need one at all, and the
+   math is done on fewer lanes. That only happens if nothing else uses the
+   math's result and it doesn't make more instructions than it removes. */
+
+static Uint32 swizzle_lane(const Uint32 swizvals, const Uint32 i)
+{
+    return (swizvals >> (i * 8)) & 0xFF;
+}
+
+/* how many lanes a SWIZZLE's `swizvals` produces; the first one that's > 3 ends the list. */
+static Uint32 swizzle_lanes(const Uint32 swizvals)
+{
+    Uint32 i;
+    for (i = 0; (i < 4) && (swizzle_lane(swizvals, i) <= 3); i++) { /* spin */ }
+    return i;
+}
+
+/* the lanes of `inner` that `outer` picks, as one `swizvals`. SDL_FALSE if `outer` picks lanes `inner` doesn't have. */
+static SDL_bool swizzle_compose(const Uint32 inner, const Uint32 outer, Uint32 *_swizvals)
+{
+    const Uint32 num_inner = swizzle_lanes(inner);
+    const Uint32 num_outer = swizzle_lanes(outer);
+    Uint32 swizvals = 0xFFFFFFFF;
+    Uint32 i;
+
+    for (i = 0; i < num_outer; i++) {
+        const Uint32 lane = swizzle_lane(outer, i);
+        if (lane >= num_inner) {
+            return SDL_FALSE;
+        }
+        swizvals &= ~(0xFFu << (i * 8));
+        swizvals |= swizzle_lane(inner, lane) << (i * 8);
+    }
+
+    *_swizvals = swizvals;
+    return SDL_TRUE;
+}
+
+/* SDL_TRUE if `swizvals` picks every lane of something `width` lanes wide, in order. */
+static SDL_bool swizzle_is_identity(const Uint32 swizvals, const Uint32 width)
+{
+    Uint32 i;
+    if (swizzle_lanes(swizvals) != width) {
+        return SDL_FALSE;
+    }
+    for (i = 0; i < width; i++) {
+        if (swizzle_lane(swizvals, i) != i) {
+            return SDL_FALSE;
+        }
+    }
+    return SDL_TRUE;
+}
+
+/* how many lanes `id` has: 1 for a scalar, 0 if we can't tell or it's not a scalar or vector. */
+static Uint32 swizzle_width(const IrFunction *fn, const Uint32 id)
+{
+    const IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+    const DataType *dt = ir_datatype(fn, id);
+
+    if (dt) {
+        if (dt->dtype == DT_VECTOR) {
+            return dt->info.vector.elements;
+        }
+        return (scalar_type(dt) == dt) ? 1 : 0;
+    } else if (!def) {
+        return 0;
+    }
+
+    switch (def->opcode) {
+        case SDL_SHADER_BCTAG_OP_LITERALINT:
+        case SDL_SHADER_BCTAG_OP_LITERALFLOAT:
+            return 1;
+        case SDL_SHADER_BCTAG_OP_LITERALINT4:
+        case SDL_SHADER_BCTAG_OP_LITERALFLOAT4:
+            return 4;
+        case SDL_SHADER_BCTAG_OP_SWIZZLE:
+            return swizzle_lanes(def->operands[2]);
+        case SDL_SHADER_BCTAG_OP_CONSTRUCT:  /* matrices have rows in the type word, and zero means a struct or array. */
+            return ((def->operands[1] >> 16) == 1) ? ((def->operands[1] >> 8) & 0xFF) : 0;
+        default: break;
+    }
+    return 0;
+}
+
+/* the value of lane `lane` of `src`, if we can get it without a SWIZZLE, or 0. */
+static Uint32 swizzle_pick(Context *ctx, IrFunction *fn, Uint32 src, const Uint32 lane)
+{
+    const IrInstruction *def;
+    Sint32 idx;
+    Uint32 i;
+
+    while (((def = ((src < fn->num_ids) ? fn->defs[src] : NULL)) != NULL) && (def->opcode == SDL_SHADER_BCTAG_OP_INSERT) && literal_int(fn, def->operands[2], &idx)) {
+        if (((Uint32) idx) == lane) {
+            return def->operands[3];
+        }
+        src = def->operands[1];  /* a different lane, so look past it. */
+    }
+
+    if (!def) {
+        return 0;
+    }
+
+    switch (def->opcode) {
+        case SDL_SHADER_BCTAG_OP_LITERALINT4:
+            return ir_constant(ctx, fn, SDL_SHADER_BCTAG_OP_LITERALINT, &def->operands[1 + lane]);
+        case SDL_SHADER_BCTAG_OP_LITERALFLOAT4:
+            return ir_constant(ctx, fn, SDL_SHADER_BCTAG_OP_LITERALFLOAT, &def->operands[1 + lane]);
+        case SDL_SHADER_BCTAG_OP_CONSTRUCT:
+            if (swizzle_width(fn, src) != (def->num_operands - 2)) {
+                return 0;  /* not built from one scalar per lane. */
+            }
+            for (i = 2; i < def->num_operands; i++) {
+                if (swizzle_width(fn, def->operands[i]) != 1) {
+                    return 0;
+                }
+            }
+            return def->operands[2 + lane];
+        default: break;
+    }
+    return 0;
+}
+
+/* simplifies swizzling `*src` by `*swizvals`, composing it with any SWIZZLE that made `*src`. Returns the
+   result if that needs no SWIZZLE at all, or 0 with `*src` and `*swizvals` updated to what to swizzle instead. */
+static Uint32 swizzle_fold(Context *ctx, IrFunction *fn, Uint32 *src, Uint32 *swizvals)
+{
+    const IrInstruction *def;
+    Uint32 num_lanes, composed, i;
+
+    while (((def = ((*src < fn->num_ids) ? fn->defs[*src] : NULL)) != NULL) && (def->opcode == SDL_SHADER_BCTAG_OP_SWIZZLE) && swizzle_compose(def->operands[2], *swizvals, &composed)) {
+        *src = def->operands[1];
+        *swizvals = composed;
+    }
+
+    num_lanes = swizzle_lanes(*swizvals);
+    if (swizzle_is_identity(*swizvals, swizzle_width(fn, *src))) {
+        return *src;
+    } else if (num_lanes == 1) {
+        return swizzle_pick(ctx, fn, *src, swizzle_lane(*swizvals, 0));
+    } else if (def && (num_lanes == 4) && ((def->opcode == SDL_SHADER_BCTAG_OP_LITERALINT4) || (def->opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT4))) {
+        Uint32 values[4];
+        for (i = 0; i < 4; i++) {
+            values[i] = def->operands[1 + swizzle_lane(*swizvals, i)];
+        }
+        return ir_constant(ctx, fn, def->opcode, values);
+    }
+
+    return 0;
+}
+
+static Uint32 swizzle_emit(Context *ctx, IrFunction *fn, IrInstruction *before, const Uint32 src, const Uint32 swizvals)
+{
+    IrInstruction *newinsn = ir_instruction_create(ctx, SDL_SHADER_BCTAG_OP_SWIZZLE, 3);
+    const Uint32 id = ir_new_id(ctx, fn);
+
+    if (!newinsn || !id) {
+        return 0;
+    }
+
+    newinsn->operands[0] = id;
+    newinsn->operands[2] = swizvals;  /* not an SSA id, so not an input. */
+    newinsn->dt = narrow_datatype(ctx, ir_datatype(fn, src), swizzle_lanes(swizvals));
+    ir_insert_before(before->block, before, newinsn);
+    fn->defs[id] = newinsn;
+    ir_set_input(ctx, fn, newinsn, 1, src);
+    return id;
+}
+
+/* SDL_TRUE if `opcode` works on each lane separately, so it can be done on just the lanes someone wants. */
+static SDL_bool swizzle_is_componentwise(const SDL_SHADER_BytecodeTag opcode)
+{
+    switch (opcode) {
+        case SDL_SHADER_BCTAG_OP_NEGATE:
+        case SDL_SHADER_BCTAG_OP_COMPLEMENT:
+        case SDL_SHADER_BCTAG_OP_MULTIPLY:  /* matrix multiplies have an input with no width, so they're skipped. */
+        case SDL_SHADER_BCTAG_OP_DIVIDE:
+        case SDL_SHADER_BCTAG_OP_MODULO:
+        case SDL_SHADER_BCTAG_OP_ADD:
+        case SDL_SHADER_BCTAG_OP_SUBTRACT:
+        case SDL_SHADER_BCTAG_OP_SHIFTLEFT:
+        case SDL_SHADER_BCTAG_OP_SHIFTRIGHT:
+        case SDL_SHADER_BCTAG_OP_BINARYAND:
+        case SDL_SHADER_BCTAG_OP_BINARYOR:
+        case SDL_SHADER_BCTAG_OP_BINARYXOR:
+        case SDL_SHADER_BCTAG_OP_ABS:
+        case SDL_SHADER_BCTAG_OP_SIGN:
+        case SDL_SHADER_BCTAG_OP_FLOOR:
+        case SDL_SHADER_BCTAG_OP_CEIL:
+        case SDL_SHADER_BCTAG_OP_FRACT:
+        case SDL_SHADER_BCTAG_OP_TRUNC:
+        case SDL_SHADER_BCTAG_OP_SQRT:
+        case SDL_SHADER_BCTAG_OP_RSQRT:
+        case SDL_SHADER_BCTAG_OP_MIN:
+        case SDL_SHADER_BCTAG_OP_MAX:
+        case SDL_SHADER_BCTAG_OP_CLAMP:
+        case SDL_SHADER_BCTAG_OP_MIX:
+        case SDL_SHADER_BCTAG_OP_MAD:
+            return SDL_TRUE;
+        default: break;
+    }
+    return SDL_FALSE;
+}
+
+/* `(a op b).xy` as `a.xy op b.xy`, if that's no more instructions than it was. 0 if it isn't. */
+static Uint32 swizzle_push(Context *ctx, IrFunction *fn, IrInstruction *insn, const Uint32 src, const Uint32 swizvals)
+{
+    IrInstruction *def = (src < fn->num_ids) ? fn->defs[src] : NULL;
+    const Uint32 num_lanes = swizzle_lanes(swizvals);
+    const Uint32 width = swizzle_width(fn, src);
+    Uint32 inputs[3] = { 0, 0, 0 };
+    Uint32 added = 0;
+    Uint32 id, i;
+
+    if (!def || !swizzle_is_componentwise(def->opcode) || (def->num_operands < 2) || (def->num_operands > 4)) {
+        return 0;
+    } else if (!def->uses || def->uses->next || (width < 2)) {
+        return 0;  /* something else still needs all of it. */
+    }
+
+    /* each vector input needs a SWIZZLE of its own, unless we can fold it away or it replaces one that only this used. */
+    for (i = 1; i < def->num_operands; i++) {
+        const IrInstruction *indef = (def->operands[i] < fn->num_ids) ? fn->defs[def->operands[i]] : NULL;
+        const Uint32 inwidth = swizzle_width(fn, def->operands[i]);
+        Uint32 in = def->operands[i];
+        Uint32 inswizvals = swizvals;
+        if (inwidth == 1) {
+            continue;  /* scalars splat to whatever width they need. */
+        } else if (inwidth != width) {
+            return 0;
+        } else if (swizzle_fold(ctx, fn, &in, &inswizvals) != 0) {
+            continue;
+        } else if (!indef || (indef->opcode != SDL_SHADER_BCTAG_OP_SWIZZLE) || !indef->uses || indef->uses->next) {
+            added++;
+        }
+    }
+
+    /* removing this SWIZZLE pays for one new one, but only bother if the math gets narrower. */
+    if (added > ((num_lanes < width) ? 1 : 0)) {
+        return 0;
+    }
+
+    for (i = 1; i < def->num_operands; i++) {
+        Uint32 in = def->operands[i];
+        Uint32 inswizvals = swizvals;
+        if (swizzle_width(fn, in) == 1) {
+            inputs[i - 1] = in;
+        } else if ((inputs[i - 1] = swizzle_fold(ctx, fn, &in, &inswizvals)) == 0) {
+            inputs[i - 1] = swizzle_emit(ctx, fn, insn, in, inswizvals);
+        }
+    }
+
+    id = peephole_emit(ctx, fn, insn, def->opcode, def->num_operands - 1, inputs[0], inputs[1], inputs[2]);
+    if (id && !insn->dt && (num_lanes == 1)) {
+        fn->defs[id]->dt = scalar_type(def->dt);
+    }
+    return id;
+}
+
+static SDL_bool swizzle(Context *ctx, IrFunction *fn)
+{
+    SDL_bool changed = SDL_FALSE;
+    IrInstruction *insn;
+    IrInstruction *next;
+
+    for (insn = fn->body.first; (insn != NULL) && !ctx->out_of_memory; insn = next) {
+        next = ir_walk(insn);
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_SWIZZLE) {
+            Uint32 src = insn->operands[1];
+            Uint32 swizvals = insn->operands[2];
+            Uint32 replacement = swizzle_fold(ctx, fn, &src, &swizvals);
+            if ((replacement == 0) && (src != insn->operands[1])) {
+                ir_set_input(ctx, fn, insn, 1, src);
+                insn->operands[2] = swizvals;
+                changed = SDL_TRUE;
+            }
+            if (replacement == 0) {
+                replacement = swizzle_push(ctx, fn, insn, src, swizvals);
+            }
+            if (replacement != 0) {
+                ir_replace_uses(ctx, fn, ir_output(insn), replacement);
+                ir_remove(fn, insn);
+                changed = SDL_TRUE;
+            }
+        }
+    }
+
+    if (changed) {
+        ir_remove_unused_constants(fn);
+        ir_renumber(ctx, fn);
+    }
+
+    return changed;
+}
+
+/* Per-lane liveness and narrowing...
+
+   Shaders often compute a whole float4 and then only look at `.xy`. This works
+   out which lanes of each value anything actually reads, working backwards
+   from the uses: a SWIZZLE reads the lanes it picks, component-wise math reads
+   the same lanes of its inputs that someone reads of its output, a CONSTRUCT
+   passes each lane back to the input it came from, an INSERT at a constant
+   lane doesn't read that lane of the vector it's inserting into, and anything
+   else reads everything. PHIs pass lanes back to their inputs, and we repeat
+   until nothing changes, since a loop's PHIs read values from later on.
+
+   Then, last use first:
+
+   - an INSERT into a lane nobody reads is dropped.
+   - component-wise math whose users are all SWIZZLEs is done on just the lanes
+     they read, with its inputs swizzled down to match, and the users' SWIZZLEs
+     pick from the narrower result instead. That's only done if it doesn't add
+     instructions: every vector input that isn't already a SWIZZLE we can fold
+     into needs a new one, so it has to get rid of at least as many SWIZZLEs,
+     like a user that would pick every lane of the result in order. `(b - c).zx`
+     would need two SWIZZLEs to save none, so it's left alone.
+   - a CONSTRUCT of scalars is narrowed the same way.
+
+   Going last use first means that narrowing something can leave what it reads
+   with only SWIZZLEs as users, so that gets its chance to be narrowed next. */
+
+#define NARROW_ALL_LANES 0xF
+
+/* how many of the lanes in `mask` come before `lane`, which is where `lane` ends up once the others are gone. */
+static Uint32 narrow_rank(const Uint32 mask, const Uint32 lane)
+{
+    Uint32 retval = 0;
+    Uint32 i;
+    for (i = 0; i < lane; i++) {
+        retval += (mask >> i) & 1;
+    }
+    return retval;
+}
+
+static Uint32 narrow_count(const Uint32 mask)
+{
+    return narrow_rank(mask, 4);
+}
+
+/* SDL_TRUE if `insn` is a CONSTRUCT of a vector, as opposed to a matrix, struct or array. */
+static SDL_bool narrow_is_vector_construct(const IrInstruction *insn)
+{
+    const Uint32 typeword = insn->operands[1];
+    return ((insn->opcode == SDL_SHADER_BCTAG_OP_CONSTRUCT) && ((typeword >> 16) == 1) && (((typeword >> 8) & 0xFF) >= 2)) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* which lanes of operand `operand` `insn` reads, if `live` are the lanes of its output someone reads. */
+static Uint32 narrow_demand(Context *ctx, const IrFunction *fn, const IrInstruction *insn, const Uint32 operand, const Uint32 live)
+{
+    const Uint32 input = insn->operands[operand];
+    const Uint32 width = swizzle_width(fn, input);
+    Uint32 retval = 0;
+    Sint32 idx;
+    Uint32 i;
+
+    if ((ir_output(insn) == 0) || !is_pure(ctx, insn)) {
+        return (insn->opcode == SDL_SHADER_BCTAG_OP_PHI) ? live : NARROW_ALL_LANES;
+    } else if (live == 0) {
+        return 0;  /* nobody reads any of it, so it doesn't read anything either. */
+    }
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_SWIZZLE:
+            for (i = 0; i < swizzle_lanes(insn->operands[2]); i++) {
+                if (live & (1 << i)) {
+                    retval |= 1 << swizzle_lane(insn->operands[2], i);
+                }
+            }
+            return retval;
+
+        case SDL_SHADER_BCTAG_OP_INSERT:
+        case SDL_SHADER_BCTAG_OP_EXTRACT:
+            if (!literal_int(fn, insn->operands[2], &idx) || (idx < 0) || (idx > 3) || (swizzle_width(fn, insn->operands[1]) < 2)) {
+                return NARROW_ALL_LANES;  /* an array or struct, or we can't tell which lane. */
+            } else if (operand != 1) {
+                return ((insn->opcode == SDL_SHADER_BCTAG_OP_EXTRACT) || (live & (1 << idx))) ? NARROW_ALL_LANES : 0;
+            } else if (insn->opcode == SDL_SHADER_BCTAG_OP_EXTRACT) {
+                return 1 << idx;
+            }
+            return live & ~(1 << idx);
+
+        case SDL_SHADER_BCTAG_OP_CONSTRUCT:
+            if (!narrow_is_vector_construct(insn)) {
+                return NARROW_ALL_LANES;
+            }
+            for (i = 2; i < operand; i++) {
+                const Uint32 w = swizzle_width(fn, insn->operands[i]);
+                if (w == 0) {
+                    return NARROW_ALL_LANES;
+                }
+                retval += w;  /* the lane this input starts at. */
+            }
+            return (width == 0) ? NARROW_ALL_LANES : ((live >> retval) & ((1 << width) - 1));
+
+        case SDL_SHADER_BCTAG_OP_SELECT:
+            return ((operand != 1) && (width >= 2) && (width == swizzle_width(fn, ir_output(insn)))) ? live : NARROW_ALL_LANES;
+
+        default: break;
+    }
+
+    if (swizzle_is_componentwise(insn->opcode) && (width >= 1)) {
+        if (width == 1) {
+            return 1;  /* a scalar gets splatted to every lane. */
+        } else if (width == swizzle_width(fn, ir_output(insn))) {
+            return live;
+        }
+    }
+
+    return NARROW_ALL_LANES;
+}
+
+/* works out which lanes of every SSA id get read, in `live`. */
+static void narrow_liveness(Context *ctx, const IrFunction *fn, Uint8 *live)
+{
+    const IrInstruction *insn;
+    SDL_bool changed;
+    Uint32 i, end;
+
+    do {
+        changed = SDL_FALSE;
+        for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+            const Uint32 output = ir_output(insn);
+            const Uint32 outlive = output ? live[output] : NARROW_ALL_LANES;
+            for (ir_inputs(insn, &i, &end); i < end; i++) {
+                const Uint32 input = insn->operands[i];
+                if ((input != 0) && (input < fn->num_ids)) {
+                    const Uint8 demand = (Uint8) (live[input] | narrow_demand(ctx, fn, insn, i, outlive));
+                    if (demand != live[input]) {
+                        live[input] = demand;
+                        changed = SDL_TRUE;
+                    }
+                }
+            }
+        }
+    } while (changed);
+}
+
+/* what a SWIZZLE picking `swizvals` has to pick instead, once what it reads only has the lanes in `mask`. */
+static Uint32 narrow_user_swizzle(const Uint32 mask, const Uint32 swizvals)
+{
+    const Uint32 num_lanes = swizzle_lanes(swizvals);
+    Uint32 retval = 0xFFFFFFFF;
+    Uint32 i;
+
+    for (i = 0; i < num_lanes; i++) {
+        retval &= ~(0xFFu << (i * 8));
+        retval |= narrow_rank(mask, swizzle_lane(swizvals, i)) << (i * 8);
+    }
+    return retval;
+}
+
+/* points every user of `def` (all SWIZZLEs) at `replacement`, which only has the lanes in `mask`. */
+static void narrow_users(Context *ctx, IrFunction *fn, IrInstruction *def, const Uint32 replacement, const Uint32 mask)
+{
+    const Uint32 num_lanes = narrow_count(mask);
+
+    while (def->uses != NULL) {
+        IrInstruction *user = def->uses->user;
+        const Uint32 swizvals = narrow_user_swizzle(mask, user->operands[2]);
+
+        if ((num_lanes == 1) || swizzle_is_identity(swizvals, num_lanes)) {
+            ir_replace_uses(ctx, fn, ir_output(user), replacement);  /* it'd be picking every lane in order, so it's not needed. */
+            ir_remove(fn, user);
+        } else {
+            ir_set_input(ctx, fn, user, 1, replacement);
+            user->operands[2] = swizvals;
+        }
+    }
+}
+
+/* SDL_TRUE if everything that reads `def` is a SWIZZLE (and a single lane of it, if it's going to be a scalar). */
+static SDL_bool narrow_users_are_swizzles(const IrInstruction *def, const Uint32 num_lanes)
+{
+    const IrUse *use;
+    for (use = def->uses; use != NULL; use = use->next) {
+        if ((use->user->opcode != SDL_SHADER_BCTAG_OP_SWIZZLE) || (use->operand != 1)) {
+            return SDL_FALSE;
+        } else if ((num_lanes == 1) && (swizzle_lanes(use->user->operands[2]) != 1)) {
+            return SDL_FALSE;  /* we can't swizzle a scalar. */
+        }
+    }
+    return (def->uses != NULL) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* SDL_TRUE if narrowing component-wise `insn` to the lanes in `mask` (picked by `swizvals`) doesn't make more
+   instructions than it started with: each input that isn't a scalar needs a SWIZZLE down to those lanes, unless
+   it folds into one that's already there, and that's only worth it if as many SWIZZLEs go away. */
+static SDL_bool narrow_pays_off(const IrFunction *fn, const IrInstruction *insn, const Uint32 mask, const Uint32 swizvals)
+{
+    const Uint32 num_lanes = narrow_count(mask);
+    Uint32 added = 0;
+    Uint32 removed = 0;
+    const IrUse *use;
+    Uint32 i;
+
+    for (use = insn->uses; use != NULL; use = use->next) {
+        if ((num_lanes == 1) || swizzle_is_identity(narrow_user_swizzle(mask, use->user->operands[2]), num_lanes)) {
+            removed++;  /* it'd pick every lane of the narrower result, in order, so it goes. */
+        }
+    }
+
+    for (i = 1; i < insn->num_operands; i++) {
+        const IrInstruction *def;
+        Uint32 src = insn->operands[i];
+        Uint32 inswizvals = swizvals;
+        Uint32 composed;
+
+        if (swizzle_width(fn, src) == 1) {
+            continue;  /* scalars splat, they don't need a SWIZZLE. */
+        }
+
+        /* this is the same walk swizzle_fold() does, without making anything. */
+        while (((def = ((src < fn->num_ids) ? fn->defs[src] : NULL)) != NULL) && (def->opcode == SDL_SHADER_BCTAG_OP_SWIZZLE) && swizzle_compose(def->operands[2], inswizvals, &composed)) {
+            src = def->operands[1];
+            inswizvals = composed;
+        }
+
+        if (swizzle_is_identity(inswizvals, swizzle_width(fn, src))) {
+            continue;
+        } else if (def && (num_lanes == 1) && ((def->opcode == SDL_SHADER_BCTAG_OP_LITERALINT4) || (def->opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT4))) {
+            continue;  /* that's just a constant. */
+        }
+        added++;
+    }
+
+    /* an input that's a SWIZZLE nothing else reads gets folded into the new one and isn't needed anymore. */
+    for (i = 1; i < insn->num_operands; i++) {
+        const Uint32 in = insn->operands[i];
+        const IrInstruction *def = (in < fn->num_ids) ? fn->defs[in] : NULL;
+        Uint32 composed, j;
+        if (!def || (def->opcode != SDL_SHADER_BCTAG_OP_SWIZZLE) || (swizzle_width(fn, in) == 1) || !swizzle_compose(def->operands[2], swizvals, &composed)) {
+            continue;
+        }
+        for (j = 1; (j < i) && (insn->operands[j] != in); j++) { /* spin */ }
+        for (use = def->uses; (use != NULL) && (use->user == insn); use = use->next) { /* spin */ }
+        if ((j == i) && (use == NULL)) {
+            removed++;  /* (and only counted once, if `insn` reads it twice.) */
+        }
+    }
+
+    return (added <= removed) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* replaces `insn` with a version that only makes the lanes in `mask`. SDL_FALSE if it can't. */
+static SDL_bool narrow_instruction(Context *ctx, IrFunction *fn, IrInstruction *insn, Uint32 mask)
+{
+    const Uint32 width = swizzle_width(fn, ir_output(insn));
+    Uint32 inputs[3] = { 0, 0, 0 };
+    Uint32 swizvals = 0xFFFFFFFF;
+    Uint32 num_lanes, id, i, lane;
+
+    mask &= (1 << width) - 1;
+    num_lanes = narrow_count(mask);
+    if ((width < 2) || (num_lanes == 0) || (num_lanes >= width) || !narrow_users_are_swizzles(insn, num_lanes)) {
+        return SDL_FALSE;
+    }
+
+    for (i = 0, lane = 0; lane < 4; lane++) {
+        if (mask & (1 << lane)) {
+            swizvals &= ~(0xFFu << (i * 8));
+            swizvals |= lane << (i * 8);
+            i++;
+        }
+    }
+
+    if (narrow_is_vector_construct(insn)) {
+        IrInstruction *newinsn;
+        if ((insn->num_operands - 2) != width) {
+            return SDL_FALSE;  /* built from vectors, not one scalar per lane. */
+        }
+        for (i = 2; i < insn->num_operands; i++) {
+            if (swizzle_width(fn, insn->operands[i]) != 1) {
+                return SDL_FALSE;
+            }
+        }
+
+        if (num_lanes == 1) {
+            id = insn->operands[2 + swizzle_lane(swizvals, 0)];
+        } else if (((newinsn = ir_instruction_create(ctx, SDL_SHADER_BCTAG_OP_CONSTRUCT, num_lanes + 2)) == NULL) || ((id = ir_new_id(ctx, fn)) == 0)) {
+            return SDL_FALSE;
+        } else {
+            newinsn->operands[0] = id;
+            newinsn->operands[1] = (insn->operands[1] & ~0xFF00u) | (num_lanes << 8);  /* same scalar type, fewer elements. */
+            newinsn->dt = narrow_datatype(ctx, insn->dt, num_lanes);
+            ir_insert_before(insn->block, insn, newinsn);
+            fn->defs[id] = newinsn;
+            for (i = 0; i < num_lanes; i++) {
+                ir_set_input(ctx, fn, newinsn, i + 2, insn->operands[2 + swizzle_lane(swizvals, i)]);
+            }
+        }
+    } else if (swizzle_is_componentwise(insn->opcode) && (insn->num_operands >= 2) && (insn->num_operands <= 4)) {
+        for (i = 1; i < insn->num_operands; i++) {
+            const Uint32 inwidth = swizzle_width(fn, insn->operands[i]);
+            if ((inwidth != 1) && (inwidth != width)) {
+                return SDL_FALSE;
+            }
+        }
+
+        if (!narrow_pays_off(fn, insn, mask, swizvals)) {
+            return SDL_FALSE;
+        }
+
+        for (i = 1; i < insn->num_operands; i++) {
+            Uint32 in = insn->operands[i];
+            Uint32 inswizvals = swizvals;
+            if (swizzle_width(fn, in) == 1) {
+                inputs[i - 1] = in;  /* scalars splat to whatever width they need. */
+            } else if ((inputs[i - 1] = swizzle_fold(ctx, fn, &in, &inswizvals)) == 0) {
+                inputs[i - 1] = swizzle_emit(ctx, fn, insn, in, inswizvals);
+            }
+        }
+
+        id = peephole_emit(ctx, fn, insn, insn->opcode, insn->num_operands - 1, inputs[0], inputs[1], inputs[2]);
+        if (id == 0) {
+            return SDL_FALSE;
+        }
+        fn->defs[id]->dt = narrow_datatype(ctx, insn->dt, num_lanes);
+    } else {
+        return SDL_FALSE;
+    }
+
+    narrow_users(ctx, fn, insn, id, mask);
+    ir_remove(fn, insn);
+    return SDL_TRUE;
+}
+
+static SDL_bool narrow(Context *ctx, IrFunction *fn)
+{
+    const Uint32 num_ids = fn->num_ids;
+    Uint8 *live = (Uint8 *) ir_alloc(ctx, num_ids);
+    IrInstruction **order;
+    IrInstruction *insn;
+    SDL_bool changed = SDL_FALSE;
+    Uint32 count = 0;
+    Uint32 i;
+
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        count++;
+    }
+
+    order = (IrInstruction **) ir_alloc(ctx, (count + 1) * sizeof (IrInstruction *));
+    if ((live == NULL) || (order == NULL)) {
+        return SDL_FALSE;
+    }
+
+    count = 0;
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        order[count++] = insn;
+    }
+
+    narrow_liveness(ctx, fn, live);
+
+    /* last first, so users get narrowed before the things they use. Anything we remove comes after `i`. */
+    for (i = count; (i > 0) && !ctx->out_of_memory; i--) {
+        const Uint32 output = ir_output(order[i - 1]);
+        Sint32 idx;
+        insn = order[i - 1];
+        if ((output == 0) || (output >= num_ids) || (live[output] == 0)) {
+            continue;  /* nothing reads it at all; that's DCE's job. */
+        } else if (insn->opcode == SDL_SHADER_BCTAG_OP_INSERT) {
+            if (literal_int(fn, insn->operands[2], &idx) && (idx >= 0) && (idx <= 3) && (swizzle_width(fn, insn->operands[1]) >= 2) && !(live[output] & (1 << idx))) {
+                ir_replace_uses(ctx, fn, output, insn->operands[1]);
+                ir_remove(fn, insn);
+                changed = SDL_TRUE;
+            }
+        } else if (narrow_instruction(ctx, fn, insn, live[output])) {
+            changed = SDL_TRUE;
+        }
+    }
+
+    if (changed) {
+        ir_remove_unused_constants(fn);
+        ir_renumber(ctx, fn);
+    }
+
+    return changed;
+}
+
+/* If-conversion...
+
+   A small IF whose arms only compute values can become straight-line code:
+   run both arms before it, then SELECT between their results where the PHIs
+   after it were. When the pixels running a shader disagree about a branch,
+   the GPU runs both sides anyway, so for a few instructions this costs less
+   than the branch does, and it leaves one bigger block for the other passes.
+
+   Anything that can't be undone stops this: DISCARD, RETURN, BREAK and
+   CONTINUE, LOOPs, and CALLs. Like LICM, this runs code that otherwise might
+   not have run, so integer division that might be by zero and SAMPLE stay
+   where they are, too. Nested IFs go first, so `a ? (b ? x : y) : z` can
+   become two SELECTs if it's cheap enough. */
+
+#define IFCONVERT_MAX_COST 8  /* IFs whose arms and SELECTs cost more than this, together, stay branches. */
+
+/* roughly how much running `insn` for every pixel costs, or 0 if it can't be moved out of an IF at all. */
+static Uint32 ifconvert_cost(Context *ctx, const IrFunction *fn, const IrInstruction *insn)
+{
+    if (!is_pure(ctx, insn) || !can_speculate(fn, insn)) {
+        return 0;
+    }
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_CALL:
+        case SDL_SHADER_BCTAG_OP_SAMPLE:
+            return 0;
+
+        case SDL_SHADER_BCTAG_OP_DIVIDE:
+        case SDL_SHADER_BCTAG_OP_MODULO:
+        case SDL_SHADER_BCTAG_OP_SIN:
+        case SDL_SHADER_BCTAG_OP_COS:
+        case SDL_SHADER_BCTAG_OP_TAN:
+        case SDL_SHADER_BCTAG_OP_ASIN:
+        case SDL_SHADER_BCTAG_OP_ACOS:
+        case SDL_SHADER_BCTAG_OP_ATAN:
+        case SDL_SHADER_BCTAG_OP_SINH:
+        case SDL_SHADER_BCTAG_OP_COSH:
+        case SDL_SHADER_BCTAG_OP_TANH:
+        case SDL_SHADER_BCTAG_OP_ASINH:
+        case SDL_SHADER_BCTAG_OP_ACOSH:
+        case SDL_SHADER_BCTAG_OP_ATANH:
+        case SDL_SHADER_BCTAG_OP_ATAN2:
+        case SDL_SHADER_BCTAG_OP_POW:
+        case SDL_SHADER_BCTAG_OP_EXP:
+        case SDL_SHADER_BCTAG_OP_LOG:
+        case SDL_SHADER_BCTAG_OP_EXP2:
+        case SDL_SHADER_BCTAG_OP_LOG2:
+        case SDL_SHADER_BCTAG_OP_SQRT:
+        case SDL_SHADER_BCTAG_OP_LEN:
+        case SDL_SHADER_BCTAG_OP_DISTANCE:
+        case SDL_SHADER_BCTAG_OP_NORMALIZE:
+        case SDL_SHADER_BCTAG_OP_REFRACT:
+            return 4;  /* these are a handful of instructions, or a trip to a slower unit, on most GPUs. */
+
+        default: break;
+    }
+
+    return 1;
+}
+
+/* SDL_TRUE if everything in `block` can move out of its IF, adding up what it costs in `cost`. */
+static SDL_bool ifconvert_arm(Context *ctx, const IrFunction *fn, const IrBlock *block, Uint32 *cost)
+{
+    const IrInstruction *insn;
+
+    for (insn = block->first; insn != NULL; insn = insn->next) {
+        const Uint32 c = ifconvert_cost(ctx, fn, insn);
+        if (c == 0) {
+            return SDL_FALSE;
+        }
+        *cost += c;
+    }
+
+    return SDL_TRUE;
+}
+
+/* moves both arms of `ifinsn` in front of it, turns its PHIs into SELECTs, and removes it, if it's small enough. */
+static SDL_bool ifconvert_if(Context *ctx, IrFunction *fn, IrInstruction *ifinsn)
+{
+    const Uint32 cond = ifinsn->operands[0];
+    IrInstruction *insn;
+    IrInstruction *next;
+    Uint32 cost = 0;
+    Uint32 i;
+
+    if (!ifconvert_arm(ctx, fn, &ifinsn->children[0], &cost) || !ifconvert_arm(ctx, fn, &ifinsn->children[1], &cost)) {
+        return SDL_FALSE;
+    }
+
+    for (insn = ifinsn->next; (insn != NULL) && (insn->opcode == SDL_SHADER_BCTAG_OP_PHI); insn = insn->next) {
+        if (insn->num_operands != 3) {
+            return SDL_FALSE;  /* shouldn't happen, both arms fall through. */
+        } else if (insn->operands[1] != insn->operands[2]) {
+            cost++;
+        }
+    }
+
+    if (cost > IFCONVERT_MAX_COST) {
+        return SDL_FALSE;
+    }
+
+    for (i = 0; i < 2; i++) {
+        for (insn = ifinsn->children[i].first; insn != NULL; insn = next) {
+            next = insn->next;
+            ir_unlink(insn);
+            ir_insert_before(ifinsn->block, ifinsn, insn);
+        }
+    }
+
+    for (insn = ifinsn->next; (insn != NULL) && (insn->opcode == SDL_SHADER_BCTAG_OP_PHI); insn = next) {
+        Uint32 id = insn->operands[1];
+        next = insn->next;
+        if (insn->operands[2] != id) {
+            id = peephole_emit(ctx, fn, ifinsn, SDL_SHADER_BCTAG_OP_SELECT, 3, cond, insn->operands[1], insn->operands[2]);
+            if (id == 0) {
+                return SDL_TRUE;  /* out of memory; it's all still valid, we just stop here. */
+            }
+            fn->defs[id]->dt = insn->dt;  /* (peephole_emit gave it the IF's, which is nothing.) */
+        }
+        ir_replace_uses(ctx, fn, ir_output(insn), id);
+        ir_remove(fn, insn);
+    }
+
+    ir_remove(fn, ifinsn);
+    return SDL_TRUE;
+}
+
+static SDL_bool ifconvert_block(Context *ctx, IrFunction *fn, IrBlock *block)
+{
+    SDL_bool changed = SDL_FALSE;
+    IrInstruction *insn;
+    IrInstruction *next;
+    Uint32 i;
+
+    for (insn = block->first; (insn != NULL) && !ctx->out_of_memory; insn = next) {
+        next = insn->next;
+        for (i = 0; i < ir_num_children(insn); i++) {
+            changed = ifconvert_block(ctx, fn, &insn->children[i]) || changed;
+        }
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_IF) {
+            IrInstruction *after = insn->next;
+            while ((after != NULL) && (after->opcode == SDL_SHADER_BCTAG_OP_PHI)) {
+                after = after->next;
+            }
+            if (ifconvert_if(ctx, fn, insn)) {
+                next = after;  /* its PHIs are gone, too. */
+                changed = SDL_TRUE;
+            }
+        }
+    }
+
+    return changed;
+}
+
+static SDL_bool ifconvert(Context *ctx, IrFunction *fn)
+{
+    const SDL_bool changed = ifconvert_block(ctx, fn, &fn->body);
+    if (changed) {
+        ir_renumber(ctx, fn);
+    }
+    return changed;
+}
+
+/* Half-precision lowering...
+
+   Mobile GPUs can often do twice the math on halfs that they can on floats,
+   and halfs take half the registers, but a half only has 11 bits of
+   precision and tops out at 65504. So we only move a float computation to
+   half if we can show its result stays within half's range, and we can put a
+   bound on how far it ends up from what float math would have made, which
+   has to be under the function's half_tolerance (zero, the default, turns
+   this off; so does `@precise`).
+
+   First we work out a range for every float value we can, walking the code
+   in order. Most come from things that can't go past a certain range no
+   matter what goes in: normalize(), sin() and cos() are between -1 and 1,
+   clamp() with constant bounds is between those bounds, and literals are
+   what they are. Color math is mostly built from these, and ranges carry
+   through +, -, *, mad(), mix(), dot(), etc. Parameters and anything we
+   can't reason about have no range, so nothing that depends on them moves,
+   except through a clamp(), which doesn't care how far off the end its input
+   was.
+
+   Then each instruction that could run in half gets an error bound: the
+   errors of its inputs, carried through the math, plus the rounding of its
+   own result to half. Division, transcendentals, and anything where a tiny
+   change in input can make a big change in output (floor(), step()...) stay
+   float. If the bound is within the tolerance, it's demoted.
+
+   Demoted instructions that read each other form regions. Each region
+   needs a CONVERT to half for every float it reads (literals are free, more
+   or less: they're converted once, at the start of the function) and a
+   CONVERT back to float for every value the float code reads, so a region
+   that doesn't have more instructions than conversions isn't worth it.
+
+   The result is marked in the bytecode by those CONVERTs, and by the type id
+   of everything computed from halfs, which is a half type. */
+
+#define HALF_MAX 65504.0f  /* biggest finite half. */
+
+typedef struct HalfValue
+{
+    float lo;  /* every lane of this value is between lo and hi, if `bounded`. */
+    float hi;
+    float error;  /* if `demoted`, it might be this far from what float math would have made. */
+    SDL_bool bounded;
+    SDL_bool demoted;
+    Uint32 region;  /* demoted values that read each other share this (union-find). */
+    Uint32 size;  /* for a region's root: how many instructions are in it... */
+    Uint32 conversions;  /* ...and about how many CONVERTs it needs. */
+} HalfValue;
+
+/* the distance between halfs around `magnitude` (which is positive). */
+static float half_spacing(const float magnitude)
+{
+    float spacing = 1.0f / 16777216.0f;  /* subnormals are 2^-24 apart... */
+    float limit = 1.0f / 8192.0f;  /* ...up to 2^-13; past that, it's 2^-10 of the power of two we're in. */
+    while ((magnitude >= limit) && (limit < HALF_MAX)) {
+        spacing *= 2.0f;
+        limit *= 2.0f;
+    }
+    return spacing;
+}
+
+/* most that rounding something between -magnitude and magnitude to a half can change it. */
+static float half_rounding(const float magnitude)
+{
+    return half_spacing(magnitude) * 0.5f;
+}
+
+/* exactly how much rounding `val` to a half changes it. */
+static float half_literal_error(const float val)
+{
+    const float spacing = half_spacing(SDL_fabsf(val));
+    return SDL_fabsf(val - (SDL_floorf((val / spacing) + 0.5f) * spacing));
+}
+
+static float half_magnitude(const HalfValue *val)
+{
+    return SDL_max(SDL_fabsf(val->lo), SDL_fabsf(val->hi));
+}
+
+/* number of lanes in `id` if it's a float scalar or vector, zero if it's something else. */
+static Uint32 half_lanes(const IrFunction *fn, const Uint32 id)
+{
+    const IrInstruction *def = (id < fn->num_ids) ? fn->defs[id] : NULL;
+    const DataType *dt = ir_datatype(fn, id);
+
+    if (def && (def->opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT)) {
+        return 1;
+    } else if (def && (def->opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT4)) {
+        return 4;
+    } else if (!dt) {
+        return 0;
+    } else if (dt->dtype == DT_FLOAT) {
+        return 1;
+    } else if ((dt->dtype == DT_VECTOR) && (dt->info.vector.childdt->dtype == DT_FLOAT)) {
+        return (Uint32) dt->info.vector.elements;
+    }
+    return 0;
+}
+
+/* the half scalar or vector with `lanes` lanes. */
+static const DataType *half_datatype(Context *ctx, const Uint32 lanes)
+{
+    const DataType *retval = NULL;
+    const char *name = (lanes > 1) ? stringcache_fmt(ctx->strcache, "half%u", (unsigned int) lanes) : stringcache(ctx->strcache, "half");
+    if (!name || !hash_find(ctx->datatypes, name, (const void **) &retval)) {
+        return NULL;
+    }
+    return retval;
+}
+
+static void half_set_range(HalfValue *val, const float lo, const float hi)
+{
+    /* NaNs and infinities (from overflowing float math on huge bounds) fail these, and leave it unbounded. */
+    if ((lo <= hi) && (lo >= -3.0e38f) && (hi <= 3.0e38f)) {
+        val->lo = lo;
+        val->hi = hi;
+        val->bounded = SDL_TRUE;
+    }
+}
+
+static void half_multiply_range(const HalfValue *a, const HalfValue *b, float *lo, float *hi)
+{
+    const float p1 = a->lo * b->lo, p2 = a->lo * b->hi, p3 = a->hi * b->lo, p4 = a->hi * b->hi;
+    *lo = SDL_min(SDL_min(p1, p2), SDL_min(p3, p4));
+    *hi = SDL_max(SDL_max(p1, p2), SDL_max(p3, p4));
+}
+
+/* works out the range of what `insn` makes, if we can. Its inputs all came before it (except for PHIs in LOOPs, which then aren't bounded). */
+static void half_range(const IrFunction *fn, HalfValue *vals, const IrInstruction *insn)
+{
+    const Uint32 output = ir_output(insn);
+    HalfValue *val = &vals[output];
+    const HalfValue *a = NULL;
+    const HalfValue *b = NULL;
+    const HalfValue *c = NULL;
+    float lo, hi;
+    Uint32 i, end;
+
+    if (half_lanes(fn, output) == 0) {
+        return;  /* we only care about floats. */
+    }
+
+    for (ir_inputs(insn, &i, &end); i < end; i++) {
+        if (insn->operands[i] >= fn->num_ids) {
+            return;  /* shouldn't happen. */
+        }
+    }
+
+    if (insn->opcode != SDL_SHADER_BCTAG_OP_SWIZZLE) {  /* a SWIZZLE's second operand is the lanes, not an SSA id. */
+        a = (end > 1) ? &vals[insn->operands[1]] : NULL;
+        b = (end > 2) ? &vals[insn->operands[2]] : NULL;
+        c = (end > 3) ? &vals[insn->operands[3]] : NULL;
+    } else {
+        a = &vals[insn->operands[1]];
+    }
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_SIN:
+        case SDL_SHADER_BCTAG_OP_COS:
+        case SDL_SHADER_BCTAG_OP_SIGN:
+        case SDL_SHADER_BCTAG_OP_NORMALIZE:
+            half_set_range(val, -1.0f, 1.0f);
+            return;
+
+        case SDL_SHADER_BCTAG_OP_FRACT:
+        case SDL_SHADER_BCTAG_OP_STEP:
+        case SDL_SHADER_BCTAG_OP_SMOOTHSTEP:
+            half_set_range(val, 0.0f, 1.0f);
+            return;
+
+        case SDL_SHADER_BCTAG_OP_CLAMP:  /* min(max(x, lo), hi), whether or not we know anything about x. */
+            if (b->bounded && c->bounded) {
+                lo = a->bounded ? SDL_max(a->lo, b->lo) : b->lo;
+                hi = a->bounded ? SDL_max(a->hi, b->hi) : SDL_max(b->hi, c->hi);
+                half_set_range(val, SDL_min(lo, c->lo), SDL_min(hi, c->hi));
+            }
+            return;
+
+        case SDL_SHADER_BCTAG_OP_SWIZZLE:
+        case SDL_SHADER_BCTAG_OP_EXTRACT:
+            if (a->bounded) {
+                half_set_range(val, a->lo, a->hi);
+            }
+            return;
+
+        case SDL_SHADER_BCTAG_OP_INSERT:
+            if (a->bounded && c->bounded) {
+                half_set_range(val, SDL_min(a->lo, c->lo), SDL_max(a->hi, c->hi));
+            }
+            return;
+
+        case SDL_SHADER_BCTAG_OP_SELECT:
+            if (b->bounded && c->bounded) {
+                half_set_range(val, SDL_min(b->lo, c->lo), SDL_max(b->hi, c->hi));
+            }
+            return;
+
+        case SDL_SHADER_BCTAG_OP_PHI:
+        case SDL_SHADER_BCTAG_OP_CONSTRUCT:
+            lo = 3.0e38f;
+            hi = -3.0e38f;
+            for (ir_inputs(insn, &i, &end); i < end; i++) {
+                if (!vals[insn->operands[i]].bounded) {
+                    return;
+                }
+                lo = SDL_min(lo, vals[insn->operands[i]].lo);
+                hi = SDL_max(hi, vals[insn->operands[i]].hi);
+            }
+            half_set_range(val, lo, hi);
+            return;
+
+        default: break;
+    }
+
+    /* everything else needs to know what its inputs are. */
+    for (ir_inputs(insn, &i, &end); i < end; i++) {
+        if (!vals[insn->operands[i]].bounded) {
+            return;
+        }
+    }
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_NEGATE: half_set_range(val, -a->hi, -a->lo); break;
+        case SDL_SHADER_BCTAG_OP_ABS: half_set_range(val, ((a->lo <= 0.0f) && (a->hi >= 0.0f)) ? 0.0f : SDL_min(SDL_fabsf(a->lo), SDL_fabsf(a->hi)), half_magnitude(a)); break;
+        case SDL_SHADER_BCTAG_OP_ADD: half_set_range(val, a->lo + b->lo, a->hi + b->hi); break;
+        case SDL_SHADER_BCTAG_OP_SUBTRACT: half_set_range(val, a->lo - b->hi, a->hi - b->lo); break;
+        case SDL_SHADER_BCTAG_OP_MIN: half_set_range(val, SDL_min(a->lo, b->lo), SDL_min(a->hi, b->hi)); break;
+        case SDL_SHADER_BCTAG_OP_MAX: half_set_range(val, SDL_max(a->lo, b->lo), SDL_max(a->hi, b->hi)); break;
+        case SDL_SHADER_BCTAG_OP_FLOOR:
+        case SDL_SHADER_BCTAG_OP_CEIL:
+        case SDL_SHADER_BCTAG_OP_ROUND:
+        case SDL_SHADER_BCTAG_OP_ROUNDEVEN:
+        case SDL_SHADER_BCTAG_OP_TRUNC:
+            half_set_range(val, SDL_floorf(a->lo), SDL_ceilf(a->hi));
+            break;
+
+        case SDL_SHADER_BCTAG_OP_SQRT:
+            if (a->hi >= 0.0f) {
+                half_set_range(val, 0.0f, (float) SDL_sqrt((double) a->hi));
+            }
+            break;
+
+        case SDL_SHADER_BCTAG_OP_MULTIPLY:
+            if (half_lanes(fn, insn->operands[1]) && half_lanes(fn, insn->operands[2])) {  /* not matrix math. */
+                half_multiply_range(a, b, &lo, &hi);
+                half_set_range(val, lo, hi);
+            }
+            break;
+
+        case SDL_SHADER_BCTAG_OP_MAD:
+            half_multiply_range(a, b, &lo, &hi);
+            half_set_range(val, lo + c->lo, hi + c->hi);
+            break;
+
+        case SDL_SHADER_BCTAG_OP_MIX:  /* a + (b - a) * t, which is between a and b if t is between 0 and 1. */
+            if ((c->lo >= 0.0f) && (c->hi <= 1.0f)) {
+                half_set_range(val, SDL_min(a->lo, b->lo), SDL_max(a->hi, b->hi));
+            }
+            break;
+
+        case SDL_SHADER_BCTAG_OP_DOT:
+            half_multiply_range(a, b, &lo, &hi);
+            i = half_lanes(fn, insn->operands[1]);
+            half_set_range(val, lo * (float) i, hi * (float) i);
+            break;
+
+        default: break;
+    }
+}
+
+/* how far off input `operand` of `insn` might be once it's a half, in `err`. SDL_FALSE if it can't be a half. */
+static SDL_bool half_input_error(const IrFunction *fn, const HalfValue *vals, const IrInstruction *insn, const Uint32 operand, float *err)
+{
+    const Uint32 id = insn->operands[operand];
+    const IrInstruction *def = fn->defs[id];
+    const HalfValue *val = &vals[id];
+
+    if (val->demoted) {
+        *err = val->error;
+        return SDL_TRUE;
+    } else if (def && (def->opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT)) {
+        *err = half_literal_error(((const float *) &def->operands[1])[0]);
+        return SDL_TRUE;
+    } else if (def && (def->opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT4)) {
+        const float *f = (const float *) &def->operands[1];
+        *err = SDL_max(SDL_max(half_literal_error(f[0]), half_literal_error(f[1])), SDL_max(half_literal_error(f[2]), half_literal_error(f[3])));
+        return SDL_TRUE;
+    } else if ((insn->opcode == SDL_SHADER_BCTAG_OP_CLAMP) && (operand == 1)) {
+        /* anything outside the bounds gets clamped anyhow, even if it turned into an infinity. */
+        *err = half_rounding(half_magnitude(&vals[ir_output(insn)]));
+        return SDL_TRUE;
+    } else if (val->bounded && (half_magnitude(val) <= HALF_MAX)) {
+        *err = half_rounding(half_magnitude(val));
+        return SDL_TRUE;
+    }
+
+    return SDL_FALSE;
+}
+
+/* SDL_TRUE if `operand` is a float that `insn` reads, as opposed to an index, a condition, or a type word. */
+static SDL_bool half_is_float_input(const IrInstruction *insn, const Uint32 operand)
+{
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_EXTRACT: return (operand == 1) ? SDL_TRUE : SDL_FALSE;
+        case SDL_SHADER_BCTAG_OP_INSERT: return (operand != 2) ? SDL_TRUE : SDL_FALSE;
+        case SDL_SHADER_BCTAG_OP_SELECT: return (operand != 1) ? SDL_TRUE : SDL_FALSE;
+        default: break;
+    }
+    return SDL_TRUE;
+}
+
+/* SDL_TRUE if `insn` can run in half precision, with how far off its result could be in `err`. */
+static SDL_bool half_error(const IrFunction *fn, const HalfValue *vals, const IrInstruction *insn, float *err)
+{
+    const HalfValue *out = &vals[ir_output(insn)];
+    const HalfValue *a;
+    const HalfValue *b;
+    float e[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float r, A, B;
+    Uint32 i, end, n;
+
+    if (!out->bounded || (half_magnitude(out) > HALF_MAX) || (half_lanes(fn, ir_output(insn)) == 0)) {
+        return SDL_FALSE;
+    }
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_CONSTRUCT:
+            if (!narrow_is_vector_construct(insn)) {
+                return SDL_FALSE;
+            }
+            break;
+
+        case SDL_SHADER_BCTAG_OP_SWIZZLE:
+        case SDL_SHADER_BCTAG_OP_EXTRACT:
+        case SDL_SHADER_BCTAG_OP_INSERT:
+        case SDL_SHADER_BCTAG_OP_SELECT:
+        case SDL_SHADER_BCTAG_OP_NEGATE:
+        case SDL_SHADER_BCTAG_OP_ABS:
+        case SDL_SHADER_BCTAG_OP_ADD:
+        case SDL_SHADER_BCTAG_OP_SUBTRACT:
+        case SDL_SHADER_BCTAG_OP_MULTIPLY:
+        case SDL_SHADER_BCTAG_OP_MAD:
+        case SDL_SHADER_BCTAG_OP_MIN:
+        case SDL_SHADER_BCTAG_OP_MAX:
+        case SDL_SHADER_BCTAG_OP_CLAMP:
+        case SDL_SHADER_BCTAG_OP_MIX:
+        case SDL_SHADER_BCTAG_OP_DOT:
+            break;
+
+        default: return SDL_FALSE;
+    }
+
+    for (ir_inputs(insn, &i, &end); i < end; i++) {
+        if (!half_is_float_input(insn, i)) {
+            continue;
+        } else if (half_lanes(fn, insn->operands[i]) == 0) {
+            return SDL_FALSE;  /* a matrix, or something we don't know the type of. */
+        } else if (!half_input_error(fn, vals, insn, i, &e[(i < 4) ? i : 0])) {
+            return SDL_FALSE;
+        } else if (i >= 4) {
+            e[1] = SDL_max(e[1], e[0]);  /* CONSTRUCT can have lots of inputs; they all just get copied. */
+        }
+    }
+
+    r = half_rounding(half_magnitude(out));
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_CONSTRUCT:  /* these just move values around, or pick one, so they don't add any error. */
+        case SDL_SHADER_BCTAG_OP_SWIZZLE:
+        case SDL_SHADER_BCTAG_OP_EXTRACT:
+        case SDL_SHADER_BCTAG_OP_INSERT:
+        case SDL_SHADER_BCTAG_OP_SELECT:
+        case SDL_SHADER_BCTAG_OP_NEGATE:
+        case SDL_SHADER_BCTAG_OP_ABS:
+        case SDL_SHADER_BCTAG_OP_MIN:
+        case SDL_SHADER_BCTAG_OP_MAX:
+        case SDL_SHADER_BCTAG_OP_CLAMP:
+            *err = SDL_max(SDL_max(e[1], e[2]), e[3]);
+            return SDL_TRUE;
+
+        case SDL_SHADER_BCTAG_OP_ADD:
+        case SDL_SHADER_BCTAG_OP_SUBTRACT:
+            *err = e[1] + e[2] + r;
+            return SDL_TRUE;
+
+        default: break;
+    }
+
+    /* the rest multiply, and need bounded inputs to say how much that makes their errors grow. */
+    a = &vals[insn->operands[1]];
+    b = &vals[insn->operands[2]];
+    if (!a->bounded || !b->bounded) {
+        return SDL_FALSE;
+    }
+    A = half_magnitude(a);
+    B = half_magnitude(b);
+
+    switch (insn->opcode) {
+        case SDL_SHADER_BCTAG_OP_MULTIPLY:
+            *err = (A * e[2]) + (B * e[1]) + (e[1] * e[2]) + r;
+            return SDL_TRUE;
+
+        case SDL_SHADER_BCTAG_OP_MAD:  /* it might round after the multiply, too. */
+            *err = (A * e[2]) + (B * e[1]) + (e[1] * e[2]) + half_rounding(A * B) + e[3] + r;
+            return SDL_TRUE;
+
+        case SDL_SHADER_BCTAG_OP_MIX:  /* a + (b - a) * t */
+            if (!vals[insn->operands[3]].bounded || (vals[insn->operands[3]].lo < 0.0f) || (vals[insn->operands[3]].hi > 1.0f)) {
+                return SDL_FALSE;
+            }
+            *err = e[1] + e[2] + ((A + B) * e[3]) + (2.0f * half_rounding(A + B)) + r;
+            return SDL_TRUE;
+
+        case SDL_SHADER_BCTAG_OP_DOT:
+            n = half_lanes(fn, insn->operands[1]);
+            *err = ((float) n) * ((A * e[2]) + (B * e[1]) + (e[1] * e[2]) + half_rounding(A * B)) + (((float) (n - 1)) * r);
+            return SDL_TRUE;
+
+        default: break;
+    }
+
+    return SDL_FALSE;
+}
+
+static Uint32 half_region(HalfValue *vals, Uint32 id)
+{
+    while (vals[id].region != id) {
+        vals[id].region = vals[vals[id].region].region;
+        id = vals[id].region;
+    }
+    return id;
+}
+
+/* SDL_TRUE if `id` needs a CONVERT to get into a half region, as opposed to being a half already or a literal. */
+static SDL_bool half_needs_conversion(const IrFunction *fn, const HalfValue *vals, const Uint32 id)
+{
+    const IrInstruction *def = fn->defs[id];
+    return (!vals[id].demoted && (!def || (def->block != &fn->constants))) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* adds `CONVERT %new, typeword, id` where everything that can see `id` can see it, and returns %new (0 if out of memory). */
+static Uint32 half_convert(Context *ctx, IrFunction *fn, const Uint32 id, const SDL_SHADER_BytecodeScalarType scalar, const DataType *dt)
+{
+    IrInstruction *def = fn->defs[id];
+    IrInstruction *insn = ir_instruction_create(ctx, SDL_SHADER_BCTAG_OP_CONVERT, 3);
+    const Uint32 newid = ir_new_id(ctx, fn);
+    IrInstruction *before;
+
+    if (!insn || !newid) {
+        return 0;
+    }
+
+    if (!def || (def->block == &fn->constants)) {
+        ir_insert_before(&fn->body, fn->body.first, insn);  /* parameters and constants are there from the start. */
+    } else {
+        for (before = def->next; (before != NULL) && (before->opcode == SDL_SHADER_BCTAG_OP_PHI); before = before->next) { /* spin */ }
+        ir_insert_before(def->block, before, insn);
+    }
+
+    insn->operands[0] = newid;
+    insn->operands[1] = SDL_SHADER_BYTECODE_TYPEWORD(scalar, (dt && (dt->dtype == DT_VECTOR)) ? dt->info.vector.elements : 1, 1);  /* (`id` might be a half already, which half_lanes() doesn't count.) */
+    insn->dt = dt;
+    fn->defs[newid] = insn;
+    ir_set_input(ctx, fn, insn, 2, id);
+    return newid;
+}
+
+static SDL_bool half_precision(Context *ctx, IrFunction *fn)
+{
+    const Uint32 num_ids = fn->num_ids;
+    HalfValue *vals;
+    Uint32 *tohalf;
+    IrInstruction *insn;
+    SDL_bool changed = SDL_FALSE;
+    Uint32 i, end;
+
+    if (fn->half_tolerance <= 0.0f) {
+        return SDL_FALSE;
+    }
+
+    vals = (HalfValue *) ir_alloc(ctx, num_ids * sizeof (HalfValue));
+    tohalf = (Uint32 *) ir_alloc(ctx, num_ids * sizeof (Uint32));
+    if (!vals || !tohalf) {
+        return SDL_FALSE;
+    }
+
+    for (insn = fn->constants.first; insn != NULL; insn = insn->next) {
+        const float *f = (const float *) &insn->operands[1];
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT) {
+            half_set_range(&vals[insn->operands[0]], f[0], f[0]);
+        } else if (insn->opcode == SDL_SHADER_BCTAG_OP_LITERALFLOAT4) {
+            half_set_range(&vals[insn->operands[0]], SDL_min(SDL_min(f[0], f[1]), SDL_min(f[2], f[3])), SDL_max(SDL_max(f[0], f[1]), SDL_max(f[2], f[3])));
+        }
+    }
+
+    /* ranges and errors, in order, so inputs are done before what reads them. */
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        const Uint32 output = ir_output(insn);
+        float err;
+        if ((output == 0) || (output >= num_ids)) {
+            continue;
+        }
+        half_range(fn, vals, insn);
+        if (half_error(fn, vals, insn, &err) && (err <= fn->half_tolerance)) {
+            vals[output].demoted = SDL_TRUE;
+            vals[output].error = err;
+        }
+        vals[output].region = output;
+    }
+
+    /* group demoted instructions that read each other, and see if each group is worth the conversions. */
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        const Uint32 output = ir_output(insn);
+        if ((output != 0) && (output < num_ids) && vals[output].demoted) {
+            for (ir_inputs(insn, &i, &end); i < end; i++) {
+                const Uint32 id = insn->operands[i];
+                if (half_is_float_input(insn, i) && vals[id].demoted) {
+                    vals[half_region(vals, id)].region = half_region(vals, output);
+                }
+            }
+        }
+    }
+
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        const Uint32 output = ir_output(insn);
+        if ((output != 0) && (output < num_ids) && vals[output].demoted) {
+            HalfValue *root = &vals[half_region(vals, output)];
+            const IrUse *use;
+            root->size++;
+            for (ir_inputs(insn, &i, &end); i < end; i++) {
+                const Uint32 id = insn->operands[i];
+                if (half_is_float_input(insn, i) && half_needs_conversion(fn, vals, id) && (tohalf[id] != output)) {
+                    tohalf[id] = output;  /* just so the same input twice only counts once. */
+                    root->conversions++;
+                }
+            }
+            for (use = insn->uses; use != NULL; use = use->next) {
+                const Uint32 user = ir_output(use->user);
+                if ((user == 0) || (user >= num_ids) || !vals[user].demoted) {
+                    root->conversions++;  /* it needs to be a float again for this. */
+                    break;
+                }
+            }
+        }
+    }
+
+    for (insn = fn->body.first; insn != NULL; insn = ir_walk(insn)) {
+        const Uint32 output = ir_output(insn);
+        if ((output != 0) && (output < num_ids) && vals[output].demoted) {
+            const HalfValue *root = &vals[half_region(vals, output)];
+            vals[output].demoted = (root->size > root->conversions) ? SDL_TRUE : SDL_FALSE;
+        }
+    }
+
+    SDL_memset(tohalf, '\0', num_ids * sizeof (Uint32));
+
+    /* now change the ones that made it. The CONVERTs we add never come before the walk, and are past num_ids. */
+    for (insn = fn->body.first; (insn != NULL) && !ctx->out_of_memory; insn = ir_walk(insn)) {
+        const Uint32 output = ir_output(insn);
+        const DataType *floatdt;
+        const DataType *halfdt;
+        IrUse *use;
+        IrUse *nextuse;
+        Uint32 tofloat = 0;
+
+        if ((output == 0) || (output >= num_ids) || !vals[output].demoted) {
+            continue;
+        }
+
+        floatdt = insn->dt;
+        halfdt = half_datatype(ctx, half_lanes(fn, output));
+        if (!halfdt) {
+            vals[output].demoted = SDL_FALSE;  /* shouldn't happen, but nothing reads it as a half yet, so it can stay a float. */
+            continue;
+        }
+
+        for (ir_inputs(insn, &i, &end); i < end; i++) {
+            const Uint32 id = insn->operands[i];
+            if ((id < num_ids) && half_is_float_input(insn, i) && !vals[id].demoted) {
+                if (tohalf[id] == 0) {
+                    tohalf[id] = half_convert(ctx, fn, id, SDL_SHADER_BCSCALAR_HALF, half_datatype(ctx, half_lanes(fn, id)));
+                    if (tohalf[id] == 0) {
+                        break;
+                    }
+                }
+                ir_set_input(ctx, fn, insn, i, tohalf[id]);
+            }
+        }
+
+        insn->dt = halfdt;
+        if (insn->opcode == SDL_SHADER_BCTAG_OP_CONSTRUCT) {
+            insn->operands[1] = SDL_SHADER_BYTECODE_TYPEWORD(SDL_SHADER_BCSCALAR_HALF, SDL_SHADER_BYTECODE_TYPEWORD_ELEMENTS(insn->operands[1]), 1);
+        }
+
+        for (use = insn->uses; use != NULL; use = nextuse) {
+            const Uint32 user = ir_output(use->user);
+            nextuse = use->next;
+            if ((user != 0) && (user < num_ids) && vals[user].demoted) {
+                continue;
+            } else if ((tofloat == 0) && ((tofloat = half_convert(ctx, fn, output, SDL_SHADER_BCSCALAR_FLOAT, floatdt)) == 0)) {
+                break;
+            } else if (use->user != fn->defs[tofloat]) {
+                ir_set_input(ctx, fn, use->user, use->operand, tofloat);
+            }
+        }
+
+        changed = SDL_TRUE;
+    }
+
+    if (changed) {
+        ir_renumber(ctx, fn);
+    }
+
+    return changed;
+}
+
+static const OptimizationPass optimization_passes[] = {
+    { "inline", SDL_SHADER_OPTPASS_INLINE, 2, inline_functions, NULL },
+    { "unroll", SDL_SHADER_OPTPASS_UNROLL, 2, NULL, unroll },
+    { "ifconvert", SDL_SHADER_OPTPASS_IFCONVERT, 2, find_side_effects, ifconvert },
+    { "swizzle", SDL_SHADER_OPTPASS_SWIZZLE, 1, NULL, swizzle },
+    { "narrow", SDL_SHADER_OPTPASS_NARROW, 2, find_side_effects, narrow },
+    { "peephole", SDL_SHADER_OPTPASS_PEEPHOLE, 1, NULL, peephole },
+    { "half", SDL_SHADER_OPTPASS_HALF, 2, NULL, half_precision },  /* after peephole, so it sees fused MADs. */
+    { "licm", SDL_SHADER_OPTPASS_LICM, 1, find_side_effects, licm },
+    { "gvn", SDL_SHADER_OPTPASS_GVN, 1, find_side_effects, gvn },
+    { "dce", SDL_SHADER_OPTPASS_DCE, 1, find_side_effects, dce },  /* after anything that can leave code unused. */
+    { NULL, 0, 0, NULL, NULL }  /* passes go before this, in the order they should run. */
+};
+
+static Uint32 count_instructions(const Context *ctx)
+{
+    const IrFunction *fn;
+    Uint32 retval = 0;
+    for (fn = ctx->ir_functions; fn != NULL; fn = fn->next) {
+        retval += ir_count_instructions(fn);
+    }
+    return retval;
+}
+
+static Uint64 elapsed_nanoseconds(const Uint64 start, const Uint64 end)
+{
+    const Uint64 freq = SDL_GetPerformanceFrequency();
+    const Uint64 ticks = end - start;
+    return ((ticks / freq) * 1000000000) + (((ticks % freq) * 1000000000) / freq);
+}
+
+static SDL_bool pass_enabled(const Context *ctx, const OptimizationPass *pass)
+{
+    if (ctx->optimization_level < pass->min_level) {
+        return SDL_FALSE;
+    } else if ((ctx->optimization_passes != SDL_SHADER_OPTPASS_ALL) && ((ctx->optimization_passes & pass->flag) == 0)) {
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+static void run_pass(Context *ctx, const OptimizationPass *pass, SDL_SHADER_OptimizationStats *stats)
+{
+    const Uint64 start = SDL_GetPerformanceCounter();
+    SDL_bool changed = SDL_FALSE;
+    IrFunction *fn;
+
+    stats->pass = pass->name;
+    stats->instructions_before = count_instructions(ctx);
+
+    if (pass->program) {
+        changed = pass->program(ctx) || changed;
+    }
+
+    if (pass->function) {
+        for (fn = ctx->ir_functions; (fn != NULL) && !ctx->out_of_memory; fn = fn->next) {
+            changed = pass->function(ctx, fn) || changed;
+        }
+    }
+
+    stats->nanoseconds = elapsed_nanoseconds(start, SDL_GetPerformanceCounter());
+    stats->changed = changed;
+    stats->instructions_after = count_instructions(ctx);
+}
+
+void optimize(Context *ctx)
+{
+    const OptimizationPass *pass;
+    size_t num_passes = 0;
+
+    if (ctx->optimization_level <= 0) {
+        return;  /* don't even look at anything, this is for when compile time matters most. */
+    }
+
+    for (pass = optimization_passes; pass->name != NULL; pass++) {
+        if (pass_enabled(ctx, pass)) {
+            num_passes++;
+        }
+    }
+
+    if (num_passes == 0) {
+        return;
+    }
+
+    ctx->optimization_stats = (SDL_SHADER_OptimizationStats *) Malloc(ctx, num_passes * sizeof (SDL_SHADER_OptimizationStats));
+    if (ctx->optimization_stats == NULL) {
+        return;
+    }
+    SDL_memset(ctx->optimization_stats, '\0', num_passes * sizeof (SDL_SHADER_OptimizationStats));
+
+    for (pass = optimization_passes; (pass->name != NULL) && !ctx->isfail; pass++) {
+        if (pass_enabled(ctx, pass)) {
+            run_pass(ctx, pass, &ctx->optimization_stats[ctx->optimization_stats_count++]);
+        }
+    }
+}
+
+/* end of SDL_shader_optimizer.c ... */
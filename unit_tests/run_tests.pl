@@ -14,8 +14,72 @@ my $binpath = getcwd();
 
 my $GPrintCmds = 0;
 
-my @modules = qw( preprocessor assembler compiler parser );
+my @modules = qw( preprocessor assembler compiler optimizer fastmath halfprecision parallel unreachablecheck unreachableskip verifier reader parser );
+
+# command line options for sdl-shader-compiler, for each module that compiles.
+my %compiler_options = (
+    'compiler' => '',
+    'optimizer' => '-O2 ',
+    'fastmath' => '-O2 -ffast-math ',
+    'halfprecision' => '-O2 -fhalf-precision ',
+    'parallel' => '-j 4 ',
+    'unreachablecheck' => '-u check ',
+    'unreachableskip' => '-u skip ',
+);
+
+# the same CRC-32 as SDL_SHADER_BytecodeCrc32(), a bit at a time, since tests are small.
+sub crc32 {
+    my $crc = 0xFFFFFFFF;
+    foreach (unpack('C*', $_[0])) {
+        $crc ^= $_;
+        for (my $i = 0; $i < 8; $i++) {
+            $crc = ($crc >> 1) ^ (($crc & 1) ? 0xEDB88320 : 0);
+        }
+    }
+    return $crc ^ 0xFFFFFFFF;
+}
 
+# Tests of bytecode files are written out as 32-bit words in hex, separated by
+#  whitespace, with '#' starting a comment. A word of 'crc' gets the CRC-32 of
+#  everything after it, so a test can change a file without working it out.
+sub write_bytecode {
+    my ($fname, $output) = @_;
+    my @words = ();
+    my $crcpos = -1;
+
+    if (not open(IN, '<', $fname)) {
+        return 0;
+    }
+
+    while (<IN>) {
+        s/#.*//;
+        foreach (split) {
+            if ($_ eq 'crc') {
+                $crcpos = scalar(@words);
+                push(@words, 0);
+            } elsif (/\A(0x)?[0-9a-fA-F]{1,8}\Z/) {
+                push(@words, hex($_));
+            } else {
+                close(IN);
+                return 0;
+            }
+        }
+    }
+    close(IN);
+
+    my $bytecode = pack('V*', @words);
+    if ($crcpos >= 0) {
+        substr($bytecode, $crcpos * 4, 4) = pack('V', crc32(substr($bytecode, ($crcpos + 1) * 4)));
+    }
+
+    if (not open(OUT, '>', $output)) {
+        return 0;
+    }
+    binmode(OUT);
+    print OUT $bytecode;
+    close(OUT);
+    return 1;
+}
 
 sub compare_files {
     my ($a, $b, $endlines) = @_;
@@ -61,10 +125,26 @@ $tests{'output'} = sub {
     # !!! FIXME: this should go elsewhere.
     if ($module eq 'preprocessor') {
         $cmd = "$binpath/sdl-shader-compiler -P '$fname' -o '$output'";
+        $cmd .= ' 2>/dev/null 1>/dev/null';
+    } elsif (defined $compiler_options{$module}) {
+        my $bytecode = 'unittest_tempbytecode';
+        my $options = $compiler_options{$module};
+        $cmd = "$binpath/sdl-shader-compiler $options-C '$fname' -o '$bytecode' 2>/dev/null 1>/dev/null";
+        $cmd .= " && $binpath/sdl-shader-bytecode-dumper '$bytecode' 2>/dev/null 1>'$output'";
+        $cmd .= " && $binpath/sdl-shader-bytecode-reader-test '$bytecode' 2>/dev/null 1>/dev/null";
+        $cmd .= " ; rc=\$? ; rm -f '$bytecode' ; exit \$rc";
+    } elsif ($module eq 'reader') {
+        # bytecode the compiler doesn't make, to check the reading API against.
+        my $bytecode = 'unittest_tempbytecode';
+        if (not write_bytecode($fname, $bytecode)) {
+            return (0, "Couldn't read bytecode words from '$fname'");
+        }
+        $cmd = "$binpath/sdl-shader-bytecode-dumper '$bytecode' 2>/dev/null 1>'$output'";
+        $cmd .= " && $binpath/sdl-shader-bytecode-reader-test '$bytecode' 2>/dev/null 1>/dev/null";
+        $cmd .= " ; rc=\$? ; rm -f '$bytecode' ; exit \$rc";
     } else {
         return (0, "Don't know how to do this module type");
     }
-    $cmd .= ' 2>/dev/null 1>/dev/null';
 
     print("$cmd\n") if ($GPrintCmds);
 
@@ -91,10 +171,19 @@ $tests{'errors'} = sub {
     # !!! FIXME: this should go elsewhere.
     if ($module eq 'preprocessor') {
         $cmd = "$binpath/sdl-shader-compiler -P '$fname' -o '$output'";
+    } elsif (defined $compiler_options{$module}) {
+        my $options = $compiler_options{$module};
+        $cmd = "$binpath/sdl-shader-compiler $options-C '$fname' -o '$output'";
+    } elsif ($module eq 'verifier') {
+        # the dumper says what the verifier thought of the file; that's the error we want.
+        if (not write_bytecode($fname, $output)) {
+            return (0, "Couldn't read bytecode words from '$fname'");
+        }
+        $cmd = "$binpath/sdl-shader-bytecode-dumper '$output' 2>/dev/null | grep '^verifier:' 1>$error_output";
     } else {
         return (0, "Don't know how to do this module type");
     }
-    $cmd .= " 2>$error_output 1>/dev/null";
+    $cmd .= " 2>$error_output 1>/dev/null" if ($module ne 'verifier');
 
     print("$cmd\n") if ($GPrintCmds);
 
@@ -0,0 +1,256 @@
+/**
+ * SDL_shader_tools; tools for SDL GPU shader support.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+/* This goes through bytecode files with SDL_SHADER_OpenBytecode() and the functions that read
+   through it, and checks that they find everything where the file says it is. It works out what
+   to expect straight from the words, so it doesn't trust the reading API to tell it. Every file
+   has to pass SDL_SHADER_VerifyBytecode(); run_tests.pl runs this on everything it compiles. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "SDL_shader_bytecode.h"
+
+static Uint32 raw_word(const Uint8 *file, const size_t pos)
+{
+    const Uint8 *ptr = file + (pos * 4);
+    return ((Uint32) ptr[0]) | (((Uint32) ptr[1]) << 8) | (((Uint32) ptr[2]) << 16) | (((Uint32) ptr[3]) << 24);
+}
+
+/* how many instructions are in the code from word `pos` to `end`, counting the code inside IFs and LOOPs. */
+static Uint32 raw_count_instructions(const Uint8 *file, size_t pos, const size_t end)
+{
+    Uint32 retval = 0;
+    while (pos < end) {
+        const Uint32 opcode = raw_word(file, pos);
+        const Uint32 num_words = raw_word(file, pos + 1);
+        if (opcode == SDL_SHADER_BCTAG_OP_IF) {
+            retval += raw_count_instructions(file, pos + 4, pos + num_words);
+        } else if (opcode == SDL_SHADER_BCTAG_OP_LOOP) {
+            retval += raw_count_instructions(file, pos + 2, pos + num_words);
+        }
+        retval++;
+        pos += num_words;
+    }
+    return retval;
+}
+
+static int check_reader_code(const char *fname, const SDL_SHADER_BytecodeFunction *fn, SDL_SHADER_BytecodeCode code, Uint32 *num_instructions)
+{
+    SDL_SHADER_BytecodeInstruction inst;
+    const Uint32 *expected = code.pos;
+
+    while (SDL_SHADER_NextBytecodeInstruction(&code, &inst)) {
+        if (inst.words != expected) {
+            fprintf(stderr, "%s: reading API lost its place in function $%u\n", fname, (unsigned int) fn->index);
+            return 0;
+        }
+
+        expected += inst.num_words;
+        (*num_instructions)++;
+
+        if (inst.opcode == SDL_SHADER_BCTAG_OP_IF) {
+            const Uint32 true_words = SDL_SHADER_BytecodeWord(inst.words, 3);
+            if ((inst.body.pos != (inst.words + 4)) || (inst.body.end != (inst.body.pos + true_words)) || (inst.else_body.pos != inst.body.end) || (inst.else_body.end != expected)) {
+                fprintf(stderr, "%s: reading API has an IF's code in the wrong place in function $%u\n", fname, (unsigned int) fn->index);
+                return 0;
+            } else if (!check_reader_code(fname, fn, inst.body, num_instructions) || !check_reader_code(fname, fn, inst.else_body, num_instructions)) {
+                return 0;
+            }
+        } else if (inst.opcode == SDL_SHADER_BCTAG_OP_LOOP) {
+            if ((inst.body.pos != (inst.words + 2)) || (inst.body.end != expected)) {
+                fprintf(stderr, "%s: reading API has a LOOP's code in the wrong place in function $%u\n", fname, (unsigned int) fn->index);
+                return 0;
+            } else if (!check_reader_code(fname, fn, inst.body, num_instructions)) {
+                return 0;
+            }
+        } else if ((inst.body.pos != expected) || (inst.body.end != expected) || (inst.else_body.pos != expected) || (inst.else_body.end != expected)) {
+            fprintf(stderr, "%s: reading API gave a %u instruction some code in function $%u\n", fname, (unsigned int) inst.opcode, (unsigned int) fn->index);
+            return 0;
+        }
+    }
+
+    if (expected != code.end) {
+        fprintf(stderr, "%s: reading API went past the end of some code in function $%u\n", fname, (unsigned int) fn->index);
+        return 0;
+    }
+    return 1;
+}
+
+/* looking up an entry point that isn't there should fail, and leave what it was given alone. */
+static int check_reader_misses(const char *fname, const SDL_SHADER_BytecodeModule *module, const char *name)
+{
+    SDL_SHADER_BytecodeFunction fn, untouched;
+
+    memset(&fn, 0xAA, sizeof (fn));
+    memcpy(&untouched, &fn, sizeof (fn));
+
+    if (SDL_SHADER_FindBytecodeEntryPoint(module, name, &fn)) {
+        fprintf(stderr, "%s: reading API found an entry point named '%s'\n", fname, name);
+        return 0;
+    } else if (memcmp(&fn, &untouched, sizeof (fn)) != 0) {
+        fprintf(stderr, "%s: reading API changed the function it was given when it didn't find '%s'\n", fname, name);
+        return 0;
+    }
+    return 1;
+}
+
+static int check_reader(const char *fname, const Uint8 *file, const size_t filelen)
+{
+    const size_t num_words = filelen / 4;
+    SDL_SHADER_BytecodeModule module, verified;
+    SDL_SHADER_BytecodeType type, othertype;
+    SDL_SHADER_BytecodeFunction fn, otherfn;
+    SDL_bool has_directory = SDL_FALSE;
+    Uint32 num_types = 0;
+    Uint32 num_functions = 0;
+    Uint32 expected_instructions = 0;
+    Uint32 num_instructions = 0;
+    size_t pos = 5;
+    char errbuf[256];
+
+    if (!SDL_SHADER_OpenBytecode(&module, file, filelen, errbuf, sizeof (errbuf))) {
+        fprintf(stderr, "%s: reading API couldn't open the file: %s\n", fname, errbuf);
+        return 0;
+    } else if (!SDL_SHADER_OpenVerifiedBytecode(&verified, file, filelen, errbuf, sizeof (errbuf))) {
+        fprintf(stderr, "%s: reading API couldn't open the file without verifying it: %s\n", fname, errbuf);
+        return 0;
+    } else if (memcmp(&module, &verified, sizeof (module)) != 0) {
+        fprintf(stderr, "%s: reading API opened the file differently without verifying it\n", fname);
+        return 0;
+    }
+
+    /* the file verified, so we can walk it without checking anything. */
+    while (pos < num_words) {
+        const Uint32 tag = raw_word(file, pos);
+        const size_t end = pos + raw_word(file, pos + 1);
+        if (tag == SDL_SHADER_BCTAG_DIRECTORY) {
+            has_directory = SDL_TRUE;
+        } else if (tag == SDL_SHADER_BCTAG_TYPES) {
+            num_types = raw_word(file, pos + 2);
+        } else {
+            /* skip the name, then the inputs, outputs and constant pool, which each start with their size. */
+            size_t code = pos + 4 + raw_word(file, pos + 3);
+            code += raw_word(file, code);
+            code += raw_word(file, code);
+            code += raw_word(file, code);
+            expected_instructions += raw_count_instructions(file, code, end);
+            num_functions++;
+        }
+        pos = end;
+    }
+
+    if ((module.num_types != num_types) || (module.num_functions != num_functions)) {
+        fprintf(stderr, "%s: reading API found %u types and %u functions, not %u and %u\n", fname, (unsigned int) module.num_types, (unsigned int) module.num_functions, (unsigned int) num_types, (unsigned int) num_functions);
+        return 0;
+    } else if ((module.directory != NULL) != has_directory) {
+        fprintf(stderr, "%s: reading API is wrong about there being a directory\n", fname);
+        return 0;
+    }
+
+    memset(&type, 0, sizeof (type));
+    while (SDL_SHADER_NextBytecodeType(&module, &type)) {
+        if (!SDL_SHADER_GetBytecodeType(&module, type.id, &othertype) || (othertype.words != type.words)) {
+            fprintf(stderr, "%s: reading API can't look up type #%u\n", fname, (unsigned int) type.id);
+            return 0;
+        }
+    }
+
+    memset(&fn, 0, sizeof (fn));
+    while (SDL_SHADER_NextBytecodeFunction(&module, &fn)) {
+        if (!SDL_SHADER_GetBytecodeFunction(&module, fn.index, &otherfn) || (otherfn.words != fn.words)) {
+            fprintf(stderr, "%s: reading API can't look up function $%u\n", fname, (unsigned int) fn.index);
+            return 0;
+        } else if (fn.name && (!SDL_SHADER_FindBytecodeEntryPoint(&module, fn.name, &otherfn) || (otherfn.index != fn.index))) {
+            fprintf(stderr, "%s: reading API can't find entry point '%s'\n", fname, fn.name);
+            return 0;
+        } else if (!check_reader_code(fname, &fn, fn.code, &num_instructions)) {
+            return 0;
+        }
+
+        if (fn.name) {  /* names can't have a '.' in them, so this shouldn't find anything. */
+            char notaname[128];
+            snprintf(notaname, sizeof (notaname), "%s.", fn.name);
+            if (!check_reader_misses(fname, &module, notaname)) {
+                return 0;
+            } else if ((strcmp(fn.name, "fs_main") == 0) && !check_reader_misses(fname, &module, "f83gev")) {
+                return 0;  /* that has the same hash as "fs_main", so a DIRECTORY finds its bucket, but it still isn't there. */
+            }
+        }
+    }
+
+    if (SDL_SHADER_GetBytecodeFunction(&module, module.num_functions, &otherfn)) {
+        fprintf(stderr, "%s: reading API found a function after the last one\n", fname);
+        return 0;
+    } else if (num_instructions != expected_instructions) {
+        fprintf(stderr, "%s: reading API found %u instructions, not %u\n", fname, (unsigned int) num_instructions, (unsigned int) expected_instructions);
+        return 0;
+    }
+    return 1;
+}
+
+static int check_file(const char *fname)
+{
+    Uint8 *bytecode = NULL;
+    size_t allocated = 0;
+    int retval = 0;
+    FILE *io = fopen(fname, "rb");
+
+    if (!io) {
+        fprintf(stderr, "Failed to open '%s': %s\n", fname, strerror(errno));
+        return 0;
+    }
+
+    while (1) {
+        const size_t blocklen = 4096;
+        const size_t new_allocated = allocated + blocklen;
+        void *ptr = realloc(bytecode, new_allocated);
+        size_t br;
+
+        if (!ptr) {
+            fprintf(stderr, "%s: Out of memory.\n", fname);
+            free(bytecode);
+            fclose(io);
+            return 0;
+        }
+
+        bytecode = (Uint8 *) ptr;
+
+        br = fread(bytecode + allocated, 1, blocklen, io);
+        allocated += br;
+        if (br < blocklen) {
+            break;
+        }
+    }
+
+    if (ferror(io)) {
+        fprintf(stderr, "%s: read error: %s\n", fname, strerror(errno));
+    } else {
+        retval = check_reader(fname, bytecode, allocated);
+    }
+
+    fclose(io);
+    free(bytecode);
+    return retval;
+}
+
+int main(int argc, char **argv)
+{
+    int retval = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (!check_file(argv[i])) {
+            retval = 1;
+        }
+    }
+
+    return retval;
+}
+
+/* end of sdl-shader-bytecode-reader-test.c ... */
@@ -12,38 +12,6 @@ typedef union Uint32_Float_Reinterpreter {
     float f;
 } Uint32_Float_Reinterpreter;
 
-static void crc32_init(Uint32 *context)
-{
-    *context = (Uint32) 0xFFFFFFFF;
-}
-
-static void crc32_append(Uint32 *_crc, const Uint8 *buf, const Uint32 len)
-{
-    Uint32 crc = *_crc;
-    Uint32 n;
-
-    for (n = 0; n < len; n++) {
-        Uint32 xorval = (Uint32) ((crc ^ buf[n]) & 0xFF);
-        xorval = ((xorval & 1) ? (0xEDB88320 ^ (xorval >> 1)) : (xorval >> 1));
-        xorval = ((xorval & 1) ? (0xEDB88320 ^ (xorval >> 1)) : (xorval >> 1));
-        xorval = ((xorval & 1) ? (0xEDB88320 ^ (xorval >> 1)) : (xorval >> 1));
-        xorval = ((xorval & 1) ? (0xEDB88320 ^ (xorval >> 1)) : (xorval >> 1));
-        xorval = ((xorval & 1) ? (0xEDB88320 ^ (xorval >> 1)) : (xorval >> 1));
-        xorval = ((xorval & 1) ? (0xEDB88320 ^ (xorval >> 1)) : (xorval >> 1));
-        xorval = ((xorval & 1) ? (0xEDB88320 ^ (xorval >> 1)) : (xorval >> 1));
-        xorval = ((xorval & 1) ? (0xEDB88320 ^ (xorval >> 1)) : (xorval >> 1));
-        crc = xorval ^ (crc >> 8);
-    }
-
-    *_crc = crc;
-}
-
-static Uint32 crc32_finish(Uint32 *context)
-{
-    *context ^= 0xFFFFFFFF;
-    return *context;
-}
-
 static Uint32 readui32(Uint8 **_ui8, size_t *_bclen)
 {
     const Uint8 *ui8 = *_ui8;
@@ -88,6 +56,40 @@ static void print_indent(const int indent)
     }
 }
 
+/* format 3 and later put a type id after every instruction's output; these are the file's type table, as printable names. */
+typedef char TypeName[64];
+static Uint32 bytecode_version = 0;
+static TypeName *type_names = NULL;
+static Uint32 num_type_names = 0;
+
+/* words an instruction's output takes up: the SSA id, and its type id in format 3 and later. */
+static Uint32 output_words(void)
+{
+    return (bytecode_version >= 3) ? 2 : 1;
+}
+
+static const char *typeidstr(const Uint32 typeid)
+{
+    if (typeid == 0) {
+        return "void";
+    } else if (typeid > num_type_names) {
+        return "???";
+    }
+    return type_names[typeid - 1];
+}
+
+/* reads an instruction's output (and its type, if the format has one), as something like "%5:float4". */
+static const char *read_output(Uint8 **bytecode, size_t *bclen, char *buf, const size_t buflen)
+{
+    const Uint32 output = readui32(bytecode, bclen);
+    if (bytecode_version >= 3) {
+        snprintf(buf, buflen, "%%%u:%s", (unsigned int) output, typeidstr(readui32(bytecode, bclen)));
+    } else {
+        snprintf(buf, buflen, "%%%u", (unsigned int) output);
+    }
+    return buf;
+}
+
 
 static int dump_bytecode_instructions(const int indent, const char *fname, Uint8 **bytecode, size_t *bclen, Uint32 num_words);
 
@@ -121,10 +123,11 @@ static int dump_bytecode_instruction_noinout(const int indent, const char *fname
 
 static int dump_bytecode_instruction_noinput(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
-    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 3)) {
-        const Uint32 output = readui32(bytecode, bclen);
+    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 2 + output_words())) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
         print_indent(indent);
-        printf("%s %%%u\n", opcode, (unsigned int) output);
+        printf("%s %s\n", opcode, output);
         return 1;
     }
     return 0;
@@ -132,11 +135,12 @@ static int dump_bytecode_instruction_noinput(const int indent, const char *fname
 
 static int dump_bytecode_instruction_unary(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
-    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 4)) {
-        const Uint32 output = readui32(bytecode, bclen);
+    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 3 + output_words())) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
         const Uint32 input = readui32(bytecode, bclen);
         print_indent(indent);
-        printf("%s %%%u, %%%u\n", opcode, (unsigned int) output, (unsigned int) input);
+        printf("%s %s, %%%u\n", opcode, output, (unsigned int) input);
         return 1;
     }
     return 0;
@@ -144,12 +148,13 @@ static int dump_bytecode_instruction_unary(const int indent, const char *fname,
 
 static int dump_bytecode_instruction_binary(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
-    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 5)) {
-        const Uint32 output = readui32(bytecode, bclen);
+    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 4 + output_words())) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
         const Uint32 input1 = readui32(bytecode, bclen);
         const Uint32 input2 = readui32(bytecode, bclen);
         print_indent(indent);
-        printf("%s %%%u, %%%u, %%%u\n", opcode, (unsigned int) output, (unsigned int) input1, (unsigned int) input2);
+        printf("%s %s, %%%u, %%%u\n", opcode, output, (unsigned int) input1, (unsigned int) input2);
         return 1;
     }
     return 0;
@@ -157,13 +162,14 @@ static int dump_bytecode_instruction_binary(const int indent, const char *fname,
 
 static int dump_bytecode_instruction_ternary(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
-    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 6)) {
-        const Uint32 output = readui32(bytecode, bclen);
+    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 5 + output_words())) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
         const Uint32 input1 = readui32(bytecode, bclen);
         const Uint32 input2 = readui32(bytecode, bclen);
         const Uint32 input3 = readui32(bytecode, bclen);
         print_indent(indent);
-        printf("%s %%%u, %%%u, %%%u, %%%u\n", opcode, (unsigned int) output, (unsigned int) input1, (unsigned int) input2, (unsigned int) input3);
+        printf("%s %s, %%%u, %%%u, %%%u\n", opcode, output, (unsigned int) input1, (unsigned int) input2, (unsigned int) input3);
         return 1;
     }
     return 0;
@@ -171,11 +177,12 @@ static int dump_bytecode_instruction_ternary(const int indent, const char *fname
 
 static int dump_bytecode_instruction_literalint(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
-    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 4)) {
-        const Uint32 output = readui32(bytecode, bclen);
+    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 3 + output_words())) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
         const Uint32 input = readui32(bytecode, bclen);
         print_indent(indent);
-        printf("%s %%%u, %u\n", opcode, (unsigned int) output, (unsigned int) input);
+        printf("%s %s, %u\n", opcode, output, (unsigned int) input);
         return 1;
     }
     return 0;
@@ -183,13 +190,14 @@ static int dump_bytecode_instruction_literalint(const int indent, const char *fn
 
 static int dump_bytecode_instruction_literalfloat(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
-    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 4)) {
-        const Uint32 output = readui32(bytecode, bclen);
+    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 3 + output_words())) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
         const Uint32 input = readui32(bytecode, bclen);
         Uint32_Float_Reinterpreter cvt;
         cvt.ui32 = input;
         print_indent(indent);
-        printf("%s %%%u, %f\n", opcode, (unsigned int) output, cvt.f);
+        printf("%s %s, %f\n", opcode, output, cvt.f);
         return 1;
     }
     return 0;
@@ -197,11 +205,12 @@ static int dump_bytecode_instruction_literalfloat(const int indent, const char *
 
 static int dump_bytecode_instruction_literalint4(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
-    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 7)) {
-        const Uint32 output = readui32(bytecode, bclen);
+    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 6 + output_words())) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
         int i;
         print_indent(indent);
-        printf("%s %%%u", opcode, (unsigned int) output);
+        printf("%s %s", opcode, output);
         for (i = 0; i < 4; i++) {
             const Uint32 input = readui32(bytecode, bclen);
             printf(", %u", (unsigned int) input);
@@ -214,9 +223,12 @@ static int dump_bytecode_instruction_literalint4(const int indent, const char *f
 
 static int dump_bytecode_instruction_literalfloat4(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
-    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 7)) {
-        const Uint32 output = readui32(bytecode, bclen);
+    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 6 + output_words())) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
         int i;
+        print_indent(indent);
+        printf("%s %s", opcode, output);
         for (i = 0; i < 4; i++) {
             const Uint32 input = readui32(bytecode, bclen);
             Uint32_Float_Reinterpreter cvt;
@@ -229,6 +241,96 @@ static int dump_bytecode_instruction_literalfloat4(const int indent, const char
     return 0;
 }
 
+/* PHI %output, %input1, %input2, ... */
+static int dump_bytecode_instruction_phi(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
+{
+    if (instruction_num_words_atleast(fname, opcode, bytecode, bclen, num_words, 3 + output_words())) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
+        Uint32 i;
+
+        print_indent(indent);
+        printf("%s %s", opcode, output);
+
+        num_words -= output_words();  /* remaining words are the inputs. */
+        for (i = 0; i < num_words; i++) {
+            printf(", %%%u", (unsigned int) readui32(bytecode, bclen));
+        }
+        printf("\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* CONSTRUCT and CONVERT have a type word: this turns it into something like "float4x4". */
+static const char *typewordstr(const Uint32 typeword, char *buf, const size_t buflen)
+{
+    const Uint32 elements = SDL_SHADER_BYTECODE_TYPEWORD_ELEMENTS(typeword);
+    const Uint32 rows = SDL_SHADER_BYTECODE_TYPEWORD_ROWS(typeword);
+    const char *scalar;
+
+    switch (SDL_SHADER_BYTECODE_TYPEWORD_SCALAR(typeword)) {
+        case SDL_SHADER_BCSCALAR_NONE: return (typeword == 0) ? "struct" : "unknown";
+        case SDL_SHADER_BCSCALAR_BOOL: scalar = "bool"; break;
+        case SDL_SHADER_BCSCALAR_INT: scalar = "int"; break;
+        case SDL_SHADER_BCSCALAR_UINT: scalar = "uint"; break;
+        case SDL_SHADER_BCSCALAR_HALF: scalar = "half"; break;
+        case SDL_SHADER_BCSCALAR_FLOAT: scalar = "float"; break;
+        default: return "unknown";
+    }
+
+    if (rows > 1) {
+        snprintf(buf, buflen, "%s%ux%u", scalar, (unsigned int) elements, (unsigned int) rows);
+    } else if (elements > 1) {
+        snprintf(buf, buflen, "%s%u", scalar, (unsigned int) elements);
+    } else {
+        snprintf(buf, buflen, "%s", scalar);
+    }
+    return buf;
+}
+
+/* CONSTRUCT %output, type, %input1, %input2, ... (format 3 and later: the type is a type id, like every other output's.) */
+static int dump_bytecode_instruction_construct(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
+{
+    if (instruction_num_words_atleast(fname, opcode, bytecode, bclen, num_words, 4)) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
+        Uint32 i;
+
+        print_indent(indent);
+        if (bytecode_version >= 3) {
+            printf("%s %s", opcode, output);
+        } else {
+            char buf[32];
+            printf("%s %s, %s", opcode, output, typewordstr(readui32(bytecode, bclen), buf, sizeof (buf)));
+        }
+
+        num_words -= 2;  /* remaining words are the inputs. */
+        for (i = 0; i < num_words; i++) {
+            printf(", %%%u", (unsigned int) readui32(bytecode, bclen));
+        }
+        printf("\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* CONVERT %output, type, %input (format 3 and later: the type is a type id, like every other output's.) */
+static int dump_bytecode_instruction_convert(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
+{
+    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 5)) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
+        char buf[32];
+        const char *type = (bytecode_version >= 3) ? NULL : typewordstr(readui32(bytecode, bclen), buf, sizeof (buf));
+        const Uint32 input = readui32(bytecode, bclen);
+        print_indent(indent);
+        printf("%s %s, %s%s%%%u\n", opcode, output, type ? type : "", type ? ", " : "", (unsigned int) input);
+        return 1;
+    }
+    return 0;
+}
+
 static int dump_bytecode_instruction_if(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
     if (instruction_num_words_atleast(fname, opcode, bytecode, bclen, num_words, 4)) {
@@ -279,15 +381,16 @@ static int dump_bytecode_instruction_if(const int indent, const char *fname, con
 
 static int dump_bytecode_instruction_call(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
-    if (instruction_num_words_atleast(fname, opcode, bytecode, bclen, num_words, 4)) {
+    if (instruction_num_words_atleast(fname, opcode, bytecode, bclen, num_words, 3 + output_words())) {
+        char outbuf[96];
         const Uint32 fnid = readui32(bytecode, bclen);
-        const Uint32 output = readui32(bytecode, bclen);
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
         Uint32 i;
 
         print_indent(indent);
-        printf("%s $%u, %%%u", opcode, (unsigned int) fnid, (unsigned int) output);
+        printf("%s $%u, %s", opcode, (unsigned int) fnid, output);
 
-        num_words -= 2;  /* remaining words are the inputs. */
+        num_words -= 1 + output_words();  /* remaining words are the inputs. */
         for (i = 0; i < num_words; i++) {
             printf(", %%%u", (unsigned int) readui32(bytecode, bclen));
         }
@@ -335,12 +438,13 @@ static int dump_bytecode_instruction_return(const int indent, const char *fname,
 
 static int dump_bytecode_instruction_swizzle(const int indent, const char *fname, const char *opcode, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
-    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 5)) {
-        const Uint32 output = readui32(bytecode, bclen);
+    if (instruction_num_words_okay(fname, opcode, bytecode, bclen, num_words, 4 + output_words())) {
+        char outbuf[96];
+        const char *output = read_output(bytecode, bclen, outbuf, sizeof (outbuf));
         const Uint32 input = readui32(bytecode, bclen);
         const Uint32 swizvals = readui32(bytecode, bclen);
         print_indent(indent);
-        printf("%s %%%u, %%%u, 0x%X\n", opcode, (unsigned int) output, (unsigned int) input, (unsigned int) swizvals);
+        printf("%s %s, %%%u, 0x%X\n", opcode, output, (unsigned int) input, (unsigned int) swizvals);
         return 1;
     }
     return 0;
@@ -397,7 +501,7 @@ static int dump_bytecode_instruction(const int indent, const char *fname, Uint8
         case SDL_SHADER_BCTAG_OP_CONTINUE: return dump_bytecode_instruction_noinout(indent, fname, "CONTINUE", bytecode, bclen, num_words);
         case SDL_SHADER_BCTAG_OP_LOOP: return dump_bytecode_instruction_loop(indent, fname, "LOOP", bytecode, bclen, num_words);
         case SDL_SHADER_BCTAG_OP_RETURN: return dump_bytecode_instruction_return(indent, fname, "RETURN", bytecode, bclen, num_words);
-        case SDL_SHADER_BCTAG_OP_PHI: return dump_bytecode_instruction_binary(indent, fname, "PHI", bytecode, bclen, num_words);
+        case SDL_SHADER_BCTAG_OP_PHI: return dump_bytecode_instruction_phi(indent, fname, "PHI", bytecode, bclen, num_words);
         case SDL_SHADER_BCTAG_OP_SWIZZLE: return dump_bytecode_instruction_swizzle(indent, fname, "SWIZZLE", bytecode, bclen, num_words);
         case SDL_SHADER_BCTAG_OP_ALL: return dump_bytecode_instruction_unary(indent, fname, "ALL", bytecode, bclen, num_words);
         case SDL_SHADER_BCTAG_OP_ANY: return dump_bytecode_instruction_unary(indent, fname, "ANY", bytecode, bclen, num_words);
@@ -436,7 +540,7 @@ static int dump_bytecode_instruction(const int indent, const char *fname, Uint8
         case SDL_SHADER_BCTAG_OP_MAX: return dump_bytecode_instruction_binary(indent, fname, "MAX", bytecode, bclen, num_words);
         case SDL_SHADER_BCTAG_OP_CLAMP: return dump_bytecode_instruction_ternary(indent, fname, "CLAMP", bytecode, bclen, num_words);
         case SDL_SHADER_BCTAG_OP_MIX: return dump_bytecode_instruction_ternary(indent, fname, "MIX", bytecode, bclen, num_words);
-        case SDL_SHADER_BCTAG_OP_STEP: return dump_bytecode_instruction_ternary(indent, fname, "STEP", bytecode, bclen, num_words);
+        case SDL_SHADER_BCTAG_OP_STEP: return dump_bytecode_instruction_binary(indent, fname, "STEP", bytecode, bclen, num_words);
         case SDL_SHADER_BCTAG_OP_SMOOTHSTEP: return dump_bytecode_instruction_ternary(indent, fname, "SMOOTHSTEP", bytecode, bclen, num_words);
         case SDL_SHADER_BCTAG_OP_MAD: return dump_bytecode_instruction_ternary(indent, fname, "MAD", bytecode, bclen, num_words);
         case SDL_SHADER_BCTAG_OP_FREXP: return dump_bytecode_instruction_binary(indent, fname, "FREXP", bytecode, bclen, num_words);
@@ -451,6 +555,12 @@ static int dump_bytecode_instruction(const int indent, const char *fname, Uint8
         case SDL_SHADER_BCTAG_OP_REFRACT: return dump_bytecode_instruction_ternary(indent, fname, "REFRACT", bytecode, bclen, num_words);
         case SDL_SHADER_BCTAG_OP_TRANSPOSE: return dump_bytecode_instruction_unary(indent, fname, "TRANSPOSE", bytecode, bclen, num_words);
         //case SDL_SHADER_BCTAG_OP_SAMPLE: return dump_bytecode_instruction_sample(indent, fname, "SAMPLE", bytecode, bclen, num_words);
+        case SDL_SHADER_BCTAG_OP_CONSTRUCT: return dump_bytecode_instruction_construct(indent, fname, "CONSTRUCT", bytecode, bclen, num_words);
+        case SDL_SHADER_BCTAG_OP_CONVERT: return dump_bytecode_instruction_convert(indent, fname, "CONVERT", bytecode, bclen, num_words);
+        case SDL_SHADER_BCTAG_OP_EXTRACT: return dump_bytecode_instruction_binary(indent, fname, "EXTRACT", bytecode, bclen, num_words);
+        case SDL_SHADER_BCTAG_OP_INSERT: return dump_bytecode_instruction_ternary(indent, fname, "INSERT", bytecode, bclen, num_words);
+        case SDL_SHADER_BCTAG_OP_SELECT: return dump_bytecode_instruction_ternary(indent, fname, "SELECT", bytecode, bclen, num_words);
+        case SDL_SHADER_BCTAG_OP_MATMUL: return dump_bytecode_instruction_binary(indent, fname, "MATMUL", bytecode, bclen, num_words);
         default: break;
     }
 
@@ -472,7 +582,7 @@ static int dump_bytecode_instructions(const int indent, const char *fname, Uint8
     if (num_words) {
         fprintf(stderr, "%s: extra bytes at end of code block, corrupt file?\n", fname);
         retval = 0;
-        bytecode += num_words * 4;
+        *bytecode += num_words * 4;
         *bclen -= num_words * 4;
         num_words = 0;
     }
@@ -482,48 +592,395 @@ static int dump_bytecode_instructions(const int indent, const char *fname, Uint8
 
 static const char *fntypestr(const Uint32 fntype)
 {
-    switch (fntype) {
-        /* !!! FIXME: need an enum here */
-        case 0x0: return "";
-        case 0x1: return " @vertex";
-        case 0x2: return " @fragment";
+    switch ((SDL_SHADER_BytecodeFunctionType) fntype) {
+        case SDL_SHADER_BCFNTYPE_NORMAL: return "";
+        case SDL_SHADER_BCFNTYPE_VERTEX: return " @vertex";
+        case SDL_SHADER_BCFNTYPE_FRAGMENT: return " @fragment";
         default: break;
     }
-    return "unknown";
+    return " @unknown";
+}
+
+/* Inputs and Outputs are both a num_words and a count, then (format 3 and later) each one's type id, which `*types` points to if there are enough of them (NULL otherwise). Returns the count, or -1 if corrupt. */
+static Sint64 dump_bytecode_function_details(const char *fname, const char *what, Uint8 **bytecode, size_t *bclen, Uint32 *num_words, const Uint8 **types)
+{
+    Uint32 details_words;
+    Uint32 count;
+
+    if (*num_words < 2) {
+        fprintf(stderr, "%s: Function is missing its %s, corrupt file?\n", fname, what);
+        return -1;
+    }
+
+    details_words = readui32(bytecode, bclen);
+    count = readui32(bytecode, bclen);
+    if ((details_words < 2) || (details_words > *num_words)) {
+        fprintf(stderr, "%s: Function %s are %u words, corrupt file?\n", fname, what, (unsigned int) details_words);
+        return -1;
+    }
+
+    *types = ((bytecode_version >= 3) && ((details_words - 2) >= count)) ? *bytecode : NULL;
+
+    /* skip anything newer versions added that we don't understand. */
+    *bytecode += (details_words - 2) * 4;
+    *bclen -= (details_words - 2) * 4;
+    *num_words -= details_words;
+    return (Sint64) count;
+}
+
+/* The constant pool (format 2 and later): each constant is an opcode and its value(s), and gets the next SSA id after the inputs. */
+static int dump_bytecode_function_constants(const char *fname, Uint8 **bytecode, size_t *bclen, Uint32 *num_words, const Uint32 first_id)
+{
+    Uint32 constants_words, count, words_left, i;
+    int retval = 1;
+
+    if (*num_words < 2) {
+        fprintf(stderr, "%s: Function is missing its constants, corrupt file?\n", fname);
+        return 0;
+    }
+
+    constants_words = readui32(bytecode, bclen);
+    count = readui32(bytecode, bclen);
+    if ((constants_words < 2) || (constants_words > *num_words)) {
+        fprintf(stderr, "%s: Function constants are %u words, corrupt file?\n", fname, (unsigned int) constants_words);
+        return 0;
+    }
+
+    *num_words -= constants_words;
+    words_left = constants_words - 2;
+
+    if (count > 0) {
+        print_indent(1);
+        printf("CONSTANTS\n");
+    }
+
+    for (i = 0; i < count; i++) {
+        SDL_bool is_float, is_vec4;
+        Uint32 tag, num_values, j;
+
+        if (words_left == 0) {
+            fprintf(stderr, "%s: Function constants go past their end, corrupt file?\n", fname);
+            retval = 0;
+            break;
+        }
+
+        tag = readui32(bytecode, bclen);
+        words_left--;
+        is_vec4 = ((tag == SDL_SHADER_BCTAG_OP_LITERALINT4) || (tag == SDL_SHADER_BCTAG_OP_LITERALFLOAT4)) ? SDL_TRUE : SDL_FALSE;
+        is_float = ((tag == SDL_SHADER_BCTAG_OP_LITERALFLOAT) || (tag == SDL_SHADER_BCTAG_OP_LITERALFLOAT4)) ? SDL_TRUE : SDL_FALSE;
+        num_values = is_vec4 ? 4 : 1;
+
+        if (!is_float && !is_vec4 && (tag != SDL_SHADER_BCTAG_OP_LITERALINT)) {
+            fprintf(stderr, "%s: Constant %u has unknown type %u, corrupt file?\n", fname, (unsigned int) i, (unsigned int) tag);
+            retval = 0;
+            break;
+        } else if (words_left < num_values) {
+            fprintf(stderr, "%s: Function constants go past their end, corrupt file?\n", fname);
+            retval = 0;
+            break;
+        }
+
+        words_left -= num_values;
+        print_indent(2);
+        printf("%s %%%u", is_float ? (is_vec4 ? "LITERALFLOAT4" : "LITERALFLOAT") : (is_vec4 ? "LITERALINT4" : "LITERALINT"), (unsigned int) (first_id + i));
+        for (j = 0; j < num_values; j++) {
+            const Uint32 value = readui32(bytecode, bclen);
+            if (is_float) {
+                Uint32_Float_Reinterpreter cvt;
+                cvt.ui32 = value;
+                printf(", %f", cvt.f);
+            } else {
+                printf(", %u", (unsigned int) value);
+            }
+        }
+        printf("\n");
+    }
+
+    if (count > 0) {
+        print_indent(1);
+        printf("ENDCONSTANTS\n");
+    }
+
+    /* skip anything we didn't get to (or anything newer versions added). */
+    *bytecode += words_left * 4;
+    *bclen -= words_left * 4;
+    return retval;
 }
 
-static int dump_bytecode_function(const Uint32 fnid, const char *fname, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
+static int dump_bytecode_function(const Uint32 version, const Uint32 fnid, const char *fname, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
 {
-    const Uint32 fntype = readui32(bytecode, bclen);  // currently: 0x0 for generic function, 0x1 for vertex, 0x2 for fragment.
-    const Uint32 namelen = readui32(bytecode, bclen);
+    Uint32 fntype, namelen;
     const char *name;
+    Sint64 num_inputs, num_outputs;
+    const Uint8 *input_types = NULL;
+    const Uint8 *output_types = NULL;
+    Sint64 i;
     int retval;
 
-    num_words -= 2;
+    if (num_words < 4) {
+        fprintf(stderr, "%s: Function is too small, corrupt file?\n", fname);
+        *bytecode += (num_words - 2) * 4;
+        *bclen -= (num_words - 2) * 4;
+        return 0;
+    }
+
+    fntype = readui32(bytecode, bclen);  /* see SDL_SHADER_BytecodeFunctionType */
+    namelen = readui32(bytecode, bclen);
+    num_words -= 4;  /* tag, num_words, fntype, namelen */
     if (namelen > num_words) {
         fprintf(stderr, "%s: Function with too-long name, corrupt file?\n", fname);
-        *bytecode += num_words;
+        *bytecode += num_words * 4;
         *bclen -= num_words * 4;
         return 0;
     }
 
     num_words -= namelen;
-    name = namelen ? *bytecode : NULL;
+    name = namelen ? (const char *) *bytecode : NULL;
+    if (name && (name[(namelen * 4) - 1] != '\0')) {
+        fprintf(stderr, "%s: Function name isn't null-terminated, corrupt file?\n", fname);
+        name = "???";
+    }
     *bytecode += namelen * 4;
     *bclen -= namelen * 4;
 
-    /* !!! FIXME: make sure string has a null-terminator */
-    printf("$%u = FUNCTION%s%s%s\n", (unsigned int) fnid, name ? " " : "", name ? name : "", fntypestr(fntype));
+    num_inputs = dump_bytecode_function_details(fname, "inputs", bytecode, bclen, &num_words, &input_types);
+    num_outputs = (num_inputs < 0) ? -1 : dump_bytecode_function_details(fname, "outputs", bytecode, bclen, &num_words, &output_types);
+    if (num_outputs < 0) {
+        *bytecode += num_words * 4;
+        *bclen -= num_words * 4;
+        return 0;
+    }
 
-    // !!! FIXME:    Inputs inputs;  // details of arguments to the function (see below).
-    // !!! FIXME:    Outputs outputs;  // details of outputs from the function (see below).
+    /* inputs are the first SSA ids in the function. */
+    printf("$%u = FUNCTION%s%s(", (unsigned int) fnid, name ? " " : "", name ? name : "");
+    for (i = 0; i < num_inputs; i++) {
+        printf("%s%%%u", i ? ", " : "", (unsigned int) (i + 1));
+        if (input_types) {
+            Uint8 *ptr = (Uint8 *) (input_types + (i * 4));
+            size_t len = 4;
+            printf(":%s", typeidstr(readui32(&ptr, &len)));
+        }
+    }
+    if (output_types && (num_outputs > 0)) {
+        Uint8 *ptr = (Uint8 *) output_types;
+        size_t len = 4;
+        printf(") -> %s%s\n", typeidstr(readui32(&ptr, &len)), fntypestr(fntype));
+    } else {
+        printf(") -> %s%s\n", (num_outputs > 0) ? "value" : "void", fntypestr(fntype));
+    }
 
-    retval = dump_bytecode_instructions(1, fname, bytecode, bclen, num_words);
+    retval = 1;
+    if ((version >= 2) && !dump_bytecode_function_constants(fname, bytecode, bclen, &num_words, (Uint32) (num_inputs + 1))) {
+        retval = 0;
+    }
+
+    if (!dump_bytecode_instructions(1, fname, bytecode, bclen, num_words)) {
+        retval = 0;
+    }
     printf("ENDFUNCTION\n\n");
+    return retval;
+}
+
+/* The type table (format 3 and later): each entry is a kind, num_words, and the kind's data. */
+static int dump_bytecode_types(const char *fname, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
+{
+    Uint32 count, i;
+    int retval = 1;
+
+    if (num_words < 3) {
+        fprintf(stderr, "%s: Type table is too small, corrupt file?\n", fname);
+        *bytecode += (num_words - 2) * 4;
+        *bclen -= (num_words - 2) * 4;
+        return 0;
+    }
+
+    count = readui32(bytecode, bclen);
+    num_words -= 3;  /* tag, num_words, count */
+
+    free(type_names);
+    num_type_names = 0;
+    type_names = (count > num_words) ? NULL : (TypeName *) malloc((count ? count : 1) * sizeof (TypeName));
+    if (type_names == NULL) {
+        fprintf(stderr, "%s: Type table is too big (%u entries), corrupt file?\n", fname, (unsigned int) count);
+        *bytecode += num_words * 4;
+        *bclen -= num_words * 4;
+        return 0;
+    }
+
+    printf("TYPES\n");
+    for (i = 0; i < count; i++) {
+        char *name = type_names[i];
+        Uint32 kind, entry_words, j;
+
+        if (num_words < 2) {
+            fprintf(stderr, "%s: Type table goes past its end, corrupt file?\n", fname);
+            retval = 0;
+            break;
+        }
+
+        kind = readui32(bytecode, bclen);
+        entry_words = readui32(bytecode, bclen);
+        if ((entry_words < 2) || (entry_words > num_words)) {
+            fprintf(stderr, "%s: Type #%u is %u words, corrupt file?\n", fname, (unsigned int) (i + 1), (unsigned int) entry_words);
+            num_words -= 2;
+            retval = 0;
+            break;
+        }
+        num_words -= entry_words;
+        entry_words -= 2;
+
+        if ((kind == SDL_SHADER_BCTYPE_VALUE) && (entry_words == 1)) {
+            char buf[32];
+            snprintf(name, sizeof (TypeName), "%s", typewordstr(readui32(bytecode, bclen), buf, sizeof (buf)));
+            entry_words = 0;
+        } else if ((kind == SDL_SHADER_BCTYPE_ARRAY) && (entry_words == 2)) {
+            const Uint32 elemtype = readui32(bytecode, bclen);
+            const Uint32 elements = readui32(bytecode, bclen);
+            snprintf(name, sizeof (TypeName), "%s[%u]", (elemtype <= i) ? typeidstr(elemtype) : "???", (unsigned int) elements);
+            entry_words = 0;
+        } else if (kind == SDL_SHADER_BCTYPE_STRUCT) {
+            snprintf(name, sizeof (TypeName), "struct#%u", (unsigned int) (i + 1));
+        } else {
+            fprintf(stderr, "%s: Type #%u has unknown kind %u, corrupt file?\n", fname, (unsigned int) (i + 1), (unsigned int) kind);
+            snprintf(name, sizeof (TypeName), "???");
+            retval = 0;
+        }
+
+        num_type_names = i + 1;
+
+        print_indent(1);
+        printf("#%u = %s", (unsigned int) (i + 1), name);
+        if (kind == SDL_SHADER_BCTYPE_STRUCT) {
+            const char *comma = " ";
+            printf(" {");
+            for (j = 0; j < entry_words; j++) {
+                const Uint32 membertype = readui32(bytecode, bclen);
+                printf("%s%s", comma, (membertype <= i) ? typeidstr(membertype) : "???");
+                comma = ", ";
+            }
+            printf(" }");
+            entry_words = 0;
+        }
+        printf("\n");
+
+        /* skip anything we didn't understand. */
+        *bytecode += entry_words * 4;
+        *bclen -= entry_words * 4;
+    }
+    printf("ENDTYPES\n\n");
+
+    /* skip anything we didn't get to (or anything newer versions added). */
+    *bytecode += num_words * 4;
+    *bclen -= num_words * 4;
+    return retval;
+}
+
+/* The directory (format 4 and later): each function's byte offset in the file, then a hash table of entry point names. */
+static Uint32 *directory_offsets = NULL;
+static Uint32 num_directory_offsets = 0;
+
+/* the name of the function whose tag is `offset` bytes into the file, NULL if there isn't one there. */
+static const char *directory_function_name(const Uint8 *file, const size_t filelen, const Uint32 offset)
+{
+    Uint8 *ptr = (Uint8 *) (file + offset);
+    size_t len = filelen - offset;
+    Uint32 namelen;
+
+    if ((offset % 4) || (offset > filelen) || (len < 16) || (readui32(&ptr, &len) != SDL_SHADER_BCTAG_FUNCTION)) {
+        return NULL;
+    }
+    readui32(&ptr, &len);  /* num_words */
+    readui32(&ptr, &len);  /* fntype */
+    namelen = readui32(&ptr, &len);
+    if ((namelen == 0) || (namelen > (len / 4)) || (ptr[(namelen * 4) - 1] != '\0')) {
+        return NULL;
+    }
+    return (const char *) ptr;
+}
+
+static int dump_bytecode_directory(const char *fname, const Uint8 *file, const size_t filelen, Uint8 **bytecode, size_t *bclen, Uint32 num_words)
+{
+    Uint32 count, num_buckets, i;
+    int retval = 1;
+
+    num_words -= 2;  /* tag, num_words */
+    count = (num_words > 0) ? readui32(bytecode, bclen) : 0;
+    if ((num_words < 2) || (count > (num_words - 2))) {
+        fprintf(stderr, "%s: Directory is too small, corrupt file?\n", fname);
+        *bytecode += (num_words - ((num_words > 0) ? 1 : 0)) * 4;
+        *bclen -= (num_words - ((num_words > 0) ? 1 : 0)) * 4;
+        return 0;
+    }
+    num_words -= 1;
+
+    free(directory_offsets);
+    directory_offsets = (Uint32 *) malloc((count ? count : 1) * sizeof (Uint32));
+    num_directory_offsets = 0;
+    if (directory_offsets == NULL) {
+        fprintf(stderr, "%s: Out of memory\n", fname);
+        *bytecode += num_words * 4;
+        *bclen -= num_words * 4;
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        directory_offsets[i] = readui32(bytecode, bclen);
+    }
+    num_directory_offsets = count;
+    num_words -= count;
+
+    num_buckets = readui32(bytecode, bclen);
+    num_words--;
+    if ((num_buckets & (num_buckets - 1)) || (num_buckets > (num_words / 2))) {
+        fprintf(stderr, "%s: Directory has a bad entry point table (%u buckets), corrupt file?\n", fname, (unsigned int) num_buckets);
+        *bytecode += num_words * 4;
+        *bclen -= num_words * 4;
+        return 0;
+    }
+
+    printf("DIRECTORY\n");
+    for (i = 0; i < count; i++) {
+        print_indent(1);
+        printf("$%u at byte %u\n", (unsigned int) i, (unsigned int) directory_offsets[i]);
+    }
+
+    for (i = 0; i < num_buckets; i++) {
+        const Uint32 hash = readui32(bytecode, bclen);
+        const Uint32 fn = readui32(bytecode, bclen);
+        const char *name;
+        if (fn == SDL_SHADER_BYTECODE_NO_FUNCTION) {
+            continue;
+        }
+
+        name = (fn < count) ? directory_function_name(file, filelen, directory_offsets[fn]) : NULL;
+        print_indent(1);
+        if (name == NULL) {
+            fprintf(stderr, "%s: Directory entry point in bucket %u is function #%u, which isn't there, corrupt file?\n", fname, (unsigned int) i, (unsigned int) fn);
+            printf("??? -> $%u\n", (unsigned int) fn);
+            retval = 0;
+        } else {
+            printf("%s -> $%u\n", name, (unsigned int) fn);
+            if (hash != SDL_SHADER_BytecodeHashName(name)) {
+                fprintf(stderr, "%s: Directory has the wrong hash for entry point '%s', corrupt file?\n", fname, name);
+                retval = 0;
+            }
+        }
+    }
+    printf("ENDDIRECTORY\n\n");
+
+    num_words -= num_buckets * 2;
+
+    /* skip anything newer versions added. */
+    *bytecode += num_words * 4;
+    *bclen -= num_words * 4;
+    return retval;
 }
 
 static int dump_bytecode_from_buffer(const char *fname, Uint8 *bytecode, size_t bclen)
 {
+    const Uint8 *file = bytecode;
+    const size_t filelen = bclen;
+    SDL_bool seen_types = SDL_FALSE;
     int retval = 1;
     Uint32 version;
     Uint32 crc32;
@@ -536,35 +993,65 @@ static int dump_bytecode_from_buffer(const char *fname, Uint8 *bytecode, size_t
     } else if (memcmp(bytecode, SDL_SHADER_BYTECODE_MAGIC, 12) != 0) {
         fprintf(stderr, "%s: not a shader bytecode file (wrong magic)\n", fname);
         return 0;
-    } else if ((version = readui32(&bytecode, &bclen)) > SDL_SHADER_BYTECODE_VERSION) {
+    }
+
+    bytecode += 12;
+    bclen -= 12;
+
+    if ((version = readui32(&bytecode, &bclen)) > SDL_SHADER_BYTECODE_VERSION) {
         fprintf(stderr, "%s: shader bytecode format %u is not supported\n", fname, (unsigned int) version);
         return 0;
     }
 
     crc32 = readui32(&bytecode, &bclen);
 
-    crc32_init(&actual_crc32);
-    crc32_append(&actual_crc32, bytecode, bclen);
-    crc32_finish(&actual_crc32);
+    bytecode_version = version;
+    num_type_names = 0;
+    num_directory_offsets = 0;
+
+    actual_crc32 = SDL_SHADER_BytecodeCrc32(0, bytecode, bclen);
 
-    printf("%s: shader bytecode format %u, crc32 0x%X (checksum is %s)\n\n", fname, (unsigned int) version, (unsigned int) crc32, (crc32 == actual_crc32) ? "good" : "BAD");
+    printf("%s: shader bytecode format %u, crc32 0x%X (checksum is %s)\n", fname, (unsigned int) version, (unsigned int) crc32, (crc32 == actual_crc32) ? "good" : "BAD");
+
+    /* dump it either way, since that's the best way to see what's wrong with it. */
+    if (version < 3) {
+        printf("verifier: format is too old to verify\n\n");
+    } else {
+        char errbuf[256];
+        if (SDL_SHADER_VerifyBytecode(file, filelen, errbuf, sizeof (errbuf))) {
+            printf("verifier: okay\n\n");
+        } else {
+            printf("verifier: %s\n\n", errbuf);
+            retval = 0;
+        }
+    }
 
     while (bclen >= 8) {
         const Uint32 tag = readui32(&bytecode, &bclen);
         const Uint32 num_words = readui32(&bytecode, &bclen);
         const size_t remaining_bytes = (((size_t) num_words) - 2) * 4;
-        if (remaining_bytes > bclen) {
+        if ((num_words < 2) || (remaining_bytes > bclen)) {
             fprintf(stderr, "%s: section with tag %u goes past eof, corrupt file?\n", fname, (unsigned int) tag);
             retval = 0;
             bclen = 0;
             break;
+        } else if ((tag == SDL_SHADER_BCTAG_DIRECTORY) && (version >= 4) && !seen_types && (fnid == 0)) {
+            if (!dump_bytecode_directory(fname, file, filelen, &bytecode, &bclen, num_words)) { retval = 0; break; }
+        } else if ((tag == SDL_SHADER_BCTAG_TYPES) && (version >= 3) && !seen_types && (fnid == 0)) {
+            if (!dump_bytecode_types(fname, &bytecode, &bclen, num_words)) { retval = 0; break; }
+            seen_types = SDL_TRUE;
         } else if (tag == SDL_SHADER_BCTAG_FUNCTION) {
-            if (!dump_bytecode_function(fnid, fname, &bytecode, &bclen, num_words)) { retval = 0; break; }
+            const Uint32 offset = (Uint32) ((bytecode - 8) - file);
+            if ((fnid < num_directory_offsets) && (directory_offsets[fnid] != offset)) {
+                fprintf(stderr, "%s: Directory says function #%u is at byte %u, but it's at %u, corrupt file?\n", fname, (unsigned int) fnid, (unsigned int) directory_offsets[fnid], (unsigned int) offset);
+                retval = 0;
+            }
+            if (!dump_bytecode_function(version, fnid, fname, &bytecode, &bclen, num_words)) { retval = 0; break; }
             fnid++;
         /*} else if (tag == SDL_SHADER_BCTAG_DEBUGTABLE) {   !!! FIXME
             if (!dump_bytecode_debug_table(fname, bytecode, bclen, num_words)) { retval = 0; break; }*/
         } else {
-            fprintf(stderr, "%s: Unexpected tag %u (should have been function or debug table), corrupt file? Skipping section.\n", fname, (unsigned int) tag);
+            fprintf(stderr, "%s: Unexpected tag %u (should have been directory, types, function or debug table), corrupt file? Skipping section.\n", fname, (unsigned int) tag);
             retval = 0;
             bclen -= remaining_bytes;
             bytecode += remaining_bytes;
@@ -577,6 +1064,11 @@ static int dump_bytecode_from_buffer(const char *fname, Uint8 *bytecode, size_t
         retval = 0;
     }
 
+    if (num_directory_offsets && (fnid != num_directory_offsets)) {
+        fprintf(stderr, "%s: Directory lists %u functions, but there are %u, corrupt file?\n", fname, (unsigned int) num_directory_offsets, (unsigned int) fnid);
+        retval = 0;
+    }
+
     return retval;
 }
 
@@ -598,6 +1090,8 @@ static int dump_bytecode_from_stdio(const char *fname, FILE *io)
             return 0;
         }
 
+        bytecode = (Uint8 *) ptr;
+
         br = fread(bytecode + allocated, 1, blocklen, io);
         allocated += br;
         if (br < blocklen) {
@@ -644,6 +1138,8 @@ int main(int argc, char **argv)
         }
     }
 
+    free(type_names);
+    free(directory_offsets);
     return retval;
 }
 
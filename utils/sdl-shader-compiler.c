@@ -1078,13 +1078,30 @@ static int ast_xml(const SDL_SHADER_CompilerParams *params, const char *outfile,
     return retval;
 }
 
-static int compile(const SDL_SHADER_CompilerParams *params, const char *outfile, FILE *io)
+static void print_optimization_stats(const SDL_SHADER_OptimizationStats *stats, const size_t stats_count)
+{
+    size_t i;
+    for (i = 0; i < stats_count; i++) {
+        fprintf(stderr, "%s: %.3fms, %s, %u -> %u instructions\n",
+                stats[i].pass,
+                ((double) stats[i].nanoseconds) / 1000000.0,
+                stats[i].changed ? "changed" : "unchanged",
+                (unsigned int) stats[i].instructions_before,
+                (unsigned int) stats[i].instructions_after);
+    }
+}
+
+static int compile(const SDL_SHADER_CompilerParams *params, const char *outfile, FILE *io, SDL_bool show_stats)
 {
     const SDL_SHADER_CompileData *cd;
     int retval = 0;
 
     cd = SDL_SHADER_Compile(params);
 
+    if (show_stats) {
+        print_optimization_stats(cd->optimization_stats, cd->optimization_stats_count);
+    }
+
     if (cd->error_count > 0) {
         print_errors(cd->errors, cd->error_count);
     } else {
@@ -1123,6 +1140,7 @@ int main(int argc, char **argv)
     int retval = 1;
     const char *outfile = NULL;
     FILE *outio = NULL;
+    SDL_bool show_stats = SDL_FALSE;
     int i;
 
     SDL_zero(params);
@@ -1187,6 +1205,66 @@ int main(int argc, char **argv)
                 fail("no filename after '-o'");
             }
             outfile = arg;
+        } else if (strcmp(arg, "-j") == 0) {
+            arg = argv[++i];
+            if (arg == NULL) {
+                fail("no thread count after '-j'");
+            }
+            params.worker_threads = atoi(arg);
+        } else if (strcmp(arg, "-u") == 0) {
+            arg = argv[++i];
+            if (arg == NULL) {
+                fail("no policy after '-u'");
+            } else if (strcmp(arg, "analyze") == 0) {
+                params.unreachable_functions = SDL_SHADER_UNREACHABLE_ANALYZE;
+            } else if (strcmp(arg, "check") == 0) {
+                params.unreachable_functions = SDL_SHADER_UNREACHABLE_CHECK;
+            } else if (strcmp(arg, "skip") == 0) {
+                params.unreachable_functions = SDL_SHADER_UNREACHABLE_SKIP;
+            } else {
+                fail("'-u' must be followed by 'analyze', 'check', or 'skip'");
+            }
+        } else if (strcmp(arg, "-O") == 0) {
+            params.optimization_level = 2;
+        } else if ((strncmp(arg, "-O", 2) == 0) && (arg[2] >= '0') && (arg[2] <= '9') && (arg[3] == '\0')) {
+            params.optimization_level = arg[2] - '0';
+        } else if (strcmp(arg, "-ffast-math") == 0) {
+            params.fast_math = SDL_SHADER_FASTMATH_ALL;
+        } else if (strcmp(arg, "-fno-fast-math") == 0) {
+            params.fast_math = SDL_SHADER_FASTMATH_NONE;
+        } else if (strcmp(arg, "-fassociative-math") == 0) {
+            params.fast_math |= SDL_SHADER_FASTMATH_REASSOCIATE;
+        } else if (strcmp(arg, "-freciprocal-math") == 0) {
+            params.fast_math |= SDL_SHADER_FASTMATH_RECIPROCAL;
+        } else if (strcmp(arg, "-fno-honor-nans") == 0) {
+            params.fast_math |= SDL_SHADER_FASTMATH_NO_NANS;
+        } else if (strcmp(arg, "-fno-honor-infinities") == 0) {
+            params.fast_math |= SDL_SHADER_FASTMATH_NO_INFS;
+        } else if (strcmp(arg, "-ffinite-math-only") == 0) {
+            params.fast_math |= SDL_SHADER_FASTMATH_NO_NANS | SDL_SHADER_FASTMATH_NO_INFS;
+        } else if (strcmp(arg, "-ffp-contract=fast") == 0) {
+            params.fast_math |= SDL_SHADER_FASTMATH_CONTRACT;
+        } else if (strcmp(arg, "-ffp-contract=off") == 0) {
+            params.fast_math &= ~SDL_SHADER_FASTMATH_CONTRACT;
+        } else if (strcmp(arg, "-fhalf-precision") == 0) {
+            params.half_precision_tolerance = SDL_SHADER_HALF_TOLERANCE_COLOR;
+        } else if (strncmp(arg, "-fhalf-precision=", 17) == 0) {
+            params.half_precision_tolerance = (float) atof(arg + 17);
+            if (params.half_precision_tolerance <= 0.0f) {
+                fail("'-fhalf-precision=' needs a tolerance greater than zero");
+            }
+        } else if (strcmp(arg, "-fno-half-precision") == 0) {
+            params.half_precision_tolerance = 0.0f;
+        } else if (strcmp(arg, "-fmatrix-multiply=native") == 0) {
+            params.matrix_multiply = SDL_SHADER_MATRIX_MULTIPLY_NATIVE;
+        } else if (strcmp(arg, "-fmatrix-multiply=dot") == 0) {
+            params.matrix_multiply = SDL_SHADER_MATRIX_MULTIPLY_DOT;
+        } else if (strcmp(arg, "-fmatrix-multiply=mad") == 0) {
+            params.matrix_multiply = SDL_SHADER_MATRIX_MULTIPLY_MAD;
+        } else if (strncmp(arg, "-fmatrix-multiply=", 18) == 0) {
+            fail("'-fmatrix-multiply=' must be followed by 'native', 'dot', or 'mad'");
+        } else if (strcmp(arg, "--pass-stats") == 0) {
+            show_stats = SDL_TRUE;
         } else if (strcmp(arg, "-I") == 0) {
             arg = argv[++i];
             if (arg == NULL) {
@@ -1264,7 +1342,7 @@ int main(int argc, char **argv)
     } else if (action == ACTION_AST_XML) {
         retval = (!ast_xml(&params, outfile, outio));
     } else if (action == ACTION_COMPILE) {
-        retval = (!compile(&params, outfile, outio));
+        retval = (!compile(&params, outfile, outio, show_stats));
     }
 
     if ((retval != 0) && (outfile != NULL)) {